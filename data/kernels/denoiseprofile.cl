@@ -366,9 +366,11 @@ denoiseprofile_finish_v2(read_only image2d_t in, global float4* U2, write_only i
 
 
 
+// the backtransforms also do the wavelet synthesis: they add the coarsest scale to the
+// sum of the thresholded details in accu, which saves a pass over the image.
 kernel void
-denoiseprofile_backtransform(read_only image2d_t in, write_only image2d_t out, const int width, const int height,
-                             const float4 a, const float4 sigma2)
+denoiseprofile_backtransform(read_only image2d_t coarse, global const float4 *accu, write_only image2d_t out,
+                             const int width, const int height, const float4 a, const float4 sigma2)
 {
   const int x = get_global_id(0);
   const int y = get_global_id(1);
@@ -376,8 +378,9 @@ denoiseprofile_backtransform(read_only image2d_t in, write_only image2d_t out, c
 
   if(x >= width || y >= height) return;
 
-  float4 px = read_imagef(in, sampleri, (int2)(x, y));
+  float4 px = read_imagef(coarse, sampleri, (int2)(x, y));
   const float alpha = px.w;
+  px += accu[gidx];
 
   px = (px < (float4)0.5f ? (float4)0.0f :
     0.25f*px*px + 0.25f*sqrt(1.5f)/px - 1.375f/(px*px) + 0.625f*sqrt(1.5f)/(px*px*px) - 0.125f - sigma2);
@@ -390,8 +393,9 @@ denoiseprofile_backtransform(read_only image2d_t in, write_only image2d_t out, c
 
 
 kernel void
-denoiseprofile_backtransform_v2(read_only image2d_t in, write_only image2d_t out, const int width, const int height,
-                             const float4 a, const float4 p, const float4 b, const float bias, const float4 wb)
+denoiseprofile_backtransform_v2(read_only image2d_t coarse, global const float4 *accu, write_only image2d_t out,
+                                const int width, const int height, const float4 a, const float4 p, const float4 b,
+                                const float bias, const float4 wb)
 {
   const int x = get_global_id(0);
   const int y = get_global_id(1);
@@ -399,8 +403,9 @@ denoiseprofile_backtransform_v2(read_only image2d_t in, write_only image2d_t out
 
   if(x >= width || y >= height) return;
 
-  float4 px = read_imagef(in, sampleri, (int2)(x, y));
+  float4 px = read_imagef(coarse, sampleri, (int2)(x, y));
   const float alpha = px.w;
+  px += accu[gidx];
 
   px = fmax((float4)0.0f, px);
   const float4 delta = px * px + (float4)bias;
@@ -414,8 +419,9 @@ denoiseprofile_backtransform_v2(read_only image2d_t in, write_only image2d_t out
 }
 
 kernel void
-denoiseprofile_backtransform_Y0U0V0(read_only image2d_t in, write_only image2d_t out, const int width, const int height,
-                             const float4 a, const float4 p, const float4 b, const float bias, const float4 wb, global float *toRGB)
+denoiseprofile_backtransform_Y0U0V0(read_only image2d_t coarse, global const float4 *accu, write_only image2d_t out,
+                                    const int width, const int height, const float4 a, const float4 p,
+                                    const float4 b, const float bias, const float4 wb, global float *toRGB)
 {
   const int x = get_global_id(0);
   const int y = get_global_id(1);
@@ -423,8 +429,9 @@ denoiseprofile_backtransform_Y0U0V0(read_only image2d_t in, write_only image2d_t
 
   if(x >= width || y >= height) return;
 
-  const float4 t = read_imagef(in, sampleri, (int2)(x, y));
-  const float alpha = t.w;
+  const float4 c = read_imagef(coarse, sampleri, (int2)(x, y));
+  const float alpha = c.w;
+  const float4 t = c + accu[gidx];
 
   float4 px = (float4)0.0f;
   px.x += toRGB[0] * t.x;
@@ -461,8 +468,10 @@ weight(const float4 c1, const float4 c2, const float inv_sigma2)
 }
 
 
+// the detail coefficients are never stored: they are the difference of the fine
+// and coarse images, recomputed by the reduction and the accumulation below.
 kernel void
-denoiseprofile_decompose(read_only image2d_t in, write_only image2d_t coarse, write_only image2d_t detail,
+denoiseprofile_decompose(read_only image2d_t in, write_only image2d_t coarse,
      const int width, const int height, const unsigned int scale, const float inv_sigma2, global const float *filter)
 {
   const int x = get_global_id(0);
@@ -492,35 +501,30 @@ denoiseprofile_decompose(read_only image2d_t in, write_only image2d_t coarse, wr
   sum /= wgt;
   sum.w = pixel.w;
 
-  write_imagef (detail, (int2)(x, y), pixel - sum);
   write_imagef (coarse, (int2)(x, y), sum);
 }
 
 
+// add the thresholded detail coefficients fine - coarse of one scale to the running sum in accu
 kernel void
-denoiseprofile_synthesize(read_only image2d_t coarse, read_only image2d_t detail, write_only image2d_t out,
-     const int width, const int height,
-     const float t0, const float t1, const float t2, const float t3,
-     const float b0, const float b1, const float b2, const float b3)
+denoiseprofile_accumulate(read_only image2d_t fine, read_only image2d_t coarse, global float4 *accu,
+     const int width, const int height, const float4 threshold, const float4 boost, const int first)
 {
   const int x = get_global_id(0);
   const int y = get_global_id(1);
 
   if(x >= width || y >= height) return;
 
-  const float4 threshold = (float4)(t0, t1, t2, t3);
-  const float4 boost     = (float4)(b0, b1, b2, b3);
-  float4 c = read_imagef(coarse, sampleri, (int2)(x, y));
-  float4 d = read_imagef(detail, sampleri, (int2)(x, y));
+  const int k = mad24(y, width, x);
+  float4 d = read_imagef(fine, sampleri, (int2)(x, y)) - read_imagef(coarse, sampleri, (int2)(x, y));
   float4 amount = copysign(max((float4)(0.0f), fabs(d) - threshold), d);
-  float4 sum = c + boost*amount;
-  sum.w = c.w;
-  write_imagef (out, (int2)(x, y), sum);
+  accu[k] = (first ? (float4)(0.0f) : accu[k]) + boost*amount;
 }
 
 
+// sum of the squared detail coefficients fine - coarse, per work group
 kernel void
-denoiseprofile_reduce_first(read_only image2d_t in, const int width, const int height,
+denoiseprofile_reduce_first(read_only image2d_t fine, read_only image2d_t coarse, const int width, const int height,
                             global float4 *accu, local float4 *buffer)
 {
   const int x = get_global_id(0);
@@ -533,7 +537,7 @@ denoiseprofile_reduce_first(read_only image2d_t in, const int width, const int h
   const int l = mad24(ylid, xlsz, xlid);
 
   const int isinimage = (x < width && y < height);
-  float4 pixel = read_imagef(in, sampleri, (int2)(x, y));
+  float4 pixel = read_imagef(fine, sampleri, (int2)(x, y)) - read_imagef(coarse, sampleri, (int2)(x, y));
 
   buffer[l] = isinimage ? pixel*pixel : (float4)0.0f;
 
@@ -333,3 +333,68 @@ inpaint_mask(write_only image2d_t inpainted, read_only image2d_t original,
 
   write_imagef(inpainted, (int2)(x, y), pix_out);
 }
+
+kernel void
+diffuse_downsample(read_only image2d_t in, write_only image2d_t out,
+                   read_only image2d_t mask_in, write_only image2d_t mask_out, const int has_mask,
+                   const int width, const int height, const int coarse_width, const int coarse_height)
+{
+  // average 2×2 blocks of pixels. A coarse pixel belongs to the inpainting mask if any of its pixels does.
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= coarse_width || y >= coarse_height) return;
+
+  const int x0 = 2 * x;
+  const int x1 = min(2 * x + 1, width - 1);
+  const int y0 = 2 * y;
+  const int y1 = min(2 * y + 1, height - 1);
+
+  const float4 pix_out = 0.25f * (read_imagef(in, samplerA, (int2)(x0, y0)) + read_imagef(in, samplerA, (int2)(x1, y0))
+                                  + read_imagef(in, samplerA, (int2)(x0, y1)) + read_imagef(in, samplerA, (int2)(x1, y1)));
+  write_imagef(out, (int2)(x, y), pix_out);
+
+  if(has_mask)
+  {
+    const unsigned int m = read_imageui(mask_in, samplerA, (int2)(x0, y0)).x | read_imageui(mask_in, samplerA, (int2)(x1, y0)).x
+                           | read_imageui(mask_in, samplerA, (int2)(x0, y1)).x | read_imageui(mask_in, samplerA, (int2)(x1, y1)).x;
+    write_imageui(mask_out, (int2)(x, y), m);
+  }
+}
+
+kernel void
+diffuse_upsample(read_only image2d_t in, read_only image2d_t coarse_in, read_only image2d_t coarse_out,
+                 read_only image2d_t mask, const int has_mask, write_only image2d_t out,
+                 const int width, const int height, const int coarse_width, const int coarse_height)
+{
+  // start a level from its own input plus what the iterations changed on the coarser level,
+  // interpolated bilinearly. Outside of the inpainting mask, the input is kept as is.
+  const int x = get_global_id(0);
+  const int y = get_global_id(1);
+
+  if(x >= width || y >= height) return;
+
+  const float4 pix_in = read_imagef(in, samplerA, (int2)(x, y));
+  if(has_mask && !read_imageui(mask, samplerA, (int2)(x, y)).x)
+  {
+    write_imagef(out, (int2)(x, y), pix_in);
+    return;
+  }
+
+  const float fxc = 0.5f * x - 0.25f;
+  const float fyc = 0.5f * y - 0.25f;
+  const int x0 = clamp((int)floor(fxc), 0, coarse_width - 1);
+  const int x1 = min(x0 + 1, coarse_width - 1);
+  const int y0 = clamp((int)floor(fyc), 0, coarse_height - 1);
+  const int y1 = min(y0 + 1, coarse_height - 1);
+  const float fx = clamp(fxc - x0, 0.f, 1.f);
+  const float fy = clamp(fyc - y0, 0.f, 1.f);
+
+  const float4 d00 = read_imagef(coarse_out, samplerA, (int2)(x0, y0)) - read_imagef(coarse_in, samplerA, (int2)(x0, y0));
+  const float4 d01 = read_imagef(coarse_out, samplerA, (int2)(x1, y0)) - read_imagef(coarse_in, samplerA, (int2)(x1, y0));
+  const float4 d10 = read_imagef(coarse_out, samplerA, (int2)(x0, y1)) - read_imagef(coarse_in, samplerA, (int2)(x0, y1));
+  const float4 d11 = read_imagef(coarse_out, samplerA, (int2)(x1, y1)) - read_imagef(coarse_in, samplerA, (int2)(x1, y1));
+  const float4 delta = (1.f - fx) * (1.f - fy) * d00 + fx * (1.f - fy) * d01 + (1.f - fx) * fy * d10 + fx * fy * d11;
+
+  write_imagef(out, (int2)(x, y), fmax(pix_in + delta, 0.f));
+}
@@ -20,7 +20,7 @@
 
 kernel void
 lut3d_tetrahedral(read_only image2d_t in, write_only image2d_t out, const int width, const int height,
-           global float *clut, const int level)
+           global float4 *clut, const int level)
 {
   int4 rgbi = (int4)(0);
   float4 rgbd = (float4)(0.0f);
@@ -43,24 +43,24 @@ lut3d_tetrahedral(read_only image2d_t in, write_only image2d_t out, const int wi
 
 // indexes of P000 to P111 in clut
   const int color = rgbi.x + rgbi.y * level + rgbi.z * level2;
-  const int i000 = color * 3 ;  // P000
-  const int i100 = i000 + 3;  // P100
-  const int i010 = (int)(color + level) * 3;  // P010
-  const int i110 = i010 + 3;  //P110
-  const int i001 = (int)(color + level2) * 3;  // P001
-  const int i101 = i001 + 3;  // P101
-  const int i011 = (int)(color + level + level2) * 3;  // P011
-  const int i111 = i011 + 3;  // P111
-
-// float3 are 16 bytes aligned. So no way to set clut as an array of float3.
-  const float4 clut000 = (float4)(clut[i000], clut[i000+1], clut[i000+2], 0.0f);
-  const float4 clut100 = (float4)(clut[i100], clut[i100+1], clut[i100+2], 0.0f);
-  const float4 clut010 = (float4)(clut[i010], clut[i010+1], clut[i010+2], 0.0f);
-  const float4 clut110 = (float4)(clut[i110], clut[i110+1], clut[i110+2], 0.0f);
-  const float4 clut001 = (float4)(clut[i001], clut[i001+1], clut[i001+2], 0.0f);
-  const float4 clut101 = (float4)(clut[i101], clut[i101+1], clut[i101+2], 0.0f);
-  const float4 clut011 = (float4)(clut[i011], clut[i011+1], clut[i011+2], 0.0f);
-  const float4 clut111 = (float4)(clut[i111], clut[i111+1], clut[i111+2], 0.0f);
+  const int i000 = color;  // P000
+  const int i100 = i000 + 1;  // P100
+  const int i010 = color + level;  // P010
+  const int i110 = i010 + 1;  //P110
+  const int i001 = color + level2;  // P001
+  const int i101 = i001 + 1;  // P101
+  const int i011 = color + level + level2;  // P011
+  const int i111 = i011 + 1;  // P111
+
+  // the nodes are padded to 4 floats
+  const float4 clut000 = clut[i000];
+  const float4 clut100 = clut[i100];
+  const float4 clut010 = clut[i010];
+  const float4 clut110 = clut[i110];
+  const float4 clut001 = clut[i001];
+  const float4 clut101 = clut[i101];
+  const float4 clut011 = clut[i011];
+  const float4 clut111 = clut[i111];
 
   if (rgbd.x > rgbd.y)
   {
@@ -98,7 +98,7 @@ lut3d_tetrahedral(read_only image2d_t in, write_only image2d_t out, const int wi
 
 kernel void
 lut3d_trilinear(read_only image2d_t in, write_only image2d_t out, const int width, const int height,
-           global float *clut, const uint level)
+           global float4 *clut, const uint level)
 {
   int4 rgbi = (int4)(0);
   float4 rgbd = (float4)(0.0f);
@@ -123,24 +123,24 @@ lut3d_trilinear(read_only image2d_t in, write_only image2d_t out, const int widt
 
   // indexes of P000 to P111 in clut
   const int color = rgbi.x + rgbi.y * level + rgbi.z * level2;
-  const int i000 = color * 3 ;  // P000
-  const int i100 = i000 + 3;  // P100
-  const int i010 = (int)(color + level) * 3;  // P010
-  const int i110 = i010 + 3;  //P110
-  const int i001 = (int)(color + level2) * 3;  // P001
-  const int i101 = i001 + 3;  // P101
-  const int i011 = (int)(color + level + level2) * 3;  // P011
-  const int i111 = i011 + 3;  // P111
-
-  // float3 are 16 bytes aligned. So no way to set clut as an array of float3.
-  const float4 clut000 = (float4)(clut[i000], clut[i000+1], clut[i000+2], 0.0f);
-  const float4 clut100 = (float4)(clut[i100], clut[i100+1], clut[i100+2], 0.0f);
-  const float4 clut010 = (float4)(clut[i010], clut[i010+1], clut[i010+2], 0.0f);
-  const float4 clut110 = (float4)(clut[i110], clut[i110+1], clut[i110+2], 0.0f);
-  const float4 clut001 = (float4)(clut[i001], clut[i001+1], clut[i001+2], 0.0f);
-  const float4 clut101 = (float4)(clut[i101], clut[i101+1], clut[i101+2], 0.0f);
-  const float4 clut011 = (float4)(clut[i011], clut[i011+1], clut[i011+2], 0.0f);
-  const float4 clut111 = (float4)(clut[i111], clut[i111+1], clut[i111+2], 0.0f);
+  const int i000 = color;  // P000
+  const int i100 = i000 + 1;  // P100
+  const int i010 = color + level;  // P010
+  const int i110 = i010 + 1;  //P110
+  const int i001 = color + level2;  // P001
+  const int i101 = i001 + 1;  // P101
+  const int i011 = color + level + level2;  // P011
+  const int i111 = i011 + 1;  // P111
+
+  // the nodes are padded to 4 floats
+  const float4 clut000 = clut[i000];
+  const float4 clut100 = clut[i100];
+  const float4 clut010 = clut[i010];
+  const float4 clut110 = clut[i110];
+  const float4 clut001 = clut[i001];
+  const float4 clut101 = clut[i101];
+  const float4 clut011 = clut[i011];
+  const float4 clut111 = clut[i111];
 
   tmp1 = clut000*(1.0f-rgbd.x) + clut100*rgbd.x;
   tmp2 = clut010*(1.0f-rgbd.x) + clut110*rgbd.x;
@@ -156,7 +156,7 @@ lut3d_trilinear(read_only image2d_t in, write_only image2d_t out, const int widt
 
 kernel void
 lut3d_pyramid(read_only image2d_t in, write_only image2d_t out, const int width, const int height,
-           global float *clut, const uint level)
+           global float4 *clut, const uint level)
 {
   int4 rgbi = (int4)(0);
   float4 rgbd = (float4)(0.0f);
@@ -179,24 +179,24 @@ lut3d_pyramid(read_only image2d_t in, write_only image2d_t out, const int width,
 
   // indexes of P000 to P111 in clut
   const int color = rgbi.x + rgbi.y * level + rgbi.z * level2;
-  const int i000 = color * 3 ;  // P000
-  const int i100 = i000 + 3;  // P100
-  const int i010 = (int)(color + level) * 3;  // P010
-  const int i110 = i010 + 3;  //P110
-  const int i001 = (int)(color + level2) * 3;  // P001
-  const int i101 = i001 + 3;  // P101
-  const int i011 = (int)(color + level + level2) * 3;  // P011
-  const int i111 = i011 + 3;  // P111
-
-  // float3 are 16 bytes aligned. So no way to set clut as an array of float3.
-  const float4 clut000 = (float4)(clut[i000], clut[i000+1], clut[i000+2], 0.0f);
-  const float4 clut100 = (float4)(clut[i100], clut[i100+1], clut[i100+2], 0.0f);
-  const float4 clut010 = (float4)(clut[i010], clut[i010+1], clut[i010+2], 0.0f);
-  const float4 clut110 = (float4)(clut[i110], clut[i110+1], clut[i110+2], 0.0f);
-  const float4 clut001 = (float4)(clut[i001], clut[i001+1], clut[i001+2], 0.0f);
-  const float4 clut101 = (float4)(clut[i101], clut[i101+1], clut[i101+2], 0.0f);
-  const float4 clut011 = (float4)(clut[i011], clut[i011+1], clut[i011+2], 0.0f);
-  const float4 clut111 = (float4)(clut[i111], clut[i111+1], clut[i111+2], 0.0f);
+  const int i000 = color;  // P000
+  const int i100 = i000 + 1;  // P100
+  const int i010 = color + level;  // P010
+  const int i110 = i010 + 1;  //P110
+  const int i001 = color + level2;  // P001
+  const int i101 = i001 + 1;  // P101
+  const int i011 = color + level + level2;  // P011
+  const int i111 = i011 + 1;  // P111
+
+  // the nodes are padded to 4 floats
+  const float4 clut000 = clut[i000];
+  const float4 clut100 = clut[i100];
+  const float4 clut010 = clut[i010];
+  const float4 clut110 = clut[i110];
+  const float4 clut001 = clut[i001];
+  const float4 clut101 = clut[i101];
+  const float4 clut011 = clut[i011];
+  const float4 clut111 = clut[i111];
 
   if (rgbd.y > rgbd.x && rgbd.z > rgbd.x)
   {
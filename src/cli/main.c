@@ -754,7 +754,8 @@ int main(int argc, char *arg[])
   }
 
   // cleanup time
-  if(storage->finalize_store) storage->finalize_store(storage, sdata);
+  if(storage->finalize_store && storage->finalize_store(storage, sdata) != 0)
+    res = 1;
   storage->free_params(storage, sdata);
   format->free_params(format, fdata);
   g_list_free(id_list);
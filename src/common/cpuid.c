@@ -44,6 +44,10 @@ dt_cpu_flags_t dt_detect_cpu_features()
   g_mutex_lock(&lock);
   if(__get_cpuid(0x00000000,&ax,&bx,&cx,&dx))
   {
+    const guint32 max_leaf = ax;
+    // the wide registers are only usable if the OS saves them on context switches
+    gboolean os_ymm = FALSE, os_zmm = FALSE;
+
     /* Request for standard features */
     if(__get_cpuid(0x00000001,&ax,&bx,&cx,&dx))
     {
@@ -57,7 +61,25 @@ dt_cpu_flags_t dt_detect_cpu_features()
       if(cx & 0x00040000) cpuflags |= CPU_FLAG_SSE4_1;
       if(cx & 0x00080000) cpuflags |= CPU_FLAG_SSE4_2;
 
-      if(cx & 0x08000000) cpuflags |= CPU_FLAG_AVX;
+      if(cx & 0x10000000) cpuflags |= CPU_FLAG_AVX;
+      if(cx & 0x00001000) cpuflags |= CPU_FLAG_FMA;
+
+      if(cx & 0x08000000) // OSXSAVE
+      {
+        guint32 xcr0_lo, xcr0_hi;
+        __asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        os_ymm = (xcr0_lo & 0x06) == 0x06;
+        os_zmm = (xcr0_lo & 0xe6) == 0xe6;
+      }
+      if(!os_ymm) cpuflags &= ~(CPU_FLAG_AVX | CPU_FLAG_FMA);
+    }
+
+    /* Structured extended features */
+    if(max_leaf >= 7)
+    {
+      __cpuid_count(0x00000007, 0, ax, bx, cx, dx);
+      if((bx & 0x00000020) && os_ymm) cpuflags |= CPU_FLAG_AVX2;
+      if((bx & 0x00010000) && os_zmm) cpuflags |= CPU_FLAG_AVX512F;
     }
 
     /* Are there extensions? */
@@ -41,6 +41,7 @@
 #include "common/cpuid.h"
 #include "common/file_location.h"
 #include "common/film.h"
+#include "common/gaussian.h"
 #include "common/grealpath.h"
 #include "common/image.h"
 #include "common/image_cache.h"
@@ -53,6 +54,7 @@
 #include "common/points.h"
 #include "common/resource_limits.h"
 #include "common/undo.h"
+#include "common/wavelet_cache.h"
 #include "control/conf.h"
 #include "control/control.h"
 #include "control/crawler.h"
@@ -61,6 +63,7 @@
 #include "control/signal.h"
 #include "develop/blend.h"
 #include "develop/imageop.h"
+#include "develop/masks.h"
 #include "gui/accelerators.h"
 #include "gui/gtk.h"
 #include "gui/guides.h"
@@ -305,15 +308,27 @@ static void dt_codepaths_init()
   {
 #ifdef HAVE_BUILTIN_CPU_SUPPORTS
     darktable.codepath.SSE2 = (__builtin_cpu_supports("sse") && __builtin_cpu_supports("sse2"));
+#ifdef DT_HAVE_AVX_KERNELS
+    darktable.codepath.AVX2 = __builtin_cpu_supports("avx2");
+    darktable.codepath.AVX512 = __builtin_cpu_supports("avx512f");
+#endif
 #else
     dt_cpu_flags_t flags = dt_detect_cpu_features();
     darktable.codepath.SSE2 = ((flags & (CPU_FLAG_SSE)) && (flags & (CPU_FLAG_SSE2)));
+#ifdef DT_HAVE_AVX_KERNELS
+    darktable.codepath.AVX2 = (flags & CPU_FLAG_AVX2) != 0;
+    darktable.codepath.AVX512 = (flags & CPU_FLAG_AVX512F) != 0;
+#endif
 #endif
   }
 
   // second, apply overrides from conf
   // NOTE: all intrinsics sets can only be overridden to OFF
   if(!dt_conf_get_bool("codepaths/sse2")) darktable.codepath.SSE2 = 0;
+  if(!dt_conf_get_bool("codepaths/avx2")) darktable.codepath.AVX2 = 0;
+  if(!dt_conf_get_bool("codepaths/avx512")) darktable.codepath.AVX512 = 0;
+  // the wide kernels fall back to the SSE2 ones for image borders and leftovers
+  if(!darktable.codepath.SSE2) darktable.codepath.AVX2 = darktable.codepath.AVX512 = 0;
 
   // last: do we have any intrinsics sets enabled?
   darktable.codepath._no_intrinsics = !(darktable.codepath.SSE2);
@@ -1400,6 +1415,9 @@ void dt_cleanup()
   free(darktable.image_cache);
   dt_mipmap_cache_cleanup(darktable.mipmap_cache);
   free(darktable.mipmap_cache);
+  dt_masks_cache_cleanup();
+  dt_wavelet_cache_cleanup();
+  dt_gaussian_pool_cleanup();
   if(init_gui)
   {
     dt_control_cleanup(darktable.control);
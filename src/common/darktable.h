@@ -139,6 +139,20 @@ typedef unsigned int u_int;
 #define __DT_CLONE_TARGETS__
 #endif
 
+/* Wider versions of hand-written SSE2 kernels, built for one target and selected at runtime through
+ * darktable.codepath. FMA contraction is kept off, so with strict IEEE math they give the same bits as the SSE2
+ * code they replace. -ffast-math lets the compiler reassociate each variant differently, the last bits may
+ * then differ. */
+#if defined(__SSE2__) && (defined(__x86_64__) || defined(__x86_64)) && __has_attribute(target) && !defined(_WIN32)
+#define DT_HAVE_AVX_KERNELS 1
+#define __DT_TARGET_AVX2__ __attribute__((target("avx2")))
+# if defined(__clang__)
+#define __DT_TARGET_AVX512__ __attribute__((target("avx512f")))
+# else
+#define __DT_TARGET_AVX512__ __attribute__((target("avx512f"), optimize("fp-contract=off")))
+# endif
+#endif
+
 /* Helper to force stack vectors to be aligned on 64 bits blocks to enable AVX2 */
 #define DT_IS_ALIGNED(x) __builtin_assume_aligned(x, 64)
 
@@ -277,6 +291,8 @@ typedef enum dt_debug_thread_t
 typedef struct dt_codepath_t
 {
   unsigned int SSE2 : 1;
+  unsigned int AVX2 : 1;
+  unsigned int AVX512 : 1;
   unsigned int _no_intrinsics : 1;
   unsigned int OPENMP_SIMD : 1; // always stays the last one
 } dt_codepath_t;
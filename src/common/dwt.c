@@ -18,6 +18,7 @@
 
 #include "common/darktable.h"
 #include "common/imagebuf.h"
+#include "common/wavelet_cache.h"
 #include "control/control.h"
 #include "develop/imageop.h"
 #include "dwt.h"
@@ -48,6 +49,7 @@ dwt_params_t *dt_dwt_init(float *image, const int width, const int height, const
   p->user_data = user_data;
   p->preview_scale = preview_scale;
   p->use_sse = use_sse;
+  p->cache_key = 0;
 
   return p;
 }
@@ -225,6 +227,8 @@ static void dwt_wavelet_decompose(float *img, dwt_params_t *const p, _dwt_layer_
   float *layers = NULL;
   float *merged_layers = NULL;
   float *buffer[2] = { 0, 0 };
+  const dt_wavelet_cache_entry_t *cached = NULL;
+  dt_wavelet_cache_entry_t *fill = NULL;
   int bcontinue = 1;
   const size_t size = (size_t)p->width * p->height * p->ch;
 
@@ -234,6 +238,18 @@ static void dwt_wavelet_decompose(float *img, dwt_params_t *const p, _dwt_layer_
 
   if(p->scales <= 0) goto cleanup;
 
+  // an input decomposed before gets its scales from the cache, a new one is stored there if the whole image
+  // will be reconstructed (a preview of a single scale stops half way)
+  cached = p->cache_key ? dt_wavelet_cache_get(p->cache_key) : NULL;
+  if(cached && (cached->width != p->width || cached->height != p->height || cached->ch != p->ch
+                || cached->scales != p->scales))
+  {
+    dt_wavelet_cache_release(cached);
+    cached = NULL;
+  }
+  if(p->cache_key && !cached && p->return_layer == 0)
+    fill = dt_wavelet_cache_new(p->cache_key, DT_WAVELET_DWT, p->width, p->height, p->ch, p->scales);
+
   /* image buffers */
   buffer[0] = img;
   /* temporary storage */
@@ -267,7 +283,13 @@ static void dwt_wavelet_decompose(float *img, dwt_params_t *const p, _dwt_layer_
   {
     unsigned int lpass = (1 - (lev & 1));
 
-    dwt_decompose_layer(buffer[lpass], buffer[hpass], temp, lev, p);
+    if(cached)
+      memcpy(buffer[hpass], cached->layers[lev], sizeof(float) * size);
+    else
+    {
+      dwt_decompose_layer(buffer[lpass], buffer[hpass], temp, lev, p);
+      if(fill) memcpy(fill->layers[lev], buffer[hpass], sizeof(float) * size);
+    }
 
     // no merge scales or we didn't reach the merge scale from yet
     if(p->merge_from_scale == 0 || p->merge_from_scale > lev + 1)
@@ -315,6 +337,15 @@ static void dwt_wavelet_decompose(float *img, dwt_params_t *const p, _dwt_layer_
   // all scales have been processed
   if(bcontinue)
   {
+    if(cached)
+      memcpy(buffer[hpass], cached->layers[p->scales], sizeof(float) * size);
+    else if(fill)
+    {
+      memcpy(fill->layers[p->scales], buffer[hpass], sizeof(float) * size);
+      dt_wavelet_cache_publish(fill);
+      fill = NULL;
+    }
+
     // allow to process residual image
     if(layer_func) layer_func(buffer[hpass], p, p->scales + 1);
 
@@ -346,6 +377,8 @@ static void dwt_wavelet_decompose(float *img, dwt_params_t *const p, _dwt_layer_
   }
 
 cleanup:
+  dt_wavelet_cache_release(cached);
+  dt_wavelet_cache_release(fill);
   if(temp) dt_free_align(temp);
   if(layers) dt_free_align(layers);
   if(merged_layers) dt_free_align(merged_layers);
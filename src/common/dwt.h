@@ -19,6 +19,8 @@
 #ifndef DT_DEVELOP_DWT_H
 #define DT_DEVELOP_DWT_H
 
+#include <stdint.h>
+
 /* structure returned by dt_dwt_init() to be used when calling dwt_decompose() */
 typedef struct dwt_params_t
 {
@@ -32,6 +34,7 @@ typedef struct dwt_params_t
   void *user_data;
   float preview_scale;
   int use_sse;
+  uint64_t cache_key;
 } dwt_params_t;
 
 /* function prototype for the layer_func on dwt_decompose() call */
@@ -47,6 +50,8 @@ typedef void(_dwt_layer_func)(float *layer, dwt_params_t *const p, const int sca
  * user_data: user-supplied data to be passed to layer_func on each call
  * preview_scale: image scale (zoom factor)
  * use_sse: use SSE instructions
+ * the scales are taken from and stored into the wavelet cache (common/wavelet_cache.h) if cache_key is set
+ * afterwards, which is only correct if layer_func leaves the image itself (scale 0) untouched
  */
 dwt_params_t *dt_dwt_init(float *image, const int width, const int height, const int ch, const int scales,
                           const int return_layer, const int merge_from_scale, void *user_data,
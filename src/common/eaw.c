@@ -297,6 +297,174 @@ void eaw_decompose_sse2(float *const restrict out, const float *const restrict i
 }
 #endif
 
+#ifdef DT_HAVE_AVX_KERNELS
+/* The wide kernels below process two (AVX2) or four (AVX-512) pixels per instruction in the bulk of the image,
+ * with the very same operations in the same order as the SSE2 ones, so their output is bit-identical. The
+ * image borders, where neighbours have to be clamped, and the leftover pixels of each row go through the SSE2
+ * code one pixel at a time. */
+
+// one pixel of eaw_decompose_sse2, with clamping on both edges
+static inline void _eaw_decompose_pixel_sse2(float *const restrict out, const float *const restrict in,
+                                             float *const restrict detail, const int i, const size_t j,
+                                             const int mult, const float sharpen, const int32_t width,
+                                             const int32_t height)
+{
+  static const float filter[5] = { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
+  const __m128 *px = ((__m128 *)in) + i + j * width;
+  const __m128 *px2;
+  float *pdetail = detail + 4 * (i + j * width);
+  float *pcoarse = out + 4 * (i + j * width);
+
+  SUM_PIXEL_PROLOGUE_SSE;
+  for(int jj = 0; jj < 5; jj++)
+  {
+    const int y = j + mult * (jj - 2);
+    const int clamp_y = CLAMP(y, 0, height - 1);
+    for(int ii = 0; ii < 5; ii++)
+    {
+      const int x = i + mult * (ii - 2);
+      const int clamp_x = CLAMP(x, 0, width - 1);
+      px2 = ((__m128 *)in) + clamp_x + (size_t)clamp_y * width;
+      SUM_PIXEL_CONTRIBUTION_SSE(ii, jj);
+    }
+  }
+  SUM_PIXEL_EPILOGUE_SSE;
+}
+
+// same initialiser as o111: being a float vector, its lanes hold the bits of -1.0f rather than all ones, and
+// the wide kernels have to mask with exactly that to match weight_sse2()
+static const __m256 o111_avx2 DT_ALIGNED_ARRAY = { ~0, ~0, ~0, 0, ~0, ~0, ~0, 0 };
+static const __m512 o111_avx512 DT_ALIGNED_ARRAY = { ~0, ~0, ~0, 0, ~0, ~0, ~0, 0, ~0, ~0, ~0, 0, ~0, ~0, ~0, 0 };
+
+static inline __DT_TARGET_AVX2__ __m256 _weight_avx2(const __m256 c1, const __m256 c2, const float sharpen)
+{
+  const __m256 diff = c1 - c2;
+  const __m256 square = diff * diff;
+  const __m256 square2 = _mm256_shuffle_ps(square, square, _MM_SHUFFLE(3, 1, 2, 0));
+  const __m256 added = square + square2;
+  const __m256 added_l = added - square;
+  const __m256 d = _mm256_blend_ps(added, added_l, 0x11);        // (?, d2+d3, d2+d3, d1) for both pixels
+  const __m256 sharpened = d * _mm256_set1_ps(-sharpen);
+  return dt_fast_expf_avx2(_mm256_and_ps(sharpened, o111_avx2));
+}
+
+__DT_TARGET_AVX2__
+void eaw_decompose_avx2(float *const restrict out, const float *const restrict in, float *const restrict detail,
+                        const int scale, const float sharpen, const int32_t width, const int32_t height)
+{
+  const int mult = 1 << scale;
+  static const float filter[5] = { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
+  const int boundary = 2 * mult;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(detail, filter, height, in, sharpen, mult, boundary, out, width) \
+  schedule(static)
+#endif
+  for(int rowid = 0; rowid < height; rowid++)
+  {
+    const size_t j = dwt_interleave_rows(rowid, height, mult);
+    const int lbound = (j < boundary || j >= height - boundary) ? width - boundary : boundary;
+
+    int i;
+    for(i = 0; i < lbound; i++) _eaw_decompose_pixel_sse2(out, in, detail, i, j, mult, sharpen, width, height);
+
+    for(; i + 2 <= width - boundary; i += 2)
+    {
+      const __m256 px = _mm256_loadu_ps(in + 4 * (i + j * width));
+      const float *px2 = in + 4 * (i - 2 * mult + (j - 2 * mult) * width);
+      __m256 sum = _mm256_setzero_ps();
+      __m256 wgt = _mm256_setzero_ps();
+      for(int jj = 0; jj < 5; jj++)
+      {
+        for(int ii = 0; ii < 5; ii++)
+        {
+          const float f = filter[ii] * filter[jj];
+          const __m256 p2 = _mm256_loadu_ps(px2);
+          const __m256 wp = _weight_avx2(px, p2, sharpen);
+          const __m256 w = f * wp;
+          const __m256 pd = p2 * w;
+          sum = sum + pd;
+          wgt = wgt + w;
+          px2 += 4 * mult;
+        }
+        px2 += 4 * (width - 5) * mult;
+      }
+      sum = sum / wgt;
+      _mm256_storeu_ps(detail + 4 * (i + j * width), px - sum);
+      _mm256_storeu_ps(out + 4 * (i + j * width), sum);
+    }
+
+    for(; i < width; i++) _eaw_decompose_pixel_sse2(out, in, detail, i, j, mult, sharpen, width, height);
+  }
+  _mm_sfence();
+}
+
+static inline __DT_TARGET_AVX512__ __m512 _weight_avx512(const __m512 c1, const __m512 c2, const float sharpen)
+{
+  const __m512 diff = c1 - c2;
+  const __m512 square = diff * diff;
+  const __m512 square2 = _mm512_shuffle_ps(square, square, _MM_SHUFFLE(3, 1, 2, 0));
+  const __m512 added = square + square2;
+  const __m512 d = _mm512_mask_sub_ps(added, 0x1111, added, square);
+  const __m512 sharpened = d * _mm512_set1_ps(-sharpen);
+  const __m512i masked = _mm512_and_si512(_mm512_castps_si512(sharpened), _mm512_castps_si512(o111_avx512));
+  return dt_fast_expf_avx512(_mm512_castsi512_ps(masked));
+}
+
+__DT_TARGET_AVX512__
+void eaw_decompose_avx512(float *const restrict out, const float *const restrict in, float *const restrict detail,
+                          const int scale, const float sharpen, const int32_t width, const int32_t height)
+{
+  const int mult = 1 << scale;
+  static const float filter[5] = { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
+  const int boundary = 2 * mult;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(detail, filter, height, in, sharpen, mult, boundary, out, width) \
+  schedule(static)
+#endif
+  for(int rowid = 0; rowid < height; rowid++)
+  {
+    const size_t j = dwt_interleave_rows(rowid, height, mult);
+    const int lbound = (j < boundary || j >= height - boundary) ? width - boundary : boundary;
+
+    int i;
+    for(i = 0; i < lbound; i++) _eaw_decompose_pixel_sse2(out, in, detail, i, j, mult, sharpen, width, height);
+
+    for(; i + 4 <= width - boundary; i += 4)
+    {
+      const __m512 px = _mm512_loadu_ps(in + 4 * (i + j * width));
+      const float *px2 = in + 4 * (i - 2 * mult + (j - 2 * mult) * width);
+      __m512 sum = _mm512_setzero_ps();
+      __m512 wgt = _mm512_setzero_ps();
+      for(int jj = 0; jj < 5; jj++)
+      {
+        for(int ii = 0; ii < 5; ii++)
+        {
+          const float f = filter[ii] * filter[jj];
+          const __m512 p2 = _mm512_loadu_ps(px2);
+          const __m512 wp = _weight_avx512(px, p2, sharpen);
+          const __m512 w = f * wp;
+          const __m512 pd = p2 * w;
+          sum = sum + pd;
+          wgt = wgt + w;
+          px2 += 4 * mult;
+        }
+        px2 += 4 * (width - 5) * mult;
+      }
+      sum = sum / wgt;
+      _mm512_storeu_ps(detail + 4 * (i + j * width), px - sum);
+      _mm512_storeu_ps(out + 4 * (i + j * width), sum);
+    }
+
+    for(; i < width; i++) _eaw_decompose_pixel_sse2(out, in, detail, i, j, mult, sharpen, width, height);
+  }
+  _mm_sfence();
+}
+#endif // DT_HAVE_AVX_KERNELS
+
 void eaw_synthesize(float *const out, const float *const in, const float *const restrict detail,
                     const float *const restrict threshold, const float *const restrict boost,
                     const int32_t width, const int32_t height)
@@ -351,6 +519,86 @@ void eaw_synthesize_sse2(float *const out, const float *const in, const float *c
 }
 #endif
 
+#ifdef DT_HAVE_AVX_KERNELS
+// same sign trick as eaw_synthesize_sse2, on one pixel
+static inline void _eaw_synthesize_pixel_sse2(float *const out, const float *const in,
+                                              const float *const restrict detail, const __m128 threshold,
+                                              const __m128 boost, const size_t j)
+{
+  const __m128i maski = _mm_set1_epi32(0x80000000u);
+  const __m128 mask = _mm_castsi128_ps(maski);
+  const __m128 pdetail = _mm_load_ps(detail + 4 * j);
+  const __m128 absamt = _mm_max_ps(_mm_setzero_ps(), _mm_andnot_ps(mask, pdetail) - threshold);
+  const __m128 amount = _mm_or_ps(_mm_and_ps(pdetail, mask), absamt);
+  const __m128 boosted = boost * amount;
+  _mm_stream_ps(out + 4 * j, _mm_load_ps(in + 4 * j) + boosted);
+}
+
+__DT_TARGET_AVX2__
+void eaw_synthesize_avx2(float *const out, const float *const in, const float *const restrict detail,
+                         const float *const restrict thrsf, const float *const restrict boostf,
+                         const int32_t width, const int32_t height)
+{
+  const __m128 threshold4 = _mm_load_ps(thrsf);
+  const __m128 boost4 = _mm_load_ps(boostf);
+  const __m256 threshold = _mm256_insertf128_ps(_mm256_castps128_ps256(threshold4), threshold4, 1);
+  const __m256 boost = _mm256_insertf128_ps(_mm256_castps128_ps256(boost4), boost4, 1);
+  const __m256 mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000u));
+  const size_t npixels = (size_t)width * height;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(boost, detail, in, out, threshold, mask, npixels) \
+  schedule(static)
+#endif
+  for(size_t j = 0; j < npixels / 2; j++)
+  {
+    const __m256 pdetail = _mm256_loadu_ps(detail + 8 * j);
+    const __m256 absamt = _mm256_max_ps(_mm256_setzero_ps(), _mm256_andnot_ps(mask, pdetail) - threshold);
+    const __m256 amount = _mm256_or_ps(_mm256_and_ps(pdetail, mask), absamt);
+    const __m256 boosted = boost * amount;
+    _mm256_storeu_ps(out + 8 * j, _mm256_loadu_ps(in + 8 * j) + boosted);
+  }
+
+  for(size_t j = npixels & ~(size_t)1; j < npixels; j++)
+    _eaw_synthesize_pixel_sse2(out, in, detail, threshold4, boost4, j);
+  _mm_sfence();
+}
+
+__DT_TARGET_AVX512__
+void eaw_synthesize_avx512(float *const out, const float *const in, const float *const restrict detail,
+                           const float *const restrict thrsf, const float *const restrict boostf,
+                           const int32_t width, const int32_t height)
+{
+  const __m128 threshold4 = _mm_load_ps(thrsf);
+  const __m128 boost4 = _mm_load_ps(boostf);
+  const __m512 threshold = _mm512_broadcast_f32x4(threshold4);
+  const __m512 boost = _mm512_broadcast_f32x4(boost4);
+  const __m512i mask = _mm512_set1_epi32(0x80000000u);
+  const size_t npixels = (size_t)width * height;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(boost, detail, in, out, threshold, mask, npixels) \
+  schedule(static)
+#endif
+  for(size_t j = 0; j < npixels / 4; j++)
+  {
+    const __m512i pdetail = _mm512_castps_si512(_mm512_loadu_ps(detail + 16 * j));
+    const __m512 magnitude = _mm512_castsi512_ps(_mm512_andnot_si512(mask, pdetail));
+    const __m512 absamt = _mm512_max_ps(_mm512_setzero_ps(), magnitude - threshold);
+    const __m512 amount
+        = _mm512_castsi512_ps(_mm512_or_si512(_mm512_and_si512(pdetail, mask), _mm512_castps_si512(absamt)));
+    const __m512 boosted = boost * amount;
+    _mm512_storeu_ps(out + 16 * j, _mm512_loadu_ps(in + 16 * j) + boosted);
+  }
+
+  for(size_t j = npixels & ~(size_t)3; j < npixels; j++)
+    _eaw_synthesize_pixel_sse2(out, in, detail, threshold4, boost4, j);
+  _mm_sfence();
+}
+#endif // DT_HAVE_AVX_KERNELS
+
 // =====================================================================================
 // begin wavelet code from denoiseprofile.c
 // =====================================================================================
@@ -648,10 +896,228 @@ void eaw_dn_decompose_sse(float *const restrict out, const float *const restrict
   _mm_sfence();
 }
 
+#ifdef DT_HAVE_AVX_KERNELS
+// one pixel of eaw_dn_decompose_sse, with clamping on both edges
+static inline void _eaw_dn_decompose_pixel_sse(float *const restrict out, const float *const restrict in,
+                                               float *const restrict detail, _aligned_pixel *sum_sq,
+                                               const int i, const size_t j, const int mult,
+                                               const float inv_sigma2, const int32_t width,
+                                               const int32_t height)
+{
+  static const float filter[5] = { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
+  const __m128 *px = ((__m128 *)in) + i + j * width;
+  const __m128 *px2;
+  float *pdetail = detail + 4 * (i + j * width);
+  float *pcoarse = out + 4 * (i + j * width);
+
+  SUM_PIXEL_PROLOGUE_SSE;
+  for(int jj = 0; jj < 5; jj++)
+  {
+    const int y = j + mult * (jj - 2);
+    const int clamp_y = CLAMP(y, 0, height - 1);
+    for(int ii = 0; ii < 5; ii++)
+    {
+      const int x = i + mult * (ii - 2);
+      const int clamp_x = CLAMP(x, 0, width - 1);
+      px2 = ((__m128 *)in) + clamp_x + (size_t)clamp_y * width;
+      SUM_PIXEL_CONTRIBUTION_SSE(ii, jj);
+    }
+  }
+  sum = sum / wgt;
+  _mm_stream_ps(pcoarse, sum);
+  sum = *px - sum;
+  _mm_stream_ps(pdetail, sum);
+  const __m128 sqr = sum * sum;
+  sum_sq->sse = sum_sq->sse + sqr;
+}
+
+// the weight is a scalar per pixel, computed exactly like dn_weight_sse
+static inline float _dn_weight_lane(const float *const sqr, const float inv_sigma2)
+{
+  const float dot = (sqr[0] + sqr[1] + sqr[2]) * inv_sigma2;
+  const float var = 0.02f;
+  const float off2 = 9.0f;
+  const float scaled = dot * var;
+  return fast_mexp2f(MAX(0, scaled - off2));
+}
+
+__DT_TARGET_AVX2__
+void eaw_dn_decompose_avx2(float *const restrict out, const float *const restrict in, float *const restrict detail,
+                           dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
+                           const int32_t width, const int32_t height)
+{
+  const int mult = 1u << scale;
+  static const float filter[5] = { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
+  const int boundary = 2 * mult;
+
+  _aligned_pixel sum_sq = { .v = { 0.0f } };
+
+#if !(defined(__apple_build_version__) && __apple_build_version__ < 11030000) //makes Xcode 11.3.1 compiler crash
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(detail, filter, height, in, inv_sigma2, mult, boundary, out, width) \
+  reduction(vsum: sum_sq) \
+  schedule(static)
+#endif
+#endif
+  for(int rowid = 0; rowid < height; rowid++)
+  {
+    const size_t j = dwt_interleave_rows(rowid, height, mult);
+    const int lbound = (j < boundary || j >= height - boundary) ? width - boundary : boundary;
+
+    int i;
+    for(i = 0; i < lbound; i++)
+      _eaw_dn_decompose_pixel_sse(out, in, detail, &sum_sq, i, j, mult, inv_sigma2, width, height);
+
+    for(; i + 2 <= width - boundary; i += 2)
+    {
+      const __m256 px = _mm256_loadu_ps(in + 4 * (i + j * width));
+      const float *px2 = in + 4 * (i - 2 * mult + (j - 2 * mult) * width);
+      __m256 sum = _mm256_setzero_ps();
+      __m256 wgt = _mm256_setzero_ps();
+      for(int jj = 0; jj < 5; jj++)
+      {
+        for(int ii = 0; ii < 5; ii++)
+        {
+          const float f = filter[ii] * filter[jj];
+          const __m256 p2 = _mm256_loadu_ps(px2);
+          const __m256 diff = px - p2;
+          dt_aligned_pixel_t sqr[2];
+          _mm256_storeu_ps(sqr[0], diff * diff);
+          const __m128 w0 = _mm_set1_ps(f * _dn_weight_lane(sqr[0], inv_sigma2));
+          const __m128 w1 = _mm_set1_ps(f * _dn_weight_lane(sqr[1], inv_sigma2));
+          const __m256 w = _mm256_insertf128_ps(_mm256_castps128_ps256(w0), w1, 1);
+          const __m256 pd = p2 * w;
+          sum = sum + pd;
+          wgt = wgt + w;
+          px2 += 4 * mult;
+        }
+        px2 += 4 * (width - 5) * mult;
+      }
+      sum = sum / wgt;
+      _mm256_storeu_ps(out + 4 * (i + j * width), sum);
+      const __m256 det = px - sum;
+      _mm256_storeu_ps(detail + 4 * (i + j * width), det);
+      // accumulate pixel by pixel, in the order of the SSE2 code
+      const __m256 det2 = det * det;
+      sum_sq.sse = sum_sq.sse + _mm256_castps256_ps128(det2);
+      sum_sq.sse = sum_sq.sse + _mm256_extractf128_ps(det2, 1);
+    }
+
+    for(; i < width; i++)
+      _eaw_dn_decompose_pixel_sse(out, in, detail, &sum_sq, i, j, mult, inv_sigma2, width, height);
+  }
+  _mm_store_ps(sum_squared, sum_sq.sse);
+  _mm_sfence();
+}
+
+__DT_TARGET_AVX512__
+void eaw_dn_decompose_avx512(float *const restrict out, const float *const restrict in,
+                             float *const restrict detail, dt_aligned_pixel_t sum_squared, const int scale,
+                             const float inv_sigma2, const int32_t width, const int32_t height)
+{
+  const int mult = 1u << scale;
+  static const float filter[5] = { 1.0f / 16.0f, 4.0f / 16.0f, 6.0f / 16.0f, 4.0f / 16.0f, 1.0f / 16.0f };
+  const int boundary = 2 * mult;
+
+  _aligned_pixel sum_sq = { .v = { 0.0f } };
+
+#if !(defined(__apple_build_version__) && __apple_build_version__ < 11030000) //makes Xcode 11.3.1 compiler crash
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(detail, filter, height, in, inv_sigma2, mult, boundary, out, width) \
+  reduction(vsum: sum_sq) \
+  schedule(static)
+#endif
+#endif
+  for(int rowid = 0; rowid < height; rowid++)
+  {
+    const size_t j = dwt_interleave_rows(rowid, height, mult);
+    const int lbound = (j < boundary || j >= height - boundary) ? width - boundary : boundary;
+
+    int i;
+    for(i = 0; i < lbound; i++)
+      _eaw_dn_decompose_pixel_sse(out, in, detail, &sum_sq, i, j, mult, inv_sigma2, width, height);
+
+    for(; i + 4 <= width - boundary; i += 4)
+    {
+      const __m512 px = _mm512_loadu_ps(in + 4 * (i + j * width));
+      const float *px2 = in + 4 * (i - 2 * mult + (j - 2 * mult) * width);
+      __m512 sum = _mm512_setzero_ps();
+      __m512 wgt = _mm512_setzero_ps();
+      for(int jj = 0; jj < 5; jj++)
+      {
+        for(int ii = 0; ii < 5; ii++)
+        {
+          const float f = filter[ii] * filter[jj];
+          const __m512 p2 = _mm512_loadu_ps(px2);
+          const __m512 diff = px - p2;
+          dt_aligned_pixel_t sqr[4];
+          _mm512_storeu_ps(sqr[0], diff * diff);
+          const float w0 = f * _dn_weight_lane(sqr[0], inv_sigma2);
+          const float w1 = f * _dn_weight_lane(sqr[1], inv_sigma2);
+          const float w2 = f * _dn_weight_lane(sqr[2], inv_sigma2);
+          const float w3 = f * _dn_weight_lane(sqr[3], inv_sigma2);
+          const __m512 w = _mm512_setr_ps(w0, w0, w0, w0, w1, w1, w1, w1, w2, w2, w2, w2, w3, w3, w3, w3);
+          const __m512 pd = p2 * w;
+          sum = sum + pd;
+          wgt = wgt + w;
+          px2 += 4 * mult;
+        }
+        px2 += 4 * (width - 5) * mult;
+      }
+      sum = sum / wgt;
+      _mm512_storeu_ps(out + 4 * (i + j * width), sum);
+      const __m512 det = px - sum;
+      _mm512_storeu_ps(detail + 4 * (i + j * width), det);
+      const __m512 det2 = det * det;
+      sum_sq.sse = sum_sq.sse + _mm512_extractf32x4_ps(det2, 0);
+      sum_sq.sse = sum_sq.sse + _mm512_extractf32x4_ps(det2, 1);
+      sum_sq.sse = sum_sq.sse + _mm512_extractf32x4_ps(det2, 2);
+      sum_sq.sse = sum_sq.sse + _mm512_extractf32x4_ps(det2, 3);
+    }
+
+    for(; i < width; i++)
+      _eaw_dn_decompose_pixel_sse(out, in, detail, &sum_sq, i, j, mult, inv_sigma2, width, height);
+  }
+  _mm_store_ps(sum_squared, sum_sq.sse);
+  _mm_sfence();
+}
+#endif // DT_HAVE_AVX_KERNELS
+
 #undef SUM_PIXEL_CONTRIBUTION_SSE
 #undef SUM_PIXEL_PROLOGUE_SSE
 #undef SUM_PIXEL_EPILOGUE_SSE
 #endif
+#if defined(__SSE2__)
+eaw_decompose_t eaw_select_decompose()
+{
+#ifdef DT_HAVE_AVX_KERNELS
+  if(darktable.codepath.AVX512) return eaw_decompose_avx512;
+  if(darktable.codepath.AVX2) return eaw_decompose_avx2;
+#endif
+  return eaw_decompose_sse2;
+}
+
+eaw_synthesize_t eaw_select_synthesize()
+{
+#ifdef DT_HAVE_AVX_KERNELS
+  if(darktable.codepath.AVX512) return eaw_synthesize_avx512;
+  if(darktable.codepath.AVX2) return eaw_synthesize_avx2;
+#endif
+  return eaw_synthesize_sse2;
+}
+
+eaw_dn_decompose_t eaw_select_dn_decompose()
+{
+#ifdef DT_HAVE_AVX_KERNELS
+  if(darktable.codepath.AVX512) return eaw_dn_decompose_avx512;
+  if(darktable.codepath.AVX2) return eaw_dn_decompose_avx2;
+#endif
+  return eaw_dn_decompose_sse;
+}
+#endif
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
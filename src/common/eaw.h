@@ -51,6 +51,32 @@ void eaw_dn_decompose(float *const restrict out, const float *const restrict in,
 void eaw_dn_decompose_sse(float *const restrict out, const float *const restrict in, float *const restrict detail,
                           dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
                           const int32_t width, const int32_t height);
+
+#ifdef DT_HAVE_AVX_KERNELS
+void eaw_decompose_avx2(float *const restrict out, const float *const restrict in, float *const restrict detail,
+                        const int scale, const float sharpen, const int32_t width, const int32_t height);
+void eaw_decompose_avx512(float *const restrict out, const float *const restrict in, float *const restrict detail,
+                          const int scale, const float sharpen, const int32_t width, const int32_t height);
+void eaw_synthesize_avx2(float *const restrict out, const float *const restrict in, const float *const restrict detail,
+                         const float *const restrict thrsf, const float *const restrict boostf,
+                         const int32_t width, const int32_t height);
+void eaw_synthesize_avx512(float *const restrict out, const float *const restrict in, const float *const restrict detail,
+                           const float *const restrict thrsf, const float *const restrict boostf,
+                           const int32_t width, const int32_t height);
+void eaw_dn_decompose_avx2(float *const restrict out, const float *const restrict in, float *const restrict detail,
+                           dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
+                           const int32_t width, const int32_t height);
+void eaw_dn_decompose_avx512(float *const restrict out, const float *const restrict in, float *const restrict detail,
+                             dt_aligned_pixel_t sum_squared, const int scale, const float inv_sigma2,
+                             const int32_t width, const int32_t height);
+#endif
+
+#if defined(__SSE2__)
+// the widest variant of the SSE2 kernels enabled in darktable.codepath, for the process_sse2() paths
+eaw_decompose_t eaw_select_decompose();
+eaw_synthesize_t eaw_select_synthesize();
+eaw_dn_decompose_t eaw_select_dn_decompose();
+#endif
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -65,8 +65,9 @@
  * - average of guide
  * - variance of guide
  * - average of mask
- * - covariance of mask and guide. */
-static inline void eigf_variance_analysis(const float *const restrict guide, // I
+ * - covariance of mask and guide.
+ * returns 0 on success, 1 for lack of memory. */
+static inline int eigf_variance_analysis(const float *const restrict guide, // I
                                     const float *const restrict mask, //p
                                     float *const restrict out,
                                     const size_t width, const size_t height,
@@ -75,6 +76,7 @@ static inline void eigf_variance_analysis(const float *const restrict guide, //
   // We also use gaussian blurs instead of the square blurs of the guided filter
   const size_t Ndim = width * height;
   float *const restrict in = dt_alloc_sse_ps(Ndim * 4);
+  if(!in) return 1;
 
   float ming = 10000000.0f;
   float maxg = 0.0f;
@@ -114,7 +116,11 @@ dt_omp_firstprivate(guide, mask, in, Ndim) \
   dt_aligned_pixel_t max = {maxg, maxg2, maxm, maxmg};
   dt_aligned_pixel_t min = {ming, ming2, minm, minmg};
   dt_gaussian_t *g = dt_gaussian_init(width, height, 4, max, min, sigma, 0);
-  if(!g) return;
+  if(!g)
+  {
+    dt_free_align(in);
+    return 1;
+  }
   dt_gaussian_blur_4c(g, in, out);
   dt_gaussian_free(g);
 
@@ -130,11 +136,12 @@ dt_omp_firstprivate(out, Ndim) \
   }
 
   dt_free_align(in);
+  return 0;
 }
 
 // same function as above, but specialized for the case where guide == mask
 // for increased performance
-static inline void eigf_variance_analysis_no_mask(const float *const restrict guide, // I
+static inline int eigf_variance_analysis_no_mask(const float *const restrict guide, // I
                                     float *const restrict out,
                                     const size_t width, const size_t height,
                                     const float sigma)
@@ -142,6 +149,7 @@ static inline void eigf_variance_analysis_no_mask(const float *const restrict gu
   // We also use gaussian blurs instead of the square blurs of the guided filter
   const size_t Ndim = width * height;
   float *const restrict in = dt_alloc_sse_ps(Ndim * 2);
+  if(!in) return 1;
 
   float ming = 10000000.0f;
   float maxg = 0.0f;
@@ -169,7 +177,11 @@ dt_omp_firstprivate(guide, in, Ndim) \
   float max[2] = {maxg, maxg2};
   float min[2] = {ming, ming2};
   dt_gaussian_t *g = dt_gaussian_init(width, height, 2, max, min, sigma, 0);
-  if(!g) return;
+  if(!g)
+  {
+    dt_free_align(in);
+    return 1;
+  }
   dt_gaussian_blur(g, in, out);
   dt_gaussian_free(g);
 
@@ -185,78 +197,122 @@ dt_omp_firstprivate(out, Ndim) \
   }
 
   dt_free_align(in);
+  return 0;
+}
+
+static inline float _eigf_blend(const float pixel, const float a, const float b,
+                               const dt_iop_guided_filter_blending_t filter)
+{
+  const float blended = fmaxf(pixel * a + b, MIN_FLOAT);
+  // filter == DT_GF_BLENDING_GEOMEAN takes the geometric mean with the input
+  return (filter == DT_GF_BLENDING_LINEAR) ? blended : sqrtf(pixel * blended);
 }
 
-void eigf_blending(float *const restrict image, const float *const restrict mask,
-                  const float *const restrict av, const size_t Ndim,
-                  const dt_iop_guided_filter_blending_t filter,
-                  const float feathering)
+/* upsamples the averages and variances of ds_av one row at a time and blends the guided image with them.
+ * this is the same as upsampling ds_av to full size first, but never writes nor reads back the 4 full-size
+ * channels. returns 0 on success, 1 if image was left unblended for lack of memory. */
+__DT_CLONE_TARGETS__
+static inline int eigf_blending(float *const restrict image, const float *const restrict mask,
+                                 const float *const restrict ds_av, const size_t width, const size_t height,
+                                 const size_t ds_width, const size_t ds_height,
+                                 const dt_iop_guided_filter_blending_t filter, const float feathering)
 {
+  int err = 0;
+  size_t padded_size;
+  float *const restrict av_rows = dt_alloc_perthread_float(4 * width, &padded_size);
+  dt_bilinear_coord_t *const restrict cols = _bilinear_coords(width, ds_width);
+  if(!av_rows || !cols)
+  {
+    err = 1;
+    goto clean;
+  }
+
 #ifdef _OPENMP
-#pragma omp parallel for simd default(none) \
-  dt_omp_firstprivate(image, mask, av, Ndim, feathering, filter) \
-  schedule(simd:static) aligned(image, mask, av:64)
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(image, mask, ds_av, width, height, ds_width, ds_height, feathering, filter, cols, \
+                      av_rows, padded_size) \
+  schedule(static)
 #endif
-  for(size_t k = 0; k < Ndim; k++)
+  for(size_t i = 0; i < height; i++)
   {
-    const float avg_g = av[k * 4];
-    const float avg_m = av[k * 4 + 2];
-    const float var_g = av[k * 4 + 1];
-    const float covar_mg = av[k * 4 + 3];
-    const float norm_g = fmaxf(avg_g * image[k], 1E-6);
-    const float norm_m = fmaxf(avg_m * mask[k], 1E-6);
-    const float normalized_var_guide = var_g / norm_g;
-    const float normalized_covar = covar_mg / sqrtf(norm_g * norm_m);
-    const float a = normalized_covar / (normalized_var_guide + feathering);
-    const float b = avg_m - a * avg_g;
-    if(filter == DT_GF_BLENDING_LINEAR)
-    {
-      image[k] = fmaxf(image[k] * a + b, MIN_FLOAT);
-    }
-    else
+    float *const restrict av = dt_get_perthread(av_rows, padded_size);
+    _interpolate_bilinear_row(ds_av, ds_width, ds_height, av, width, height, i, cols, 4);
+
+    float *const restrict row = image + i * width;
+    const float *const restrict mask_row = mask + i * width;
+    for(size_t k = 0; k < width; k++)
     {
-      // filter == DT_GF_BLENDING_GEOMEAN
-      image[k] *= fmaxf(image[k] * a + b, MIN_FLOAT);
-      image[k] = sqrtf(image[k]);
+      const float avg_g = av[k * 4];
+      const float avg_m = av[k * 4 + 2];
+      const float var_g = av[k * 4 + 1];
+      const float covar_mg = av[k * 4 + 3];
+      const float norm_g = fmaxf(avg_g * row[k], 1E-6);
+      const float norm_m = fmaxf(avg_m * mask_row[k], 1E-6);
+      const float normalized_var_guide = var_g / norm_g;
+      const float normalized_covar = covar_mg / sqrtf(norm_g * norm_m);
+      const float a = normalized_covar / (normalized_var_guide + feathering);
+      const float b = avg_m - a * avg_g;
+      row[k] = _eigf_blend(row[k], a, b, filter);
     }
   }
+
+clean:
+  if(cols) dt_free_align(cols);
+  if(av_rows) dt_free_align(av_rows);
+  return err;
 }
 
 // same function as above, but specialized for the case where guide == mask
 // for increased performance
-void eigf_blending_no_mask(float *const restrict image,
-                  const float *const restrict av, const size_t Ndim,
-                  const dt_iop_guided_filter_blending_t filter,
-                  const float feathering)
+__DT_CLONE_TARGETS__
+static inline int eigf_blending_no_mask(float *const restrict image, const float *const restrict ds_av,
+                                         const size_t width, const size_t height, const size_t ds_width,
+                                         const size_t ds_height, const dt_iop_guided_filter_blending_t filter,
+                                         const float feathering)
 {
+  int err = 0;
+  size_t padded_size;
+  float *const restrict av_rows = dt_alloc_perthread_float(2 * width, &padded_size);
+  dt_bilinear_coord_t *const restrict cols = _bilinear_coords(width, ds_width);
+  if(!av_rows || !cols)
+  {
+    err = 1;
+    goto clean;
+  }
+
 #ifdef _OPENMP
-#pragma omp parallel for simd default(none) \
-  dt_omp_firstprivate(image, av, Ndim, feathering, filter) \
-  schedule(simd:static) aligned(image, av:64)
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(image, ds_av, width, height, ds_width, ds_height, feathering, filter, cols, av_rows, \
+                      padded_size) \
+  schedule(static)
 #endif
-  for(size_t k = 0; k < Ndim; k++)
+  for(size_t i = 0; i < height; i++)
   {
-    const float avg_g = av[k * 2];
-    const float var_g = av[k * 2 + 1];
-    const float norm_g = fmaxf(avg_g * image[k], 1E-6);
-    const float normalized_var_guide = var_g / norm_g;
-    const float a = normalized_var_guide / (normalized_var_guide + feathering);
-    const float b = avg_g - a * avg_g;
-    if(filter == DT_GF_BLENDING_LINEAR)
-    {
-      image[k] = fmaxf(image[k] * a + b, MIN_FLOAT);
-    }
-    else
+    float *const restrict av = dt_get_perthread(av_rows, padded_size);
+    _interpolate_bilinear_row(ds_av, ds_width, ds_height, av, width, height, i, cols, 2);
+
+    float *const restrict row = image + i * width;
+    for(size_t k = 0; k < width; k++)
     {
-      // filter == DT_GF_BLENDING_GEOMEAN
-      image[k] *= fmaxf(image[k] * a + b, MIN_FLOAT);
-      image[k] = sqrtf(image[k]);
+      const float avg_g = av[k * 2];
+      const float var_g = av[k * 2 + 1];
+      const float norm_g = fmaxf(avg_g * row[k], 1E-6);
+      const float normalized_var_guide = var_g / norm_g;
+      const float a = normalized_var_guide / (normalized_var_guide + feathering);
+      const float b = avg_g - a * avg_g;
+      row[k] = _eigf_blend(row[k], a, b, filter);
     }
   }
+
+clean:
+  if(cols) dt_free_align(cols);
+  if(av_rows) dt_free_align(av_rows);
+  return err;
 }
 
+// returns 0 on success, 1 if image could not be blurred for lack of memory
 __DT_CLONE_TARGETS__
-static inline void fast_eigf_surface_blur(float *const restrict image,
+static inline int fast_eigf_surface_blur(float *const restrict image,
                                       const size_t width, const size_t height,
                                       const float sigma, float feathering, const int iterations,
                                       const dt_iop_guided_filter_blending_t filter, const float scale,
@@ -276,21 +332,22 @@ static inline void fast_eigf_surface_blur(float *const restrict image,
   const size_t num_elem_ds = ds_width * ds_height;
   const size_t num_elem = width * height;
 
-  float *const restrict mask = dt_alloc_sse_ps(dt_round_size_sse(num_elem));
+  int err = 0;
+  // the full size mask is only needed when quantizing
+  float *const restrict mask = (quantization != 0.0f) ? dt_alloc_sse_ps(dt_round_size_sse(num_elem)) : NULL;
   float *const restrict ds_image = dt_alloc_sse_ps(dt_round_size_sse(num_elem_ds));
   float *const restrict ds_mask = dt_alloc_sse_ps(dt_round_size_sse(num_elem_ds));
   // average - variance arrays: store the guide and mask averages and variances
   float *const restrict ds_av = dt_alloc_sse_ps(dt_round_size_sse(num_elem_ds * 4));
-  float *const restrict av = dt_alloc_sse_ps(dt_round_size_sse(num_elem * 4));
 
-  if(!ds_image || !ds_mask || !ds_av || !av)
+  if(!ds_image || !ds_mask || !ds_av || (quantization != 0.0f && !mask))
   {
-    dt_control_log(_("fast exposure independent guided filter failed to allocate memory, check your RAM settings"));
+    err = 1;
     goto clean;
   }
 
   // Iterations of filter models the diffusion, sort of
-  for(int i = 0; i < iterations; i++)
+  for(int i = 0; i < iterations && !err; i++)
   {
     // blend linear for all intermediate images
     dt_iop_guided_filter_blending_t blend = DT_GF_BLENDING_LINEAR;
@@ -298,36 +355,41 @@ static inline void fast_eigf_surface_blur(float *const restrict image,
     if(i == iterations - 1)
       blend = filter;
 
-    interpolate_bilinear(image, width, height, ds_image, ds_width, ds_height, 1);
+    if(interpolate_bilinear(image, width, height, ds_image, ds_width, ds_height, 1))
+    {
+      err = 1;
+      break;
+    }
     if(quantization != 0.0f)
     {
       // (Re)build the mask from the quantized image to help guiding
       quantize(image, mask, width * height, quantization, quantize_min, quantize_max);
       // Downsample the image for speed-up
-      interpolate_bilinear(mask, width, height, ds_mask, ds_width, ds_height, 1);
-      eigf_variance_analysis(ds_mask, ds_image, ds_av, ds_width, ds_height, ds_sigma);
-      // Upsample the variances and averages
-      interpolate_bilinear(ds_av, ds_width, ds_height, av, width, height, 4);
-      // Blend the guided image
-      eigf_blending(image, mask, av, num_elem, blend, feathering);
+      err = interpolate_bilinear(mask, width, height, ds_mask, ds_width, ds_height, 1);
+      if(err) break;
+      err = eigf_variance_analysis(ds_mask, ds_image, ds_av, ds_width, ds_height, ds_sigma);
+      if(err) break;
+      // Upsample the variances and averages and blend the guided image
+      err = eigf_blending(image, mask, ds_av, width, height, ds_width, ds_height, blend, feathering);
     }
     else
     {
       // no need to build a mask.
-      eigf_variance_analysis_no_mask(ds_image, ds_av, ds_width, ds_height, ds_sigma);
-      // Upsample the variances and averages
-      interpolate_bilinear(ds_av, ds_width, ds_height, av, width, height, 2);
-      // Blend the guided image
-      eigf_blending_no_mask(image, av, num_elem, blend, feathering);
+      err = eigf_variance_analysis_no_mask(ds_image, ds_av, ds_width, ds_height, ds_sigma);
+      if(err) break;
+      // Upsample the variances and averages and blend the guided image
+      err = eigf_blending_no_mask(image, ds_av, width, height, ds_width, ds_height, blend, feathering);
     }
   }
 
 clean:
-  if(av) dt_free_align(av);
+  if(err)
+    dt_control_log(_("fast exposure independent guided filter failed to allocate memory, check your RAM settings"));
   if(ds_av) dt_free_align(ds_av);
   if(ds_mask) dt_free_align(ds_mask);
   if(ds_image) dt_free_align(ds_image);
   if(mask) dt_free_align(mask);
+  return err;
 }
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
@@ -1610,6 +1610,50 @@ int dt_exif_read(dt_image_t *img, const char *path)
   }
 }
 
+// merge an exif blob into the metadata of an image, replacing the existing keys
+static void _exif_merge_blob(Exiv2::ExifData &imgExifData, uint8_t *blob, uint32_t size, const int compressed)
+{
+  Exiv2::ExifData blobExifData;
+  Exiv2::ExifParser::decode(blobExifData, blob, size);
+  Exiv2::ExifData::const_iterator end = blobExifData.end();
+  Exiv2::ExifData::iterator it;
+  for(Exiv2::ExifData::const_iterator i = blobExifData.begin(); i != end; ++i)
+  {
+    // add() does not override! we need to delete existing key first.
+    Exiv2::ExifKey key(i->key());
+    if((it = imgExifData.findKey(key)) != imgExifData.end()) imgExifData.erase(it);
+
+    imgExifData.add(Exiv2::ExifKey(i->key()), &i->value());
+  }
+
+  {
+    // Remove thumbnail
+    static const char *keys[] = {
+      "Exif.Thumbnail.Compression",
+      "Exif.Thumbnail.XResolution",
+      "Exif.Thumbnail.YResolution",
+      "Exif.Thumbnail.ResolutionUnit",
+      "Exif.Thumbnail.JPEGInterchangeFormat",
+      "Exif.Thumbnail.JPEGInterchangeFormatLength"
+    };
+    static const guint n_keys = G_N_ELEMENTS(keys);
+    dt_remove_exif_keys(imgExifData, keys, n_keys);
+  }
+
+  // only compressed images may set PixelXDimension and PixelYDimension
+  if(!compressed)
+  {
+    static const char *keys[] = {
+      "Exif.Photo.PixelXDimension",
+      "Exif.Photo.PixelYDimension"
+    };
+    static const guint n_keys = G_N_ELEMENTS(keys);
+    dt_remove_exif_keys(imgExifData, keys, n_keys);
+  }
+
+  imgExifData.sortByTag();
+}
+
 int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path, const int compressed)
 {
   try
@@ -1617,46 +1661,7 @@ int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path, const int
     std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
     assert(image.get() != 0);
     read_metadata_threadsafe(image);
-    Exiv2::ExifData &imgExifData = image->exifData();
-    Exiv2::ExifData blobExifData;
-    Exiv2::ExifParser::decode(blobExifData, blob, size);
-    Exiv2::ExifData::const_iterator end = blobExifData.end();
-    Exiv2::ExifData::iterator it;
-    for(Exiv2::ExifData::const_iterator i = blobExifData.begin(); i != end; ++i)
-    {
-      // add() does not override! we need to delete existing key first.
-      Exiv2::ExifKey key(i->key());
-      if((it = imgExifData.findKey(key)) != imgExifData.end()) imgExifData.erase(it);
-
-      imgExifData.add(Exiv2::ExifKey(i->key()), &i->value());
-    }
-
-    {
-      // Remove thumbnail
-      static const char *keys[] = {
-        "Exif.Thumbnail.Compression",
-        "Exif.Thumbnail.XResolution",
-        "Exif.Thumbnail.YResolution",
-        "Exif.Thumbnail.ResolutionUnit",
-        "Exif.Thumbnail.JPEGInterchangeFormat",
-        "Exif.Thumbnail.JPEGInterchangeFormatLength"
-      };
-      static const guint n_keys = G_N_ELEMENTS(keys);
-      dt_remove_exif_keys(imgExifData, keys, n_keys);
-    }
-
-    // only compressed images may set PixelXDimension and PixelYDimension
-    if(!compressed)
-    {
-      static const char *keys[] = {
-        "Exif.Photo.PixelXDimension",
-        "Exif.Photo.PixelYDimension"
-      };
-      static const guint n_keys = G_N_ELEMENTS(keys);
-      dt_remove_exif_keys(imgExifData, keys, n_keys);
-    }
-
-    imgExifData.sortByTag();
+    _exif_merge_blob(image->exifData(), blob, size, compressed);
     image->writeMetadata();
   }
   catch(Exiv2::AnyError &e)
@@ -4008,247 +4013,368 @@ static void dt_remove_iptc_key(Exiv2::IptcData &iptc, const char *key)
   }
 }
 
-int dt_exif_xmp_attach_export(const int imgid, const char *filename, void *metadata)
+// import the xmp and iptc data of the image into the export metadata: from the original file, the sidecar,
+// the database and the export settings. see dt_exif_xmp_attach_export().
+static void _exif_xmp_attach(Exiv2::Image *img, const int imgid, dt_export_metadata_t *m)
 {
-  dt_export_metadata_t *m = (dt_export_metadata_t *)metadata;
+  char input_filename[PATH_MAX] = { 0 };
+  gboolean from_cache = TRUE;
+  dt_image_full_path(imgid,  input_filename,  sizeof(input_filename),  &from_cache, __FUNCTION__);
+
   try
   {
-    char input_filename[PATH_MAX] = { 0 };
-    gboolean from_cache = TRUE;
-    dt_image_full_path(imgid,  input_filename,  sizeof(input_filename),  &from_cache, __FUNCTION__);
-
-    std::unique_ptr<Exiv2::Image> img(Exiv2::ImageFactory::open(WIDEN(filename)));
-    // unfortunately it seems we have to read the metadata, to not erase the exif (which we just wrote).
-    // will make export slightly slower, oh well.
-    // img->clearXmpPacket();
-    read_metadata_threadsafe(img);
-
-    try
-    {
-      // initialize XMP and IPTC data with the one from the original file
-      std::unique_ptr<Exiv2::Image> input_image(Exiv2::ImageFactory::open(WIDEN(input_filename)));
-      if(input_image.get() != 0)
-      {
-        read_metadata_threadsafe(input_image);
-        img->setIptcData(input_image->iptcData());
-        img->setXmpData(input_image->xmpData());
-      }
-    }
-    catch(Exiv2::AnyError &e)
+    // initialize XMP and IPTC data with the one from the original file
+    std::unique_ptr<Exiv2::Image> input_image(Exiv2::ImageFactory::open(WIDEN(input_filename)));
+    if(input_image.get() != 0)
     {
-      std::cerr << "[xmp_attach] " << input_filename << ": caught exiv2 exception '" << e << "'\n";
+      read_metadata_threadsafe(input_image);
+      img->setIptcData(input_image->iptcData());
+      img->setXmpData(input_image->xmpData());
     }
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    std::cerr << "[xmp_attach] " << input_filename << ": caught exiv2 exception '" << e << "'\n";
+  }
 
-    Exiv2::XmpData &xmpData = img->xmpData();
+  Exiv2::XmpData &xmpData = img->xmpData();
 
-    // now add whatever we have in the sidecar XMP. this overwrites stuff from the source image
-    dt_image_path_append_version(imgid, input_filename, sizeof(input_filename));
-    g_strlcat(input_filename, ".xmp", sizeof(input_filename));
-    if(g_file_test(input_filename, G_FILE_TEST_EXISTS))
-    {
-      Exiv2::XmpData sidecarXmpData;
-      std::string xmpPacket;
+  // now add whatever we have in the sidecar XMP. this overwrites stuff from the source image
+  dt_image_path_append_version(imgid, input_filename, sizeof(input_filename));
+  g_strlcat(input_filename, ".xmp", sizeof(input_filename));
+  if(g_file_test(input_filename, G_FILE_TEST_EXISTS))
+  {
+    Exiv2::XmpData sidecarXmpData;
+    std::string xmpPacket;
 
-      Exiv2::DataBuf buf = Exiv2::readFile(WIDEN(input_filename));
+    Exiv2::DataBuf buf = Exiv2::readFile(WIDEN(input_filename));
 #if EXIV2_TEST_VERSION(0,28,0)
-      xmpPacket.assign(buf.c_str(), buf.size());
+    xmpPacket.assign(buf.c_str(), buf.size());
 #else
-      xmpPacket.assign(reinterpret_cast<char *>(buf.pData_), buf.size_);
+    xmpPacket.assign(reinterpret_cast<char *>(buf.pData_), buf.size_);
 #endif
-      Exiv2::XmpParser::decode(sidecarXmpData, xmpPacket);
+    Exiv2::XmpParser::decode(sidecarXmpData, xmpPacket);
 
-      for(Exiv2::XmpData::const_iterator it = sidecarXmpData.begin(); it != sidecarXmpData.end(); ++it)
-        xmpData.add(*it);
-    }
+    for(Exiv2::XmpData::const_iterator it = sidecarXmpData.begin(); it != sidecarXmpData.end(); ++it)
+      xmpData.add(*it);
+  }
 
-    dt_remove_known_keys(xmpData); // is this needed?
+  dt_remove_known_keys(xmpData); // is this needed?
 
-    {
-      // We also want to make sure to not have some tags that might
-      // have come in from XMP files created by digikam or similar
-      static const char *keys[] = {
-        "Xmp.tiff.Orientation"
-      };
-      static const guint n_keys = G_N_ELEMENTS(keys);
-      dt_remove_xmp_keys(xmpData, keys, n_keys);
-    }
+  {
+    // We also want to make sure to not have some tags that might
+    // have come in from XMP files created by digikam or similar
+    static const char *keys[] = {
+      "Xmp.tiff.Orientation"
+    };
+    static const guint n_keys = G_N_ELEMENTS(keys);
+    dt_remove_xmp_keys(xmpData, keys, n_keys);
+  }
 
-    // last but not least attach what we have in DB to the XMP. in theory that should be
-    // the same as what we just copied over from the sidecar file, but you never know ...
-    // make sure to remove all geotags if necessary
-    if(m)
+  // last but not least attach what we have in DB to the XMP. in theory that should be
+  // the same as what we just copied over from the sidecar file, but you never know ...
+  // make sure to remove all geotags if necessary
+  if(m)
+  {
+    Exiv2::ExifData exifOldData;
+    Exiv2::ExifData &exifData = img->exifData();
+    if(!(m->flags & DT_META_EXIF))
     {
-      Exiv2::ExifData exifOldData;
-      Exiv2::ExifData &exifData = img->exifData();
-      if(!(m->flags & DT_META_EXIF))
+      for(Exiv2::ExifData::const_iterator i = exifData.begin(); i != exifData.end() ; ++i)
       {
-        for(Exiv2::ExifData::const_iterator i = exifData.begin(); i != exifData.end() ; ++i)
-        {
-          exifOldData[i->key()] = i->value();
-        }
-        img->clearExifData();
+        exifOldData[i->key()] = i->value();
       }
+      img->clearExifData();
+    }
 
-      _exif_xmp_read_data_export(xmpData, imgid, m);
-
-      Exiv2::IptcData &iptcData = img->iptcData();
+    _exif_xmp_read_data_export(xmpData, imgid, m);
 
-      if(!(m->flags & DT_META_GEOTAG))
-        dt_remove_exif_geotag(exifData);
-      // calculated metadata
-      dt_variables_params_t *params;
-      dt_variables_params_init(&params);
-      params->filename = input_filename;
-      params->jobcode = "infos";
-      params->sequence = 0;
-      params->imgid = imgid;
+    Exiv2::IptcData &iptcData = img->iptcData();
 
-      dt_variables_set_tags_flags(params, m->flags);
-      for (GList *tags = m->list; tags; tags = g_list_next(tags))
+    if(!(m->flags & DT_META_GEOTAG))
+      dt_remove_exif_geotag(exifData);
+    // calculated metadata
+    dt_variables_params_t *params;
+    dt_variables_params_init(&params);
+    params->filename = input_filename;
+    params->jobcode = "infos";
+    params->sequence = 0;
+    params->imgid = imgid;
+
+    dt_variables_set_tags_flags(params, m->flags);
+    for (GList *tags = m->list; tags; tags = g_list_next(tags))
+    {
+      gchar *tagname = (gchar *)tags->data;
+      tags = g_list_next(tags);
+      if (!tags) break;
+      gchar *formula = (gchar *)tags->data;
+      if (formula[0])
       {
-        gchar *tagname = (gchar *)tags->data;
-        tags = g_list_next(tags);
-        if (!tags) break;
-        gchar *formula = (gchar *)tags->data;
-        if (formula[0])
+        if(!(m->flags & DT_META_EXIF) && (formula[0] == '=') && g_str_has_prefix(tagname, "Exif."))
         {
-          if(!(m->flags & DT_META_EXIF) && (formula[0] == '=') && g_str_has_prefix(tagname, "Exif."))
+          // remove this specific exif
+          Exiv2::ExifData::const_iterator pos;
+          if(dt_exif_read_exif_tag(exifOldData, &pos, tagname))
           {
-            // remove this specific exif
-            Exiv2::ExifData::const_iterator pos;
-            if(dt_exif_read_exif_tag(exifOldData, &pos, tagname))
-            {
-              exifData[tagname] = pos->value();
-            }
+            exifData[tagname] = pos->value();
           }
-          else
+        }
+        else
+        {
+          gchar *result = dt_variables_expand(params, formula, FALSE);
+          if(result && result[0])
           {
-            gchar *result = dt_variables_expand(params, formula, FALSE);
-            if(result && result[0])
+            if(g_str_has_prefix(tagname, "Xmp."))
             {
-              if(g_str_has_prefix(tagname, "Xmp."))
+              const char *type = _exif_get_exiv2_tag_type(tagname);
+              // if xmpBag or xmpSeq, split the list when necessary
+              // else provide the string as is (can be a list of strings)
+              if(!g_strcmp0(type, "XmpBag") || !g_strcmp0(type, "XmpSeq"))
               {
-                const char *type = _exif_get_exiv2_tag_type(tagname);
-                // if xmpBag or xmpSeq, split the list when necessary
-                // else provide the string as is (can be a list of strings)
-                if(!g_strcmp0(type, "XmpBag") || !g_strcmp0(type, "XmpSeq"))
+                char *tuple = g_strrstr(result, ",");
+                while(tuple)
                 {
-                  char *tuple = g_strrstr(result, ",");
-                  while(tuple)
-                  {
-                    tuple[0] = '\0';
-                    tuple++;
-                    xmpData[tagname] = tuple;
-                    tuple = g_strrstr(result, ",");
-                  }
+                  tuple[0] = '\0';
+                  tuple++;
+                  xmpData[tagname] = tuple;
+                  tuple = g_strrstr(result, ",");
                 }
-                xmpData[tagname] = result;
               }
-              else if(g_str_has_prefix(tagname, "Iptc."))
+              xmpData[tagname] = result;
+            }
+            else if(g_str_has_prefix(tagname, "Iptc."))
+            {
+              const char *type = _exif_get_exiv2_tag_type(tagname);
+              if(!g_strcmp0(type, "String-R"))
               {
-                const char *type = _exif_get_exiv2_tag_type(tagname);
-                if(!g_strcmp0(type, "String-R"))
+                // clean up the original tags before giving new values
+                dt_remove_iptc_key(iptcData, tagname);
+                // convert the input list (separator ", ") into different tags
+                // FIXME if an element of the list contains a ", " it is not correctly exported
+                Exiv2::IptcKey key(tagname);
+                Exiv2::Iptcdatum id(key);
+                gchar **values = g_strsplit(result, ", ", 0);
+                if(values)
                 {
-                  // clean up the original tags before giving new values
-                  dt_remove_iptc_key(iptcData, tagname);
-                  // convert the input list (separator ", ") into different tags
-                  // FIXME if an element of the list contains a ", " it is not correctly exported
-                  Exiv2::IptcKey key(tagname);
-                  Exiv2::Iptcdatum id(key);
-                  gchar **values = g_strsplit(result, ", ", 0);
-                  if(values)
+                  gchar **entry = values;
+                  while (*entry)
                   {
-                    gchar **entry = values;
-                    while (*entry)
+                    char *e = g_strstrip(*entry);
+                    if(*e)
                     {
-                      char *e = g_strstrip(*entry);
-                      if(*e)
-                      {
-                        id.setValue(e);
-                        iptcData.add(id);
-                      }
-                      entry++;
+                      id.setValue(e);
+                      iptcData.add(id);
                     }
+                    entry++;
                   }
-                g_strfreev(values);
                 }
-                else iptcData[tagname] = result;
+              g_strfreev(values);
               }
-              else if(g_str_has_prefix(tagname, "Exif."))
+              else iptcData[tagname] = result;
+            }
+            else if(g_str_has_prefix(tagname, "Exif."))
+            {
+              const char *type = _exif_get_exiv2_tag_type(tagname);
+              if((!g_strcmp0(type, "Rational") || !g_strcmp0(type, "SRational")) &&
+                 (g_strstr_len(result, strlen(result), "/") == NULL))
               {
-                const char *type = _exif_get_exiv2_tag_type(tagname);
-                if((!g_strcmp0(type, "Rational") || !g_strcmp0(type, "SRational")) &&
-                   (g_strstr_len(result, strlen(result), "/") == NULL))
+                float float_value = (float)std::atof(result);
+                if(!std::isnan(float_value))
                 {
-                  float float_value = (float)std::atof(result);
-                  if(!std::isnan(float_value))
+                  g_free(result);
+                  int int_value = (int)float_value;
+                  int divisor = 1;
+                  while(fabs(float_value - int_value) > 0.000001)
                   {
-                    g_free(result);
-                    int int_value = (int)float_value;
-                    int divisor = 1;
-                    while(fabs(float_value - int_value) > 0.000001)
-                    {
-                      divisor *= 10;
-                      float_value *= 10.0;
-                      int_value = (int)float_value;
-                    }
-                    result = g_strdup_printf("%d/%d", (int)float_value, divisor);
+                    divisor *= 10;
+                    float_value *= 10.0;
+                    int_value = (int)float_value;
                   }
+                  result = g_strdup_printf("%d/%d", (int)float_value, divisor);
                 }
-                exifData[tagname] = result;
               }
+              exifData[tagname] = result;
             }
-            g_free(result);
           }
-        }
-        else
-        {
-          if (g_str_has_prefix(tagname, "Xmp."))
-            dt_remove_xmp_key(xmpData, tagname);
-          else if (g_str_has_prefix(tagname, "Exif."))
-            dt_remove_exif_key(exifData, tagname);
-          else if (g_str_has_prefix(tagname, "Iptc."))
-            dt_remove_iptc_key(iptcData, tagname);
+          g_free(result);
         }
       }
-      dt_variables_params_destroy(params);
+      else
+      {
+        if (g_str_has_prefix(tagname, "Xmp."))
+          dt_remove_xmp_key(xmpData, tagname);
+        else if (g_str_has_prefix(tagname, "Exif."))
+          dt_remove_exif_key(exifData, tagname);
+        else if (g_str_has_prefix(tagname, "Iptc."))
+          dt_remove_iptc_key(iptcData, tagname);
+      }
     }
+    dt_variables_params_destroy(params);
+  }
+}
 
-    try
+// write the metadata of an export, dropping the history when it doesn't fit (jpeg segments are limited to 64kB)
+static void _exif_xmp_write_metadata(Exiv2::Image *img)
+{
+  try
+  {
+    img->writeMetadata();
+  }
+  catch(Exiv2::AnyError &e)
+  {
+#if EXIV2_TEST_VERSION(0,27,0)
+    if(e.code() == Exiv2::ErrorCode::kerTooLargeJpegSegment)
+#else
+    if(e.code() == 37)
+#endif
     {
+      Exiv2::XmpData &xmpData = img->xmpData();
+      _remove_xmp_keys(xmpData, "Xmp.darktable.history");
+      _remove_xmp_keys(xmpData, "Xmp.darktable.masks_history");
+      _remove_xmp_keys(xmpData, "Xmp.darktable.auto_presets_applied");
+      _remove_xmp_keys(xmpData, "Xmp.darktable.iop_order");
       img->writeMetadata();
     }
-    catch(Exiv2::AnyError &e)
+    else
+      throw;
+  }
+}
+
+int dt_exif_xmp_attach_export(const int imgid, const char *filename, void *metadata)
+{
+  try
+  {
+    std::unique_ptr<Exiv2::Image> img(Exiv2::ImageFactory::open(WIDEN(filename)));
+    // unfortunately it seems we have to read the metadata, to not erase the exif (which we just wrote).
+    // will make export slightly slower, oh well.
+    // img->clearXmpPacket();
+    read_metadata_threadsafe(img);
+
+    _exif_xmp_attach(img.get(), imgid, (dt_export_metadata_t *)metadata);
+    _exif_xmp_write_metadata(img.get());
+    return 0;
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    std::cerr << "[dt_exif_xmp_attach_export] " << filename << ": caught exiv2 exception '" << e << "'\n";
+    return -1;
+  }
+}
+
+uint8_t *dt_exif_embed_metadata(const uint8_t *data, const size_t size, uint8_t *blob, const uint32_t blob_size,
+                                const int compressed, const int imgid, void *metadata, size_t *new_size)
+{
+  try
+  {
+    std::unique_ptr<Exiv2::Image> img(Exiv2::ImageFactory::open(data, size));
+    read_metadata_threadsafe(img);
+
+    if(blob && blob_size > 0) _exif_merge_blob(img->exifData(), blob, blob_size, compressed);
+    if(metadata && imgid > 0) _exif_xmp_attach(img.get(), imgid, (dt_export_metadata_t *)metadata);
+    _exif_xmp_write_metadata(img.get());
+
+    // the memory io now holds the complete file
+    Exiv2::BasicIo &io = img->io();
+    io.open();
+    const size_t length = io.size();
+    uint8_t *out = (uint8_t *)g_try_malloc(length);
+    if(out && (size_t)io.read(out, length) != length)
     {
-#if EXIV2_TEST_VERSION(0,27,0)
-      if(e.code() == Exiv2::ErrorCode::kerTooLargeJpegSegment)
-#else
-      if(e.code() == 37)
-#endif
+      g_free(out);
+      out = NULL;
+    }
+    io.close();
+    *new_size = out ? length : 0;
+    return out;
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    std::cerr << "[dt_exif_embed_metadata] caught exiv2 exception '" << e << "'\n";
+    return NULL;
+  }
+}
+
+int dt_exif_get_export_metadata(uint8_t *blob, const uint32_t blob_size, const int compressed, const int imgid,
+                                void *metadata, GList **tags, char **xmp, size_t *xmp_size, uint8_t **iptc,
+                                size_t *iptc_size)
+{
+  *tags = NULL;
+  *xmp = NULL;
+  *iptc = NULL;
+  *xmp_size = *iptc_size = 0;
+  try
+  {
+    // only holds the metadata, it is never written
+    std::unique_ptr<Exiv2::Image> img(Exiv2::ImageFactory::create(Exiv2::ImageType::xmp));
+
+    if(blob && blob_size > 0) _exif_merge_blob(img->exifData(), blob, blob_size, compressed);
+    if(metadata && imgid > 0) _exif_xmp_attach(img.get(), imgid, (dt_export_metadata_t *)metadata);
+
+    const Exiv2::ByteOrder order = (G_BYTE_ORDER == G_LITTLE_ENDIAN) ? Exiv2::littleEndian : Exiv2::bigEndian;
+    Exiv2::ExifData &exifData = img->exifData();
+    for(Exiv2::ExifData::const_iterator i = exifData.begin(); i != exifData.end(); ++i)
+    {
+      dt_exif_ifd_t ifd;
+      const std::string group = i->groupName();
+      if(group == "Image")
+        ifd = DT_EXIF_IFD_IMAGE;
+      else if(group == "Photo")
+        ifd = DT_EXIF_IFD_PHOTO;
+      else if(group == "GPSInfo")
+        ifd = DT_EXIF_IFD_GPS;
+      else
+        continue; // makernotes and the like can't be written as plain tags
+
+      const int type = i->typeId();
+      const size_t size = i->size();
+      if(type < Exiv2::unsignedByte || type > Exiv2::tiffDouble || i->count() == 0 || size == 0) continue;
+
+      // the values follow the struct in the same allocation
+      dt_exif_tag_t *t = (dt_exif_tag_t *)g_malloc(sizeof(dt_exif_tag_t) + size);
+      t->ifd = ifd;
+      t->tag = i->tag();
+      t->type = type;
+      t->count = i->count();
+      t->data = (uint8_t *)(t + 1);
+      i->copy(t->data, order);
+      *tags = g_list_prepend(*tags, t);
+    }
+    *tags = g_list_reverse(*tags);
+
+    if(metadata && !img->xmpData().empty())
+    {
+      std::string xmpPacket;
+      if(Exiv2::XmpParser::encode(xmpPacket, img->xmpData()) == 0)
       {
-        _remove_xmp_keys(xmpData, "Xmp.darktable.history");
-        _remove_xmp_keys(xmpData, "Xmp.darktable.masks_history");
-        _remove_xmp_keys(xmpData, "Xmp.darktable.auto_presets_applied");
-        _remove_xmp_keys(xmpData, "Xmp.darktable.iop_order");
-        try
-        {
-          img->writeMetadata();
-        }
-        catch(Exiv2::AnyError &e2)
-        {
-          std::cerr << "[dt_exif_xmp_attach_export] without history " << filename << ": caught exiv2 exception '" << e2 << "'\n";
-          return -1;
-        }
+        *xmp = g_strndup(xmpPacket.c_str(), xmpPacket.size());
+        *xmp_size = xmpPacket.size();
       }
-      else
-        throw;
+    }
+
+    if(metadata && !img->iptcData().empty())
+    {
+      Exiv2::DataBuf buf = Exiv2::IptcParser::encode(img->iptcData());
+#if EXIV2_TEST_VERSION(0,28,0)
+      *iptc_size = buf.size();
+      *iptc = (uint8_t *)g_malloc(*iptc_size);
+      memcpy(*iptc, buf.c_data(), *iptc_size);
+#else
+      *iptc_size = buf.size_;
+      *iptc = (uint8_t *)g_malloc(*iptc_size);
+      memcpy(*iptc, buf.pData_, *iptc_size);
+#endif
     }
     return 0;
   }
   catch(Exiv2::AnyError &e)
   {
-    std::cerr << "[dt_exif_xmp_attach_export] " << filename << ": caught exiv2 exception '" << e << "'\n";
-    return -1;
+    std::cerr << "[dt_exif_get_export_metadata] caught exiv2 exception '" << e << "'\n";
+    g_list_free_full(*tags, g_free);
+    *tags = NULL;
+    g_free(*xmp);
+    *xmp = NULL;
+    *xmp_size = 0;
+    return 1;
   }
 }
 
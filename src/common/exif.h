@@ -84,6 +84,38 @@ int dt_exif_xmp_write(const int imgid, const char *filename);
 /** write xmp packet inside an image. */
 int dt_exif_xmp_attach_export(const int imgid, const char *filename, void *metadata);
 
+/** embed the exif blob and, if metadata is not NULL, the xmp/iptc data of imgid (as dt_exif_xmp_attach_export()
+ * does) into an encoded image held in memory. returns the complete file in a newly allocated buffer (g_free)
+ * of new_size bytes, NULL on error. lets formats write the exported file only once. */
+uint8_t *dt_exif_embed_metadata(const uint8_t *data, const size_t size, uint8_t *blob, const uint32_t blob_size,
+                                const int compressed, const int imgid, void *metadata, size_t *new_size);
+
+/** the directory an exported exif tag goes to */
+typedef enum dt_exif_ifd_t
+{
+  DT_EXIF_IFD_IMAGE = 0,
+  DT_EXIF_IFD_PHOTO = 1,
+  DT_EXIF_IFD_GPS = 2
+} dt_exif_ifd_t;
+
+/** an exported exif tag: count values of tiff type type, in host byte order */
+typedef struct dt_exif_tag_t
+{
+  dt_exif_ifd_t ifd;
+  uint16_t tag;
+  uint16_t type;
+  uint32_t count;
+  uint8_t *data;
+} dt_exif_tag_t;
+
+/** prepare the metadata dt_exif_embed_metadata() would embed, for formats writing it themselves while encoding:
+ * tags gets the exif tags of the image, photo and gps directories as a list of dt_exif_tag_t (g_list_free_full
+ * with g_free), xmp and iptc the xmp packet and iptc block if metadata is not NULL (g_free). makernotes are not
+ * exported this way. returns 0 on success. */
+int dt_exif_get_export_metadata(uint8_t *blob, const uint32_t blob_size, const int compressed, const int imgid,
+                                void *metadata, GList **tags, char **xmp, size_t *xmp_size, uint8_t **iptc,
+                                size_t *iptc_size);
+
 /** get the xmp blob for imgid. */
 char *dt_exif_xmp_read_string(const int imgid);
 
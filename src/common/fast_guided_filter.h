@@ -92,70 +92,103 @@ static inline float fast_clamp(const float value, const float bottom, const floa
 }
 
 
+// position of an output column (or row) between its two neighbours in input space
+typedef struct dt_bilinear_coord_t
+{
+  size_t prev, next;
+  float w_prev, w_next; // weights of prev and next
+} dt_bilinear_coord_t;
+
+static inline dt_bilinear_coord_t _bilinear_coord(const size_t i, const size_t size_out, const size_t size_in)
+{
+  // Relative then absolute coordinate of the pixel in input space
+  const float x_out = (float)i / (float)size_out;
+  const float x_in = x_out * (float)size_in;
+
+  // Nearest neighbours coordinates in input space
+  size_t prev = (size_t)floorf(x_in);
+  size_t next = prev + 1;
+  prev = (prev < size_in) ? prev : size_in - 1;
+  next = (next < size_in) ? next : size_in - 1;
+
+  // Spatial differences between nodes
+  const float d_next = (float)next - x_in;
+  return (dt_bilinear_coord_t){ prev, next, d_next, 1.f - d_next }; // because next - prev = 1
+}
+
+// the column coordinates are the same for all rows, so they are computed once per image
+static inline dt_bilinear_coord_t *_bilinear_coords(const size_t size_out, const size_t size_in)
+{
+  dt_bilinear_coord_t *const coords = dt_alloc_align(64, sizeof(dt_bilinear_coord_t) * size_out);
+  if(coords)
+    for(size_t i = 0; i < size_out; i++) coords[i] = _bilinear_coord(i, size_out, size_in);
+  return coords;
+}
+
+// bilinear interpolation of row i of the output, ch is a constant once inlined
+static inline void _interpolate_bilinear_row(const float *const restrict in, const size_t width_in,
+                                             const size_t height_in, float *const restrict out,
+                                             const size_t width_out, const size_t height_out, const size_t i,
+                                             const dt_bilinear_coord_t *const restrict cols, const size_t ch)
+{
+  const dt_bilinear_coord_t y = _bilinear_coord(i, height_out, height_in);
+  const float *const restrict row_prev = in + y.prev * width_in * ch;
+  const float *const restrict row_next = in + y.next * width_in * ch;
+
+  for(size_t j = 0; j < width_out; j++)
+  {
+    // Nearest pixels in input array (nodes in grid)
+    const dt_bilinear_coord_t x = cols[j];
+    const float *const Q_NW = row_prev + x.prev * ch;
+    const float *const Q_NE = row_prev + x.next * ch;
+    const float *const Q_SE = row_next + x.next * ch;
+    const float *const Q_SW = row_next + x.prev * ch;
+    float *const pixel_out = out + j * ch;
+
+    for(size_t c = 0; c < ch; c++)
+      pixel_out[c] = y.w_next * (Q_SW[c] * x.w_prev + Q_SE[c] * x.w_next) +
+                     y.w_prev * (Q_NW[c] * x.w_prev + Q_NE[c] * x.w_next);
+  }
+}
+
+
+// returns 0 on success, 1 if out could not be written for lack of memory
 __DT_CLONE_TARGETS__
-static inline void interpolate_bilinear(const float *const restrict in, const size_t width_in, const size_t height_in,
-                                        float *const restrict out, const size_t width_out, const size_t height_out,
-                                        const size_t ch)
+static inline int interpolate_bilinear(const float *const restrict in, const size_t width_in, const size_t height_in,
+                                       float *const restrict out, const size_t width_out, const size_t height_out,
+                                       const size_t ch)
 {
   // Fast vectorized bilinear interpolation on ch channels
+  dt_bilinear_coord_t *const restrict cols = _bilinear_coords(width_out, width_in);
+  if(!cols) return 1;
+
 #ifdef _OPENMP
-#pragma omp parallel for collapse(2) default(none) \
-  dt_omp_firstprivate(in, out, width_out, height_out, width_in, height_in, ch) \
-  schedule(simd:static)
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(in, out, width_out, height_out, width_in, height_in, ch, cols) \
+  schedule(static)
 #endif
   for(size_t i = 0; i < height_out; i++)
   {
-    for(size_t j = 0; j < width_out; j++)
-    {
-      // Relative coordinates of the pixel in output space
-      const float x_out = (float)j /(float)width_out;
-      const float y_out = (float)i /(float)height_out;
-
-      // Corresponding absolute coordinates of the pixel in input space
-      const float x_in = x_out * (float)width_in;
-      const float y_in = y_out * (float)height_in;
-
-      // Nearest neighbours coordinates in input space
-      size_t x_prev = (size_t)floorf(x_in);
-      size_t x_next = x_prev + 1;
-      size_t y_prev = (size_t)floorf(y_in);
-      size_t y_next = y_prev + 1;
-
-      x_prev = (x_prev < width_in) ? x_prev : width_in - 1;
-      x_next = (x_next < width_in) ? x_next : width_in - 1;
-      y_prev = (y_prev < height_in) ? y_prev : height_in - 1;
-      y_next = (y_next < height_in) ? y_next : height_in - 1;
-
-      // Nearest pixels in input array (nodes in grid)
-      const size_t Y_prev = y_prev * width_in;
-      const size_t Y_next =  y_next * width_in;
-      const float *const Q_NW = (float *)in + (Y_prev + x_prev) * ch;
-      const float *const Q_NE = (float *)in + (Y_prev + x_next) * ch;
-      const float *const Q_SE = (float *)in + (Y_next + x_next) * ch;
-      const float *const Q_SW = (float *)in + (Y_next + x_prev) * ch;
-
-      // Spatial differences between nodes
-      const float Dy_next = (float)y_next - y_in;
-      const float Dy_prev = 1.f - Dy_next; // because next - prev = 1
-      const float Dx_next = (float)x_next - x_in;
-      const float Dx_prev = 1.f - Dx_next; // because next - prev = 1
-
-      // Interpolate over ch layers
-      float *const pixel_out = (float *)out + (i * width_out + j) * ch;
-
-//#pragma unroll //LLVM warns it can't unroll -- presumably because 'ch' is not a constant
-      for(size_t c = 0; c < ch; c++)
-      {
-        pixel_out[c] = Dy_prev * (Q_SW[c] * Dx_next + Q_SE[c] * Dx_prev) +
-                       Dy_next * (Q_NW[c] * Dx_next + Q_NE[c] * Dx_prev);
-      }
-    }
+    float *const restrict row = out + i * width_out * ch;
+    // give the compiler a constant number of channels for the common cases
+    if(ch == 1)
+      _interpolate_bilinear_row(in, width_in, height_in, row, width_out, height_out, i, cols, 1);
+    else if(ch == 2)
+      _interpolate_bilinear_row(in, width_in, height_in, row, width_out, height_out, i, cols, 2);
+    else if(ch == 4)
+      _interpolate_bilinear_row(in, width_in, height_in, row, width_out, height_out, i, cols, 4);
+    else
+      _interpolate_bilinear_row(in, width_in, height_in, row, width_out, height_out, i, cols, ch);
   }
+
+  dt_free_align(cols);
+  return 0;
 }
 
 
+// returns 0 on success, 1 for lack of memory
 __DT_CLONE_TARGETS__
-static inline void variance_analyse(const float *const restrict guide, // I
+static inline int variance_analyse(const float *const restrict guide, // I
                                     const float *const restrict mask, //p
                                     float *const restrict ab,
                                     const size_t width, const size_t height,
@@ -173,6 +206,7 @@ static inline void variance_analyse(const float *const restrict guide, // I
   * input is array of struct : { { guide , mask, guide * guide, guide * mask } }
   */
   float *const restrict input = dt_alloc_align_float(Ndimch);
+  if(!input) return 1;
 
   // Pre-multiply guide and mask and pack all inputs into an array of 4×1 SIMD struct
 #ifdef _OPENMP
@@ -207,7 +241,8 @@ static inline void variance_analyse(const float *const restrict guide, // I
     ab[2*idx+1] = b;
   }
 
-  if(input != NULL) dt_free_align(input);
+  dt_free_align(input);
+  return 0;
 }
 
 
@@ -229,21 +264,51 @@ schedule(simd:static) aligned(image, ab:64)
 }
 
 
+// returns 0 on success, 1 if image was left unblended for lack of memory
 __DT_CLONE_TARGETS__
-static inline void apply_linear_blending_w_geomean(float *const restrict image,
-                                                   const float *const restrict ab,
-                                                   const size_t num_elem)
+static inline int apply_blending_upsampled(float *const restrict image, const size_t width, const size_t height,
+                                           const float *const restrict ds_ab, const size_t ds_width,
+                                           const size_t ds_height, const dt_iop_guided_filter_blending_t filter)
 {
+  // Same as upsampling a and b to full size then applying the linear or geomean blending,
+  // but a and b are only ever upsampled one row at a time in cache.
+  int err = 0;
+  size_t padded_size;
+  float *const restrict ab_rows = dt_alloc_perthread_float(2 * width, &padded_size);
+  dt_bilinear_coord_t *const restrict cols = _bilinear_coords(width, ds_width);
+  if(!ab_rows || !cols)
+  {
+    err = 1;
+    goto clean;
+  }
+
 #ifdef _OPENMP
-#pragma omp parallel for simd default(none) \
-dt_omp_firstprivate(image, ab, num_elem) \
-schedule(simd:static) aligned(image, ab:64)
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(image, ds_ab, width, height, ds_width, ds_height, filter, cols, ab_rows, padded_size) \
+  schedule(static)
 #endif
-  for(size_t k = 0; k < num_elem; k++)
+  for(size_t i = 0; i < height; i++)
   {
-    // Note : image[k] is positive at the outside of the luminance mask
-    image[k] = sqrtf(image[k] * fmaxf(image[k] * ab[k * 2] + ab[k * 2 + 1], MIN_FLOAT));
+    float *const restrict ab = dt_get_perthread(ab_rows, padded_size);
+    _interpolate_bilinear_row(ds_ab, ds_width, ds_height, ab, width, height, i, cols, 2);
+
+    float *const restrict row = image + i * width;
+    if(filter == DT_GF_BLENDING_LINEAR)
+    {
+      for(size_t k = 0; k < width; k++)
+        row[k] = fmaxf(row[k] * ab[k * 2] + ab[k * 2 + 1], MIN_FLOAT);
+    }
+    else
+    {
+      for(size_t k = 0; k < width; k++)
+        row[k] = sqrtf(row[k] * fmaxf(row[k] * ab[k * 2] + ab[k * 2 + 1], MIN_FLOAT));
+    }
   }
+
+clean:
+  if(cols) dt_free_align(cols);
+  if(ab_rows) dt_free_align(ab_rows);
+  return err;
 }
 
 
@@ -286,8 +351,9 @@ schedule(simd:static) aligned(image, out:64)
 }
 
 
+// returns 0 on success, 1 if image could not be blurred for lack of memory. image is then left unchanged.
 __DT_CLONE_TARGETS__
-static inline void fast_surface_blur(float *const restrict image,
+static inline int fast_surface_blur(float *const restrict image,
                                       const size_t width, const size_t height,
                                       const int radius, float feathering, const int iterations,
                                       const dt_iop_guided_filter_blending_t filter, const float scale,
@@ -304,22 +370,20 @@ static inline void fast_surface_blur(float *const restrict image,
   const size_t ds_width = width / scaling;
 
   const size_t num_elem_ds = ds_width * ds_height;
-  const size_t num_elem = width * height;
 
+  int err = 0;
   float *const restrict ds_image = dt_alloc_sse_ps(dt_round_size_sse(num_elem_ds));
   float *const restrict ds_mask = dt_alloc_sse_ps(dt_round_size_sse(num_elem_ds));
   float *const restrict ds_ab = dt_alloc_sse_ps(dt_round_size_sse(num_elem_ds * 2));
-  float *const restrict ab = dt_alloc_sse_ps(dt_round_size_sse(num_elem * 2));
 
-  if(!ds_image || !ds_mask || !ds_ab || !ab)
+  // Downsample the image for speed-up
+  if(!ds_image || !ds_mask || !ds_ab
+     || interpolate_bilinear(image, width, height, ds_image, ds_width, ds_height, 1))
   {
-    dt_control_log(_("fast guided filter failed to allocate memory, check your RAM settings"));
+    err = 1;
     goto clean;
   }
 
-  // Downsample the image for speed-up
-  interpolate_bilinear(image, width, height, ds_image, ds_width, ds_height, 1);
-
   // Iterations of filter models the diffusion, sort of
   for(int i = 0; i < iterations; ++i)
   {
@@ -328,7 +392,8 @@ static inline void fast_surface_blur(float *const restrict image,
 
     // Perform the patch-wise variance analyse to get
     // the a and b parameters for the linear blending s.t. mask = a * I + b
-    variance_analyse(ds_mask, ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering);
+    err = variance_analyse(ds_mask, ds_image, ds_ab, ds_width, ds_height, ds_radius, feathering);
+    if(err) goto clean;
 
     // Compute the patch-wise average of parameters a and b
     dt_box_mean(ds_ab, ds_height, ds_width, 2, ds_radius, 1);
@@ -340,20 +405,15 @@ static inline void fast_surface_blur(float *const restrict image,
     }
   }
 
-  // Upsample the blending parameters a and b
-  interpolate_bilinear(ds_ab, ds_width, ds_height, ab, width, height, 2);
-
-  // Finally, blend the guided image
-  if(filter == DT_GF_BLENDING_LINEAR)
-    apply_linear_blending(image, ab, num_elem);
-  else if(filter == DT_GF_BLENDING_GEOMEAN)
-    apply_linear_blending_w_geomean(image, ab, num_elem);
+  // Upsample the blending parameters a and b and blend the guided image
+  err = apply_blending_upsampled(image, width, height, ds_ab, ds_width, ds_height, filter);
 
 clean:
-  if(ab) dt_free_align(ab);
+  if(err) dt_control_log(_("fast guided filter failed to allocate memory, check your RAM settings"));
   if(ds_ab) dt_free_align(ds_ab);
   if(ds_mask) dt_free_align(ds_mask);
   if(ds_image) dt_free_align(ds_image);
+  return err;
 }
 
 // clang-format off
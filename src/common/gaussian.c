@@ -19,9 +19,7 @@
 
 #include <assert.h>
 #include <math.h>
-#if defined(__SSE__)
-#include <xmmintrin.h>
-#endif
+#include <string.h>
 #include "common/gaussian.h"
 #include "common/math.h"
 #include "common/opencl.h"
@@ -81,11 +79,123 @@ static void compute_gauss_params(const float sigma, dt_gaussian_order_t order, f
   *coefn = (*a2 + *a3) / (1.0f + *b1 + *b2);
 }
 
+/*
+ * The CPU code runs the recursive filter on many floats at once, whatever the number of channels:
+ *
+ *  - the vertical pass walks down strips of GAUSS_STRIP consecutive floats of the image, i.e. a bunch of
+ *    neighbouring columns with all of their channels. every row step reads a contiguous 1kB the prefetcher
+ *    can follow, and the recursion is a plain vector operation along the strip,
+ *  - the horizontal pass copies GAUSS_LANES / channels rows into a per-thread buffer, transposed so that
+ *    the same pixel of all these rows is contiguous, and runs the same vector recursion along it.
+ *
+ * The per-thread scratch buffers are taken in dt_gaussian_init() and reused by every blur with the same
+ * dt_gaussian_t. Blurs can be done in place.
+ *
+ * Modules often blur several times per run and the pipe runs again on every change, so dt_gaussian_free()
+ * gives the scratch buffer back to a small pool for the next dt_gaussian_init(), rather than to the system:
+ * a fresh large allocation costs a page fault on the first touch of every page. The pool keeps at most
+ * GAUSS_POOL_SIZE buffers, and no more than dt_get_singlebuffer_mem() bytes.
+ */
+#define GAUSS_STRIP 256
+#define GAUSS_LANES 16
+#define GAUSS_POOL_SIZE 4
+
+typedef struct _gauss_coeffs_t
+{
+  float a0, a1, a2, a3, b1, b2, coefp, coefn;
+  float min[GAUSS_STRIP], max[GAUSS_STRIP]; // clamping bounds of each float of a strip
+} _gauss_coeffs_t;
+
+// size of the per-thread scratch buffer
+static inline size_t _scratch_size(const int width, const int height)
+{
+  return MAX((size_t)GAUSS_STRIP * height, (size_t)GAUSS_LANES * 2 * width);
+}
+
+typedef struct _gauss_pool_t
+{
+  GMutex lock;
+  float *buf[GAUSS_POOL_SIZE];
+  size_t size[GAUSS_POOL_SIZE]; // floats per thread
+} _gauss_pool_t;
+
+static _gauss_pool_t _pool;
+
+// the smallest pooled buffer of at least size floats per thread, or a new one
+static float *_scratch_get(const size_t size, size_t *buf_size)
+{
+  float *buf = NULL;
+  g_mutex_lock(&_pool.lock);
+  int best = -1;
+  for(int k = 0; k < GAUSS_POOL_SIZE; k++)
+    if(_pool.buf[k] && _pool.size[k] >= size && (best < 0 || _pool.size[k] < _pool.size[best])) best = k;
+  if(best >= 0)
+  {
+    buf = _pool.buf[best];
+    *buf_size = _pool.size[best];
+    _pool.buf[best] = NULL;
+  }
+  g_mutex_unlock(&_pool.lock);
+
+  return buf ? buf : dt_alloc_perthread_float(size, buf_size);
+}
+
+// give the buffer to the pool. when the pool is full, the smallest buffer goes.
+static void _scratch_put(float *buf, const size_t size)
+{
+  if(!buf) return;
+
+  const size_t threads = dt_get_num_threads();
+  const size_t budget = dt_get_singlebuffer_mem();
+  float *evicted = NULL;
+
+  g_mutex_lock(&_pool.lock);
+  size_t used = 0;
+  int slot = -1;
+  for(int k = 0; k < GAUSS_POOL_SIZE; k++)
+  {
+    if(!_pool.buf[k])
+      slot = k;
+    else
+    {
+      used += sizeof(float) * _pool.size[k] * threads;
+      if(slot < 0 || (_pool.buf[slot] && _pool.size[k] < _pool.size[slot])) slot = k;
+    }
+  }
+  if(_pool.buf[slot] && _pool.size[slot] < size)
+  {
+    evicted = _pool.buf[slot];
+    used -= sizeof(float) * _pool.size[slot] * threads;
+    _pool.buf[slot] = NULL;
+  }
+  if(!_pool.buf[slot] && used + sizeof(float) * size * threads <= budget)
+  {
+    _pool.buf[slot] = buf;
+    _pool.size[slot] = size;
+    buf = NULL;
+  }
+  g_mutex_unlock(&_pool.lock);
+
+  dt_free_align(evicted);
+  dt_free_align(buf);
+}
+
+void dt_gaussian_pool_cleanup()
+{
+  g_mutex_lock(&_pool.lock);
+  for(int k = 0; k < GAUSS_POOL_SIZE; k++)
+  {
+    dt_free_align(_pool.buf[k]);
+    _pool.buf[k] = NULL;
+  }
+  g_mutex_unlock(&_pool.lock);
+}
+
 size_t dt_gaussian_memory_use(const int width,    // width of input image
                               const int height,   // height of input image
                               const int channels) // channels per pixel
 {
-  return sizeof(float) * channels * width * height;
+  return sizeof(float) * _scratch_size(width, height) * dt_get_num_threads();
 }
 
 #ifdef HAVE_OPENCL
@@ -105,7 +215,7 @@ size_t dt_gaussian_singlebuffer_size(const int width,    // width of input image
 #ifdef HAVE_OPENCL
   mem_use = sizeof(float) * channels * (width + BLOCKSIZE) * (height + BLOCKSIZE);
 #else
-  mem_use = sizeof(float) * channels * width * height;
+  mem_use = dt_gaussian_memory_use(width, height, channels);
 #endif
   return mem_use;
 }
@@ -119,6 +229,8 @@ dt_gaussian_t *dt_gaussian_init(const int width,    // width of input image
                                 const float sigma,  // gaussian sigma
                                 const int order)    // order of gaussian blur
 {
+  if(channels < 1 || channels > 4) return NULL;
+
   dt_gaussian_t *g = (dt_gaussian_t *)malloc(sizeof(dt_gaussian_t));
   if(!g) return NULL;
 
@@ -139,365 +251,240 @@ dt_gaussian_t *dt_gaussian_init(const int width,    // width of input image
     g->min[k] = min[k];
   }
 
-  g->buf = dt_alloc_align_float((size_t)channels * width * height);
+  g->buf = _scratch_get(_scratch_size(width, height), &g->buf_size);
   if(!g->buf) goto error;
 
   return g;
 
 error:
-  dt_free_align(g->buf);
+  _scratch_put(g->buf, g->buf_size);
   free(g->max);
   free(g->min);
   free(g);
   return NULL;
 }
 
-
-void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
+static inline float _clamp(const float x, const float mn, const float mx)
 {
+  return CLAMPF(x, mn, mx);
+}
 
-  const int width = g->width;
-  const int height = g->height;
-  const int ch = MIN(4, g->channels); // just to appease zealous compiler warnings about stack usage
-
-  float a0, a1, a2, a3, b1, b2, coefp, coefn;
-
-  compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
-
-  float *temp = g->buf;
-
-  float *Labmax = g->max;
-  float *Labmin = g->min;
-
-// vertical blur column by column
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, width, height, ch) \
-  shared(temp, Labmin, Labmax, a0, a1, a2, a3, b1, b2, coefp, coefn) \
-  schedule(static)
-#endif
-  for(int i = 0; i < width; i++)
+// vertical pass over a strip of n <= GAUSS_STRIP floats, stride floats apart from one row to the next.
+// the forward pass is kept in fw until the backward pass adds to it.
+static inline void _blur_vertical_strip(const _gauss_coeffs_t *const c, const float *const in,
+                                        float *const out, float *const restrict fw, const int height,
+                                        const size_t stride, const int n)
+{
+  float xp[GAUSS_STRIP], yb[GAUSS_STRIP], yp[GAUSS_STRIP];
+  for(int k = 0; k < n; k++)
   {
-    dt_aligned_pixel_t xp = {0.0f};
-    dt_aligned_pixel_t yb = {0.0f};
-    dt_aligned_pixel_t yp = {0.0f};
+    xp[k] = _clamp(in[k], c->min[k], c->max[k]);
+    yb[k] = xp[k] * c->coefp;
+    yp[k] = yb[k];
+  }
 
-    // forward filter
-    for(int k = 0; k < ch; k++)
+  for(int j = 0; j < height; j++)
+  {
+    const float *const row = in + j * stride;
+    float *const restrict y = fw + (size_t)j * GAUSS_STRIP;
+    for(int k = 0; k < n; k++)
     {
-      xp[k] = CLAMPF(in[(size_t)i * ch + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
+      const float xc = _clamp(row[k], c->min[k], c->max[k]);
+      const float yc = (c->a0 * xc) + (c->a1 * xp[k]) - (c->b1 * yp[k]) - (c->b2 * yb[k]);
+      y[k] = yc;
+      xp[k] = xc;
+      yb[k] = yp[k];
+      yp[k] = yc;
     }
+  }
 
-    dt_aligned_pixel_t xc = {0.0f};
-    dt_aligned_pixel_t yc = {0.0f};
-    dt_aligned_pixel_t xn = {0.0f};
-    dt_aligned_pixel_t xa = {0.0f};
-    dt_aligned_pixel_t yn = {0.0f};
-    dt_aligned_pixel_t ya = {0.0f};
-    for(int j = 0; j < height; j++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        temp[offset + k] = yc[k];
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
+  float xn[GAUSS_STRIP], xa[GAUSS_STRIP], yn[GAUSS_STRIP], ya[GAUSS_STRIP];
+  for(int k = 0; k < n; k++)
+  {
+    xn[k] = _clamp(in[(height - 1) * stride + k], c->min[k], c->max[k]);
+    xa[k] = xn[k];
+    yn[k] = xn[k] * c->coefn;
+    ya[k] = yn[k];
+  }
 
-    // backward filter
-    for(int k = 0; k < ch; k++)
+  for(int j = height - 1; j > -1; j--)
+  {
+    // in and out may be the same buffer: the row is read completely before it is written
+    const float *const row = in + j * stride;
+    float *const row_out = out + j * stride;
+    const float *const restrict y = fw + (size_t)j * GAUSS_STRIP;
+    float xc[GAUSS_STRIP];
+    for(int k = 0; k < n; k++) xc[k] = _clamp(row[k], c->min[k], c->max[k]);
+    for(int k = 0; k < n; k++)
     {
-      xn[k] = CLAMPF(in[((size_t)(height - 1) * width + i) * ch + k], Labmin[k], Labmax[k]);
+      const float yc = (c->a2 * xn[k]) + (c->a3 * xa[k]) - (c->b1 * yn[k]) - (c->b2 * ya[k]);
       xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
+      xn[k] = xc[k];
       ya[k] = yn[k];
+      yn[k] = yc;
     }
-
-    for(int j = height - 1; j > -1; j--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(in[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
-
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
-
-        temp[offset + k] += yc[k];
-      }
-    }
+    for(int k = 0; k < n; k++) row_out[k] = y[k] + yn[k];
   }
+}
 
-// horizontal blur line by line
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(out, ch, width, height) \
-  shared(temp, Labmin, Labmax, a0, a1, a2, a3, b1, b2, coefp, coefn) \
-  schedule(static)
-#endif
-  for(int j = 0; j < height; j++)
+// recursive filter along x of width pixels of GAUSS_LANES floats each, from the clamped input x to y
+static inline void _blur_transposed(const _gauss_coeffs_t *const c, const float *const restrict x,
+                                    float *const restrict y, const int width)
+{
+  float xp[GAUSS_LANES], yb[GAUSS_LANES], yp[GAUSS_LANES];
+  for(int k = 0; k < GAUSS_LANES; k++)
   {
-    dt_aligned_pixel_t xp = {0.0f};
-    dt_aligned_pixel_t yb = {0.0f};
-    dt_aligned_pixel_t yp = {0.0f};
+    xp[k] = x[k];
+    yb[k] = xp[k] * c->coefp;
+    yp[k] = yb[k];
+  }
 
-    // forward filter
-    for(int k = 0; k < ch; k++)
+  for(int i = 0; i < width; i++)
+  {
+    const float *const xi = x + (size_t)i * GAUSS_LANES;
+    float *const yi = y + (size_t)i * GAUSS_LANES;
+    for(int k = 0; k < GAUSS_LANES; k++)
     {
-      xp[k] = CLAMPF(temp[(size_t)j * width * ch + k], Labmin[k], Labmax[k]);
-      yb[k] = xp[k] * coefp;
-      yp[k] = yb[k];
+      const float yc = (c->a0 * xi[k]) + (c->a1 * xp[k]) - (c->b1 * yp[k]) - (c->b2 * yb[k]);
+      yi[k] = yc;
+      xp[k] = xi[k];
+      yb[k] = yp[k];
+      yp[k] = yc;
     }
+  }
 
-    dt_aligned_pixel_t xc = {0.0f};
-    dt_aligned_pixel_t yc = {0.0f};
-    dt_aligned_pixel_t xn = {0.0f};
-    dt_aligned_pixel_t xa = {0.0f};
-    dt_aligned_pixel_t yn = {0.0f};
-    dt_aligned_pixel_t ya = {0.0f};
-
-    for(int i = 0; i < width; i++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
-        yc[k] = (a0 * xc[k]) + (a1 * xp[k]) - (b1 * yp[k]) - (b2 * yb[k]);
-
-        out[offset + k] = yc[k];
-
-        xp[k] = xc[k];
-        yb[k] = yp[k];
-        yp[k] = yc[k];
-      }
-    }
+  float xn[GAUSS_LANES], xa[GAUSS_LANES], yn[GAUSS_LANES], ya[GAUSS_LANES];
+  for(int k = 0; k < GAUSS_LANES; k++)
+  {
+    xn[k] = x[(size_t)(width - 1) * GAUSS_LANES + k];
+    xa[k] = xn[k];
+    yn[k] = xn[k] * c->coefn;
+    ya[k] = yn[k];
+  }
 
-    // backward filter
-    for(int k = 0; k < ch; k++)
+  for(int i = width - 1; i > -1; i--)
+  {
+    const float *const xi = x + (size_t)i * GAUSS_LANES;
+    float *const yi = y + (size_t)i * GAUSS_LANES;
+    for(int k = 0; k < GAUSS_LANES; k++)
     {
-      xn[k] = CLAMPF(temp[((size_t)(j + 1) * width - 1) * ch + k], Labmin[k], Labmax[k]);
+      const float yc = (c->a2 * xn[k]) + (c->a3 * xa[k]) - (c->b1 * yn[k]) - (c->b2 * ya[k]);
       xa[k] = xn[k];
-      yn[k] = xn[k] * coefn;
+      xn[k] = xi[k];
       ya[k] = yn[k];
+      yn[k] = yc;
+      yi[k] += yc;
     }
+  }
+}
 
-    for(int i = width - 1; i > -1; i--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
+// horizontal pass over rows rows (at most GAUSS_LANES / ch) of buf, in place
+static inline void _blur_horizontal_rows(const _gauss_coeffs_t *const c, float *const buf,
+                                         float *const restrict scratch, const int width, const int rows,
+                                         const int ch)
+{
+  const size_t stride = (size_t)width * ch;
+  float *const restrict x = scratch;
+  float *const restrict y = scratch + (size_t)width * GAUSS_LANES;
 
+  // transpose the rows into x, unused lanes are left zero
+  if(rows * ch < GAUSS_LANES) memset(x, 0, sizeof(float) * GAUSS_LANES * width);
+  for(int r = 0; r < rows; r++)
+  {
+    const float *const row = buf + r * stride;
+    for(int i = 0; i < width; i++)
       for(int k = 0; k < ch; k++)
-      {
-        xc[k] = CLAMPF(temp[offset + k], Labmin[k], Labmax[k]);
-
-        yc[k] = (a2 * xn[k]) + (a3 * xa[k]) - (b1 * yn[k]) - (b2 * ya[k]);
+        x[(size_t)i * GAUSS_LANES + r * ch + k] = _clamp(row[(size_t)i * ch + k], c->min[k], c->max[k]);
+  }
 
-        xa[k] = xn[k];
-        xn[k] = xc[k];
-        ya[k] = yn[k];
-        yn[k] = yc[k];
+  _blur_transposed(c, x, y, width);
 
-        out[offset + k] += yc[k];
-      }
-    }
+  for(int r = 0; r < rows; r++)
+  {
+    float *const row = buf + r * stride;
+    for(int i = 0; i < width; i++)
+      for(int k = 0; k < ch; k++)
+        row[(size_t)i * ch + k] = y[(size_t)i * GAUSS_LANES + r * ch + k];
   }
 }
 
-
-
-#if defined(__SSE__)
-static void dt_gaussian_blur_4c_sse(dt_gaussian_t *g, const float *const in, float *const out)
+__DT_CLONE_TARGETS__
+static void _gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out, const int ch)
 {
-
   const int width = g->width;
   const int height = g->height;
-  const int ch = 4;
-
-  assert(g->channels == 4);
-
-  float a0, a1, a2, a3, b1, b2, coefp, coefn;
-
-  compute_gauss_params(g->sigma, g->order, &a0, &a1, &a2, &a3, &b1, &b2, &coefp, &coefn);
-
-  const __m128 Labmax = _mm_set_ps(g->max[3], g->max[2], g->max[1], g->max[0]);
-  const __m128 Labmin = _mm_set_ps(g->min[3], g->min[2], g->min[1], g->min[0]);
-
-  float *temp = g->buf;
-
+  const size_t stride = (size_t)width * ch;
+  const int lanes = GAUSS_STRIP - GAUSS_STRIP % ch; // whole pixels in a strip
+  float *const scratch = g->buf;
+  const size_t scratch_size = g->buf_size;
+
+  _gauss_coeffs_t c;
+  compute_gauss_params(g->sigma, g->order, &c.a0, &c.a1, &c.a2, &c.a3, &c.b1, &c.b2, &c.coefp, &c.coefn);
+  for(int k = 0; k < GAUSS_STRIP; k++)
+  {
+    c.min[k] = g->min[k % ch];
+    c.max[k] = g->max[k % ch];
+  }
 
-// vertical blur column by column
+  // vertical blur in strips of whole pixels
+  const size_t strips = (stride + lanes - 1) / lanes;
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, Labmin, Labmax, width, height, ch) \
-  shared(temp, a0, a1, a2, a3, b1, b2, coefp, coefn) \
+  dt_omp_firstprivate(in, out, height, stride, lanes, strips, scratch, scratch_size) \
+  shared(c) \
   schedule(static)
 #endif
-  for(int i = 0; i < width; i++)
+  for(size_t s = 0; s < strips; s++)
   {
-    __m128 xp = _mm_setzero_ps();
-    __m128 yb = _mm_setzero_ps();
-    __m128 yp = _mm_setzero_ps();
-    __m128 xc = _mm_setzero_ps();
-    __m128 yc = _mm_setzero_ps();
-    __m128 xn = _mm_setzero_ps();
-    __m128 xa = _mm_setzero_ps();
-    __m128 yn = _mm_setzero_ps();
-    __m128 ya = _mm_setzero_ps();
-
-    // forward filter
-    xp = MMCLAMPPS(_mm_load_ps(in + i * ch), Labmin, Labmax);
-    yb = _mm_mul_ps(_mm_set_ps1(coefp), xp);
-    yp = yb;
-
-
-    for(int j = 0; j < height; j++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
-
-
-      yc = _mm_add_ps(
-          _mm_mul_ps(xc, _mm_set_ps1(a0)),
-          _mm_sub_ps(_mm_mul_ps(xp, _mm_set_ps1(a1)),
-                     _mm_add_ps(_mm_mul_ps(yp, _mm_set_ps1(b1)), _mm_mul_ps(yb, _mm_set_ps1(b2)))));
-
-      _mm_store_ps(temp + offset, yc);
-
-      xp = xc;
-      yb = yp;
-      yp = yc;
-    }
-
-    // backward filter
-    xn = MMCLAMPPS(_mm_load_ps(in + ((size_t)(height - 1) * width + i) * ch), Labmin, Labmax);
-    xa = xn;
-    yn = _mm_mul_ps(_mm_set_ps1(coefn), xn);
-    ya = yn;
-
-    for(int j = height - 1; j > -1; j--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      xc = MMCLAMPPS(_mm_load_ps(in + offset), Labmin, Labmax);
-
-      yc = _mm_add_ps(
-          _mm_mul_ps(xn, _mm_set_ps1(a2)),
-          _mm_sub_ps(_mm_mul_ps(xa, _mm_set_ps1(a3)),
-                     _mm_add_ps(_mm_mul_ps(yn, _mm_set_ps1(b1)), _mm_mul_ps(ya, _mm_set_ps1(b2)))));
-
-
-      xa = xn;
-      xn = xc;
-      ya = yn;
-      yn = yc;
-
-      _mm_store_ps(temp + offset, _mm_add_ps(_mm_load_ps(temp + offset), yc));
-    }
+    float *const restrict fw = dt_get_perthread(scratch, scratch_size);
+    const size_t offset = s * lanes;
+    const int n = MIN(lanes, stride - offset);
+    // give the compiler a constant count in the common case
+    if(n == GAUSS_STRIP)
+      _blur_vertical_strip(&c, in + offset, out + offset, fw, height, stride, GAUSS_STRIP);
+    else
+      _blur_vertical_strip(&c, in + offset, out + offset, fw, height, stride, n);
   }
 
-// horizontal blur line by line
+  // horizontal blur on blocks of rows
+  const int block = GAUSS_LANES / ch;
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(out, Labmin, Labmax, width, height, ch) \
-  shared(temp, a0, a1, a2, a3, b1, b2, coefp, coefn) \
+  dt_omp_firstprivate(out, width, height, ch, stride, block, scratch, scratch_size) \
+  shared(c) \
   schedule(static)
 #endif
-  for(size_t j = 0; j < height; j++)
+  for(int j = 0; j < height; j += block)
   {
-    __m128 xp = _mm_setzero_ps();
-    __m128 yb = _mm_setzero_ps();
-    __m128 yp = _mm_setzero_ps();
-    __m128 xc = _mm_setzero_ps();
-    __m128 yc = _mm_setzero_ps();
-    __m128 xn = _mm_setzero_ps();
-    __m128 xa = _mm_setzero_ps();
-    __m128 yn = _mm_setzero_ps();
-    __m128 ya = _mm_setzero_ps();
-
-    // forward filter
-    xp = MMCLAMPPS(_mm_load_ps(temp + j * width * ch), Labmin, Labmax);
-    yb = _mm_mul_ps(_mm_set_ps1(coefp), xp);
-    yp = yb;
-
-
-    for(int i = 0; i < width; i++)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      xc = MMCLAMPPS(_mm_load_ps(temp + offset), Labmin, Labmax);
-
-      yc = _mm_add_ps(
-          _mm_mul_ps(xc, _mm_set_ps1(a0)),
-          _mm_sub_ps(_mm_mul_ps(xp, _mm_set_ps1(a1)),
-                     _mm_add_ps(_mm_mul_ps(yp, _mm_set_ps1(b1)), _mm_mul_ps(yb, _mm_set_ps1(b2)))));
-
-      _mm_store_ps(out + offset, yc);
-
-      xp = xc;
-      yb = yp;
-      yp = yc;
-    }
-
-    // backward filter
-    xn = MMCLAMPPS(_mm_load_ps(temp + ((size_t)(j + 1) * width - 1) * ch), Labmin, Labmax);
-    xa = xn;
-    yn = _mm_mul_ps(_mm_set_ps1(coefn), xn);
-    ya = yn;
-
-
-    for(int i = width - 1; i > -1; i--)
-    {
-      size_t offset = ((size_t)j * width + i) * ch;
-
-      xc = MMCLAMPPS(_mm_load_ps(temp + offset), Labmin, Labmax);
-
-      yc = _mm_add_ps(
-          _mm_mul_ps(xn, _mm_set_ps1(a2)),
-          _mm_sub_ps(_mm_mul_ps(xa, _mm_set_ps1(a3)),
-                     _mm_add_ps(_mm_mul_ps(yn, _mm_set_ps1(b1)), _mm_mul_ps(ya, _mm_set_ps1(b2)))));
-
-
-      xa = xn;
-      xn = xc;
-      ya = yn;
-      yn = yc;
-
-      _mm_store_ps(out + offset, _mm_add_ps(_mm_load_ps(out + offset), yc));
-    }
+    float *const restrict buf = dt_get_perthread(scratch, scratch_size);
+    const int rows = MIN(block, height - j);
+    // constant channel counts for the inner transpositions
+    if(ch == 1)
+      _blur_horizontal_rows(&c, out + j * stride, buf, width, rows, 1);
+    else if(ch == 2)
+      _blur_horizontal_rows(&c, out + j * stride, buf, width, rows, 2);
+    else if(ch == 4)
+      _blur_horizontal_rows(&c, out + j * stride, buf, width, rows, 4);
+    else
+      _blur_horizontal_rows(&c, out + j * stride, buf, width, rows, ch);
   }
 }
-#endif
+
+void dt_gaussian_blur(dt_gaussian_t *g, const float *const in, float *const out)
+{
+  _gaussian_blur(g, in, out, g->channels);
+}
 
 void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const out)
 {
-  if(darktable.codepath.OPENMP_SIMD) return dt_gaussian_blur(g, in, out);
-#if defined(__SSE__)
-  else if(darktable.codepath.SSE2)
-    return dt_gaussian_blur_4c_sse(g, in, out);
-#endif
-  else
-    dt_unreachable_codepath();
+  assert(g->channels == 4);
+  _gaussian_blur(g, in, out, 4);
 }
 
 void dt_gaussian_free(dt_gaussian_t *g)
 {
   if(!g) return;
-  dt_free_align(g->buf);
+  _scratch_put(g->buf, g->buf_size);
   free(g->min);
   free(g->max);
   free(g);
@@ -37,7 +37,8 @@ typedef struct dt_gaussian_t
   int order;
   float *max;
   float *min;
-  float *buf;
+  float *buf;      // per-thread scratch space
+  size_t buf_size; // floats per thread in buf
 } dt_gaussian_t;
 
 dt_gaussian_t *dt_gaussian_init(const int width, const int height, const int channels, const float *max,
@@ -56,6 +57,9 @@ void dt_gaussian_blur_4c(dt_gaussian_t *g, const float *const in, float *const o
 
 void dt_gaussian_free(dt_gaussian_t *g);
 
+// release the scratch buffers kept for the next blurs
+void dt_gaussian_pool_cleanup();
+
 
 #ifdef HAVE_OPENCL
 typedef struct dt_gaussian_cl_global_t
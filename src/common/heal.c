@@ -34,9 +34,12 @@
  * but subtract them I2 = I0 - I1, where I0 is the sample image to be
  * corrected, I1 is the reference pattern. Then we solve DeltaI=0
  * (Laplace) with I2 Dirichlet conditions at the borders of the
- * mask. The solver is a red/black checker Gauss-Seidel with over-relaxation.
- * It could benefit from a multi-grid evaluation of an initial solution
- * before the main iteration loop.
+ * mask. The solver is a multigrid V-cycle: a few red/black checker
+ * Gauss-Seidel sweeps smooth out the high frequencies of the error, the
+ * low frequencies are solved for on a half resolution grid, recursively.
+ * Each cycle reduces the residual by about an order of magnitude whatever
+ * the size of the mask, where plain Gauss-Seidel needs a number of
+ * iterations growing with the size of the mask.
  *
  * I reduced the convergence criteria to 0.1% (0.001) as we are
  * dealing here with RGB integer components, more is overkill.
@@ -44,339 +47,236 @@
  * Jean-Yves Couleaud cjyves@free.fr
  */
 
+// levels are halved until they fit in HEAL_MIN_SIZE x HEAL_MIN_SIZE
+#define HEAL_MIN_SIZE 16
+#define HEAL_MAX_LEVELS 16
+// sweeps before and after the coarse grid correction, and on the coarsest level
+#define HEAL_SMOOTH_SWEEPS 2
+#define HEAL_COARSEST_SWEEPS 100
 
-// Subtract bottom from top and store in result as a float; separate 'red' and 'black' pixels into
-// two contiguous regions
-static void _heal_sub(const float *const top_buffer, const float *const bottom_buffer,
-                      float *const restrict red_buffer, float *const restrict black_buffer,
-                      const size_t width, const size_t height)
+typedef struct _heal_level_t
 {
-  // how many red or black pixels per line?  For consistency, we need the larger of the two, so round up
-  const size_t res_stride = 4 * ((width + 1) / 2);
-
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(top_buffer, bottom_buffer, red_buffer, black_buffer, height, width, res_stride) \
-  schedule(static)
-#endif
-  for(size_t row = 0; row < height; row++)
+  size_t width, height;
+  float *mask;  // pixels to solve for, 1 channel
+  float *u;     // solution, 4 channels
+  float *f;     // right hand side, 4 channels, NULL for zero
+} _heal_level_t;
+
+// sum of the neighbours of pixel (row, col) inside the image into sum, returns their number
+static inline float _heal_neighbours(const _heal_level_t *const l, const size_t row, const size_t col,
+                                     dt_aligned_pixel_t sum)
+{
+  const size_t k = row * l->width + col;
+  const float *const u = l->u;
+  float a = 0.0f;
+  for_each_channel(c) sum[c] = l->f ? l->f[4*k + c] : 0.0f;
+  if(row > 0)
   {
-    const int parity = row & 1;
-    const size_t row_start = (row+1) * res_stride;
-    float *const buf1 = parity ? red_buffer + row_start : black_buffer + row_start;
-    float *const buf2 = parity ? black_buffer + row_start : red_buffer + row_start;
-    // handle the pixels of the row pairwise, one red and one black at a time
-    for(size_t col = 0; col < width/2; col++)
-    {
-      const size_t idx = 4 * (row * width + 2*col);
-      for_each_channel(c)
-      {
-        buf1[4*col + c] = top_buffer[idx + c] - bottom_buffer[idx + c];
-        buf2[4*col + c] = top_buffer[idx+4 + c] - bottom_buffer[idx+4 + c];
-      }
-    }
-    if(width & 1)
-    {
-      // Handle the left-over pixel when the total width is odd.  Its color will always be the same as the
-      // left-most pixel, so it goes into buf1
-      const size_t res_idx = (width-1)/2;
-      const size_t idx = 4 * (row * width + (width-1));
-      for_each_channel(c)
-      {
-        buf1[4*res_idx + c] = top_buffer[idx + c] - bottom_buffer[idx + c];
-        buf2[4*res_idx + c] = 0.0f;
-      }
-    }
+    for_each_channel(c) sum[c] += u[4*(k - l->width) + c];
+    a += 1.0f;
+  }
+  if(row + 1 < l->height)
+  {
+    for_each_channel(c) sum[c] += u[4*(k + l->width) + c];
+    a += 1.0f;
   }
-  // clear the top and bottom rows, used for padding
-  memset(red_buffer, 0, res_stride * sizeof(float));
-  memset(red_buffer + (height+1)*res_stride, 0, res_stride * sizeof(float));
-  memset(black_buffer, 0, res_stride * sizeof(float));
-  memset(black_buffer + (height+1)*res_stride, 0, res_stride * sizeof(float));
+  if(col > 0)
+  {
+    for_each_channel(c) sum[c] += u[4*(k - 1) + c];
+    a += 1.0f;
+  }
+  if(col + 1 < l->width)
+  {
+    for_each_channel(c) sum[c] += u[4*(k + 1) + c];
+    a += 1.0f;
+  }
+  return a;
 }
 
-// Add first to second and store in result, re-interleaving the 'red' and 'black' pixels
-static void _heal_add(const float *const restrict red_buffer, const float *const black_buffer,
-                      const float *const restrict second_buffer, float *const restrict result_buffer,
-                      const size_t width, const size_t height)
+// residual f - Laplacian(u) of pixel (row, col)
+static inline void _heal_residual(const _heal_level_t *const l, const size_t row, const size_t col,
+                                  dt_aligned_pixel_t r)
 {
-  // how many red or black pixels per line?  For consistency, we need the larger of the two, so round up, then
-  // add one to ensure a padding pixel on the right
-  const size_t res_stride = 4 * ((width + 1) / 2);
+  const float a = _heal_neighbours(l, row, col, r);
+  const float *const u = l->u + 4 * (row * l->width + col);
+  for_each_channel(c) r[c] -= a * u[c];
+}
 
+// One Gauss-Seidel sweep, on the red then on the black pixels of the checker board: pixels of one color
+// only depend on the ones of the other, so that each half is done in parallel. Returns the sum of the squared
+// residuals of the pixels before their update.
+static float _heal_smooth(const _heal_level_t *const l)
+{
+  float err = 0.0f;
+  for(int parity = 0; parity < 2; parity++)
+  {
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(red_buffer, black_buffer, second_buffer, height, width, res_stride) \
-  dt_omp_sharedconst(result_buffer) \
-  schedule(static)
+  dt_omp_firstprivate(l, parity) \
+  schedule(static) \
+  reduction(+ : err)
 #endif
-  for(size_t row = 0; row < height; row++)
-  {
-    const int parity = row & 1;
-    const size_t row_start = (row+1) * res_stride;
-    const float *const restrict buf1 = parity ? red_buffer + row_start : black_buffer + row_start;
-    const float *const restrict buf2 = parity ? black_buffer + row_start : red_buffer + row_start;
-    // handle the pixels of the row pairwise, one red and one black at a time
-    for(size_t col = 0; col < width/2; col++)
-    {
-      const size_t idx = 4 * (row * width + 2*col);
-      for_each_channel(c)
+    for(size_t row = 0; row < l->height; row++)
+      for(size_t col = (row + parity) & 1; col < l->width; col += 2)
       {
-        result_buffer[idx + c] = buf1[4*col + c] + second_buffer[idx + c];
-        result_buffer[idx + 4 + c] = buf2[4*col + c] + second_buffer[idx + 4 + c];
+        const size_t k = row * l->width + col;
+        if(l->mask[k] == 0.0f) continue;
+        dt_aligned_pixel_t sum;
+        const float a = _heal_neighbours(l, row, col, sum);
+        if(a == 0.0f) continue;
+        dt_aligned_pixel_t r;
+        for_each_channel(c) r[c] = sum[c] - a * l->u[4*k + c];
+        err += r[0] * r[0] + r[1] * r[1] + r[2] * r[2];
+        for_each_channel(c) l->u[4*k + c] = sum[c] / a;
       }
-    }
-    if(width & 1)
-    {
-      // handle the left-over pixel when the total width is odd
-      const size_t res_idx = (width-1)/2;
-      const size_t idx = 4 * (row * width + (width-1));
-      for_each_channel(c)
-        result_buffer[idx + c] = buf1[4*res_idx + c] + second_buffer[idx + c];
-    }
   }
+  return err;
 }
 
-// define a custom reduction operation to handle a 3-vector of floats
-// we can't return an array from a function, so wrap the array type in a struct
-typedef struct _aligned_pixel { dt_aligned_pixel_t v; } _aligned_pixel;
-#ifdef _OPENMP
-static inline _aligned_pixel _add_float4(_aligned_pixel acc, _aligned_pixel newval)
-{
-  for_each_channel(c) acc.v[c] += newval.v[c];
-  return acc;
-}
-#pragma omp declare reduction(vsum:_aligned_pixel:omp_out=_add_float4(omp_out,omp_in)) \
-  initializer(omp_priv = { { 0.0f, 0.0f, 0.0f, 0.0f } })
-#endif
-
-// Perform one iteration of Gauss-Seidel, and return the sum squared residual.
-static float _heal_laplace_iteration(float *const restrict active_pixels,
-                                     const float *const restrict neighbor_pixels,
-                                     const size_t height, const size_t width, const unsigned *const restrict runs,
-                                     const size_t num_runs, const size_t start_parity, const float w)
+// Move the residual of the fine level to the right hand side of the coarse one, and clear its solution. The
+// sum of the 2x2 fine residuals keeps the scale of the coarse Laplacian, which has twice the pixel spacing.
+static void _heal_restrict(const _heal_level_t *const fine, const _heal_level_t *const coarse)
 {
-  _aligned_pixel err = { { 0.f } };
-
-  // on each iteration, we adjust each cell of the current color by a weighted fraction of the difference between
-  // it and the sum of the adjacenct cells of the opposite color.  Because we've split the cells by color, this
-  // leads to a somewhat different computation of neighbors.
-  // Rearranged, as provided to this function:
-  //   r00 r01 r02 ...           b00 b01 b02 ...
-  //   r10 r11 r12               b10 b11 b12
-  //   r20 r21 r22               b20 b21 b22
-  //   ...                       ...
-  // Original layout, from which we need to get the neighbors:
-  //     r00 b00 r01 b01 r02 b02 ...
-  //     b10 r10 b11 r11 b12 r12
-  //     r20 b20 r21 b21 r22 b22
-  //     b30 r30 b31 r31 b32 r32
-  //     ...
-  // As can be seen, the 'above' and 'below' neighbors of r(i)(j) are always b(i-1)(j) and b(i+1)(j).  The
-  // left and right neighbors depend on which color the row starts with: if red, they are b(i)(j-1) and b(i)(j);
-  // if black, they are b(i)(j) and b(i)(j+1).  All of the above holds when colors are swapped.
-#if !(defined(__apple_build_version__) && __apple_build_version__ < 11030000) //makes Xcode 11.3.1 compiler crash
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(active_pixels, neighbor_pixels, runs, num_runs, width, height, start_parity, w) \
-  schedule(static) \
-  reduction(vsum : err)
-#endif /* _OPENMP */
+  dt_omp_firstprivate(fine, coarse) \
+  schedule(static)
 #endif
-    for(size_t i = 0; i < num_runs; i++)
+  for(size_t row = 0; row < coarse->height; row++)
+    for(size_t col = 0; col < coarse->width; col++)
     {
-      const size_t idx = runs[2*i];
-      const unsigned count = runs[2*i+1];
-      const size_t index = (size_t)4 * idx;
-      const size_t row = idx / width;
-      float a = 4.0f; // four neighboring pixels except at the edges
-      if(row == 1) a -= 1.0f;  // we added a padding row at top and bottom
-      if(row == height) a -= 1.0f;
-      const size_t vert_offset = 4 * width;
-      const size_t lroffset = 4 * (start_parity ^ (row & 1)); // how many floats to offset the left/right neighbors
-      if(count == 1)
-      {
-        const size_t col = idx % width;
-        float aa = a;
-        dt_aligned_pixel_t left = { 0.0f };
-        dt_aligned_pixel_t right = { 0.0f };
-        if(col > 0 || lroffset) // first pixel in original stamp?
-          for_each_channel(c) left[c] = neighbor_pixels[index - 4 + lroffset + c];
-        else
-          aa -= 1.0f;
-        if(col + 1 < width || lroffset == 0) // last pixel in original stamp?
-          for_each_channel(c) right[c] = neighbor_pixels[index + lroffset + c];
-        else
-          aa -= 1.0f;
-
-        dt_aligned_pixel_t diff;
-        for_each_channel(c, aligned(active_pixels, neighbor_pixels))
+      dt_aligned_pixel_t sum = { 0.0f };
+      for(size_t y = 2*row; y < MIN(2*row + 2, fine->height); y++)
+        for(size_t x = 2*col; x < MIN(2*col + 2, fine->width); x++)
         {
-          diff[c] = w * ((aa * active_pixels[index+c])
-                             - (neighbor_pixels[index - vert_offset + c] + neighbor_pixels[index + vert_offset + c]
-                                + left[c] + right[c]));
-          active_pixels[index + c] -= diff[c];
-          err.v[c] += (diff[c] * diff[c]);
+          if(fine->mask[y * fine->width + x] == 0.0f) continue;
+          dt_aligned_pixel_t r;
+          _heal_residual(fine, y, x, r);
+          for_each_channel(c) sum[c] += r[c];
         }
-        continue;
-      }
-      dt_aligned_pixel_t left;
-      copy_pixel(left, neighbor_pixels + index - 4 + lroffset);
-      for(size_t j = 0; j < count; j++)
+      const size_t k = row * coarse->width + col;
+      for_each_channel(c)
       {
-        const size_t pixidx = index + 4*j;
-        dt_aligned_pixel_t diff;
-        dt_aligned_pixel_t right;
-        for_each_channel(c, aligned(active_pixels,neighbor_pixels))
-        {
-          right[c] = neighbor_pixels[pixidx + lroffset + c];
-          diff[c] = w * (a * active_pixels[pixidx+c]
-                         - (neighbor_pixels[pixidx - vert_offset + c] + neighbor_pixels[pixidx + vert_offset + c]
-                            + left[c] + right[c]));
-          active_pixels[pixidx + c] -= diff[c];
-          err.v[c] += (diff[c] * diff[c]);
-          left[c] = right[c];
-        }
+        coarse->f[4*k + c] = sum[c];
+        coarse->u[4*k + c] = 0.0f;
       }
     }
-  return err.v[0] + err.v[1] + err.v[2];
 }
 
-// convert alternating pixels of one row of the opacity mask into a set of runs of opaque pixels of the
-// form (start_index, count), and return the updated number of runs
-static size_t _collect_color_runs(const float *const restrict mask, const size_t start_index,
-                                  size_t start, const size_t width,
-                                  unsigned *const restrict runs, size_t count, size_t *nmask)
+// Add the bilinear interpolation of the coarse correction to the pixels to solve for
+static void _heal_prolongate(const _heal_level_t *const coarse, const _heal_level_t *const fine)
 {
-  size_t masked = 0;
-  // handle the first and last pixels of the row specially so that we don't need checks on every pixel in the
-  // adaptation loop (which will be run hundreds of times for any stamp large enough that execution time is
-  // non-negligible)
-  if(start == 0 && mask[start])
-  {
-    runs[2*count] = start_index;
-    runs[2*count+1] = 1;
-    count++;
-    masked++;
-    start += 2; // we've processed the first pixel
-  }
-  gboolean in_run = FALSE;
-  unsigned run_start = 0;
-  size_t col;
-  for(col = start; col < width; col += 2)
-  {
-    if(mask[col])
-    {
-      masked++;
-      if(!in_run)
-      {
-        run_start = col;
-        in_run = TRUE;
-      }
-    }
-    else if(in_run)
-    {
-      runs[2*count] = start_index + run_start / 2;
-      runs[2*count + 1] = (col - run_start) / 2;
-      count++;
-      in_run = FALSE;
-    }
-  }
-  if(in_run)  // finish off a run that doesn't have a zero pixel to its right
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(fine, coarse) \
+  schedule(static)
+#endif
+  for(size_t row = 0; row < fine->height; row++)
   {
-    runs[2*count] = start_index + run_start / 2;
-    const unsigned runlen = (col - run_start) / 2;
-    runs[2*count + 1] = runlen;
-    if(runlen > 1 && col > width)
+    // a coarse pixel is centered between the two fine ones it covers
+    const float fy = CLAMPF(0.5f * row - 0.25f, 0.0f, coarse->height - 1.0f);
+    const size_t y0 = fy, y1 = MIN(y0 + 1, coarse->height - 1);
+    const float wy = fy - y0;
+    for(size_t col = 0; col < fine->width; col++)
     {
-      // split off the final pixel into its own run
-      runs[2*count + 1]--;
-      runs[2*count + 2] = runs[2*count] + runs[2*count+1];
-      runs[2*count + 3] = 1;
-      count++;
+      const size_t k = row * fine->width + col;
+      if(fine->mask[k] == 0.0f) continue;
+      const float fx = CLAMPF(0.5f * col - 0.25f, 0.0f, coarse->width - 1.0f);
+      const size_t x0 = fx, x1 = MIN(x0 + 1, coarse->width - 1);
+      const float wx = fx - x0;
+      const float *const c00 = coarse->u + 4 * (y0 * coarse->width + x0);
+      const float *const c01 = coarse->u + 4 * (y0 * coarse->width + x1);
+      const float *const c10 = coarse->u + 4 * (y1 * coarse->width + x0);
+      const float *const c11 = coarse->u + 4 * (y1 * coarse->width + x1);
+      for_each_channel(c)
+        fine->u[4*k + c] += (1.0f - wy) * ((1.0f - wx) * c00[c] + wx * c01[c])
+                            + wy * ((1.0f - wx) * c10[c] + wx * c11[c]);
     }
-    count++;
   }
-  *nmask += masked;
-  return count;
 }
 
-// convert one row of the opacity mask into a set of runs of opaque pixels of the form (start_index, count)
-static void collect_runs(const int start, const float *const restrict mask, const size_t width, const size_t height,
-                         const size_t subwidth, unsigned *const restrict runs, size_t *count, size_t *nmask)
+// One V-cycle, returns the residuals seen by the last sweep on the finest level
+static float _heal_vcycle(const _heal_level_t *const levels, const int num_levels)
 {
-  for(size_t row = 0; row < height; row++)
+  const _heal_level_t *const l = levels;
+  float err = 0.0f;
+  if(num_levels == 1)
   {
-    const int parity = start ^ (row & 1);
-    const size_t index = (row + 1) * subwidth;
-    const size_t mask_index = row * width;
-    *count = _collect_color_runs(mask + mask_index, index, parity, width, runs, *count, nmask);
+    for(int i = 0; i < HEAL_COARSEST_SWEEPS; i++) err = _heal_smooth(l);
+    return err;
   }
+  for(int i = 0; i < HEAL_SMOOTH_SWEEPS; i++) _heal_smooth(l);
+  _heal_restrict(l, l + 1);
+  _heal_vcycle(l + 1, num_levels - 1);
+  _heal_prolongate(l + 1, l);
+  for(int i = 0; i < HEAL_SMOOTH_SWEEPS; i++) err = _heal_smooth(l);
+  return err;
 }
 
-// Solve the laplace equation for pixels and store the result in-place.
-static void _heal_laplace_loop(float *const restrict red_pixels, float *const restrict black_pixels,
-                               const size_t width, const size_t height,
-                               const float *const restrict mask, const int max_iter)
+// Halve the resolution of the mask. A coarse pixel is solved for only if all the pixels it covers are: the
+// correction has to vanish on the boundary of the mask, and overshoots if carried over it.
+static void _heal_coarse_mask(const _heal_level_t *const fine, const _heal_level_t *const coarse)
 {
-  // we start by converting the opacity mask into runs of nonzero positions, handling the 'red' and 'black'
-  // checkerboarded pixels separately
-  // the worst case is when consecutive red pixels alternate between being in the mask and out (same for black),
-  // in which case we will need exactly as many values in the run-length encoding as pixels; any other
-  // arrangement will yield fewer runs.  For any mask a user would have the patience to draw, there will only be
-  // a handful of runs in each row of pixels.
-  // Note that using `unsigned` instead of size_t, the stamp is limited to ~8 gigapixels (the main image can be larger)
-  const size_t subwidth = (width+1)/2;  // round up to be able to handle odd widths
-  unsigned *const restrict red_runs = dt_alloc_align(64, sizeof(unsigned) * subwidth * (height + 2));
-  unsigned *const restrict black_runs = dt_alloc_align(64, sizeof(unsigned) * subwidth * (height + 2));
-  if(!red_runs || !black_runs)
-  {
-    fprintf(stderr, "_heal_laplace_loop: error allocating memory for healing\n");
-    goto cleanup;
-  }
-
-  size_t num_red = 0;
-  size_t num_black = 0;
-  size_t nmask_red = 0;
-  size_t nmask_black = 0;
-
 #ifdef _OPENMP
-#pragma omp parallel sections
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(fine, coarse) \
+  schedule(static)
 #endif
+  for(size_t row = 0; row < coarse->height; row++)
+    for(size_t col = 0; col < coarse->width; col++)
+    {
+      float m = 1.0f;
+      for(size_t y = 2*row; y < MIN(2*row + 2, fine->height); y++)
+        for(size_t x = 2*col; x < MIN(2*col + 2, fine->width); x++)
+          if(fine->mask[y * fine->width + x] == 0.0f) m = 0.0f;
+      coarse->mask[row * coarse->width + col] = m;
+    }
+}
+
+// Solve the laplace equation for the masked pixels of buffer and store the result in-place.
+static void _heal_solve(float *const restrict buffer, const float *const restrict mask, const size_t width,
+                        const size_t height, const int max_iter)
+{
+  _heal_level_t levels[HEAL_MAX_LEVELS] = { { width, height, (float *)mask, buffer, NULL } };
+  int num_levels = 1;
+  while(num_levels < HEAL_MAX_LEVELS
+        && MAX(levels[num_levels-1].width, levels[num_levels-1].height) > HEAL_MIN_SIZE)
   {
-    collect_runs(1, mask, width, height, subwidth, red_runs, &num_red, &nmask_red);
-    #ifdef _OPENMP
-    #pragma omp section
-    #endif
-    collect_runs(0, mask, width, height, subwidth, black_runs, &num_black, &nmask_black);
+    const _heal_level_t *const fine = levels + num_levels - 1;
+    _heal_level_t *const coarse = levels + num_levels;
+    coarse->width = (fine->width + 1) / 2;
+    coarse->height = (fine->height + 1) / 2;
+    const size_t npixels = coarse->width * coarse->height;
+    coarse->mask = dt_alloc_align_float(npixels);
+    coarse->u = dt_alloc_align_float(4 * npixels);
+    coarse->f = dt_alloc_align_float(4 * npixels);
+    num_levels++;
+    // without memory for all levels, the coarsest one we got is just slower to solve
+    if(!coarse->mask || !coarse->u || !coarse->f)
+    {
+      fprintf(stderr, "dt_heal: error allocating memory for healing\n");
+      num_levels--;
+      break;
+    }
+    _heal_coarse_mask(fine, coarse);
   }
-  const size_t nmask = nmask_red + nmask_black;
-
-  /* Empirically optimal over-relaxation factor. (Benchmarked on
-   * round brushes, at least. I don't know whether aspect ratio
-   * affects it.)
-   */
-  const float w = ((2.0f - 1.0f / (0.1575f * sqrtf(nmask) + 0.8f)) * .25f);
 
+  // the exit criterion of the former SOR loop: the residuals seen by one red/black sweep. It summed the squares
+  // of the over-relaxed updates w * r against (epsilon * w)^2, the weight w cancels out.
   const float epsilon = (0.1 / 255);
-  const float err_exit = epsilon * epsilon * w * w;
+  const float err_exit = epsilon * epsilon;
 
-  /* Gauss-Seidel with successive over-relaxation */
   for(int iter = 0; iter < max_iter; iter++)
-  {
-    // process red/black cells separately
-    float err = _heal_laplace_iteration(black_pixels, red_pixels, height, subwidth, black_runs, num_black, 1, w);
-    err += _heal_laplace_iteration(red_pixels, black_pixels, height, subwidth, red_runs, num_red, 0, w);
+    if(_heal_vcycle(levels, num_levels) < err_exit) break;
 
-    if(err < err_exit) break;
+  for(int l = 1; l < HEAL_MAX_LEVELS; l++)
+  {
+    if(levels[l].mask) dt_free_align(levels[l].mask);
+    if(levels[l].u) dt_free_align(levels[l].u);
+    if(levels[l].f) dt_free_align(levels[l].f);
   }
-
-cleanup:
-  if(red_runs) dt_free_align(red_runs);
-  if(black_runs) dt_free_align(black_runs);
 }
 
-
 /* Original Algorithm Design:
  *
  * T. Georgiev, "Photoshop Healing Brush: a Tool for Seamless Cloning
@@ -390,26 +290,35 @@ void dt_heal(const float *const src_buffer, float *dest_buffer, const float *con
     fprintf(stderr,"dt_heal: full-color image required\n");
     return;
   }
-  const size_t subwidth = 4 * ((width+1)/2);  // round up to be able to handle odd widths
-  float *const restrict red_buffer = dt_alloc_align_float(subwidth * (height + 2));
-  float *const restrict black_buffer = dt_alloc_align_float(subwidth * (height + 2));
-  if(red_buffer == NULL || black_buffer == NULL)
+  const size_t npixels = (size_t)width * height;
+  float *const restrict diff_buffer = dt_alloc_align_float(4 * npixels);
+  if(diff_buffer == NULL)
   {
     fprintf(stderr, "dt_heal: error allocating memory for healing\n");
-    goto cleanup;
+    return;
   }
 
-  /* subtract pattern from image and store the result split by 'red' and 'black' positions  */
-  _heal_sub(dest_buffer, src_buffer, red_buffer, black_buffer, width, height);
+  /* subtract pattern from image */
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(src_buffer, dest_buffer, diff_buffer, npixels) \
+  schedule(static) aligned(src_buffer, dest_buffer, diff_buffer:64)
+#endif
+  for(size_t k = 0; k < 4 * npixels; k++)
+    diff_buffer[k] = dest_buffer[k] - src_buffer[k];
 
-  _heal_laplace_loop(red_buffer, black_buffer, width, height, mask_buffer, max_iter);
+  _heal_solve(diff_buffer, mask_buffer, width, height, max_iter);
 
   /* add solution to original image and store in dest */
-  _heal_add(red_buffer, black_buffer, src_buffer, dest_buffer, width, height);
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(src_buffer, dest_buffer, diff_buffer, npixels) \
+  schedule(static) aligned(src_buffer, dest_buffer, diff_buffer:64)
+#endif
+  for(size_t k = 0; k < 4 * npixels; k++)
+    dest_buffer[k] = diff_buffer[k] + src_buffer[k];
 
-cleanup:
-  if(red_buffer) dt_free_align(red_buffer);
-  if(black_buffer) dt_free_align(black_buffer);
+  dt_free_align(diff_buffer);
 }
 
 #ifdef HAVE_OPENCL
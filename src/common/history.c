@@ -779,6 +779,8 @@ gboolean dt_history_copy_and_paste_on_image(const int32_t imgid, const int32_t d
   else
     ret_val = _history_copy_and_paste_on_image_overwrite(imgid, dest_imgid, ops, copy_full);
 
+  if(!ret_val) dt_dev_history_pasted(dest_imgid);
+
   dt_history_snapshot_undo_create(hist->imgid, &hist->after, &hist->after_history_end);
   dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
   dt_undo_record(darktable.undo, NULL, DT_UNDO_LT_HISTORY, (dt_undo_data_t)hist,
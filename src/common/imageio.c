@@ -39,6 +39,7 @@
 #include "common/imageio_pfm.h"
 #include "common/imageio_png.h"
 #include "common/imageio_pnm.h"
+#include "common/imageio_preview.h"
 #include "common/imageio_rawspeed.h"
 #include "common/imageio_libraw.h"
 #include "common/imageio_rgbe.h"
@@ -75,6 +76,7 @@
 #include <strings.h>
 
 #ifdef USE_LUA
+#include "lua/events.h"
 #include "lua/image.h"
 #endif
 
@@ -117,9 +119,38 @@ dt_image_flags_t dt_imageio_get_type_from_extension(const char *extension)
   return 0;
 }
 
+// decompress a jpeg thumbnail into our own memory format
+static int _decompress_jpeg_thumbnail(const uint8_t *buf, const size_t bufsize, uint8_t **buffer, int32_t *width,
+                                      int32_t *height, dt_colorspaces_color_profile_type_t *color_space,
+                                      const int box_width, const int box_height)
+{
+  dt_imageio_jpeg_t jpg;
+  if(dt_imageio_jpeg_decompress_header(buf, bufsize, &jpg)) return 1;
+  dt_imageio_jpeg_decompress_scale(&jpg, box_width, box_height);
+  *buffer = (uint8_t *)dt_alloc_align(64, sizeof(uint8_t) * 4 * jpg.width * jpg.height);
+  if(!*buffer)
+  {
+    jpeg_destroy_decompress(&jpg.dinfo);
+    return 1;
+  }
+
+  *width = jpg.width;
+  *height = jpg.height;
+  // TODO: check if the embedded thumbs have a color space set! currently we assume that it's always sRGB
+  *color_space = DT_COLORSPACE_SRGB;
+  if(dt_imageio_jpeg_decompress(&jpg, *buffer))
+  {
+    dt_free_align(*buffer);
+    *buffer = NULL;
+    return 1;
+  }
+  return 0;
+}
+
 // load a full-res thumbnail:
 int dt_imageio_large_thumbnail(const char *filename, uint8_t **buffer, int32_t *width, int32_t *height,
-                               dt_colorspaces_color_profile_type_t *color_space)
+                               dt_colorspaces_color_profile_type_t *color_space, const int box_width,
+                               const int box_height)
 {
   int res = 1;
 
@@ -127,29 +158,26 @@ int dt_imageio_large_thumbnail(const char *filename, uint8_t **buffer, int32_t *
   char *mime_type = NULL;
   size_t bufsize;
 
-  // get the biggest thumb from exif
+  // fast path: find the jpeg by walking the raw container ourselves, this doesn't need exiv2 and its lock
+  // so the thumbnail jobs of all the worker threads can run concurrently.
+  if(!dt_imageio_preview_read(filename, box_width, box_height, &buf, &bufsize))
+  {
+    res = _decompress_jpeg_thumbnail(buf, bufsize, buffer, width, height, color_space, box_width, box_height);
+    free(buf);
+    buf = NULL;
+    if(!res) return 0;
+    // a stream we found but can't decode, exiv2 may still know of a usable one
+    dt_print(DT_DEBUG_CACHE, "[dt_imageio_large_thumbnail] %s: embedded jpeg can't be decoded, trying exiv2\n",
+             filename);
+  }
+
+  // otherwise get the biggest thumb from exif
   if(dt_exif_get_thumbnail(filename, &buf, &bufsize, &mime_type)) goto error;
 
   if(strcmp(mime_type, "image/jpeg") == 0)
   {
-    // Decompress the JPG into our own memory format
-    dt_imageio_jpeg_t jpg;
-    if(dt_imageio_jpeg_decompress_header(buf, bufsize, &jpg)) goto error;
-    *buffer = (uint8_t *)dt_alloc_align(64, sizeof(uint8_t) * 4 * jpg.width * jpg.height);
-    if(!*buffer) goto error;
-
-    *width = jpg.width;
-    *height = jpg.height;
-    // TODO: check if the embedded thumbs have a color space set! currently we assume that it's always sRGB
-    *color_space = DT_COLORSPACE_SRGB;
-    if(dt_imageio_jpeg_decompress(&jpg, *buffer))
-    {
-      dt_free_align(*buffer);
-      *buffer = NULL;
-      goto error;
-    }
-
-    res = 0;
+    res = _decompress_jpeg_thumbnail(buf, bufsize, buffer, width, height, color_space, box_width, box_height);
+    if(res) goto error;
   }
   else
   {
@@ -275,7 +303,7 @@ gboolean dt_imageio_has_mono_preview(const char *filename)
   int32_t thumb_width = 0, thumb_height = 0;
   gboolean mono = FALSE;
 
-  if(dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height, &color_space))
+  if(dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height, &color_space, 0, 0))
     goto cleanup;
   if((thumb_width < 32) || (thumb_height < 32) || (tmp == NULL))
     goto cleanup;
@@ -688,6 +716,76 @@ void dt_imageio_to_fractional(float in, uint32_t *num, uint32_t *den)
   }
 }
 
+// exports run on their own job thread, from the storage down to the format, so the hold is per thread
+static __thread gboolean _hold_writes = FALSE;
+static __thread dt_imageio_held_write_t *_held_write = NULL;
+
+void dt_imageio_held_write_free(dt_imageio_held_write_t *write)
+{
+  if(!write) return;
+  if(write->free_data) write->free_data(write->data);
+  g_free(write->filename);
+  free(write);
+}
+
+static int _write_file(const char *filename, const void *data, const size_t size)
+{
+  FILE *f = g_fopen(filename, "wb");
+  if(!f) return 1;
+  const int failed = fwrite(data, 1, size, f) != size;
+  return (fclose(f) != 0) || failed;
+}
+
+int dt_imageio_write_buffer(const char *filename, void *data, const size_t size, GDestroyNotify free_data)
+{
+  // a format writing several files would have its previous one overwritten
+  if(_held_write && dt_imageio_write_held()) return 1;
+
+  if(_hold_writes)
+  {
+    dt_imageio_held_write_t *write = (dt_imageio_held_write_t *)malloc(sizeof(dt_imageio_held_write_t));
+    if(write)
+    {
+      write->filename = g_strdup(filename);
+      write->data = data;
+      write->size = size;
+      write->free_data = free_data;
+      _held_write = write;
+      return 0;
+    }
+  }
+
+  const int rc = _write_file(filename, data, size);
+  if(free_data) free_data(data);
+  return rc;
+}
+
+void dt_imageio_hold_writes(const gboolean hold)
+{
+  _hold_writes = hold;
+}
+
+dt_imageio_held_write_t *dt_imageio_take_held_write()
+{
+  dt_imageio_held_write_t *write = _held_write;
+  _held_write = NULL;
+  return write;
+}
+
+int dt_imageio_held_write_save(const dt_imageio_held_write_t *write)
+{
+  return _write_file(write->filename, write->data, write->size);
+}
+
+int dt_imageio_write_held()
+{
+  dt_imageio_held_write_t *write = dt_imageio_take_held_write();
+  if(!write) return 0;
+  const int rc = dt_imageio_held_write_save(write);
+  dt_imageio_held_write_free(write);
+  return rc;
+}
+
 int dt_imageio_export(const int32_t imgid, const char *filename, dt_imageio_module_format_t *format,
                       dt_imageio_module_data_t *format_params, const gboolean high_quality, const gboolean upscale,
                       const gboolean copy_metadata, const gboolean export_masks,
@@ -698,7 +796,7 @@ int dt_imageio_export(const int32_t imgid, const char *filename, dt_imageio_modu
   if(strcmp(format->mime(format_params), "x-copy") == 0)
     /* This is a just a copy, skip process and just export */
     return format->write_image(format_params, filename, NULL, icc_type, icc_filename, NULL, 0, imgid, num, total, NULL,
-                               export_masks);
+                               export_masks, NULL);
   else
   {
     const gboolean is_scaling =
@@ -1080,6 +1178,11 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   format_params->width = processed_width;
   format_params->height = processed_height;
 
+  // formats able to embed the xmp data while encoding get the export metadata, so they write the file only once
+  const int format_flags = format->flags(format_params);
+  const gboolean attach_xmp = copy_metadata && (format_flags & FORMAT_FLAGS_SUPPORT_XMP);
+  const gboolean embed_xmp = attach_xmp && metadata && (format_flags & FORMAT_FLAGS_EMBED_XMP);
+
   if(!ignore_exif)
   {
     int length;
@@ -1093,14 +1196,14 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
     length = dt_exif_read_blob(&exif_profile, pathname, imgid, sRGB, processed_width, processed_height, 0);
 
     res = format->write_image(format_params, filename, outbuf, icc_type, icc_filename, exif_profile, length, imgid,
-                              num, total, &pipe, export_masks);
+                              num, total, &pipe, export_masks, embed_xmp ? metadata : NULL);
 
     free(exif_profile);
   }
   else
   {
     res = format->write_image(format_params, filename, outbuf, icc_type, icc_filename, NULL, 0, imgid, num, total,
-                              &pipe, export_masks);
+                              &pipe, export_masks, embed_xmp ? metadata : NULL);
   }
 
   if(res)
@@ -1111,8 +1214,10 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
 
   /* now write xmp into that container, if possible */
-  if(copy_metadata && (format->flags(format_params) & FORMAT_FLAGS_SUPPORT_XMP))
+  if(attach_xmp && !embed_xmp)
   {
+    // exiv2 works on the file, which must be there
+    if(dt_imageio_write_held()) return 1;
     dt_exif_xmp_attach_export(imgid, filename, metadata);
     // no need to cancel the export if this fail
   }
@@ -1120,12 +1225,22 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
   if(!thumbnail_export && strcmp(format->mime(format_params), "memory")
     && !(format->flags(format_params) & FORMAT_FLAGS_NO_TMPFILE))
   {
+    // the listeners get the name of the exported file, so it must be written if there are any
+    if(dt_control_signal_has_handlers(darktable.signals, DT_SIGNAL_IMAGE_EXPORT_TMPFILE)
+       && dt_imageio_write_held())
+      return 1;
 #ifdef USE_LUA
     //Synchronous calling of lua intermediate-export-image events
     dt_lua_lock();
 
     lua_State *L = darktable.lua_state.state;
 
+    if(dt_lua_event_in_use(L, "intermediate-export-image") && dt_imageio_write_held())
+    {
+      dt_lua_unlock();
+      return 1;
+    }
+
     luaA_push(L, dt_lua_image_t, &imgid);
 
     lua_pushstring(L, filename);
@@ -91,6 +91,30 @@ int dt_imageio_export_with_flags(const int32_t imgid, const char *filename,
                                  dt_imageio_module_storage_t *storage, dt_imageio_module_data_t *storage_params,
                                  int num, int total, dt_export_metadata_t *metadata);
 
+// a complete exported file held in memory, see dt_imageio_hold_writes()
+typedef struct dt_imageio_held_write_t
+{
+  gchar *filename;
+  void *data;
+  size_t size;
+  GDestroyNotify free_data;
+} dt_imageio_held_write_t;
+
+// formats building the whole file in memory write it with this. takes ownership of data, released with
+// free_data. returns 0 on success. while the calling thread holds its writes, the file is kept for
+// dt_imageio_take_held_write() instead of being written.
+int dt_imageio_write_buffer(const char *filename, void *data, const size_t size, GDestroyNotify free_data);
+// make dt_imageio_write_buffer() keep the file in memory, for the calling thread only. lets a storage
+// write the file behind the export job.
+void dt_imageio_hold_writes(const gboolean hold);
+// returns the file kept while holding, NULL if the format wrote it itself. free with dt_imageio_held_write_free()
+dt_imageio_held_write_t *dt_imageio_take_held_write();
+// write a held file to its destination. returns 0 on success
+int dt_imageio_held_write_save(const dt_imageio_held_write_t *write);
+// write the held file now, if any, for when it has to be on disk before the export returns
+int dt_imageio_write_held();
+void dt_imageio_held_write_free(dt_imageio_held_write_t *write);
+
 size_t dt_imageio_write_pos(int i, int j, int wd, int ht, float fwd, float fht,
                             dt_image_orientation_t orientation);
 
@@ -105,9 +129,11 @@ void dt_imageio_flip_buffers_ui8_to_float(float *out, const uint8_t *in, const f
                                           const int fht, const int stride,
                                           const dt_image_orientation_t orientation);
 
-// allocate buffer and return 0 on success along with largest jpg thumbnail from raw.
+// allocate buffer and return 0 on success along with the embedded jpg thumbnail from raw, decoded at the
+// smallest size covering box_width x box_height (0 x 0 for the largest thumbnail at full size).
 int dt_imageio_large_thumbnail(const char *filename, uint8_t **buffer, int32_t *width, int32_t *height,
-                               dt_colorspaces_color_profile_type_t *color_space);
+                               dt_colorspaces_color_profile_type_t *color_space, const int box_width,
+                               const int box_height);
 
 // lookup maker and model, dispatch lookup to rawspeed or libraw
 gboolean dt_imageio_lookup_makermodel(const char *maker, const char *model,
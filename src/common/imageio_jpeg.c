@@ -24,6 +24,7 @@
 #include "common/exif.h"
 #include "common/imageio.h"
 #include "common/imageio_jpeg.h"
+#include "common/imageio_preview.h"
 #include <setjmp.h>
 
 // error functions
@@ -154,11 +155,34 @@ int dt_imageio_jpeg_decompress_header(const void *in, size_t length, dt_imageio_
   return 0;
 }
 
+void dt_imageio_jpeg_decompress_scale(dt_imageio_jpeg_t *jpg, const int box_width, const int box_height)
+{
+  if(box_width <= 0 || box_height <= 0) return;
+
+  // libjpeg can skip the high frequency DCT coefficients and decode at 1/2, 1/4 or 1/8 of the size for a
+  // fraction of the cost. use the largest factor still giving enough pixels for the box.
+  const int width = jpg->dinfo.image_width;
+  const int height = jpg->dinfo.image_height;
+  for(int denom = 8; denom > 1; denom /= 2)
+  {
+    const int wd = (width + denom - 1) / denom;
+    const int ht = (height + denom - 1) / denom;
+    if(!dt_imageio_preview_covers(wd, ht, box_width, box_height)) continue;
+
+    jpg->dinfo.scale_num = 1;
+    jpg->dinfo.scale_denom = denom;
+    jpeg_calc_output_dimensions(&(jpg->dinfo));
+    jpg->width = jpg->dinfo.output_width;
+    jpg->height = jpg->dinfo.output_height;
+    return;
+  }
+}
+
 #ifdef JCS_EXTENSIONS
 static int decompress_jsc(dt_imageio_jpeg_t *jpg, uint8_t *out)
 {
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), &tmp, 1) != 1)
     {
@@ -175,14 +199,14 @@ static int decompress_plain(dt_imageio_jpeg_t *jpg, uint8_t *out)
   JSAMPROW row_pointer[1];
   row_pointer[0] = (uint8_t *)dt_alloc_align(64, (size_t)jpg->dinfo.output_width * jpg->dinfo.num_components);
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), row_pointer, 1) != 1)
     {
       dt_free_align(row_pointer[0]);
       return 1;
     }
-    for(unsigned int i = 0; i < jpg->dinfo.image_width; i++)
+    for(unsigned int i = 0; i < jpg->dinfo.output_width; i++)
     {
       for(int k = 0; k < 3; k++) tmp[4 * i + k] = row_pointer[0][3 * i + k];
     }
@@ -598,7 +622,7 @@ int dt_imageio_jpeg_read_header(const char *filename, dt_imageio_jpeg_t *jpg)
 static int read_jsc(dt_imageio_jpeg_t *jpg, uint8_t *out)
 {
   uint8_t *tmp = out;
-  while(jpg->dinfo.output_scanline < jpg->dinfo.image_height)
+  while(jpg->dinfo.output_scanline < jpg->dinfo.output_height)
   {
     if(jpeg_read_scanlines(&(jpg->dinfo), &tmp, 1) != 1)
     {
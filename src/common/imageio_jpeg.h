@@ -44,6 +44,9 @@ typedef struct dt_imageio_jpeg_t
 
 /** reads the header and fills width/height in jpg struct. */
 int dt_imageio_jpeg_decompress_header(const void *in, size_t length, dt_imageio_jpeg_t *jpg);
+/** after reading the header, sets up a downscaled decoding (in the DCT domain) giving the smallest image
+ * that still covers a box_width x box_height thumbnail. updates width/height in jpg struct. */
+void dt_imageio_jpeg_decompress_scale(dt_imageio_jpeg_t *jpg, const int box_width, const int box_height);
 /** reads the whole image to the out buffer, which has to be large enough. */
 int dt_imageio_jpeg_decompress(dt_imageio_jpeg_t *jpg, uint8_t *out);
 /** compresses in to out buffer with given quality (0..100). out buffer must be large enough. returns actual
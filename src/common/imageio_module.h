@@ -39,7 +39,8 @@ typedef enum dt_imageio_format_flags_t
 {
   FORMAT_FLAGS_SUPPORT_XMP = 1,
   FORMAT_FLAGS_NO_TMPFILE = 2,
-  FORMAT_FLAGS_SUPPORT_LAYERS = 4
+  FORMAT_FLAGS_SUPPORT_LAYERS = 4,
+  FORMAT_FLAGS_EMBED_XMP = 8 // xmp data is written with the image by write_image(), not attached afterwards
 } dt_imageio_format_flags_t;
 
 /**
@@ -0,0 +1,404 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2023 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/imageio_preview.h"
+#include "common/darktable.h"
+
+#include <glib/gstdio.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * Raw files almost always carry a camera-rendered jpeg. Exiv2 can find it, but it parses the whole metadata tree
+ * (makernotes included) and, on builds where it is not thread-safe, does so under a global lock. That makes it
+ * the bottleneck when the thumbnail jobs of a freshly imported film roll run on all worker threads.
+ *
+ * The containers we care about are simple enough to walk by hand: we only read the few hundred bytes of
+ * directory structure needed to locate the jpeg streams, then the SOF marker of each one to get its size.
+ */
+
+#define PREVIEW_MAX_CANDIDATES 16
+#define PREVIEW_MAX_IFDS 32
+#define PREVIEW_MAX_IFD_ENTRIES 1024
+#define PREVIEW_MAX_DEPTH 4
+#define PREVIEW_MAX_JPEG_MARKERS 64
+#define PREVIEW_MAX_BOXES 64
+
+typedef struct _preview_candidate_t
+{
+  uint64_t offset;
+  uint64_t length;
+  uint64_t tables_offset; // JPEGTables of an abbreviated stream, to be put in front of it
+  uint64_t tables_length;
+  int width, height;
+} _preview_candidate_t;
+
+typedef struct _preview_parser_t
+{
+  FILE *f;
+  uint64_t file_size;
+  uint64_t base;    // offsets in tiff directories are relative to the tiff header
+  int big_endian;
+  int num_ifds;     // guard against loops in corrupted files
+  int num_candidates;
+  _preview_candidate_t candidates[PREVIEW_MAX_CANDIDATES];
+} _preview_parser_t;
+
+static int _read_at(_preview_parser_t *p, const uint64_t offset, void *out, const size_t length)
+{
+  if(offset + length > p->file_size) return 1;
+  if(fseek(p->f, (long)offset, SEEK_SET)) return 1;
+  return fread(out, 1, length, p->f) != length;
+}
+
+static inline uint16_t _get16(const _preview_parser_t *p, const uint8_t *b)
+{
+  return p->big_endian ? (uint16_t)((b[0] << 8) | b[1]) : (uint16_t)((b[1] << 8) | b[0]);
+}
+
+static inline uint32_t _get32(const _preview_parser_t *p, const uint8_t *b)
+{
+  return p->big_endian ? ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3]
+                       : ((uint32_t)b[3] << 24) | ((uint32_t)b[2] << 16) | ((uint32_t)b[1] << 8) | b[0];
+}
+
+static inline uint32_t _get32be(const uint8_t *b)
+{
+  return ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+}
+
+// walk the markers of the jpeg stream until the frame header and read its size. only baseline and progressive
+// huffman jpegs are accepted: lossless ones (used for raw data in dng and cr2) can't be decoded by libjpeg.
+static int _jpeg_frame_size(_preview_parser_t *p, const uint64_t offset, const uint64_t length, int *width,
+                            int *height)
+{
+  uint8_t b[10];
+  if(length < 4 || _read_at(p, offset, b, 2) || b[0] != 0xFF || b[1] != 0xD8) return 1;
+
+  uint64_t pos = offset + 2;
+  for(int k = 0; k < PREVIEW_MAX_JPEG_MARKERS && pos + 4 <= offset + length; k++)
+  {
+    if(_read_at(p, pos, b, 4) || b[0] != 0xFF) return 1;
+    const uint8_t marker = b[1];
+
+    if(marker == 0xFF)
+    {
+      // fill byte
+      pos++;
+      continue;
+    }
+    if(marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8))
+    {
+      // standalone marker
+      pos += 2;
+      continue;
+    }
+    if(marker == 0xD9 || marker == 0xDA) return 1; // end of image or start of scan before any frame header
+
+    if(marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+    {
+      if(marker > 0xC2 || _read_at(p, pos + 4, b, 6)) return 1;
+      const int components = b[5];
+      if(components != 1 && components != 3) return 1;
+      *height = (b[1] << 8) | b[2];
+      *width = (b[3] << 8) | b[4];
+      return *width <= 0 || *height <= 0;
+    }
+
+    pos += 2 + ((b[2] << 8) | b[3]);
+  }
+  return 1;
+}
+
+// tables_length is 0 for complete streams
+static void _add_candidate(_preview_parser_t *p, const uint64_t offset, const uint64_t length,
+                           const uint64_t tables_offset, const uint64_t tables_length)
+{
+  if(p->num_candidates >= PREVIEW_MAX_CANDIDATES || length == 0 || offset + length > p->file_size) return;
+  if(tables_length && (tables_length < 4 || tables_offset + tables_length > p->file_size)) return;
+
+  // the same stream is often referenced twice (e.g. strip and jpeg tags of the same directory)
+  for(int k = 0; k < p->num_candidates; k++)
+    if(p->candidates[k].offset == offset)
+    {
+      _preview_candidate_t *c = p->candidates + k;
+      if(!c->tables_length)
+      {
+        c->tables_offset = tables_offset;
+        c->tables_length = tables_length;
+      }
+      return;
+    }
+
+  int width = 0, height = 0;
+  if(_jpeg_frame_size(p, offset, length, &width, &height)) return;
+
+  _preview_candidate_t *c = p->candidates + p->num_candidates++;
+  c->offset = offset;
+  c->length = length;
+  c->tables_offset = tables_offset;
+  c->tables_length = tables_length;
+  c->width = width;
+  c->height = height;
+}
+
+static uint32_t _tiff_walk_ifd(_preview_parser_t *p, const uint32_t ifd_offset, const int depth);
+
+static void _tiff_walk_subifds(_preview_parser_t *p, const uint32_t count, const uint32_t value, const int depth)
+{
+  if(depth >= PREVIEW_MAX_DEPTH) return;
+
+  if(count == 1)
+  {
+    _tiff_walk_ifd(p, value, depth + 1);
+    return;
+  }
+
+  // more than one sub-directory: the value is the offset of an array of directory offsets
+  uint8_t b[4 * 8];
+  const uint32_t n = MIN(count, 8);
+  if(_read_at(p, p->base + value, b, 4 * n)) return;
+  for(uint32_t k = 0; k < n; k++) _tiff_walk_ifd(p, _get32(p, b + 4 * k), depth + 1);
+}
+
+// returns the offset of the next directory in the chain, 0 at the end.
+static uint32_t _tiff_walk_ifd(_preview_parser_t *p, const uint32_t ifd_offset, const int depth)
+{
+  if(ifd_offset == 0 || ++p->num_ifds > PREVIEW_MAX_IFDS) return 0;
+
+  uint8_t b[12];
+  if(_read_at(p, p->base + ifd_offset, b, 2)) return 0;
+  const int entries = _get16(p, b);
+  if(entries == 0 || entries > PREVIEW_MAX_IFD_ENTRIES) return 0;
+
+  uint8_t *dir = g_malloc(12 * (size_t)entries + 4);
+  if(_read_at(p, p->base + ifd_offset + 2, dir, 12 * (size_t)entries + 4))
+  {
+    g_free(dir);
+    return 0;
+  }
+
+  uint32_t jpeg_offset = 0, jpeg_length = 0;
+  uint32_t strip_offset = 0, strip_length = 0;
+  uint32_t tables_offset = 0, tables_length = 0;
+  uint32_t compression = 0;
+  uint32_t subifd_count = 0, subifd_value = 0;
+
+  for(int k = 0; k < entries; k++)
+  {
+    const uint8_t *e = dir + 12 * k;
+    const uint16_t tag = _get16(p, e);
+    const uint16_t type = _get16(p, e + 2);
+    const uint32_t count = _get32(p, e + 4);
+    // single SHORT values are stored left-aligned in the value field
+    const uint32_t value = (type == 3 && count == 1) ? _get16(p, e + 8) : _get32(p, e + 8);
+
+    switch(tag)
+    {
+      case 0x002E: // panasonic JpgFromRaw, stored inline as an UNDEFINED blob
+        if(type == 7 && count > 4) _add_candidate(p, p->base + value, count, 0, 0);
+        break;
+      case 0x0103: // Compression
+        compression = value;
+        break;
+      case 0x0111: // StripOffsets
+        if(count == 1) strip_offset = value;
+        break;
+      case 0x0117: // StripByteCounts
+        if(count == 1) strip_length = value;
+        break;
+      case 0x014A: // SubIFDs
+        subifd_count = count;
+        subifd_value = value;
+        break;
+      case 0x015B: // JPEGTables, an SOI, the tables and an EOI
+        if(count > 4)
+        {
+          tables_offset = value;
+          tables_length = count;
+        }
+        break;
+      case 0x0201: // JPEGInterchangeFormat
+        jpeg_offset = value;
+        break;
+      case 0x0202: // JPEGInterchangeFormatLength
+        jpeg_length = value;
+        break;
+      default:
+        break;
+    }
+  }
+
+  const uint32_t next = _get32(p, dir + 12 * (size_t)entries);
+  g_free(dir);
+
+  if(jpeg_offset && jpeg_length) _add_candidate(p, p->base + jpeg_offset, jpeg_length, 0, 0);
+  // old-style and new-style jpeg compressed single strip (cr2 and nef previews, dng previews). new-style strips
+  // may be abbreviated streams, with their tables shared in the directory.
+  if(compression == 6 && strip_offset && strip_length)
+    _add_candidate(p, p->base + strip_offset, strip_length, 0, 0);
+  else if(compression == 7 && strip_offset && strip_length)
+    _add_candidate(p, p->base + strip_offset, strip_length, tables_length ? p->base + tables_offset : 0,
+                   tables_length);
+  if(subifd_count) _tiff_walk_subifds(p, subifd_count, subifd_value, depth);
+
+  return next;
+}
+
+static int _parse_tiff(_preview_parser_t *p, const uint64_t base)
+{
+  uint8_t b[8];
+  if(_read_at(p, base, b, 8)) return 1;
+
+  if(b[0] == 'I' && b[1] == 'I')
+    p->big_endian = 0;
+  else if(b[0] == 'M' && b[1] == 'M')
+    p->big_endian = 1;
+  else
+    return 1;
+
+  // plain tiff (42), olympus (0x4F52 / 0x5352) and panasonic (0x55)
+  const uint16_t magic = _get16(p, b + 2);
+  if(magic != 42 && magic != 0x4F52 && magic != 0x5352 && magic != 0x55) return 1;
+
+  p->base = base;
+  uint32_t ifd = _get32(p, b + 4);
+  while(ifd) ifd = _tiff_walk_ifd(p, ifd, 0);
+  return 0;
+}
+
+// fuji raf: a fixed header points directly to the jpeg preview
+static int _parse_raf(_preview_parser_t *p)
+{
+  uint8_t b[8];
+  if(_read_at(p, 84, b, 8)) return 1;
+  _add_candidate(p, _get32be(b), _get32be(b + 4), 0, 0);
+  return 0;
+}
+
+// canon cr3 (iso base media file format): the 1620x1080 preview lives in a top-level uuid box, in a PRVW box
+// holding its dimensions and the length of the jpeg stream that follows.
+static int _parse_cr3(_preview_parser_t *p)
+{
+  static const uint8_t prvw_uuid[16] = { 0xea, 0xf4, 0x2b, 0x5e, 0x1c, 0x98, 0x4b, 0x88,
+                                         0xb9, 0xfb, 0xb7, 0xdc, 0x40, 0x6e, 0x4d, 0x16 };
+  uint64_t pos = 0;
+  for(int k = 0; k < PREVIEW_MAX_BOXES && pos + 8 <= p->file_size; k++)
+  {
+    uint8_t b[16];
+    if(_read_at(p, pos, b, 8)) return 1;
+    uint64_t box_size = _get32be(b);
+    uint64_t header = 8;
+    if(box_size == 1)
+    {
+      if(_read_at(p, pos + 8, b + 8, 8)) return 1;
+      box_size = ((uint64_t)_get32be(b + 8) << 32) | _get32be(b + 12);
+      header = 16;
+    }
+    else if(box_size == 0)
+      box_size = p->file_size - pos;
+    if(box_size < header) return 1;
+
+    if(!memcmp(b + 4, "uuid", 4))
+    {
+      uint8_t payload[16 + 64];
+      if(!_read_at(p, pos + header, payload, sizeof(payload)) && !memcmp(payload, prvw_uuid, 16))
+      {
+        // the PRVW box follows a few bytes of unknown data
+        for(size_t i = 16 + 4; i + 4 <= sizeof(payload); i++)
+        {
+          if(memcmp(payload + i, "PRVW", 4)) continue;
+          // box layout: size, fourcc, 6 bytes of flags, u16 width, u16 height, u16 flags, u32 jpeg length
+          const uint64_t box = pos + header + i - 4;
+          uint8_t l[4];
+          if(!_read_at(p, box + 20, l, 4)) _add_candidate(p, box + 24, _get32be(l), 0, 0);
+          break;
+        }
+      }
+    }
+
+    pos += box_size;
+  }
+  return 0;
+}
+
+int dt_imageio_preview_read(const char *filename, const int box_width, const int box_height, uint8_t **buffer,
+                            size_t *size)
+{
+  _preview_parser_t p = { 0 };
+  p.f = g_fopen(filename, "rb");
+  if(!p.f) return 1;
+
+  int res = 1;
+  uint8_t magic[16];
+  fseek(p.f, 0, SEEK_END);
+  p.file_size = ftell(p.f);
+  if(_read_at(&p, 0, magic, sizeof(magic))) goto end;
+
+  if(!memcmp(magic, "FUJIFILMCCD-RAW ", 16))
+    _parse_raf(&p);
+  else if(!memcmp(magic + 4, "ftypcrx ", 8))
+    _parse_cr3(&p);
+  else
+    _parse_tiff(&p, 0);
+
+  if(p.num_candidates == 0) goto end;
+
+  // smallest preview still large enough for the requested thumbnail, so the decoder has the least work to do
+  const _preview_candidate_t *best = NULL;
+  for(int k = 0; k < p.num_candidates; k++)
+  {
+    const _preview_candidate_t *c = p.candidates + k;
+    if(!dt_imageio_preview_covers(c->width, c->height, box_width, box_height)) continue;
+    const gboolean full = box_width <= 0 || box_height <= 0;
+    if(!best || (full ? (uint64_t)c->width * c->height > (uint64_t)best->width * best->height
+                      : (uint64_t)c->width * c->height < (uint64_t)best->width * best->height))
+      best = c;
+  }
+  // nothing large enough here, exiv2 may know of a larger preview (in makernotes for instance)
+  if(!best) goto end;
+
+  // an abbreviated stream gets the tables in front of it: SOI and tables, then the stream after its own SOI
+  const uint64_t tables = best->tables_length ? best->tables_length - 2 : 0;
+  const uint64_t length = best->tables_length ? tables + best->length - 2 : best->length;
+  uint8_t *buf = malloc(length);
+  if(!buf) goto end;
+  if((tables
+      && (_read_at(&p, best->tables_offset, buf, tables + 2) || buf[0] != 0xFF || buf[1] != 0xD8
+          || buf[tables] != 0xFF || buf[tables + 1] != 0xD9))
+     || _read_at(&p, best->offset + (tables ? 2 : 0), buf + tables, length - tables))
+  {
+    free(buf);
+    goto end;
+  }
+  *buffer = buf;
+  *size = length;
+  dt_print(DT_DEBUG_CACHE, "[dt_imageio_preview_read] %s: found %dx%d embedded jpeg\n", filename, best->width,
+           best->height);
+  res = 0;
+
+end:
+  fclose(p.f);
+  return res;
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,47 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2023 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <inttypes.h>
+#include <stddef.h>
+
+/** returns TRUE if an image of width x height is large enough to be downscaled into a box_width x box_height
+ * thumbnail without upscaling, whatever the final orientation. a box of 0 x 0 means "full size" and always fits. */
+static inline gboolean dt_imageio_preview_covers(const int width, const int height, const int box_width,
+                                                 const int box_height)
+{
+  if(box_width <= 0 || box_height <= 0) return TRUE;
+  return (width >= box_width || height >= box_height) && (height >= box_width || width >= box_height);
+}
+
+/** find the embedded jpeg preview of a raw file by walking its container directly (tiff-based raws, raf, cr3)
+ * instead of doing a full exiv2 parse. the smallest preview covering box_width x box_height is selected
+ * (pass 0 x 0 to get the largest one). returns 0 on success, in which case *buffer is a malloc'ed copy of
+ * the jpeg stream the caller has to free, with the JPEGTables of its directory put in front of it if it has
+ * some. returns 1 if the container is not handled or no preview is
+ * large enough, so the caller can fall back to exiv2. */
+int dt_imageio_preview_read(const char *filename, const int box_width, const int box_height, uint8_t **buffer,
+                            size_t *size);
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -1378,320 +1378,224 @@ static int prepare_resampling_plan(const struct dt_interpolation *itor, int in,
   return 0;
 }
 
-static void dt_interpolation_resample_plain(const struct dt_interpolation *itor, float *out,
-                                            const dt_iop_roi_t *const roi_out, const int32_t out_stride,
-                                            const float *const in, const dt_iop_roi_t *const roi_in,
-                                            const int32_t in_stride)
+/* The resampling is separable: each tile of the output is computed by resampling horizontally the input lines
+ * it needs into a scratch buffer, then by combining those lines vertically. This costs hl + vl taps per output
+ * sample instead of hl * vl for a direct 2D kernel, which matters a lot for strong downscaling (about 30 taps
+ * per direction for lanczos3 from 60 to 2 Mpix). Tiles keep the scratch buffer in cache, and the vertical pass
+ * runs along contiguous lines, which vectorizes well.
+ * The sums are done in the same order as with the 2D kernel: first along each input line, then across lines. */
+#define RESAMPLING_TILE_WIDTH 256
+#define RESAMPLING_TILE_HEIGHT 32
+
+typedef struct _resampling_plan_t
 {
-  int *hindex = NULL;
-  int *hlength = NULL;
-  float *hkernel = NULL;
-  int *vindex = NULL;
-  int *vlength = NULL;
-  float *vkernel = NULL;
-  int *vmeta = NULL;
-
-  const int32_t in_stride_floats = in_stride / sizeof(float);
-  const int32_t out_stride_floats = out_stride / sizeof(float);
-  int r;
-
-  debug_info("resampling %p (%dx%d@%dx%d scale %f) -> %p (%dx%d@%dx%d scale %f)\n", in, roi_in->width,
-             roi_in->height, roi_in->x, roi_in->y, roi_in->scale, out, roi_out->width, roi_out->height,
-             roi_out->x, roi_out->y, roi_out->scale);
+  int *length;
+  float *kernel;
+  int *index;
+  int *meta;
+} _resampling_plan_t;
 
-  // Fast code path for 1:1 copy, only cropping area can change
-  if(roi_out->scale == 1.f)
-  {
-    const int x0 = roi_out->x * 4 * sizeof(float);
-#if DEBUG_RESAMPLING_TIMING
-    int64_t ts_resampling = getts();
-#endif
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-    dt_omp_firstprivate(in, in_stride, out_stride, roi_out, x0) \
-    shared(out)
-#endif
-    for(int y = 0; y < roi_out->height; y++)
+typedef struct _resampling_t
+{
+  const float *in;
+  float *out;
+  size_t in_stride;  // in floats
+  size_t out_stride; // in floats
+  int width, height; // of the output
+  _resampling_plan_t h, v;
+  const int *first_line; // first and last input lines needed by each band of tiles
+  const int *last_line;
+} _resampling_t;
+
+static inline void _resample_tile(const _resampling_t *const r, const int tx, const int ty,
+                                  float *const restrict scratch, const int ch)
+{
+  const int ox0 = tx * RESAMPLING_TILE_WIDTH;
+  const int ox1 = MIN(ox0 + RESAMPLING_TILE_WIDTH, r->width);
+  const int oy0 = ty * RESAMPLING_TILE_HEIGHT;
+  const int oy1 = MIN(oy0 + RESAMPLING_TILE_HEIGHT, r->height);
+  const int first_line = r->first_line[ty];
+  const int last_line = r->last_line[ty];
+  const size_t n = (size_t)(ox1 - ox0) * ch;
+
+  // horizontal pass, on all the input lines of the band
+  for(int line = first_line; line <= last_line; line++)
+  {
+    const float *const restrict i = r->in + (size_t)line * r->in_stride;
+    float *const restrict s = scratch + (line - first_line) * n;
+    for(int ox = ox0; ox < ox1; ox++)
     {
-      memcpy((char *)out + (size_t)out_stride * y,
-             (char *)in + (size_t)in_stride * (y + roi_out->y) + x0,
-             out_stride);
+      const int hl = r->h.length[ox];
+      const float *const restrict hkernel = r->h.kernel + r->h.meta[3 * ox + 1];
+      const int *const restrict hindex = r->h.index + r->h.meta[3 * ox + 2];
+      dt_aligned_pixel_t vhs = { 0.0f, 0.0f, 0.0f, 0.0f };
+      for(int ix = 0; ix < hl; ix++)
+      {
+        const float *const restrict pixel = i + (size_t)hindex[ix] * ch;
+        const float htap = hkernel[ix];
+        for(int c = 0; c < ch; c++) vhs[c] += pixel[c] * htap;
+      }
+      for(int c = 0; c < ch; c++) s[(ox - ox0) * ch + c] = vhs[c];
     }
-#if DEBUG_RESAMPLING_TIMING
-    ts_resampling = getts() - ts_resampling;
-    fprintf(stderr, "resampling %p plan:0us resampling:%" PRId64 "us\n", in, ts_resampling);
-#endif
-    // All done, so easy case
-    return;
   }
 
-// Generic non 1:1 case... much more complicated :D
-#if DEBUG_RESAMPLING_TIMING
-  int64_t ts_plan = getts();
-#endif
-
-  // Prepare resampling plans once and for all
-  r = prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
-                              &hlength, &hkernel, &hindex, NULL);
-  if(r)
+  // vertical pass, accumulating whole lines of the tile
+  for(int oy = oy0; oy < oy1; oy++)
   {
-    goto exit;
-  }
+    const int vl = r->v.length[oy];
+    const float *const restrict vkernel = r->v.kernel + r->v.meta[3 * oy + 1];
+    const int *const restrict vindex = r->v.index + r->v.meta[3 * oy + 2];
+    float *const restrict o = r->out + (size_t)oy * r->out_stride + (size_t)ox0 * ch;
 
-  r = prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
-                              &vlength, &vkernel, &vindex, &vmeta);
-  if(r)
-  {
-    goto exit;
+    for(size_t k = 0; k < n; k++) o[k] = 0.0f;
+    for(int iy = 0; iy < vl; iy++)
+    {
+      const float *const restrict s = scratch + (vindex[iy] - first_line) * n;
+      const float vtap = vkernel[iy];
+      for(size_t k = 0; k < n; k++) o[k] += s[k] * vtap;
+    }
+
+    // Clip negative RGB that may be produced by Lanczos undershooting
+    // Negative RGB are invalid values no matter the RGB space (light is positive)
+    // (masks are left alone)
+    if(ch == 4)
+      for(size_t k = 0; k < n; k++) o[k] = o[k] > 0.0f ? o[k] : 0.0f;
   }
+}
 
-#if DEBUG_RESAMPLING_TIMING
-  ts_plan = getts() - ts_plan;
+typedef void(_resample_tile_func)(const _resampling_t *const r, const int tx, const int ty,
+                                  float *const restrict scratch, const int ch);
+
+static void _resample_tile_default(const _resampling_t *const r, const int tx, const int ty,
+                                   float *const restrict scratch, const int ch)
+{
+  if(ch == 4)
+    _resample_tile(r, tx, ty, scratch, 4);
+  else
+    _resample_tile(r, tx, ty, scratch, 1);
+}
+
+#ifdef DT_HAVE_AVX_KERNELS
+__DT_TARGET_AVX2__ __attribute__((flatten))
+static void _resample_tile_avx2(const _resampling_t *const r, const int tx, const int ty,
+                                float *const restrict scratch, const int ch)
+{
+  if(ch == 4)
+    _resample_tile(r, tx, ty, scratch, 4);
+  else
+    _resample_tile(r, tx, ty, scratch, 1);
+}
 #endif
 
+static void _resample_copy(float *out, const dt_iop_roi_t *const roi_out, const int32_t out_stride,
+                           const float *const in, const int32_t in_stride, const int ch)
+{
+  // Fast code path for 1:1 copy, only cropping area can change
+  const int x0 = roi_out->x * ch * sizeof(float);
 #if DEBUG_RESAMPLING_TIMING
   int64_t ts_resampling = getts();
 #endif
-
-// Process each output line
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, in_stride_floats, out_stride_floats, roi_out) \
-  shared(out, hindex, hlength, hkernel, vindex, vlength, vkernel, vmeta)
+  dt_omp_firstprivate(in, in_stride, out_stride, roi_out, x0) \
+  shared(out)
 #endif
-  for(int oy = 0; oy < roi_out->height; oy++)
+  for(int y = 0; y < roi_out->height; y++)
   {
-    // Initialize column resampling indexes
-    int vlidx = vmeta[3 * oy + 0]; // V(ertical) L(ength) I(n)d(e)x
-    int vkidx = vmeta[3 * oy + 1]; // V(ertical) K(ernel) I(n)d(e)x
-    int viidx = vmeta[3 * oy + 2]; // V(ertical) I(ndex) I(n)d(e)x
-
-    // Initialize row resampling indexes
-    int hlidx = 0; // H(orizontal) L(ength) I(n)d(e)x
-    int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
-    int hiidx = 0; // H(orizontal) I(ndex) I(n)d(e)x
-
-    // Number of lines contributing to the output line
-    int vl = vlength[vlidx++]; // V(ertical) L(ength)
-
-    // Process each output column
-    for(int ox = 0; ox < roi_out->width; ox++)
-    {
-      debug_extra("output %p [% 4d % 4d]\n", out, ox, oy);
-
-      // This will hold the resulting pixel
-      dt_aligned_pixel_t vs = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-      // Number of horizontal samples contributing to the output
-      int hl = hlength[hlidx++]; // H(orizontal) L(ength)
-
-      for(int iy = 0; iy < vl; iy++)
-      {
-        // This is our input line
-        size_t baseidx_vindex = (size_t)vindex[viidx++] * in_stride_floats;
-
-        dt_aligned_pixel_t vhs = { 0.0f, 0.0f, 0.0f, 0.0f };
-
-        for(int ix = 0; ix < hl; ix++)
-        {
-          // Apply the precomputed filter kernel
-          const size_t baseidx = baseidx_vindex + (size_t)hindex[hiidx++] * 4;
-          const float htap = hkernel[hkidx++];
-          // Convince gcc 10 to vectorize
-          dt_aligned_pixel_t tmp = { in[baseidx], in[baseidx+1], in[baseidx+2], in[baseidx+3] };
-          for_each_channel(c, aligned(tmp,vhs:16)) vhs[c] += tmp[c] * htap;
-        }
-
-        // Accumulate contribution from this line
-        const float vtap = vkernel[vkidx++];
-        for_each_channel(c, aligned(vhs,vs:16)) vs[c] += vhs[c] * vtap;
-
-        // Reset horizontal resampling context
-        hkidx -= hl;
-        hiidx -= hl;
-      }
-
-      // Output pixel is ready
-      const size_t baseidx = (size_t)oy * out_stride_floats + (size_t)ox * 4;
-
-      // Clip negative RGB that may be produced by Lanczos undershooting
-      // Negative RGB are invalid values no matter the RGB space (light is positive)
-      for_each_channel(c, aligned(vs:16)) out[baseidx + c] = fmaxf(vs[c], 0.f);
-
-      // Reset vertical resampling context
-      viidx -= vl;
-      vkidx -= vl;
-
-      // Progress in horizontal context
-      hiidx += hl;
-      hkidx += hl;
-    }
+    memcpy((char *)out + (size_t)out_stride * y,
+           (char *)in + (size_t)in_stride * (y + roi_out->y) + x0,
+           out_stride);
   }
-
 #if DEBUG_RESAMPLING_TIMING
   ts_resampling = getts() - ts_resampling;
-  fprintf(stderr, "resampling %p plan:%" PRId64 "us resampling:%" PRId64 "us\n", in, ts_plan, ts_resampling);
+  fprintf(stderr, "resampling %p plan:0us resampling:%" PRId64 "us\n", in, ts_resampling);
 #endif
-
-exit:
-  /* Free the resampling plans. It's nasty to optimize allocs like that, but
-   * it simplifies the code :-D. The length array is in fact the only memory
-   * allocated. */
-  dt_free_align(hlength);
-  dt_free_align(vlength);
 }
 
-#if defined(__SSE2__)
-static void dt_interpolation_resample_sse(const struct dt_interpolation *itor, float *out,
-                                          const dt_iop_roi_t *const roi_out, const int32_t out_stride,
-                                          const float *const in, const dt_iop_roi_t *const roi_in,
-                                          const int32_t in_stride)
+static void _resample(const struct dt_interpolation *itor, float *out, const dt_iop_roi_t *const roi_out,
+                      const int32_t out_stride, const float *const in, const dt_iop_roi_t *const roi_in,
+                      const int32_t in_stride, const int ch)
 {
-  int *hindex = NULL;
-  int *hlength = NULL;
-  float *hkernel = NULL;
-  int *vindex = NULL;
-  int *vlength = NULL;
-  float *vkernel = NULL;
-  int *vmeta = NULL;
-
-  int r;
-
   debug_info("resampling %p (%dx%d@%dx%d scale %f) -> %p (%dx%d@%dx%d scale %f)\n", in, roi_in->width,
              roi_in->height, roi_in->x, roi_in->y, roi_in->scale, out, roi_out->width, roi_out->height,
              roi_out->x, roi_out->y, roi_out->scale);
 
-  // Fast code path for 1:1 copy, only cropping area can change
   if(roi_out->scale == 1.f)
   {
-    const int x0 = roi_out->x * 4 * sizeof(float);
-#if DEBUG_RESAMPLING_TIMING
-    int64_t ts_resampling = getts();
-#endif
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-    dt_omp_firstprivate(in, in_stride, out_stride, roi_out, x0) \
-    shared(out)
-#endif
-    for(int y = 0; y < roi_out->height; y++)
-    {
-      float *i = (float *)((char *)in + (size_t)in_stride * (y + roi_out->y) + x0);
-      float *o = (float *)((char *)out + (size_t)out_stride * y);
-      memcpy(o, i, out_stride);
-    }
-#if DEBUG_RESAMPLING_TIMING
-    ts_resampling = getts() - ts_resampling;
-    fprintf(stderr, "resampling %p plan:0us resampling:%" PRId64 "us\n", in, ts_resampling);
-#endif
-    // All done, so easy case
+    _resample_copy(out, roi_out, out_stride, in, in_stride, ch);
     return;
   }
 
-// Generic non 1:1 case... much more complicated :D
 #if DEBUG_RESAMPLING_TIMING
   int64_t ts_plan = getts();
 #endif
 
+  _resampling_t r = { .in = in,
+                      .out = out,
+                      .in_stride = in_stride / sizeof(float),
+                      .out_stride = out_stride / sizeof(float),
+                      .width = roi_out->width,
+                      .height = roi_out->height };
+  int *lines = NULL;
+  float *scratch = NULL;
+
   // Prepare resampling plans once and for all
-  r = prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
-                              &hlength, &hkernel, &hindex, NULL);
-  if(r)
-  {
+  if(prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
+                             &r.h.length, &r.h.kernel, &r.h.index, &r.h.meta)
+     || prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
+                                &r.v.length, &r.v.kernel, &r.v.index, &r.v.meta))
     goto exit;
-  }
 
-  r = prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
-                              &vlength, &vkernel, &vindex, &vmeta);
-  if(r)
-  {
-    goto exit;
-  }
+  const int tiles_x = (roi_out->width + RESAMPLING_TILE_WIDTH - 1) / RESAMPLING_TILE_WIDTH;
+  const int tiles_y = (roi_out->height + RESAMPLING_TILE_HEIGHT - 1) / RESAMPLING_TILE_HEIGHT;
 
-#if DEBUG_RESAMPLING_TIMING
-  ts_plan = getts() - ts_plan;
+  // the input lines needed by each band of tiles, and the largest scratch buffer this takes
+  lines = malloc(sizeof(int) * 2 * tiles_y);
+  if(!lines) goto exit;
+  int max_lines = 0;
+  for(int ty = 0; ty < tiles_y; ty++)
+  {
+    int first = G_MAXINT, last = -1;
+    for(int oy = ty * RESAMPLING_TILE_HEIGHT; oy < MIN((ty + 1) * RESAMPLING_TILE_HEIGHT, roi_out->height); oy++)
+    {
+      const int *const vindex = r.v.index + r.v.meta[3 * oy + 2];
+      for(int iy = 0; iy < r.v.length[oy]; iy++)
+      {
+        first = MIN(first, vindex[iy]);
+        last = MAX(last, vindex[iy]);
+      }
+    }
+    lines[ty] = first;
+    lines[tiles_y + ty] = last;
+    max_lines = MAX(max_lines, last - first + 1);
+  }
+  r.first_line = lines;
+  r.last_line = lines + tiles_y;
+
+  size_t padded_size;
+  scratch = dt_alloc_perthread_float((size_t)max_lines * MIN(RESAMPLING_TILE_WIDTH, roi_out->width) * ch,
+                                     &padded_size);
+  if(!scratch) goto exit;
+
+  _resample_tile_func *tile = _resample_tile_default;
+#ifdef DT_HAVE_AVX_KERNELS
+  // the wider avx-512 loads don't pay off on these short rows, avx2 is used there too
+  if(darktable.codepath.AVX2 || darktable.codepath.AVX512) tile = _resample_tile_avx2;
 #endif
 
 #if DEBUG_RESAMPLING_TIMING
+  ts_plan = getts() - ts_plan;
   int64_t ts_resampling = getts();
 #endif
 
-// Process each output line
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, in_stride, out_stride, roi_out) \
-  shared(out, hindex, hlength, hkernel, vindex, vlength, vkernel, vmeta)
+  dt_omp_firstprivate(tiles_x, tiles_y, ch, padded_size, tile) \
+  shared(r, scratch) \
+  schedule(static)
 #endif
-  for(int oy = 0; oy < roi_out->height; oy++)
-  {
-    // Initialize column resampling indexes
-    int vlidx = vmeta[3 * oy + 0]; // V(ertical) L(ength) I(n)d(e)x
-    int vkidx = vmeta[3 * oy + 1]; // V(ertical) K(ernel) I(n)d(e)x
-    int viidx = vmeta[3 * oy + 2]; // V(ertical) I(ndex) I(n)d(e)x
-
-    // Initialize row resampling indexes
-    int hlidx = 0; // H(orizontal) L(ength) I(n)d(e)x
-    int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
-    int hiidx = 0; // H(orizontal) I(ndex) I(n)d(e)x
-
-    // Number of lines contributing to the output line
-    int vl = vlength[vlidx++]; // V(ertical) L(ength)
-
-    // Process each output column
-    for(int ox = 0; ox < roi_out->width; ox++)
-    {
-      debug_extra("output %p [% 4d % 4d]\n", out, ox, oy);
-
-      // This will hold the resulting pixel
-      __m128 vs = _mm_setzero_ps();
-
-      // Number of horizontal samples contributing to the output
-      const int hl = hlength[hlidx++]; // H(orizontal) L(ength)
-
-      for(int iy = 0; iy < vl; iy++)
-      {
-        // This is our input line
-        const float *i = (float *)((char *)in + (size_t)in_stride * vindex[viidx++]);
-
-        __m128 vhs = _mm_setzero_ps();
-
-        for(int ix = 0; ix < hl; ix++)
-        {
-          // Apply the precomputed filter kernel
-          const size_t baseidx = (size_t)hindex[hiidx++] * 4;
-          const float htap = hkernel[hkidx++];
-          const __m128 vhtap = _mm_set_ps1(htap);
-          vhs = _mm_add_ps(vhs, _mm_mul_ps(*(__m128 *)&i[baseidx], vhtap));
-        }
-
-        // Accumulate contribution from this line
-        const float vtap = vkernel[vkidx++];
-        const __m128 vvtap = _mm_set_ps1(vtap);
-        vs = _mm_add_ps(vs, _mm_mul_ps(vhs, vvtap));
-
-        // Reset horizontal resampling context
-        hkidx -= hl;
-        hiidx -= hl;
-      }
-
-      // Output pixel is ready
-      float *o = (float *)((char *)out + (size_t)oy * out_stride + (size_t)ox * 4 * sizeof(float));
-
-      // Clip negative RGB that may be produced by Lanczos undershooting
-      // Negative RGB are invalid values no matter the RGB space (light is positive)
-      vs = _mm_max_ps(vs, _mm_setzero_ps());
-      _mm_stream_ps(o, vs);
-
-      // Reset vertical resampling context
-      viidx -= vl;
-      vkidx -= vl;
-
-      // Progress in horizontal context
-      hiidx += hl;
-      hkidx += hl;
-    }
-  }
-
-  _mm_sfence();
+  for(int t = 0; t < tiles_x * tiles_y; t++)
+    tile(&r, t % tiles_x, t / tiles_x, dt_get_perthread(scratch, padded_size), ch);
 
 #if DEBUG_RESAMPLING_TIMING
   ts_resampling = getts() - ts_resampling;
@@ -1702,10 +1606,11 @@ exit:
   /* Free the resampling plans. It's nasty to optimize allocs like that, but
    * it simplifies the code :-D. The length array is in fact the only memory
    * allocated. */
-  dt_free_align(hlength);
-  dt_free_align(vlength);
+  dt_free_align(r.h.length);
+  dt_free_align(r.v.length);
+  dt_free_align(scratch);
+  free(lines);
 }
-#endif
 
 /** Applies resampling (re-scaling) on *full* input and output buffers.
  *  roi_in and roi_out define the part of the buffers that is affected.
@@ -1721,14 +1626,7 @@ void dt_interpolation_resample(const struct dt_interpolation *itor, float *out,
     return;
   }
 
-  if(darktable.codepath.OPENMP_SIMD)
-    return dt_interpolation_resample_plain(itor, out, roi_out, out_stride, in, roi_in, in_stride);
-#if defined(__SSE2__)
-  else if(darktable.codepath.SSE2)
-    return dt_interpolation_resample_sse(itor, out, roi_out, out_stride, in, roi_in, in_stride);
-#endif
-  else
-    dt_unreachable_codepath();
+  _resample(itor, out, roi_out, out_stride, in, roi_in, in_stride, 4);
 }
 
 /** Applies resampling (re-scaling) on a specific region-of-interest of an image. The input
@@ -2002,162 +1900,6 @@ int dt_interpolation_resample_roi_cl(const struct dt_interpolation *itor, int de
 }
 #endif
 
-static void dt_interpolation_resample_1c_plain(const struct dt_interpolation *itor, float *out,
-                                               const dt_iop_roi_t *const roi_out, const int32_t out_stride,
-                                               const float *const in, const dt_iop_roi_t *const roi_in,
-                                               const int32_t in_stride)
-{
-  int *hindex = NULL;
-  int *hlength = NULL;
-  float *hkernel = NULL;
-  int *vindex = NULL;
-  int *vlength = NULL;
-  float *vkernel = NULL;
-  int *vmeta = NULL;
-
-  int r;
-
-  debug_info("resampling %p (%dx%d@%dx%d scale %f) -> %p (%dx%d@%dx%d scale %f)\n", in, roi_in->width,
-             roi_in->height, roi_in->x, roi_in->y, roi_in->scale, out, roi_out->width, roi_out->height,
-             roi_out->x, roi_out->y, roi_out->scale);
-
-  // Fast code path for 1:1 copy, only cropping area can change
-  if(roi_out->scale == 1.f)
-  {
-    const int x0 = roi_out->x * sizeof(float);
-#if DEBUG_RESAMPLING_TIMING
-    int64_t ts_resampling = getts();
-#endif
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-    dt_omp_firstprivate(in, in_stride, out_stride, roi_out, x0) \
-    shared(out)
-#endif
-    for(int y = 0; y < roi_out->height; y++)
-    {
-      float *i = (float *)((char *)in + (size_t)in_stride * (y + roi_out->y) + x0);
-      float *o = (float *)((char *)out + (size_t)out_stride * y);
-      memcpy(o, i, out_stride);
-    }
-#if DEBUG_RESAMPLING_TIMING
-    ts_resampling = getts() - ts_resampling;
-    fprintf(stderr, "resampling %p plan:0us resampling:%" PRId64 "us\n", in, ts_resampling);
-#endif
-    // All done, so easy case
-    return;
-  }
-
-  // Generic non 1:1 case... much more complicated :D
-#if DEBUG_RESAMPLING_TIMING
-  int64_t ts_plan = getts();
-#endif
-
-  // Prepare resampling plans once and for all
-  r = prepare_resampling_plan(itor, roi_in->width, roi_in->x, roi_out->width, roi_out->x, roi_out->scale,
-                              &hlength, &hkernel, &hindex, NULL);
-  if(r)
-  {
-    goto exit;
-  }
-
-  r = prepare_resampling_plan(itor, roi_in->height, roi_in->y, roi_out->height, roi_out->y, roi_out->scale,
-                              &vlength, &vkernel, &vindex, &vmeta);
-  if(r)
-  {
-    goto exit;
-  }
-
-#if DEBUG_RESAMPLING_TIMING
-  ts_plan = getts() - ts_plan;
-#endif
-
-#if DEBUG_RESAMPLING_TIMING
-  int64_t ts_resampling = getts();
-#endif
-
-  // Process each output line
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(in, in_stride, out_stride, roi_out) \
-  shared(out, hindex, hlength, hkernel, vindex, vlength, vkernel, vmeta)
-#endif
-  for(int oy = 0; oy < roi_out->height; oy++)
-  {
-    // Initialize column resampling indexes
-    int vlidx = vmeta[3 * oy + 0]; // V(ertical) L(ength) I(n)d(e)x
-    int vkidx = vmeta[3 * oy + 1]; // V(ertical) K(ernel) I(n)d(e)x
-    int viidx = vmeta[3 * oy + 2]; // V(ertical) I(ndex) I(n)d(e)x
-
-    // Initialize row resampling indexes
-    int hlidx = 0; // H(orizontal) L(ength) I(n)d(e)x
-    int hkidx = 0; // H(orizontal) K(ernel) I(n)d(e)x
-    int hiidx = 0; // H(orizontal) I(ndex) I(n)d(e)x
-
-    // Number of lines contributing to the output line
-    int vl = vlength[vlidx++]; // V(ertical) L(ength)
-
-    // Process each output column
-    for(int ox = 0; ox < roi_out->width; ox++)
-    {
-      debug_extra("output %p [% 4d % 4d]\n", out, ox, oy);
-
-      // This will hold the resulting pixel
-      float vs = 0.0f;
-
-      // Number of horizontal samples contributing to the output
-      const int hl = hlength[hlidx++]; // H(orizontal) L(ength)
-
-      for(int iy = 0; iy < vl; iy++)
-      {
-        // This is our input line
-        const float *i = (float *)((char *)in + (size_t)in_stride * vindex[viidx++]);
-
-        float vhs = 0.0f;
-
-        for(int ix = 0; ix < hl; ix++)
-        {
-          // Apply the precomputed filter kernel
-          const size_t baseidx = (size_t)hindex[hiidx++];
-          const float htap = hkernel[hkidx++];
-          vhs += i[baseidx] * htap;
-        }
-
-        // Accumulate contribution from this line
-        const float vtap = vkernel[vkidx++];
-        vs += vhs * vtap;
-
-        // Reset horizontal resampling context
-        hkidx -= hl;
-        hiidx -= hl;
-      }
-
-      // Output pixel is ready
-      float *o = (float *)((char *)out + (size_t)oy * out_stride + (size_t)ox * sizeof(float));
-      *o = vs;
-
-      // Reset vertical resampling context
-      viidx -= vl;
-      vkidx -= vl;
-
-      // Progress in horizontal context
-      hiidx += hl;
-      hkidx += hl;
-    }
-  }
-
-#if DEBUG_RESAMPLING_TIMING
-  ts_resampling = getts() - ts_resampling;
-  fprintf(stderr, "resampling %p plan:%" PRId64 "us resampling:%" PRId64 "us\n", in, ts_plan, ts_resampling);
-#endif
-
-  exit:
-  /* Free the resampling plans. It's nasty to optimize allocs like that, but
-   * it simplifies the code :-D. The length array is in fact the only memory
-   * allocated. */
-  dt_free_align(hlength);
-  dt_free_align(vlength);
-}
-
 /** Applies resampling (re-scaling) on *full* input and output buffers.
  *  roi_in and roi_out define the part of the buffers that is affected.
  */
@@ -2166,7 +1908,7 @@ void dt_interpolation_resample_1c(const struct dt_interpolation *itor, float *ou
                                   const float *const in, const dt_iop_roi_t *const roi_in,
                                   const int32_t in_stride)
 {
-  return dt_interpolation_resample_1c_plain(itor, out, roi_out, out_stride, in, roi_in, in_stride);
+  _resample(itor, out, roi_out, out_stride, in, roi_in, in_stride, 1);
 }
 
 /** Applies resampling (re-scaling) on a specific region-of-interest of an image. The input
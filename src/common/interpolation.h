@@ -191,7 +191,7 @@ int dt_interpolation_resample_roi_cl(const struct dt_interpolation *itor, int de
                                      const dt_iop_roi_t *const roi_in);
 #endif
 
-// same as above for single channel images (i.e., masks). no SSE or CPU code paths for now
+// same as above for single channel images (i.e., masks)
 void dt_interpolation_resample_1c(const struct dt_interpolation *itor, float *out,
                                   const dt_iop_roi_t *const roi_out, const int32_t out_stride,
                                   const float *const in, const dt_iop_roi_t *const roi_in,
@@ -25,9 +25,6 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <stdio.h>
-#if defined(__SSE2__)
-#include <xmmintrin.h>
-#endif
 
 // the maximum number of levels for the gaussian pyramid
 #define max_levels 30
@@ -60,213 +57,227 @@ static void dump_PFM(const char *filename, const float* out, const uint32_t w, c
 #define debug_dump_PFM(f,b,w,h)
 #endif
 
-// needs a boundary of 1 or 2px around i,j or else it will crash.
-// (translates to a 1px boundary around the corresponding pixel in the coarse buffer)
-// more precisely, 1<=i<wd-1 for even wd and
-//                 1<=i<wd-2 for odd wd (j likewise with ht)
-static inline float ll_expand_gaussian(
-    const float *const coarse,
-    const int i,
-    const int j,
-    const int wd,
-    const int ht)
+
+// the pyramids are only kept for the whole image from this level on, the finer levels of the remapped
+// pyramids are computed on the fly for overlapping tiles, which bounds their memory by the size of a tile.
+#define max_tiled_levels 3
+// size of a tile on the finest level
+#define tile_size 256
+
+// a rectangle of a pyramid level, in coordinates of that level
+typedef struct ll_window_t
 {
-  assert(i > 0);
-  assert(i < wd-1);
-  assert(j > 0);
-  assert(j < ht-1);
-  assert(j/2 + 1 < (ht-1)/2+1);
-  assert(i/2 + 1 < (wd-1)/2+1);
-  const int cw = (wd-1)/2+1;
-  const int ind = (j/2)*cw+i/2;
-  // case 0:     case 1:     case 2:     case 3:
-  //  x . x . x   x . x . x   x . x . x   x . x . x
-  //  . . . . .   . . . . .   . .[.]. .   .[.]. . .
-  //  x .[x]. x   x[.]x . x   x . x . x   x . x . x
-  //  . . . . .   . . . . .   . . . . .   . . . . .
-  //  x . x . x   x . x . x   x . x . x   x . x . x
-  switch((i&1) + 2*(j&1))
-  {
-    case 0: // both are even, 3x3 stencil
-      return 4./256. * (
-          6.0f*(coarse[ind-cw] + coarse[ind-1] + 6.0f*coarse[ind] + coarse[ind+1] + coarse[ind+cw])
-          + coarse[ind-cw-1] + coarse[ind-cw+1] + coarse[ind+cw-1] + coarse[ind+cw+1]);
-    case 1: // i is odd, 2x3 stencil
-      return 4./256. * (
-          24.0*(coarse[ind] + coarse[ind+1]) +
-          4.0*(coarse[ind-cw] + coarse[ind-cw+1] + coarse[ind+cw] + coarse[ind+cw+1]));
-    case 2: // j is odd, 3x2 stencil
-      return 4./256. * (
-          24.0*(coarse[ind] + coarse[ind+cw]) +
-          4.0*(coarse[ind-1] + coarse[ind+1] + coarse[ind+cw-1] + coarse[ind+cw+1]));
-    default: // case 3: // both are odd, 2x2 stencil
-      return .25f * (coarse[ind] + coarse[ind+1] + coarse[ind+cw] + coarse[ind+cw+1]);
-  }
+  float *p;   // first pixel of the rectangle
+  int x, y;   // position on the level
+  int wd, ht; // size
+  int stride; // distance between two rows, in floats
+} ll_window_t;
+
+static inline ll_window_t ll_level(float *const buf, const int wd, const int ht)
+{
+  return (ll_window_t){ buf, 0, 0, wd, ht, wd };
 }
 
-// helper to fill in one pixel boundary by copying it
-static inline void ll_fill_boundary1(
-    float *const input,
-    const int wd,
-    const int ht)
+// row j of the window, indexed by the column on the level
+static inline float *ll_row(const ll_window_t *const win, const int j)
 {
-  for(int j=1;j<ht-1;j++) input[j*wd] = input[j*wd+1];
-  for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2];
-  memcpy(input,    input+wd, sizeof(float)*wd);
-  memcpy(input+wd*(ht-1), input+wd*(ht-2), sizeof(float)*wd);
+  return win->p + (size_t)(j - win->y) * win->stride - win->x;
 }
 
-// helper to fill in two pixels boundary by copying it
-static inline void ll_fill_boundary2(
-    float *const input,
-    const int wd,
-    const int ht)
+// fine range [*fa, *fb) read to reduce the range [a, b) of a coarse level with cw pixels.
+// the boundary pixels of a reduced level repeat their inner neighbours.
+static inline void ll_reduce_range(const int a, const int b, const int cw, int *fa, int *fb)
 {
-  for(int j=1;j<ht-1;j++) input[j*wd] = input[j*wd+1];
-  if(wd & 1) for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2];
-  else       for(int j=1;j<ht-1;j++) input[j*wd+wd-1] = input[j*wd+wd-2] = input[j*wd+wd-3];
-  memcpy(input, input+wd, sizeof(float)*wd);
-  if(!(ht & 1)) memcpy(input+wd*(ht-2), input+wd*(ht-3), sizeof(float)*wd);
-  memcpy(input+wd*(ht-1), input+wd*(ht-2), sizeof(float)*wd);
+  *fa = 2 * CLAMPS(a, 1, cw - 2) - 2;
+  *fb = 2 * CLAMPS(b - 1, 1, cw - 2) + 3;
 }
 
-static void pad_by_replication(
-    float *buf,			// the buffer to be padded
-    const uint32_t w,		// width of a line
-    const uint32_t h,		// total height, including top and bottom padding
-    const uint32_t padding)	// number of lines of padding on each side
+// coarse range [*ca, *cb) read to expand the range [a, b) of a fine level with wd pixels.
+// the last one or two pixels on each side of an expanded level repeat the last ones with a full stencil.
+static inline void ll_expand_range(const int a, const int b, const int wd, int *ca, int *cb)
 {
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(buf, padding, h, w) \
-  schedule(static)
-#endif
-  for(int j=0;j<padding;j++)
-  {
-    memcpy(buf + w*j, buf+padding*w, sizeof(float)*w);
-    memcpy(buf + w*(h-padding+j), buf+w*(h-padding-1), sizeof(float)*w);
-  }
+  const int emax = ((wd - 1) & ~1) - 1;
+  *ca = MAX(CLAMPS(a, 1, emax) / 2 - 1, 0);
+  *cb = CLAMPS(b - 1, 1, emax) / 2 + 2;
 }
 
-static inline void gauss_expand(
-    const float *const input, // coarse input
-    float *const fine,        // upsampled, blurry output
-    const int wd,             // fine res
-    const int ht)
+static inline float ll_reduce_h(const float *const t)
 {
-#ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(fine, input, wd, ht) \
-  schedule(static) \
-  collapse(2)
-#endif
-  for(int j=1;j<((ht-1)&~1);j++)  // even ht: two px boundary. odd ht: one px.
-    for(int i=1;i<((wd-1)&~1);i++)
-      fine[j*wd+i] = ll_expand_gaussian(input, i, j, wd, ht);
-  ll_fill_boundary2(fine, wd, ht);
+  return (t[0] + t[4] + 4.0f * (t[1] + t[3]) + 6.0f * t[2]) * (1.0f / 256.0f);
 }
 
-#if defined(__SSE2__)
-static inline __m128 convolve14641_vert(const float *in, const int wd)
+// blur with the 1 4 6 4 1 binomial kernel and subsample row j of the coarse window from the fine one, which
+// has to hold all pixels the stencils read. the coarse level is cw x ch, tmp holds the vertical pass.
+static inline void ll_reduce_row(
+    const ll_window_t *const fine,
+    const ll_window_t *const coarse,
+    const int cw,
+    const int ch,
+    const int j,
+    float *const restrict tmp)
 {
-  const dt_aligned_pixel_t four = { 4.f, 4.f, 4.f, 4.f };
-  __m128 r0 = _mm_loadu_ps(in);
-  __m128 r1 = _mm_loadu_ps(in + wd);
-  __m128 r2 = _mm_loadu_ps(in + 2*wd);
-  __m128 r3 = _mm_loadu_ps(in + 3*wd);
-  __m128 r4 = _mm_loadu_ps(in + 4*wd);
-  _mm_prefetch(in+4,_MM_HINT_NTA);		// prefetch next column, which won't be used again afterwards
-  r0 = _mm_add_ps(r0, r4);                      // r0 = r0+r4
-  _mm_prefetch(in+4+wd,_MM_HINT_NTA);		// prefetch next column, which won't be used again afterwards
-  r1 = _mm_add_ps(_mm_add_ps(r1,r3), r2);       // r1 = r1+r2+r3
-  _mm_prefetch(in+4+2*wd,_MM_HINT_T0);
-  r0 = _mm_add_ps(r0, _mm_add_ps(r2, r2));     // r0 = r0+2*r2+r4
-  _mm_prefetch(in+4+3*wd, _MM_HINT_T0);
-  __m128 t = _mm_mul_ps(r1, _mm_load_ps(four)); // t= 4*r1+4*r2+4*r3
-  _mm_prefetch(in+4+4*wd, _MM_HINT_T0);
-  return _mm_add_ps(r0, t);                   // r0+4*r1+6*r2+4*r3+r4
+  const int a = coarse->x, b = coarse->x + coarse->wd;
+  int fa, fb;
+  ll_reduce_range(a, b, cw, &fa, &fb);
+  const int jc = CLAMPS(j, 1, ch - 2);
+  const float *const restrict r0 = ll_row(fine, 2*jc - 2) + fa;
+  const float *const restrict r1 = ll_row(fine, 2*jc - 1) + fa;
+  const float *const restrict r2 = ll_row(fine, 2*jc    ) + fa;
+  const float *const restrict r3 = ll_row(fine, 2*jc + 1) + fa;
+  const float *const restrict r4 = ll_row(fine, 2*jc + 2) + fa;
+  for(int i = 0; i < fb - fa; i++)
+    tmp[i] = r0[i] + r4[i] + 4.0f * (r1[i] + r3[i]) + 6.0f * r2[i];
+
+  float *const restrict out = ll_row(coarse, j);
+  const float *const t = tmp - fa;
+  for(int i = MAX(a, 1); i < MIN(b, cw - 1); i++)
+    out[i] = ll_reduce_h(t + 2*i - 2);
+  if(a == 0)  out[0] = ll_reduce_h(t);
+  if(b == cw) out[cw-1] = ll_reduce_h(t + 2*(cw-2) - 2);
 }
-#endif
 
-#if defined(__SSE2__)
-static inline void gauss_reduce_sse2(
-    const float *const input, // fine input buffer
-    float *const coarse,      // coarse scale, blurred input buf
-    const int wd,             // fine res
-    const int ht)
+// upsample row j of a level of size wd x ht from the coarse window, columns [i0, i1), into out.
+// this is the 3x3 stencil of the 1 4 6 4 1 kernel on the even and odd pixels, done separably.
+// tmp holds the vertical pass.
+static inline void ll_expand_row(
+    const ll_window_t *const coarse,
+    const int wd,
+    const int ht,
+    const int j,
+    const int i0,
+    const int i1,
+    float *const restrict tmp,
+    float *const restrict out)
 {
-  // blur, store only coarse res
-  const int cw = (wd-1)/2+1, ch = (ht-1)/2+1;
+  int ca, cb;
+  ll_expand_range(i0, i1, wd, &ca, &cb);
+  const int jc = CLAMPS(j, 1, ((ht-1)&~1)-1);
+  const float *const restrict r1 = ll_row(coarse, jc/2) + ca;
+  const float *const restrict r2 = ll_row(coarse, jc/2 + 1) + ca;
+  if(jc & 1)
+  {
+    for(int i = 0; i < cb - ca; i++) tmp[i] = 0.5f * (r1[i] + r2[i]);
+  }
+  else
+  {
+    const float *const restrict r0 = ll_row(coarse, jc/2 - 1) + ca;
+    for(int i = 0; i < cb - ca; i++) tmp[i] = 0.125f * (r0[i] + 6.0f * r1[i] + r2[i]);
+  }
 
-#ifdef _OPENMP
-  // DON'T parallelize the very smallest levels of the pyramid, as the threading overhead
-  // is greater than the time needed to do it sequentially
-#pragma omp parallel for default(none) if (ch*cw>1000)  \
-      dt_omp_firstprivate(cw, ch, input, wd, coarse) \
-      schedule(static)
-#endif
-  for(int j=1;j<ch-1;j++)
+  const float *const t = tmp - ca;
+  const int emax = ((wd-1)&~1)-1; // always odd
+  const int lo = MAX(i0, 1), hi = MIN(i1, emax + 1);
+  float *const o = out - i0;
+  int i = lo;
+  if((i & 1) && i < hi)
   {
-    const float *base = input + 2*(j-1)*wd;
-    float *const out = coarse + j*cw + 1;
-    // prime the vertical axis
-    const __m128 kernel = _mm_setr_ps(1.f, 4.f, 6.f, 4.f);
-    __m128 left = convolve14641_vert(base,wd);
-    for(int col=0; col<cw-3; col+=2)
-    {
-      // convolve the next four pixel wide vertical slice
-      base += 4;
-      __m128 right = convolve14641_vert(base,wd);
-      // horizontal pass, generate two output values from convolving with 1 4 6 4 1
-      // the first uses pixels 0-4, the second uses 2-6
-      __m128 conv = _mm_mul_ps(left,kernel);
-      out[col] = (conv[0] + conv[1] + conv[2] + conv[3] + right[0]) / 256.f;
-      out[col+1] = (left[2] + 4*(left[3]+right[1]) + 6*right[0] + right[2]) / 256.f;
-      // shift to next pair of output columns (four input columns)
-      left = right;
-    }
-    // handle the left-over pixel if the output size is odd
-    if (cw % 2)
-    {
-      base += 4;
-      float right = base[0] + 4*(base[wd]+base[3*wd]) + 6*base[2*wd] + base[4*wd];
-      __m128 conv = _mm_mul_ps(left,kernel);
-      out[cw-3] = (conv[0] + conv[1] + conv[2] + conv[3] + right) / 256.f;
-    }
+    o[i] = 0.5f * (t[i/2] + t[i/2 + 1]);
+    i++;
   }
-  ll_fill_boundary1(coarse, cw, ch);
+  // pairs of even and odd pixels
+  const int m0 = i/2, m1 = (hi - (hi & 1))/2;
+  for(int m = m0; m < m1; m++)
+  {
+    o[2*m]   = 0.125f * (t[m-1] + 6.0f * t[m] + t[m+1]);
+    o[2*m+1] = 0.5f * (t[m] + t[m+1]);
+  }
+  if(hi & 1 && 2*m1 >= lo) o[2*m1] = 0.125f * (t[m1-1] + 6.0f * t[m1] + t[m1+1]);
+  for(int k = i0; k < MIN(lo, i1); k++) o[k] = 0.5f * (t[0] + t[1]);
+  for(int k = MAX(hi, i0); k < i1; k++) o[k] = 0.5f * (t[emax/2] + t[emax/2 + 1]);
 }
+
+// the remapping function, written without branches so that it vectorises
+#ifdef _OPENMP
+#pragma omp declare simd
 #endif
+static inline float ll_curve(
+    const float x,
+    const float g,
+    const float sigma,
+    const float shadows,
+    const float highlights,
+    const float clarity)
+{
+  const float c = x-g;
+  // the highlights are the mirrored shadows
+  const float ssigma = c < 0.0f ? -sigma : sigma;
+  const float shadhi = c < 0.0f ? highlights : shadows;
+  // linear part far away from g
+  const float vlin = g + ssigma + shadhi * (c - ssigma);
+  // blend in via quadratic bezier
+  const float t = CLAMPF(c / (2.0f*ssigma), 0.0f, 1.0f);
+  const float vmid = g + 2.0f*ssigma * (1.0f-t) * t + t*t * (ssigma + ssigma*shadhi);
+  const float val = fabsf(c) > 2.0f*sigma ? vlin : vmid;
+  // midtone local contrast
+  return val + clarity * c * expf(-c*c/(2.0*sigma*sigma/3.0f));
+}
 
-static inline void gauss_reduce(
-    const float *const input, // fine input buffer
-    float *const coarse,      // coarse scale, blurred input buf
-    const int wd,             // fine res
-    const int ht)
+// remap row j of the padded input around g, columns [i0, i1), into out.
+// like the input, the padding repeats the (remapped) boundary of the image.
+static inline void ll_curve_row(
+    float *const restrict out,
+    const float *const restrict padded,
+    const int w,
+    const int h,
+    const int max_supp,
+    const int i0,
+    const int i1,
+    const int j,
+    const float g,
+    const float sigma,
+    const float shadows,
+    const float highlights,
+    const float clarity)
 {
-  // blur, store only coarse res
-  const int cw = (wd-1)/2+1, ch = (ht-1)/2+1;
+  const float *const restrict in = padded + (size_t)CLAMPS(j, max_supp, h-max_supp-1) * w;
+  float *const o = out - i0;
+  const float left  = ll_curve(in[max_supp], g, sigma, shadows, highlights, clarity);
+  const float right = ll_curve(in[w-max_supp-1], g, sigma, shadows, highlights, clarity);
+  for(int i = i0; i < MIN(i1, max_supp); i++) o[i] = left;
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+  for(int i = MAX(i0, max_supp); i < MIN(i1, w-max_supp); i++)
+    o[i] = ll_curve(in[i], g, sigma, shadows, highlights, clarity);
+  for(int i = MAX(i0, w-max_supp); i < i1; i++) o[i] = right;
+}
 
-  // this is the scalar (non-simd) code:
-  const float w[5] = { 1.f/16.f, 4.f/16.f, 6.f/16.f, 4.f/16.f, 1.f/16.f };
-  memset(coarse, 0, sizeof(float)*cw*ch);
-  // direct 5x5 stencil only on required pixels:
+// add the laplacian coefficients fine - coarse of the pyramid remapped around gamma[k] to acc, weighted by
+// the linear interpolation between the gamma levels at the brightness of the input
+static inline void ll_accumulate_row(
+    float *const restrict acc,
+    const float *const restrict fine,
+    const float *const restrict coarse,
+    const float *const restrict padded,
+    const int k,
+    const int n)
+{
+  for(int i = 0; i < n; i++)
+  {
+    // gamma[k] = (k+.5)/num_gamma, clamped to the first and last one outside of that
+    const float t = CLAMPF(padded[i] * num_gamma - 0.5f, 0.0f, num_gamma - 1.0f);
+    const float d = fabsf(t - k);
+    const float weight = d < 1.0f ? 1.0f - d : 0.0f;
+    acc[i] += weight * (fine[i] - coarse[i]);
+  }
+}
+
+static void pad_by_replication(
+    float *buf,			// the buffer to be padded
+    const uint32_t w,		// width of a line
+    const uint32_t h,		// total height, including top and bottom padding
+    const uint32_t padding)	// number of lines of padding on each side
+{
 #ifdef _OPENMP
-  // DON'T parallelize the very smallest levels of the pyramid, as the threading overhead
-  // is greater than the time needed to do it sequentially
-#pragma omp parallel for default(none) if (ch*cw>500)  \
-  dt_omp_firstprivate(coarse, cw, ch, input, w, wd) \
-  schedule(static) \
-  collapse(2)
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(buf, padding, h, w) \
+  schedule(static)
 #endif
-  for(int j=1;j<ch-1;j++)
-    for(int i=1;i<cw-1;i++)
-    {
-      for(int jj=-2;jj<=2;jj++)
-        for(int ii=-2;ii<=2;ii++)
-          coarse[j*cw+i] += input[(2*j+jj)*wd+2*i+ii] * w[ii+2] * w[jj+2];
-    }
-  ll_fill_boundary1(coarse, cw, ch);
+  for(int j=0;j<padding;j++)
+  {
+    memcpy(buf + w*j, buf+padding*w, sizeof(float)*w);
+    memcpy(buf + w*(h-padding+j), buf+w*(h-padding-1), sizeof(float)*w);
+  }
 }
 
 // allocate output buffer with monochrome brightness channel from input, padded
@@ -383,181 +394,252 @@ static inline float *ll_pad_input(
 }
 
 
-static inline float ll_laplacian(
-    const float *const coarse,   // coarse res gaussian
-    const float *const fine,     // fine res gaussian
-    const int i,                 // fine index
-    const int j,
-    const int wd,                // fine width
-    const int ht)                // fine height
+// everything the passes over the pyramids share
+typedef struct ll_pyramids_t
 {
-  const float c = ll_expand_gaussian(coarse,
-      CLAMPS(i, 1, ((wd-1)&~1)-1), CLAMPS(j, 1, ((ht-1)&~1)-1), wd, ht);
-  return fine[j*wd+i] - c;
-}
-
-static inline float curve_scalar(
-    const float x,
-    const float g,
-    const float sigma,
-    const float shadows,
-    const float highlights,
-    const float clarity)
+  float *padded[max_levels];          // gaussian pyramid of the padded input
+  float *output[max_levels];          // output pyramid, only from the first untiled level on
+  float *buf[num_gamma][max_levels];  // remapped pyramids, same
+  int wd[max_levels], ht[max_levels]; // size of the levels
+  int max_supp;                       // padding on each side
+  int last_level;
+  int tiled;                          // number of levels processed in tiles
+  float *scratch;                     // per thread: tile windows followed by two rows of the finest level
+  size_t scratch_size;
+  size_t tile_scratch;
+  float sigma, shadows, highlights, clarity;
+} ll_pyramids_t;
+
+// upper bound of the floats needed by the windows of one tile
+static size_t ll_tile_scratch(const int tiled)
 {
-  const float c = x-g;
-  float val;
-  // blend in via quadratic bezier
-  if     (c >  2*sigma) val = g + sigma + shadows    * (c-sigma);
-  else if(c < -2*sigma) val = g - sigma + highlights * (c+sigma);
-  else if(c > 0.0f)
-  { // shadow contrast
-    const float t = CLAMPS(c / (2.0f*sigma), 0.0f, 1.0f);
-    const float t2 = t * t;
-    const float mt = 1.0f-t;
-    val = g + sigma * 2.0f*mt*t + t2*(sigma + sigma*shadows);
-  }
-  else
-  { // highlight contrast
-    const float t = CLAMPS(-c / (2.0f*sigma), 0.0f, 1.0f);
-    const float t2 = t * t;
-    const float mt = 1.0f-t;
-    val = g - sigma * 2.0f*mt*t + t2*(- sigma - sigma*highlights);
+  if(!tiled) return 0;
+  int o[max_levels];
+  o[0] = tile_size;
+  for(int l = 1; l < tiled; l++) o[l] = o[l-1]/2 + 4;
+  // remap pass: the tile is on the first untiled level. output pass: the tile is on the finest level.
+  int ra = tile_size >> tiled, rb = o[tiled-1];
+  size_t size_a = 0, size_b = 0;
+  for(int l = tiled-1; l >= 0; l--)
+  {
+    ra = 2*ra + 4;
+    if(l < tiled-1) rb = MAX(o[l], 2*rb + 4);
+    size_a += (size_t)ra * ra;
+    size_b += (size_t)rb * rb + (size_t)o[l] * o[l];
   }
-  // midtone local contrast
-  val += clarity * c * expf(-c*c/(2.0*sigma*sigma/3.0f));
-  return val;
+  return MAX(size_a, size_b);
 }
 
-#if defined(__SSE2__)
-static inline __m128 curve_vec4(
-    const __m128 x,
-    const __m128 g,
-    const __m128 sigma,
-    const __m128 shadows,
-    const __m128 highlights,
-    const __m128 clarity)
+static inline float *ll_rows(const ll_pyramids_t *const p)
 {
-  // TODO: pull these non-data dependent constants out of the loop to see
-  // whether the compiler fail to do so
-  const __m128 const0 = _mm_set_ps1(0x3f800000u);
-  const __m128 const1 = _mm_set_ps1((float)0x402DF854u); // for e^x
-  const __m128 sign_mask = _mm_set1_ps(-0.f); // -0.f = 1 << 31
-  const __m128 one = _mm_set1_ps(1.0f);
-  const __m128 two = _mm_set1_ps(2.0f);
-  const __m128 twothirds = _mm_set1_ps(2.0f/3.0f);
-  const __m128 twosig = _mm_mul_ps(two, sigma);
-  const __m128 sigma2 = _mm_mul_ps(sigma, sigma);
-  const __m128 s22 = _mm_mul_ps(twothirds, sigma2);
-
-  const __m128 c = _mm_sub_ps(x, g);
-  const __m128 select = _mm_cmplt_ps(c, _mm_setzero_ps());
-  // select shadows or highlights as multiplier for linear part, based on c < 0
-  const __m128 shadhi = _mm_or_ps(_mm_andnot_ps(select, shadows), _mm_and_ps(select, highlights));
-  // flip sign bit of sigma based on c < 0 (c < 0 ? - sigma : sigma)
-  const __m128 ssigma = _mm_xor_ps(sigma, _mm_and_ps(select, sign_mask));
-  // this contains the linear parts valid for c > 2*sigma or c < - 2*sigma
-  const __m128 vlin = _mm_add_ps(g, _mm_add_ps(ssigma, _mm_mul_ps(shadhi, _mm_sub_ps(c, ssigma))));
-
-  const __m128 t = _mm_min_ps(one, _mm_max_ps(_mm_setzero_ps(),
-        _mm_div_ps(c, _mm_mul_ps(two, ssigma))));
-  const __m128 t2 = _mm_mul_ps(t, t);
-  const __m128 mt = _mm_sub_ps(one, t);
-
-  // midtone value fading over to linear part, without local contrast:
-  const __m128 vmid = _mm_add_ps(g,
-      _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ssigma, two), _mm_mul_ps(mt, t)),
-        _mm_mul_ps(t2, _mm_add_ps(ssigma, _mm_mul_ps(ssigma, shadhi)))));
-
-  // c > 2*sigma?
-  const __m128 linselect = _mm_cmpgt_ps(_mm_andnot_ps(sign_mask, c), twosig);
-  const __m128 val = _mm_or_ps(_mm_and_ps(linselect, vlin), _mm_andnot_ps(linselect, vmid));
+  return dt_get_perthread(p->scratch, p->scratch_size) + p->tile_scratch;
+}
 
-  // midtone local contrast
-  // dt_fast_expf in sse:
-  const __m128 arg = _mm_xor_ps(sign_mask, _mm_div_ps(_mm_mul_ps(c, c), s22));
-  const __m128 k0 = _mm_add_ps(const0, _mm_mul_ps(arg, _mm_sub_ps(const1, const0)));
-  const __m128 k = _mm_max_ps(k0, _mm_setzero_ps());
-  const __m128i ki = _mm_cvtps_epi32(k);
-  const __m128 gauss = _mm_load_ps((float*)&ki);
-  const __m128 vcon = _mm_mul_ps(clarity, _mm_mul_ps(c, gauss));
-  return _mm_add_ps(val, vcon);
+// gaussian pyramid step on a whole level
+static void ll_reduce(const ll_pyramids_t *const p, const float *const fine, float *const coarse, const int l)
+{
+  const ll_window_t f = ll_level((float *)fine, p->wd[l-1], p->ht[l-1]);
+  const ll_window_t c = ll_level(coarse, p->wd[l], p->ht[l]);
+  const int cw = p->wd[l], ch = p->ht[l];
+#ifdef _OPENMP
+  // DON'T parallelize the very smallest levels of the pyramid, as the threading overhead
+  // is greater than the time needed to do it sequentially
+#pragma omp parallel for default(none) if (ch*cw>1000) \
+  dt_omp_firstprivate(p, f, c, cw, ch) \
+  schedule(static)
+#endif
+  for(int j = 0; j < ch; j++)
+    ll_reduce_row(&f, &c, cw, ch, j, ll_rows(p));
 }
 
-// sse (4-wide)
-void apply_curve_sse2(
-    float *const out,
-    const float *const in,
-    const uint32_t w,
-    const uint32_t h,
-    const uint32_t padding,
-    const float g,
-    const float sigma,
-    const float shadows,
-    const float highlights,
-    const float clarity)
+// assemble level l of the output pyramid on the whole image: expanded coarser level plus the blended
+// laplacian coefficients of the remapped pyramids
+static void ll_assemble(const ll_pyramids_t *const p, const int l)
 {
-  // TODO: do all this in avx2 8-wide (should be straight forward):
+  const int wd = p->wd[l], ht = p->ht[l];
 #ifdef _OPENMP
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(clarity, g, h, highlights, in, out, padding, shadows, sigma, w) \
+#pragma omp parallel for default(none) if (wd*ht>1000) \
+  dt_omp_firstprivate(p, l, wd, ht) \
   schedule(static)
 #endif
-  for(uint32_t j=padding;j<h-padding;j++)
+  for(int j = 0; j < ht; j++)
   {
-    const float *in2  = in  + j*w + padding;
-    float *out2 = out + j*w + padding;
-    // find 4-byte aligned block in the middle:
-    const float *const beg = (float *)((size_t)(out2+3)&(size_t)0x10ul);
-    const float *const end = (float *)((size_t)(out2+w-padding)&(size_t)0x10ul);
-    const float *const fin = out2+w-padding;
-    const __m128 g4 = _mm_set1_ps(g);
-    const __m128 sig4 = _mm_set1_ps(sigma);
-    const __m128 shd4 = _mm_set1_ps(shadows);
-    const __m128 hil4 = _mm_set1_ps(highlights);
-    const __m128 clr4 = _mm_set1_ps(clarity);
-    for(;out2<beg;out2++,in2++)
-      *out2 = curve_scalar(*in2, g, sigma, shadows, highlights, clarity);
-    for(;out2<end;out2+=4,in2+=4)
-      _mm_stream_ps(out2, curve_vec4(_mm_load_ps(in2), g4, sig4, shd4, hil4, clr4));
-    for(;out2<fin;out2++,in2++)
-      *out2 = curve_scalar(*in2, g, sigma, shadows, highlights, clarity);
-    out2 = out + j*w;
-    for(int i=0;i<padding;i++)   out2[i] = out2[padding];
-    for(int i=w-padding;i<w;i++) out2[i] = out2[w-padding-1];
+    float *const tmp = ll_rows(p);
+    float *const e = tmp + p->wd[0];
+    float *const acc = p->output[l] + (size_t)j * wd;
+    memset(acc, 0, sizeof(float) * wd);
+    for(int k = 0; k < num_gamma; k++)
+    {
+      const ll_window_t c = ll_level(p->buf[k][l+1], p->wd[l+1], p->ht[l+1]);
+      ll_expand_row(&c, wd, ht, j, 0, wd, tmp, e);
+      ll_accumulate_row(acc, p->buf[k][l] + (size_t)j * wd, e, p->padded[l] + (size_t)j * wd, k, wd);
+    }
+    const ll_window_t c = ll_level(p->output[l+1], p->wd[l+1], p->ht[l+1]);
+    ll_expand_row(&c, wd, ht, j, 0, wd, tmp, e);
+    for(int i = 0; i < wd; i++) acc[i] += e[i];
   }
-  pad_by_replication(out, w, h, padding);
 }
-#endif
 
-// scalar version
-void apply_curve(
-    float *const out,
-    const float *const in,
-    const uint32_t w,
-    const uint32_t h,
-    const uint32_t padding,
-    const float g,
-    const float sigma,
-    const float shadows,
-    const float highlights,
-    const float clarity)
+// fill a level outside of [x0,x1) x [y0,y1) by repeating the border of that rectangle
+static void ll_replicate(
+    float *const buf,
+    const int wd,
+    const int ht,
+    const int x0,
+    const int x1,
+    const int y0,
+    const int y1)
 {
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(clarity, g, h, highlights, in, out, padding, sigma, shadows, w) \
+  dt_omp_firstprivate(buf, wd, x0, x1, y0, y1) \
   schedule(static)
 #endif
-  for(uint32_t j=padding;j<h-padding;j++)
+  for(int j=y0;j<y1;j++)
+  {
+    float *const row = buf + (size_t)j * wd;
+    for(int i=0;i<x0;i++)  row[i] = row[x0];
+    for(int i=x1;i<wd;i++) row[i] = row[x1-1];
+  }
+  for(int j=0;j<y0;j++)  memcpy(buf + (size_t)j * wd, buf + (size_t)y0 * wd, sizeof(float) * wd);
+  for(int j=y1;j<ht;j++) memcpy(buf + (size_t)j * wd, buf + (size_t)(y1-1) * wd, sizeof(float) * wd);
+}
+
+// remap one tile of the first untiled level T, [x0,x1) x [y0,y1), for all gamma levels:
+// remap the footprint on the finest level and reduce it T times.
+static void ll_remap_tile(
+    const ll_pyramids_t *const p,
+    const int x0,
+    const int x1,
+    const int y0,
+    const int y1)
+{
+  const int T = p->tiled;
+  float *const scratch = dt_get_perthread(p->scratch, p->scratch_size);
+  float *const tmp = scratch + p->tile_scratch;
+  ll_window_t win[max_levels];
+  win[T] = (ll_window_t){ NULL, x0, y0, x1-x0, y1-y0, p->wd[T] };
+  float *s = scratch;
+  for(int l = T-1; l >= 0; l--)
   {
-    const float *in2  = in  + j*w + padding;
-    float *out2 = out + j*w + padding;
-    for(uint32_t i=padding;i<w-padding;i++)
-      (*out2++) = curve_scalar(*(in2++), g, sigma, shadows, highlights, clarity);
-    out2 = out + j*w;
-    for(int i=0;i<padding;i++)   out2[i] = out2[padding];
-    for(int i=w-padding;i<w;i++) out2[i] = out2[w-padding-1];
+    int xa, xb, ya, yb;
+    ll_reduce_range(win[l+1].x, win[l+1].x + win[l+1].wd, p->wd[l+1], &xa, &xb);
+    ll_reduce_range(win[l+1].y, win[l+1].y + win[l+1].ht, p->ht[l+1], &ya, &yb);
+    win[l] = (ll_window_t){ s, xa, ya, xb-xa, yb-ya, xb-xa };
+    s += (size_t)win[l].wd * win[l].ht;
+  }
+  assert(s <= scratch + p->tile_scratch);
+
+  for(int k = 0; k < num_gamma; k++)
+  {
+    const float g = (k+.5f)/(float)num_gamma;
+    win[T].p = p->buf[k][T] + (size_t)y0 * p->wd[T] + x0;
+    for(int j = win[0].y; j < win[0].y + win[0].ht; j++)
+      ll_curve_row(ll_row(&win[0], j) + win[0].x, p->padded[0], p->wd[0], p->ht[0], p->max_supp,
+                   win[0].x, win[0].x + win[0].wd, j, g, p->sigma, p->shadows, p->highlights, p->clarity);
+    for(int l = 1; l <= T; l++)
+      for(int j = win[l].y; j < win[l].y + win[l].ht; j++)
+        ll_reduce_row(&win[l-1], &win[l], p->wd[l], p->ht[l], j, tmp);
+  }
+}
+
+// compute the tiled levels of the output pyramid for one tile [x0,x1) x [y0,y1) of the finest level and
+// write it to the image. one remapped pyramid is kept at a time, its laplacian coefficients are blended
+// into the output pyramid of the tile right away.
+static void ll_output_tile(
+    const ll_pyramids_t *const p,
+    const float *const input,
+    float *const out,
+    const int width,
+    const int x0,
+    const int x1,
+    const int y0,
+    const int y1)
+{
+  const int T = p->tiled;
+  float *const scratch = dt_get_perthread(p->scratch, p->scratch_size);
+  float *const tmp = scratch + p->tile_scratch;
+  float *const e = tmp + p->wd[0];
+  // output windows, each one is what the expansion of the finer one reads
+  ll_window_t o[max_levels], r[max_levels];
+  o[0] = (ll_window_t){ NULL, x0, y0, x1-x0, y1-y0, x1-x0 };
+  for(int l = 0; l < T-1; l++)
+  {
+    int xa, xb, ya, yb;
+    ll_expand_range(o[l].x, o[l].x + o[l].wd, p->wd[l], &xa, &xb);
+    ll_expand_range(o[l].y, o[l].y + o[l].ht, p->ht[l], &ya, &yb);
+    o[l+1] = (ll_window_t){ NULL, xa, ya, xb-xa, yb-ya, xb-xa };
+  }
+  // remapped windows: the output window plus what the reduction to the coarser remapped window reads
+  r[T-1] = o[T-1];
+  for(int l = T-2; l >= 0; l--)
+  {
+    int xa, xb, ya, yb;
+    ll_reduce_range(r[l+1].x, r[l+1].x + r[l+1].wd, p->wd[l+1], &xa, &xb);
+    ll_reduce_range(r[l+1].y, r[l+1].y + r[l+1].ht, p->ht[l+1], &ya, &yb);
+    xa = MIN(xa, o[l].x);
+    ya = MIN(ya, o[l].y);
+    xb = MAX(xb, o[l].x + o[l].wd);
+    yb = MAX(yb, o[l].y + o[l].ht);
+    r[l] = (ll_window_t){ NULL, xa, ya, xb-xa, yb-ya, xb-xa };
+  }
+  float *s = scratch;
+  for(int l = 0; l < T; l++)
+  {
+    o[l].p = s;
+    s += (size_t)o[l].wd * o[l].ht;
+    r[l].p = s;
+    s += (size_t)r[l].wd * r[l].ht;
+    memset(o[l].p, 0, sizeof(float) * o[l].wd * o[l].ht);
+  }
+  assert(s <= scratch + p->tile_scratch);
+
+  for(int k = 0; k < num_gamma; k++)
+  {
+    const float g = (k+.5f)/(float)num_gamma;
+    for(int j = r[0].y; j < r[0].y + r[0].ht; j++)
+      ll_curve_row(ll_row(&r[0], j) + r[0].x, p->padded[0], p->wd[0], p->ht[0], p->max_supp,
+                   r[0].x, r[0].x + r[0].wd, j, g, p->sigma, p->shadows, p->highlights, p->clarity);
+    for(int l = 1; l < T; l++)
+      for(int j = r[l].y; j < r[l].y + r[l].ht; j++)
+        ll_reduce_row(&r[l-1], &r[l], p->wd[l], p->ht[l], j, tmp);
+
+    for(int l = 0; l < T; l++)
+    {
+      const ll_window_t c = l+1 < T ? r[l+1] : ll_level(p->buf[k][T], p->wd[T], p->ht[T]);
+      for(int j = o[l].y; j < o[l].y + o[l].ht; j++)
+      {
+        ll_expand_row(&c, p->wd[l], p->ht[l], j, o[l].x, o[l].x + o[l].wd, tmp, e);
+        ll_accumulate_row(ll_row(&o[l], j) + o[l].x, ll_row(&r[l], j) + o[l].x, e,
+                          p->padded[l] + (size_t)j * p->wd[l] + o[l].x, k, o[l].wd);
+      }
+    }
+  }
+
+  // collapse the output pyramid of the tile
+  for(int l = T-1; l >= 0; l--)
+  {
+    const ll_window_t c = l+1 < T ? o[l+1] : ll_level(p->output[T], p->wd[T], p->ht[T]);
+    for(int j = o[l].y; j < o[l].y + o[l].ht; j++)
+    {
+      ll_expand_row(&c, p->wd[l], p->ht[l], j, o[l].x, o[l].x + o[l].wd, tmp, e);
+      float *const row = ll_row(&o[l], j) + o[l].x;
+      for(int i = 0; i < o[l].wd; i++) row[i] += e[i];
+    }
+  }
+
+  const int max_supp = p->max_supp;
+  for(int j = y0; j < y1; j++)
+  {
+    const float *const row = ll_row(&o[0], j);
+    for(int i = x0; i < x1; i++)
+    {
+      const size_t k = 4 * ((size_t)(j-max_supp) * width + i-max_supp);
+      out[k+0] = 100.0f * row[i]; // [0,1] -> L
+      out[k+1] = input[k+1]; // copy original colour channels
+      out[k+2] = input[k+2];
+    }
   }
-  pad_by_replication(out, w, h, padding);
 }
 
 void local_laplacian_internal(
@@ -569,7 +651,6 @@ void local_laplacian_internal(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    const int use_sse2,         // flag whether to use SSE version
     local_laplacian_boundary_t *b)
 {
   if(wd <= 1 || ht <= 1) return;
@@ -580,70 +661,80 @@ void local_laplacian_internal(
   if(b && b->mode == 2) // higher number here makes it less prone to aliasing and slower.
     last_level = num_levels > 4 ? 4 : num_levels-1;
   const int max_supp = 1<<last_level;
+
+  ll_pyramids_t p = { .max_supp = max_supp, .last_level = last_level,
+                      .sigma = sigma, .shadows = shadows, .highlights = highlights, .clarity = clarity };
+  // the preview pass hands out its whole output pyramid, it is small anyway
+  p.tiled = (b && b->mode == 1) ? 0 : MIN(max_tiled_levels, last_level);
+  const int T = p.tiled;
+
   int w, h;
-  float *padded[max_levels] = {0};
   if(b && b->mode == 2)
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
+    p.padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, b);
   else
-    padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
+    p.padded[0] = ll_pad_input(input, wd, ht, max_supp, &w, &h, 0);
+  for(int l=0;l<=last_level;l++)
+  {
+    p.wd[l] = dl(w,l);
+    p.ht[l] = dl(h,l);
+  }
 
-  // allocate pyramid pointers for padded input
-  for(int l=1;l<=last_level;l++)
-    padded[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
+  p.tile_scratch = ll_tile_scratch(T);
+  p.scratch = dt_alloc_perthread_float(p.tile_scratch + 2 * w, &p.scratch_size);
 
-  // allocate pyramid pointers for output
-  float *output[max_levels] = {0};
-  for(int l=0;l<=last_level;l++)
-    output[l] = dt_alloc_align_float((size_t)dl(w,l) * dl(h,l));
+  // allocate pyramid pointers for padded input
+  for(int l=1;l<last_level;l++)
+    p.padded[l] = dt_alloc_align_float((size_t)p.wd[l] * p.ht[l]);
 
-  // create gauss pyramid of padded input, write coarse directly to output
-#if defined(__SSE2__)
-  if(use_sse2)
+  // allocate pyramid pointers for output and the remapped pyramids, not needed on the tiled levels
+  for(int l=T;l<=last_level;l++)
   {
-    for(int l=1;l<last_level;l++)
-      gauss_reduce_sse2(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-    gauss_reduce_sse2(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
+    p.output[l] = dt_alloc_align_float((size_t)p.wd[l] * p.ht[l]);
+    for(int k=0;k<num_gamma;k++)
+      p.buf[k][l] = dt_alloc_align_float((size_t)p.wd[l] * p.ht[l]);
   }
-  else
-#endif
+
+  // create gauss pyramid of padded input, write coarse directly to output
+  for(int l=1;l<last_level;l++)
+    ll_reduce(&p, p.padded[l-1], p.padded[l], l);
+  ll_reduce(&p, p.padded[last_level-1], p.output[last_level], last_level);
+
+  // the remapped input repeats the boundary of the image into the padding, and so do the levels of its
+  // pyramid away from the image. only [x0,x1) x [y0,y1) of level T isn't a copy of its border.
+  int x0 = max_supp, x1 = w - max_supp, y0 = max_supp, y1 = h - max_supp;
+  for(int l=1;l<=T;l++)
   {
-    for(int l=1;l<last_level;l++)
-      gauss_reduce(padded[l-1], padded[l], dl(w,l-1), dl(h,l-1));
-    gauss_reduce(padded[last_level-1], output[last_level], dl(w,last_level-1), dl(h,last_level-1));
+    x0 = MAX((x0-2)/2, 1);
+    y0 = MAX((y0-2)/2, 1);
+    x1 = MIN((x1+4)/2, p.wd[l]-1);
+    y1 = MIN((y1+4)/2, p.ht[l]-1);
   }
 
-  // evenly sample brightness [0,1]:
-  float gamma[num_gamma] = {0.0f};
-  for(int k=0;k<num_gamma;k++) gamma[k] = (k+.5f)/(float)num_gamma;
-  // for(int k=0;k<num_gamma;k++) gamma[k] = k/(num_gamma-1.0f);
-
-  // allocate memory for intermediate laplacian pyramids
-  float *buf[num_gamma][max_levels] = {{0}};
-  for(int k=0;k<num_gamma;k++) for(int l=0;l<=last_level;l++)
-    buf[k][l] = dt_alloc_align_float((size_t)dl(w,l)*dl(h,l));
-
+  // the remapped pyramids on level T, computed tile by tile from the finest level.
   // the paper says remapping only level 3 not 0 does the trick, too
   // (but i really like the additional octave of sharpness we get,
   // willing to pay the cost).
-  for(int k=0;k<num_gamma;k++)
-  { // process images
-#if defined(__SSE2__)
-    if(use_sse2)
-      apply_curve_sse2(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);
-    else // brackets in next line needed for silly gcc warning:
-#endif
-    {apply_curve(buf[k][0], padded[0], w, h, max_supp, gamma[k], sigma, shadows, highlights, clarity);}
-
-    // create gaussian pyramids
-    for(int l=1;l<=last_level;l++)
-#if defined(__SSE2__)
-      if(use_sse2)
-        gauss_reduce_sse2(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
-      else
+  const int tw = tile_size >> T;
+  const int ntx = (x1 - x0 + tw - 1) / tw, nty = (y1 - y0 + tw - 1) / tw;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(ntx, nty, tw, x0, x1, y0, y1) \
+  shared(p) \
+  schedule(dynamic) \
+  collapse(2)
 #endif
-        gauss_reduce(buf[k][l-1], buf[k][l], dl(w,l-1), dl(h,l-1));
-  }
+  for(int ty=0;ty<nty;ty++) for(int tx=0;tx<ntx;tx++)
+    ll_remap_tile(&p, x0 + tx*tw, MIN(x0 + (tx+1)*tw, x1), y0 + ty*tw, MIN(y0 + (ty+1)*tw, y1));
+
+  for(int k=0;k<num_gamma;k++)
+    ll_replicate(p.buf[k][T], p.wd[T], p.ht[T], x0, x1, y0, y1);
 
+  // and the coarser levels on the whole image
+  for(int k=0;k<num_gamma;k++)
+    for(int l=T+1;l<=last_level;l++)
+      ll_reduce(&p, p.buf[k][l-1], p.buf[k][l], l);
+
+  float **const output = p.output;
   // resample output[last_level] from preview
   // requires to transform from padded/downsampled to full image and then
   // to padded/downsampled in preview
@@ -702,53 +793,43 @@ void local_laplacian_internal(
     debug_dump_PFM("/tmp/newcoarse.pfm", output[last_level], pw, ph);
   }
 
-  // assemble output pyramid coarse to fine
-  for(int l=last_level-1;l >= 0; l--)
-  {
-    const int pw = dl(w,l), ph = dl(h,l);
+  // assemble output pyramid coarse to fine, on the whole image down to level T
+  for(int l=last_level-1;l>=T;l--)
+    ll_assemble(&p, l);
 
-    gauss_expand(output[l+1], output[l], pw, ph);
-    // go through all coefficients in the upsampled gauss buffer:
+  if(T)
+  { // the tiled levels, straight into the output image
+    const int ntx0 = (wd + tile_size - 1) / tile_size, nty0 = (ht + tile_size - 1) / tile_size;
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-    dt_omp_firstprivate(ph, pw) \
-    shared(w,h,buf,output,l,gamma,padded) \
-    schedule(static) \
+    dt_omp_firstprivate(input, out, wd, ht, ntx0, nty0, max_supp) \
+    shared(p) \
+    schedule(dynamic) \
     collapse(2)
 #endif
-    for(int j=0;j<ph;j++) for(int i=0;i<pw;i++)
-    {
-      const float v = padded[l][j*pw+i];
-      int hi = 1;
-      for(;hi<num_gamma-1 && gamma[hi] <= v;hi++);
-      int lo = hi-1;
-      const float a = CLAMPS((v - gamma[lo])/(gamma[hi]-gamma[lo]), 0.0f, 1.0f);
-      const float l0 = ll_laplacian(buf[lo][l+1], buf[lo][l], i, j, pw, ph);
-      const float l1 = ll_laplacian(buf[hi][l+1], buf[hi][l], i, j, pw, ph);
-      output[l][j*pw+i] += l0 * (1.0f-a) + l1 * a;
-      // we could do this to save on memory (no need for finest buf[][]).
-      // unfortunately it results in a quite noticeable loss of sharpness, i think
-      // the extra level is worth it.
-      // else if(l == 0) // use finest scale from input to not amplify noise (and use less memory)
-      //   output[l][j*pw+i] += ll_laplacian(padded[l+1], padded[l], i, j, pw, ph);
-    }
+    for(int ty=0;ty<nty0;ty++) for(int tx=0;tx<ntx0;tx++)
+      ll_output_tile(&p, input, out, wd,
+                     max_supp + tx*tile_size, max_supp + MIN((tx+1)*tile_size, wd),
+                     max_supp + ty*tile_size, max_supp + MIN((ty+1)*tile_size, ht));
   }
+  else
+  {
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(ht, input, max_supp, out, wd) \
-  shared(w,output,buf) \
-  schedule(static) \
-  collapse(2)
+    dt_omp_firstprivate(ht, input, max_supp, out, wd, w, output) \
+    schedule(static) \
+    collapse(2)
 #endif
-  for(int j=0;j<ht;j++) for(int i=0;i<wd;i++)
-  {
-    out[4*(j*wd+i)+0] = 100.0f * output[0][(j+max_supp)*w+max_supp+i]; // [0,1] -> L
-    out[4*(j*wd+i)+1] = input[4*(j*wd+i)+1]; // copy original colour channels
-    out[4*(j*wd+i)+2] = input[4*(j*wd+i)+2];
+    for(int j=0;j<ht;j++) for(int i=0;i<wd;i++)
+    {
+      out[4*(j*wd+i)+0] = 100.0f * output[0][(j+max_supp)*w+max_supp+i]; // [0,1] -> L
+      out[4*(j*wd+i)+1] = input[4*(j*wd+i)+1]; // copy original colour channels
+      out[4*(j*wd+i)+2] = input[4*(j*wd+i)+2];
+    }
   }
   if(b && b->mode == 1)
   { // output the buffers for later re-use
-    b->pad0 = padded[0];
+    b->pad0 = p.padded[0];
     b->wd = wd;
     b->ht = ht;
     b->pwd = w;
@@ -759,10 +840,11 @@ void local_laplacian_internal(
   // free all buffers except the ones passed out for preview rendering
   for(int l=0;l<max_levels;l++)
   {
-    if(!b || b->mode != 1 || l)   dt_free_align(padded[l]);
+    if(!b || b->mode != 1 || l)   dt_free_align(p.padded[l]);
     if(!b || b->mode != 1)        dt_free_align(output[l]);
-    for(int k=0; k<num_gamma;k++) dt_free_align(buf[k][l]);
+    for(int k=0; k<num_gamma;k++) dt_free_align(p.buf[k][l]);
   }
+  dt_free_align(p.scratch);
 }
 
 
@@ -770,14 +852,20 @@ size_t local_laplacian_memory_use(const int width,     // width of input image
                                   const int height)    // height of input image
 {
   const int num_levels = MIN(max_levels, 31-__builtin_clz(MIN(width,height)));
-  const int max_supp = 1<<(num_levels-1);
+  const int last_level = num_levels-1;
+  const int tiled = MIN(max_tiled_levels, last_level);
+  const int max_supp = 1<<last_level;
   const int paddwd = width  + 2*max_supp;
   const int paddht = height + 2*max_supp;
 
   size_t memory_use = 0;
 
+  // gaussian pyramid of the input, output and remapped pyramids on the untiled levels
   for(int l=0;l<num_levels;l++)
-    memory_use += sizeof(float) * (2 + num_gamma) * dl(paddwd, l) * dl(paddht, l);
+    memory_use += sizeof(float) * (1 + (l >= tiled ? 1 + num_gamma : 0)) * dl(paddwd, l) * dl(paddht, l);
+
+  // tiles and rows of the threads
+  memory_use += sizeof(float) * (ll_tile_scratch(tiled) + 2 * paddwd) * dt_get_num_threads();
 
   return memory_use;
 }
@@ -54,7 +54,6 @@ void local_laplacian_internal(
     const float shadows,        // user param: lift shadows
     const float highlights,     // user param: compress highlights
     const float clarity,        // user param: increase clarity/local contrast
-    const int use_sse2,         // switch on sse optimised version, if available
     // the following is just needed for clipped roi with boundary conditions from coarse buffer (can be 0)
     local_laplacian_boundary_t *b);
 
@@ -69,7 +68,7 @@ void local_laplacian(
     const float clarity,        // user param: increase clarity/local contrast
     local_laplacian_boundary_t *b) // can be 0
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 0, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b);
 }
 
 size_t local_laplacian_memory_use(const int width,      // width of input image
@@ -92,7 +91,7 @@ void local_laplacian_sse2(
     const float clarity,        // user param: increase clarity/local contrast
     local_laplacian_boundary_t *b) // can be 0
 {
-  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, 1, b);
+  local_laplacian_internal(input, out, wd, ht, sigma, shadows, highlights, clarity, b);
 }
 #endif
 // clang-format off
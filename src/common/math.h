@@ -352,6 +352,32 @@ static inline __m128 dt_fast_expf_sse2(const __m128 x)
 
 #endif // __SSE2__
 
+#ifdef DT_HAVE_AVX_KERNELS
+#include <immintrin.h>
+
+/* AVX2 and AVX-512 versions of dt_fast_expf_sse2, giving the same bits on two or four pixels at once */
+static inline __DT_TARGET_AVX2__ __m256 dt_fast_expf_avx2(const __m256 x)
+{
+  // separate statements, so that clang doesn't contract them into an fma either
+  const __m256 xf = x * _mm256_set1_ps((float)0x00adf880u);
+  const __m256 f = _mm256_set1_ps((float)0x3f800000u) + xf;
+  __m256i i = _mm256_cvtps_epi32(f);
+  const __m256i mask = _mm256_srai_epi32(i, 31);
+  i = _mm256_andnot_si256(mask, i);
+  return _mm256_castsi256_ps(i);
+}
+
+static inline __DT_TARGET_AVX512__ __m512 dt_fast_expf_avx512(const __m512 x)
+{
+  const __m512 xf = x * _mm512_set1_ps((float)0x00adf880u);
+  const __m512 f = _mm512_set1_ps((float)0x3f800000u) + xf;
+  __m512i i = _mm512_cvtps_epi32(f);
+  const __m512i mask = _mm512_srai_epi32(i, 31);
+  i = _mm512_andnot_si512(mask, i);
+  return _mm512_castsi512_ps(i);
+}
+#endif // DT_HAVE_AVX_KERNELS
+
 // fast approximation of 2^-x for 0<x<126
 /****** if you change this function, you need to make the same change in data/kernels/{denoiseprofile,nlmeans}.cl ***/
 static inline float dt_fast_mexp2f(const float x)
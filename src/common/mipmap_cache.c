@@ -1145,7 +1145,7 @@ static int _bpp(dt_imageio_module_data_t *data)
 static int _write_image(dt_imageio_module_data_t *data, const char *filename, const void *in,
                         dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                         void *exif, int exif_len, int imgid, int num, int total, dt_dev_pixelpipe_t *pipe,
-                        const gboolean export_masks)
+                        const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
   _dummy_data_t *d = (_dummy_data_t *)data;
   memcpy(d->buf, in, sizeof(uint32_t) * data->width * data->height);
@@ -1217,7 +1217,7 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
     {
       uint8_t *tmp = 0;
       int32_t thumb_width, thumb_height;
-      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height, color_space);
+      res = dt_imageio_large_thumbnail(filename, &tmp, &thumb_width, &thumb_height, color_space, wd, ht);
       if(!res)
       {
         // if the thumbnail is not large enough, we compute one
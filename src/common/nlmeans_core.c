@@ -50,12 +50,19 @@
 #define SLICE_WIDTH 72
 #define SLICE_HEIGHT 60
 
+// number of consecutive patches which the SSE code path processes together, one per vector lane.  Their
+//  column sums are interleaved, and each output pixel is loaded and stored once per group instead of once
+//  per patch.  The weighted pixels are still added in the order of the patches, so the result is identical
+//  to processing the patches one at a time.  The AVX2 and AVX-512 kernels use groups of 8 and 16 patches.
+#define PATCH_GROUP 4
+#define PATCH_GROUP_MAX 16
+
 // try to speed up processing by caching pixel differences?  If cached, they won't need to be computed a
 // second time when sliding the patch window away from the pixel.  Testing shows it to be slower than
 // recomputing for both scalar and SSE on a Threadripper due to increased memory writes; this may differ on
-// architectures with slower multiplication.
+// architectures with slower multiplication.  Only the scalar code path supports it, the SSE code path always
+// recomputes.
 //#define CACHE_PIXDIFFS
-//#define CACHE_PIXDIFFS_SSE
 
 // number of intermediate buffers used by OpenCL code path.  If you change this, you must also change
 //   the definition in src/iop/nlmeans.c and src/iop/denoiseprofile.c
@@ -172,18 +179,6 @@ static inline float diff_of_pixels_diff(const float* const pix1, const float* pi
   return sum[0] + sum[1] + sum[2];
 }
 
-#if defined(__SSE2__)
-// compute the channel-normed squared difference between two pixels; don't do horizontal sum until later
-static inline __m128 channel_difference_sse2(const float* const pix1, const float* pix2, const dt_aligned_pixel_t norm)
-{
-  const __m128 px1 = _mm_load_ps(pix1);
-  const __m128 px2 = _mm_load_ps(pix2);
-  const __m128 n = _mm_load_ps(norm);
-  const __m128 dif = px1 - px2;
-  return dif * dif * n;
-}
-#endif /* __SSE2__ */
-
 #if defined(__SSE2__)
 // compute the channel-normed squared difference between two pixels
 static inline float pixel_difference_sse2(const float* const pix1, const float* pix2, const dt_aligned_pixel_t norm)
@@ -197,7 +192,7 @@ static inline float pixel_difference_sse2(const float* const pix1, const float*
 }
 #endif /* __SSE2__ */
 
-#if defined(CACHE_PIXDIFFS) || defined(CACHE_PIXDIFFS_SSE)
+#if defined(CACHE_PIXDIFFS)
 static inline float get_pixdiff(const float *const col_sums, const int radius, const int row, const int col)
 {
   const int stride = 2*(radius+1);
@@ -207,7 +202,7 @@ static inline float get_pixdiff(const float *const col_sums, const int radius, c
 }
 #endif
 
-#if defined(CACHE_PIXDIFFS) || defined(CACHE_PIXDIFFS_SSE)
+#if defined(CACHE_PIXDIFFS)
 static inline void set_pixdiff(float *const col_sums, const int radius, const int row, const int col,
                                const float diff)
 {
@@ -218,7 +213,7 @@ static inline void set_pixdiff(float *const col_sums, const int radius, const in
 }
 #endif
 
-#if defined(CACHE_PIXDIFFS) || defined(CACHE_PIXDIFFS_SSE)
+#if defined(CACHE_PIXDIFFS)
 static inline float pixdiff_column_sum(const float *const col_sums, const int radius, const int col)
 {
   const int stride = SLICE_WIDTH + 2*radius;
@@ -285,10 +280,11 @@ static void init_column_sums(float *const col_sums, const patch_t *const patch,
 static void init_column_sums_sse2(float *const col_sums, const patch_t *const patch, const float *const in,
                                   const int row, const int chunk_left, const int chunk_right,
                                   const int height, const int width, const int stride,
-                                  const int radius, const float *const norm)
+                                  const int radius, const float *const norm, const int group)
 {
   // Compute column sums from scratch.  Needed for the very first row, and at intervals thereafter
-  //   to limit accumulation of rounding errors
+  //   to limit accumulation of rounding errors.  The column sums of a group of patches are interleaved, so
+  //   col_sums points at the entry of this patch and consecutive columns are 'group' floats apart
 
   // figure out which columns can possibly contribute to patches whose centers lie within the RoI
   // we can go up to 'radius' columns beyond the current chunk provided that the patch does not
@@ -302,11 +298,7 @@ static void init_column_sums_sse2(float *const col_sums, const patch_t *const pa
   const int rmax = row + MIN(radius,MIN(height-1-row,height-1-(row+srow)));
   for (int col = chunk_left-radius-1; col < MIN(col_min,chunk_right+radius); col++)
   {
-    col_sums[col] = 0;
-#ifdef CACHE_PIXDIFFS_SSE
-    for(int i = row-radius; i <= row+radius; i++)
-      set_pixdiff(col_sums,radius,i,col,0.0f);
-#endif
+    col_sums[group*col] = 0;
   }
   for (int col = col_min; col < col_max; col++)
   {
@@ -314,24 +306,16 @@ static void init_column_sums_sse2(float *const col_sums, const patch_t *const pa
     for (int r = rmin; r <= rmax; r++)
     {
       const float *pixel = in + r*stride + 4*col;
-      const float diff = pixel_difference_sse2(pixel,pixel+patch->offset,norm);
-#ifdef CACHE_PIXDIFFS_SSE
-      set_pixdiff(col_sums,radius,r,col,diff);
-#endif
-      sum += diff;
+      sum += pixel_difference_sse2(pixel,pixel+patch->offset,norm);
     }
-    col_sums[col] = sum;
+    col_sums[group*col] = sum;
   }
   // clear out any columns where the patch column would be outside the RoI, as well as our overrun area
   // (When the chunk is sufficiently narrow, col_max can become less than col_min, which would cause a buffer
   // under-run if we didn't check for that condition here.)
   for (int col = MAX(col_min,col_max); col < chunk_right + radius; col++)
   {
-    col_sums[col] = 0;
-#ifdef CACHE_PIXDIFFS_SSE
-    for(int i = row-radius; i <= row+radius; i++)
-      set_pixdiff(col_sums,radius,i,col,0.0f);
-#endif
+    col_sums[group*col] = 0;
   }
   return;
 }
@@ -610,9 +594,518 @@ void nlmeans_denoise(const float *const inbuf, float *const outbuf,
 }
 
 #if defined(__SSE2__)
-void nlmeans_denoise_sse2(const float *const inbuf, float *const outbuf,
-                          const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
-                          const dt_nlmeans_param_t *const params)
+// the vector version of gh(), dt_fast_mexp2f on four values at once
+static inline __m128 gh_sse2(const __m128 f)
+{
+  const __m128i i1 = _mm_set1_epi32(0x3f800000); // bit representation of 2^0
+  const __m128 scale = _mm_set1_ps((float)(0x3f000000 - 0x3f800000)); // difference to 2^-1
+  const __m128i k0 = _mm_add_epi32(i1, _mm_cvttps_epi32(_mm_mul_ps(f, scale)));
+  const __m128i valid = _mm_cmpgt_epi32(k0, _mm_set1_epi32(0x7fffff));
+  return _mm_castsi128_ps(_mm_and_si128(k0, valid));
+}
+#endif /* __SSE2__ */
+
+#if defined(__SSE2__)
+// the rows and columns of a chunk to which a single patch contributes
+struct patch_range_t
+{
+  int row_min, row_max;   // rows where the patch center lies within the RoI
+  int row_top, row_bot;   // rows where the whole patch lies within the RoI
+  int col_min, col_max;   // columns where the patch center lies within the RoI
+  int pcol_min, pcol_max; // columns of the column sums which need to be updated
+  int offset;             // array distance between corresponding pixels
+};
+typedef struct patch_range_t patch_range_t;
+
+static inline void set_patch_range(patch_range_t *const pr, const patch_t *const patch,
+                                   const int chunk_top, const int chunk_bot,
+                                   const int chunk_left, const int chunk_right,
+                                   const int height, const int width, const int radius)
+{
+  // skip any rows where the patch center would be above top of RoI or below bottom of RoI
+  pr->row_min = MAX(chunk_top,MAX(0,-patch->rows));
+  pr->row_max = MIN(chunk_bot,height - MAX(0,patch->rows));
+  // figure out which rows at top and bottom result in patches extending outside the RoI, even though the
+  // center pixel is inside
+  pr->row_top = MAX(pr->row_min,MAX(radius,radius-patch->rows));
+  pr->row_bot = MIN(pr->row_max,height-1-MAX(radius,radius+patch->rows));
+  // skip any columns where the patch center would be to the left or the right of the RoI
+  const int scol = patch->cols;
+  pr->col_min = MAX(chunk_left,-scol);
+  pr->col_max = MIN(chunk_right,width - scol);
+  pr->pcol_min = chunk_left - MIN(radius,MIN(chunk_left,chunk_left+scol));
+  pr->pcol_max = chunk_right + MIN(radius,MIN(width-chunk_right,width-(chunk_right+scol)));
+  pr->offset = patch->offset;
+}
+#endif /* __SSE2__ */
+
+#if defined(__SSE2__)
+// add up the initial columns of the sliding window of total patch distortion of a single patch of a group
+static inline float init_distortion_sse2(const float *const col_sums, const patch_range_t *const pr,
+                                         const int radius, const int group)
+{
+  float distortion = 0.0;
+  for (int i = pr->col_min - radius; i < MIN(pr->col_min+radius, pr->col_max); i++)
+  {
+    distortion += col_sums[group*i];
+  }
+  return distortion;
+}
+#endif /* __SSE2__ */
+
+#if defined(__SSE2__)
+// slide the patch window of a single patch of a group along columns [col_from,col_to) of a row, adding the
+// weighted pixels to the output
+static inline void accumulate_patch_sse2(__m128 *const out, const float *const in, const float *const col_sums,
+                                         const int offset, const int col_from, const int col_to,
+                                         float *const distortion, const int radius, const size_t stride,
+                                         const dt_aligned_pixel_t center_norm, const float center_weight,
+                                         const float sharpness, const int group)
+{
+  float dist = *distortion;
+  for (int col = col_from; col < col_to; col++)
+  {
+    dist += (col_sums[group*(col+radius)] - col_sums[group*(col-radius-1)]);
+    float wt;
+    if (center_weight < 0)
+    {
+      // computation as used by denoise(non-local) iop
+      wt = gh(dist * sharpness);
+    }
+    else
+    {
+      // computation as used by denoiseprofiled iop with non-local means
+      const float dissimilarity = (dist + pixel_difference_sse2(in+4*col,in+4*col+offset,center_norm))
+                                   / (1.0f + center_weight);
+      wt = gh(fmaxf(0.0f, dissimilarity * sharpness - 2.0f));
+    }
+    __m128 pixel = _mm_load_ps(in+4*col+offset);
+    pixel[3] = 1.0f;
+    out[col] += (pixel * _mm_set1_ps(wt));
+    _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
+  }
+  *distortion = dist;
+}
+#endif /* __SSE2__ */
+
+#if defined(__SSE2__)
+// the same as accumulate_patch_sse2 for all patches of a full group at once, with one patch per vector lane.
+// The weighted pixels are added to the output in the order of the patches, which gives exactly the same
+// result as processing the patches one after the other.
+static inline void accumulate_group_sse2(__m128 *const out, const float *const in, const float *const col_sums,
+                                         const int *const offsets, const int col_from, const int col_to,
+                                         float *const distortion, const int radius, const size_t stride,
+                                         const dt_aligned_pixel_t center_norm, const float center_weight,
+                                         const float sharpness)
+{
+  __m128 dist = _mm_load_ps(distortion);
+  const __m128 sharp = _mm_set1_ps(sharpness);
+  const __m128 cw_norm = _mm_set1_ps(1.0f + center_weight);
+  const __m128 two = _mm_set1_ps(2.0f);
+  const __m128 norm0 = _mm_set1_ps(center_norm[0]);
+  const __m128 norm1 = _mm_set1_ps(center_norm[1]);
+  const __m128 norm2 = _mm_set1_ps(center_norm[2]);
+  for (int col = col_from; col < col_to; col++)
+  {
+    const float *const inpx = in + 4*col;
+    dist += (_mm_load_ps(col_sums + PATCH_GROUP*(col+radius)) - _mm_load_ps(col_sums + PATCH_GROUP*(col-radius-1)));
+    __m128 px0 = _mm_load_ps(inpx+offsets[0]);
+    __m128 px1 = _mm_load_ps(inpx+offsets[1]);
+    __m128 px2 = _mm_load_ps(inpx+offsets[2]);
+    __m128 px3 = _mm_load_ps(inpx+offsets[3]);
+    __m128 wt;
+    if (center_weight < 0)
+    {
+      // computation as used by denoise(non-local) iop
+      wt = gh_sse2(dist * sharp);
+    }
+    else
+    {
+      // computation as used by denoiseprofiled iop with non-local means; transpose the patch pixels to get
+      // one channel of all four patches per vector
+      __m128 ch0 = px0, ch1 = px1, ch2 = px2, ch3 = px3;
+      _MM_TRANSPOSE4_PS(ch0, ch1, ch2, ch3);
+      const __m128 d0 = _mm_set1_ps(inpx[0]) - ch0;
+      const __m128 d1 = _mm_set1_ps(inpx[1]) - ch1;
+      const __m128 d2 = _mm_set1_ps(inpx[2]) - ch2;
+      const __m128 center = d0 * d0 * norm0 + d1 * d1 * norm1 + d2 * d2 * norm2;
+      const __m128 dissimilarity = (dist + center) / cw_norm;
+      wt = gh_sse2(_mm_max_ps(_mm_setzero_ps(), dissimilarity * sharp - two));
+    }
+    px0[3] = px1[3] = px2[3] = px3[3] = 1.0f;
+    __m128 sum = out[col];
+    sum += px0 * _mm_shuffle_ps(wt, wt, _MM_SHUFFLE(0,0,0,0));
+    sum += px1 * _mm_shuffle_ps(wt, wt, _MM_SHUFFLE(1,1,1,1));
+    sum += px2 * _mm_shuffle_ps(wt, wt, _MM_SHUFFLE(2,2,2,2));
+    sum += px3 * _mm_shuffle_ps(wt, wt, _MM_SHUFFLE(3,3,3,3));
+    out[col] = sum;
+    for (int k = 0; k < PATCH_GROUP; k++)
+      _mm_prefetch(inpx+offsets[k]+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
+  }
+  _mm_store_ps(distortion, dist);
+}
+#endif /* __SSE2__ */
+
+#if defined(__SSE2__)
+// move the column sums of a single patch of a group from the current row down to the next one, for columns
+// [col_from,col_to)
+static inline void update_patch_sums_sse2(float *const col_sums, const float *const inbuf,
+                                          const patch_range_t *const pr, const int row,
+                                          const int col_from, const int col_to, const int radius,
+                                          const size_t stride, const float *const norm, const int group)
+{
+  const int offset = pr->offset;
+  if (row < MIN(pr->row_top, pr->row_bot))
+  {
+    // top edge of patch was above top of RoI, so it had a value of zero; just add in the new row
+    const float *bot_row = inbuf + (row+1+radius)*stride;
+    for (int col = col_from; col < col_to; col++)
+    {
+      const float *const bot_px = bot_row + 4*col;
+      const float diff = pixel_difference_sse2(bot_px,bot_px+offset,norm);
+      _mm_prefetch(bot_px+stride, _MM_HINT_T0);
+      col_sums[group*col] += diff;
+      _mm_prefetch(bot_px+offset+stride, _MM_HINT_T0);
+    }
+  }
+  else if (row < pr->row_bot)
+  {
+    const float *const top_row = inbuf + (row-radius)*stride;
+    const float *const bot_row = inbuf + (row+1+radius)*stride;
+    const __m128 n = _mm_load_ps(norm);
+    // both prior and new positions are entirely within the RoI, so subtract the old row and add the new one
+    for (int col = col_from; col < col_to; col++)
+    {
+      const float *const top_px = top_row + 4*col;
+      const float *const bot_px = bot_row + 4*col;
+      const __m128 bot_dif = _mm_load_ps(bot_px) - _mm_load_ps(bot_px+offset);
+      const __m128 top_dif = _mm_load_ps(top_px) - _mm_load_ps(top_px+offset);
+      const __m128 dif = (bot_dif * bot_dif - top_dif * top_dif) * n;
+      _mm_prefetch(bot_px+stride, _MM_HINT_T0);
+      col_sums[group*col] += (dif[0] + dif[1] + dif[2]);
+      _mm_prefetch(bot_px+offset+stride, _MM_HINT_T0);
+    }
+  }
+  else if (row >= pr->row_top && row + 1 < pr->row_max) // don't bother updating if last iteration
+  {
+    // new row of the patch is below the bottom of RoI, so its value is zero; just subtract the old row
+    const float *top_row = inbuf + (row-radius)*stride;
+    for (int col = col_from; col < col_to; col++)
+    {
+      const float *const top_px = top_row + 4*col;
+      col_sums[group*col] -= pixel_difference_sse2(top_px,top_px+offset,norm);
+    }
+  }
+}
+#endif /* __SSE2__ */
+
+#if defined(__SSE2__)
+// the same as update_patch_sums_sse2 for all patches of a full group whose old and new rows both lie entirely
+// within the RoI, with one patch per vector lane
+static inline void update_group_sums_sse2(float *const col_sums, const float *const inbuf, const int *const offsets,
+                                          const int row, const int col_from, const int col_to, const int radius,
+                                          const size_t stride, const float *const norm)
+{
+  const float *const top_row = inbuf + (row-radius)*stride;
+  const float *const bot_row = inbuf + (row+1+radius)*stride;
+  const __m128 norm0 = _mm_set1_ps(norm[0]);
+  const __m128 norm1 = _mm_set1_ps(norm[1]);
+  const __m128 norm2 = _mm_set1_ps(norm[2]);
+  for (int col = col_from; col < col_to; col++)
+  {
+    const float *const top_px = top_row + 4*col;
+    const float *const bot_px = bot_row + 4*col;
+    // one channel of the pixels of all four patches per vector
+    __m128 bot0 = _mm_load_ps(bot_px+offsets[0]), bot1 = _mm_load_ps(bot_px+offsets[1]);
+    __m128 bot2 = _mm_load_ps(bot_px+offsets[2]), bot3 = _mm_load_ps(bot_px+offsets[3]);
+    _MM_TRANSPOSE4_PS(bot0, bot1, bot2, bot3);
+    __m128 top0 = _mm_load_ps(top_px+offsets[0]), top1 = _mm_load_ps(top_px+offsets[1]);
+    __m128 top2 = _mm_load_ps(top_px+offsets[2]), top3 = _mm_load_ps(top_px+offsets[3]);
+    _MM_TRANSPOSE4_PS(top0, top1, top2, top3);
+    const __m128 b0 = _mm_set1_ps(bot_px[0]) - bot0, t0 = _mm_set1_ps(top_px[0]) - top0;
+    const __m128 b1 = _mm_set1_ps(bot_px[1]) - bot1, t1 = _mm_set1_ps(top_px[1]) - top1;
+    const __m128 b2 = _mm_set1_ps(bot_px[2]) - bot2, t2 = _mm_set1_ps(top_px[2]) - top2;
+    const __m128 dif = (b0 * b0 - t0 * t0) * norm0 + (b1 * b1 - t1 * t1) * norm1 + (b2 * b2 - t2 * t2) * norm2;
+    _mm_store_ps(col_sums + PATCH_GROUP*col, _mm_load_ps(col_sums + PATCH_GROUP*col) + dif);
+    _mm_prefetch(bot_px+stride, _MM_HINT_T0);
+  }
+}
+#endif /* __SSE2__ */
+
+#ifdef DT_HAVE_AVX_KERNELS
+// the vector version of gh() on eight values at once, see gh_sse2
+static inline __DT_TARGET_AVX2__ __m256 gh_avx2(const __m256 f)
+{
+  const __m256i i1 = _mm256_set1_epi32(0x3f800000); // bit representation of 2^0
+  const __m256 scale = _mm256_set1_ps((float)(0x3f000000 - 0x3f800000)); // difference to 2^-1
+  const __m256i k0 = _mm256_add_epi32(i1, _mm256_cvttps_epi32(_mm256_mul_ps(f, scale)));
+  const __m256i valid = _mm256_cmpgt_epi32(k0, _mm256_set1_epi32(0x7fffff));
+  return _mm256_castsi256_ps(_mm256_and_si256(k0, valid));
+}
+
+// the pixels at px+offsets[0] and px+offsets[4] in one vector
+static inline __DT_TARGET_AVX2__ __m256 load_pixels_avx2(const float *const px, const int *const offsets)
+{
+  return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_load_ps(px+offsets[0])), _mm_load_ps(px+offsets[4]), 1);
+}
+
+// the first three channels of the pixels at px+offsets[0..7], one channel of all eight pixels per vector
+static inline __DT_TARGET_AVX2__ void load_channels_avx2(const float *const px, const int *const offsets,
+                                                         __m256 *const ch0, __m256 *const ch1, __m256 *const ch2)
+{
+  // the transpose within each half gives patches 0..3 and 4..7
+  const __m256 p0 = load_pixels_avx2(px, offsets);
+  const __m256 p1 = load_pixels_avx2(px, offsets+1);
+  const __m256 p2 = load_pixels_avx2(px, offsets+2);
+  const __m256 p3 = load_pixels_avx2(px, offsets+3);
+  const __m256 t0 = _mm256_unpacklo_ps(p0, p1);
+  const __m256 t1 = _mm256_unpacklo_ps(p2, p3);
+  const __m256 t2 = _mm256_unpackhi_ps(p0, p1);
+  const __m256 t3 = _mm256_unpackhi_ps(p2, p3);
+  *ch0 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1,0,1,0));
+  *ch1 = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3,2,3,2));
+  *ch2 = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1,0,1,0));
+}
+
+// accumulate_group_sse2 for groups of eight patches
+static __DT_TARGET_AVX2__ void accumulate_group_avx2(__m128 *const out, const float *const in,
+                                                     const float *const col_sums, const int *const offsets,
+                                                     const int col_from, const int col_to, float *const distortion,
+                                                     const int radius, const size_t stride,
+                                                     const dt_aligned_pixel_t center_norm,
+                                                     const float center_weight, const float sharpness)
+{
+  __m256 dist = _mm256_load_ps(distortion);
+  const __m256 sharp = _mm256_set1_ps(sharpness);
+  const __m256 cw_norm = _mm256_set1_ps(1.0f + center_weight);
+  const __m256 two = _mm256_set1_ps(2.0f);
+  const __m256 norm0 = _mm256_set1_ps(center_norm[0]);
+  const __m256 norm1 = _mm256_set1_ps(center_norm[1]);
+  const __m256 norm2 = _mm256_set1_ps(center_norm[2]);
+  for (int col = col_from; col < col_to; col++)
+  {
+    const float *const inpx = in + 4*col;
+    dist += (_mm256_load_ps(col_sums + 8*(col+radius)) - _mm256_load_ps(col_sums + 8*(col-radius-1)));
+    __m256 wt;
+    if (center_weight < 0)
+    {
+      // computation as used by denoise(non-local) iop
+      wt = gh_avx2(dist * sharp);
+    }
+    else
+    {
+      // computation as used by denoiseprofiled iop with non-local means
+      __m256 ch0, ch1, ch2;
+      load_channels_avx2(inpx, offsets, &ch0, &ch1, &ch2);
+      const __m256 d0 = _mm256_set1_ps(inpx[0]) - ch0;
+      const __m256 d1 = _mm256_set1_ps(inpx[1]) - ch1;
+      const __m256 d2 = _mm256_set1_ps(inpx[2]) - ch2;
+      const __m256 center = d0 * d0 * norm0 + d1 * d1 * norm1 + d2 * d2 * norm2;
+      const __m256 dissimilarity = (dist + center) / cw_norm;
+      wt = gh_avx2(_mm256_max_ps(_mm256_setzero_ps(), dissimilarity * sharp - two));
+    }
+    float DT_ALIGNED_ARRAY w[8];
+    _mm256_store_ps(w, wt);
+    __m128 sum = out[col];
+    for (int k = 0; k < 8; k++)
+    {
+      __m128 px = _mm_load_ps(inpx+offsets[k]);
+      px[3] = 1.0f;
+      sum += px * _mm_set1_ps(w[k]);
+      _mm_prefetch(inpx+offsets[k]+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
+    }
+    out[col] = sum;
+  }
+  _mm256_store_ps(distortion, dist);
+}
+
+// update_group_sums_sse2 for groups of eight patches
+static __DT_TARGET_AVX2__ void update_group_sums_avx2(float *const col_sums, const float *const inbuf,
+                                                      const int *const offsets, const int row, const int col_from,
+                                                      const int col_to, const int radius, const size_t stride,
+                                                      const float *const norm)
+{
+  const float *const top_row = inbuf + (row-radius)*stride;
+  const float *const bot_row = inbuf + (row+1+radius)*stride;
+  const __m256 norm0 = _mm256_set1_ps(norm[0]);
+  const __m256 norm1 = _mm256_set1_ps(norm[1]);
+  const __m256 norm2 = _mm256_set1_ps(norm[2]);
+  for (int col = col_from; col < col_to; col++)
+  {
+    const float *const top_px = top_row + 4*col;
+    const float *const bot_px = bot_row + 4*col;
+    __m256 bot0, bot1, bot2, top0, top1, top2;
+    load_channels_avx2(bot_px, offsets, &bot0, &bot1, &bot2);
+    load_channels_avx2(top_px, offsets, &top0, &top1, &top2);
+    const __m256 b0 = _mm256_set1_ps(bot_px[0]) - bot0, t0 = _mm256_set1_ps(top_px[0]) - top0;
+    const __m256 b1 = _mm256_set1_ps(bot_px[1]) - bot1, t1 = _mm256_set1_ps(top_px[1]) - top1;
+    const __m256 b2 = _mm256_set1_ps(bot_px[2]) - bot2, t2 = _mm256_set1_ps(top_px[2]) - top2;
+    const __m256 dif = (b0 * b0 - t0 * t0) * norm0 + (b1 * b1 - t1 * t1) * norm1 + (b2 * b2 - t2 * t2) * norm2;
+    _mm256_store_ps(col_sums + 8*col, _mm256_load_ps(col_sums + 8*col) + dif);
+    _mm_prefetch(bot_px+stride, _MM_HINT_T0);
+  }
+}
+
+// the vector version of gh() on sixteen values at once, see gh_sse2
+static inline __DT_TARGET_AVX512__ __m512 gh_avx512(const __m512 f)
+{
+  const __m512i i1 = _mm512_set1_epi32(0x3f800000); // bit representation of 2^0
+  const __m512 scale = _mm512_set1_ps((float)(0x3f000000 - 0x3f800000)); // difference to 2^-1
+  const __m512i k0 = _mm512_add_epi32(i1, _mm512_cvttps_epi32(_mm512_mul_ps(f, scale)));
+  const __mmask16 valid = _mm512_cmpgt_epi32_mask(k0, _mm512_set1_epi32(0x7fffff));
+  return _mm512_castsi512_ps(_mm512_maskz_mov_epi32(valid, k0));
+}
+
+// the pixels at px+offsets[0], px+offsets[4], px+offsets[8] and px+offsets[12] in one vector
+static inline __DT_TARGET_AVX512__ __m512 load_pixels_avx512(const float *const px, const int *const offsets)
+{
+  __m512 pixels = _mm512_castps128_ps512(_mm_load_ps(px+offsets[0]));
+  pixels = _mm512_insertf32x4(pixels, _mm_load_ps(px+offsets[4]), 1);
+  pixels = _mm512_insertf32x4(pixels, _mm_load_ps(px+offsets[8]), 2);
+  return _mm512_insertf32x4(pixels, _mm_load_ps(px+offsets[12]), 3);
+}
+
+// the first three channels of the pixels at px+offsets[0..15], one channel of all sixteen pixels per vector
+static inline __DT_TARGET_AVX512__ void load_channels_avx512(const float *const px, const int *const offsets,
+                                                             __m512 *const ch0, __m512 *const ch1,
+                                                             __m512 *const ch2)
+{
+  // the transpose within each quarter gives patches 0..3, 4..7, 8..11 and 12..15
+  const __m512 p0 = load_pixels_avx512(px, offsets);
+  const __m512 p1 = load_pixels_avx512(px, offsets+1);
+  const __m512 p2 = load_pixels_avx512(px, offsets+2);
+  const __m512 p3 = load_pixels_avx512(px, offsets+3);
+  const __m512 t0 = _mm512_unpacklo_ps(p0, p1);
+  const __m512 t1 = _mm512_unpacklo_ps(p2, p3);
+  const __m512 t2 = _mm512_unpackhi_ps(p0, p1);
+  const __m512 t3 = _mm512_unpackhi_ps(p2, p3);
+  *ch0 = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(1,0,1,0));
+  *ch1 = _mm512_shuffle_ps(t0, t1, _MM_SHUFFLE(3,2,3,2));
+  *ch2 = _mm512_shuffle_ps(t2, t3, _MM_SHUFFLE(1,0,1,0));
+}
+
+// accumulate_group_sse2 for groups of sixteen patches
+static __DT_TARGET_AVX512__ void accumulate_group_avx512(__m128 *const out, const float *const in,
+                                                         const float *const col_sums, const int *const offsets,
+                                                         const int col_from, const int col_to,
+                                                         float *const distortion, const int radius,
+                                                         const size_t stride, const dt_aligned_pixel_t center_norm,
+                                                         const float center_weight, const float sharpness)
+{
+  __m512 dist = _mm512_load_ps(distortion);
+  const __m512 sharp = _mm512_set1_ps(sharpness);
+  const __m512 cw_norm = _mm512_set1_ps(1.0f + center_weight);
+  const __m512 two = _mm512_set1_ps(2.0f);
+  const __m512 norm0 = _mm512_set1_ps(center_norm[0]);
+  const __m512 norm1 = _mm512_set1_ps(center_norm[1]);
+  const __m512 norm2 = _mm512_set1_ps(center_norm[2]);
+  for (int col = col_from; col < col_to; col++)
+  {
+    const float *const inpx = in + 4*col;
+    dist += (_mm512_load_ps(col_sums + 16*(col+radius)) - _mm512_load_ps(col_sums + 16*(col-radius-1)));
+    __m512 wt;
+    if (center_weight < 0)
+    {
+      // computation as used by denoise(non-local) iop
+      wt = gh_avx512(dist * sharp);
+    }
+    else
+    {
+      // computation as used by denoiseprofiled iop with non-local means
+      __m512 ch0, ch1, ch2;
+      load_channels_avx512(inpx, offsets, &ch0, &ch1, &ch2);
+      const __m512 d0 = _mm512_set1_ps(inpx[0]) - ch0;
+      const __m512 d1 = _mm512_set1_ps(inpx[1]) - ch1;
+      const __m512 d2 = _mm512_set1_ps(inpx[2]) - ch2;
+      const __m512 center = d0 * d0 * norm0 + d1 * d1 * norm1 + d2 * d2 * norm2;
+      const __m512 dissimilarity = (dist + center) / cw_norm;
+      wt = gh_avx512(_mm512_max_ps(_mm512_setzero_ps(), dissimilarity * sharp - two));
+    }
+    float DT_ALIGNED_ARRAY w[16];
+    _mm512_store_ps(w, wt);
+    __m128 sum = out[col];
+    for (int k = 0; k < 16; k++)
+    {
+      __m128 px = _mm_load_ps(inpx+offsets[k]);
+      px[3] = 1.0f;
+      sum += px * _mm_set1_ps(w[k]);
+      _mm_prefetch(inpx+offsets[k]+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
+    }
+    out[col] = sum;
+  }
+  _mm512_store_ps(distortion, dist);
+}
+
+// update_group_sums_sse2 for groups of sixteen patches
+static __DT_TARGET_AVX512__ void update_group_sums_avx512(float *const col_sums, const float *const inbuf,
+                                                          const int *const offsets, const int row,
+                                                          const int col_from, const int col_to, const int radius,
+                                                          const size_t stride, const float *const norm)
+{
+  const float *const top_row = inbuf + (row-radius)*stride;
+  const float *const bot_row = inbuf + (row+1+radius)*stride;
+  const __m512 norm0 = _mm512_set1_ps(norm[0]);
+  const __m512 norm1 = _mm512_set1_ps(norm[1]);
+  const __m512 norm2 = _mm512_set1_ps(norm[2]);
+  for (int col = col_from; col < col_to; col++)
+  {
+    const float *const top_px = top_row + 4*col;
+    const float *const bot_px = bot_row + 4*col;
+    __m512 bot0, bot1, bot2, top0, top1, top2;
+    load_channels_avx512(bot_px, offsets, &bot0, &bot1, &bot2);
+    load_channels_avx512(top_px, offsets, &top0, &top1, &top2);
+    const __m512 b0 = _mm512_set1_ps(bot_px[0]) - bot0, t0 = _mm512_set1_ps(top_px[0]) - top0;
+    const __m512 b1 = _mm512_set1_ps(bot_px[1]) - bot1, t1 = _mm512_set1_ps(top_px[1]) - top1;
+    const __m512 b2 = _mm512_set1_ps(bot_px[2]) - bot2, t2 = _mm512_set1_ps(top_px[2]) - top2;
+    const __m512 dif = (b0 * b0 - t0 * t0) * norm0 + (b1 * b1 - t1 * t1) * norm1 + (b2 * b2 - t2 * t2) * norm2;
+    _mm512_store_ps(col_sums + 16*col, _mm512_load_ps(col_sums + 16*col) + dif);
+    _mm_prefetch(bot_px+stride, _MM_HINT_T0);
+  }
+}
+#endif /* DT_HAVE_AVX_KERNELS */
+
+#if defined(__SSE2__)
+// process all patches of a full group at once with the kernel for its size
+static inline void accumulate_group(const int group, __m128 *const out, const float *const in,
+                                    const float *const col_sums, const int *const offsets, const int col_from,
+                                    const int col_to, float *const distortion, const int radius,
+                                    const size_t stride, const dt_aligned_pixel_t center_norm,
+                                    const float center_weight, const float sharpness)
+{
+#ifdef DT_HAVE_AVX_KERNELS
+  if (group == 16)
+    accumulate_group_avx512(out,in,col_sums,offsets,col_from,col_to,distortion,radius,stride,center_norm,
+                            center_weight,sharpness);
+  else if (group == 8)
+    accumulate_group_avx2(out,in,col_sums,offsets,col_from,col_to,distortion,radius,stride,center_norm,
+                          center_weight,sharpness);
+  else
+#endif
+    accumulate_group_sse2(out,in,col_sums,offsets,col_from,col_to,distortion,radius,stride,center_norm,
+                          center_weight,sharpness);
+}
+
+static inline void update_group_sums(const int group, float *const col_sums, const float *const inbuf,
+                                     const int *const offsets, const int row, const int col_from,
+                                     const int col_to, const int radius, const size_t stride,
+                                     const float *const norm)
+{
+#ifdef DT_HAVE_AVX_KERNELS
+  if (group == 16)
+    update_group_sums_avx512(col_sums,inbuf,offsets,row,col_from,col_to,radius,stride,norm);
+  else if (group == 8)
+    update_group_sums_avx2(col_sums,inbuf,offsets,row,col_from,col_to,radius,stride,norm);
+  else
+#endif
+    update_group_sums_sse2(col_sums,inbuf,offsets,row,col_from,col_to,radius,stride,norm);
+}
+#endif /* __SSE2__ */
+
+#if defined(__SSE2__)
+// the SSE code path, processing 'group' consecutive patches at a time
+static void _nlmeans_denoise_groups(const float *const inbuf, float *const outbuf,
+                                    const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                                    const dt_nlmeans_param_t *const params, const int group)
 {
   // define the factors for applying blending between the original image and the denoised version
   // if running in RGB space, 'luma' should equal 'chroma'
@@ -629,20 +1122,18 @@ void nlmeans_denoise_sse2(const float *const inbuf, float *const outbuf,
   int num_patches;
   int max_shift;
   struct patch_t* patches = define_patches(params,stride,&num_patches,&max_shift);
-  // allocate scratch space, including an overrun area on each end so we don't need a boundary check on every access
+  // allocate scratch space for the interleaved column sums of a group of patches, including an overrun area on
+  // each end so we don't need a boundary check on every access
   const int radius = params->patch_radius;
-#if defined(CACHE_PIXDIFFS_SSE)
-  const size_t scratch_size = (2*radius+3)*(SLICE_WIDTH + 2*radius + 1);
-#else
-  const size_t scratch_size = SLICE_WIDTH + 2*radius + 1 + 48; // getting false sharing without the +48....
-#endif /* CACHE_PIXDIFFS_SSE */
+  const size_t scratch_size = group * (SLICE_WIDTH + 2*radius + 1) + 48; // getting false sharing without the +48....
   size_t padded_scratch_size;
   float *const restrict scratch_buf = dt_alloc_perthread_float(scratch_size, &padded_scratch_size);
   const int chk_height = compute_slice_height(roi_out->height);
   const int chk_width = compute_slice_width(roi_out->width);
 #ifdef _OPENMP
 #pragma omp parallel for default(none) num_threads(darktable.num_openmp_threads) \
-      dt_omp_firstprivate(patches, num_patches, scratch_buf, padded_scratch_size, chk_height, chk_width, radius) \
+      dt_omp_firstprivate(patches, num_patches, scratch_buf, padded_scratch_size, chk_height, chk_width, radius, \
+                          group) \
       dt_omp_sharedconst(params, roi_out, outbuf, inbuf, stride, center_norm, skip_blend, weight, invert) \
       schedule(static) \
       collapse(2)
@@ -654,7 +1145,7 @@ void nlmeans_denoise_sse2(const float *const inbuf, float *const outbuf,
       // locate our scratch space within the big buffer allocated above
       // we'll offset by chunk_left so that we don't have to subtract on every access
       float *const restrict tmpbuf = dt_get_perthread(scratch_buf, padded_scratch_size);
-      float *const col_sums =  tmpbuf + (radius+1) - chunk_left;
+      float *const col_sums =  tmpbuf + group * (radius+1-chunk_left);
       // determine which horizontal slice of the image to process
       const int chunk_bot = MIN(chunk_top + chk_height, roi_out->height);
       // determine which vertical slice of the image to process
@@ -664,126 +1155,108 @@ void nlmeans_denoise_sse2(const float *const inbuf, float *const outbuf,
       {
         memset(outbuf + 4*(i*roi_out->width+chunk_left), '\0', sizeof(float) * 4 * (chunk_right-chunk_left));
       }
-      // cycle through all of the patches over our slice of the image
-      for (int p = 0; p < num_patches; p++)
+      const int height = roi_out->height;
+      const int width = roi_out->width;
+      // cycle through all of the patches over our slice of the image, 'group' consecutive patches at a time
+      for (int first = 0; first < num_patches; first += group)
       {
-        // retrieve info about the current patch
-        const patch_t *patch = &patches[p];
-        // skip any rows where the patch center would be above top of RoI or below bottom of RoI
-        const int height = roi_out->height;
-        const int row_min = MAX(chunk_top,MAX(0,-patch->rows));
-        const int row_max = MIN(chunk_bot,height - MAX(0,patch->rows));
-        // figure out which rows at top and bottom result in patches extending outside the RoI, even though the
-        // center pixel is inside
-        const int row_top = MAX(row_min,MAX(radius,radius-patch->rows));
-        const int row_bot = MIN(row_max,height-1-MAX(radius,radius+patch->rows));
-        // skip any columns where the patch center would be to the left or the right of the RoI
-        const int width = roi_out->width;
-        const int scol = patch->cols;
-        const int col_min = MAX(chunk_left,-scol);
-        const int col_max = MIN(chunk_right,roi_out->width - scol);
+        const int group_size = MIN(group, num_patches - first);
+        patch_range_t range[PATCH_GROUP_MAX];
+        int offsets[PATCH_GROUP_MAX];
+        // find the rows covered by any patch of the group, as well as the rows and columns shared by all of them
+        int row_first = chunk_bot, row_last = chunk_top;
+        int row_shared = chunk_top, row_shared_end = chunk_bot;
+        int col_shared = chunk_left, col_shared_end = chunk_right;
+        int pcol_shared = chunk_left - radius, pcol_shared_end = chunk_right + radius;
+        for (int k = 0; k < group_size; k++)
+        {
+          patch_range_t *const pr = &range[k];
+          set_patch_range(pr,&patches[first+k],chunk_top,chunk_bot,chunk_left,chunk_right,height,width,radius);
+          offsets[k] = pr->offset;
+          row_first = MIN(row_first, pr->row_min);
+          row_last = MAX(row_last, pr->row_max);
+          row_shared = MAX(row_shared, MIN(pr->row_top, pr->row_bot));
+          row_shared_end = MIN(row_shared_end, pr->row_bot);
+          col_shared = MAX(col_shared, pr->col_min);
+          col_shared_end = MIN(col_shared_end, pr->col_max);
+          pcol_shared = MAX(pcol_shared, pr->pcol_min);
+          pcol_shared_end = MIN(pcol_shared_end, pr->pcol_max);
+        }
+        // an empty shared range must not overlap the columns which are processed patch by patch
+        col_shared_end = MAX(col_shared, col_shared_end);
+        pcol_shared_end = MAX(pcol_shared, pcol_shared_end);
 
-        init_column_sums_sse2(col_sums,patch,inbuf,row_min,chunk_left,chunk_right,height,width,
-                              stride,radius,params->norm);
-        for (int row = row_min; row < row_max; row++)
+        for (int row = row_first; row < row_last; row++)
         {
-          // add up the initial columns of the sliding window of total patch distortion
-          float distortion = 0.0;
-          for (int i = col_min - radius; i < MIN(col_min+radius, col_max); i++)
+          int active = 0;
+          for (int k = 0; k < group_size; k++)
           {
-            distortion += col_sums[i];
+            const patch_range_t *const pr = &range[k];
+            if (row == pr->row_min)
+              init_column_sums_sse2(col_sums+k,&patches[first+k],inbuf,row,chunk_left,chunk_right,height,width,
+                                    stride,radius,params->norm,group);
+            if (row >= pr->row_min && row < pr->row_max)
+              active++;
           }
           // now proceed down the current row of the image
           const float *in = inbuf + stride * row;
           __m128 *const out = (__m128*)outbuf + (size_t)width * row;
-          const int offset = patch->offset;
-          const float sharpness = params->sharpness;
-          if (params->center_weight < 0)
+          if (active == group)
           {
-            // computation as used by denoise(non-local) iop
-            for (int col = col_min; col < col_max; col++)
+            // all patches of the group contribute to this row: the columns covered by only some of them are
+            // processed patch by patch, the remainder of the row for all of them at once
+            float DT_ALIGNED_ARRAY distortion[PATCH_GROUP_MAX];
+            for (int k = 0; k < group; k++)
             {
-              distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
-              const __m128 wt = _mm_set1_ps(gh(distortion * sharpness));
-              __m128 pixel = _mm_load_ps(in+4*col+offset);
-              pixel[3] = 1.0f;
-              out[col] += (pixel * wt);
-              _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0);	// try to ensure next row is ready in time
+              const patch_range_t *const pr = &range[k];
+              distortion[k] = init_distortion_sse2(col_sums+k,pr,radius,group);
+              accumulate_patch_sse2(out,in,col_sums+k,pr->offset,pr->col_min,MIN(col_shared,pr->col_max),
+                                    &distortion[k],radius,stride,center_norm,params->center_weight,
+                                    params->sharpness,group);
             }
-          }
-          else
-          {
-            // computation as used by denoiseprofiled iop with non-local means
-            for (int col = col_min; col < col_max; col++)
+            accumulate_group(group,out,in,col_sums,offsets,col_shared,col_shared_end,distortion,radius,stride,
+                             center_norm,params->center_weight,params->sharpness);
+            for (int k = 0; k < group; k++)
             {
-              distortion += (col_sums[col+radius] - col_sums[col-radius-1]);
-              const float dissimilarity = (distortion + pixel_difference_sse2(in+4*col,in+4*col+offset,center_norm))
-                                           / (1.0f + params->center_weight);
-              const __m128 wt = _mm_set1_ps(gh(fmaxf(0.0f, dissimilarity * sharpness - 2.0f)));
-              __m128 pixel = _mm_load_ps(in+4*col+offset);
-              pixel[3] = 1.0f;
-              out[col] += (pixel * wt);
-              _mm_prefetch(in+4*col+offset+stride,_MM_HINT_T0); // try to ensure next row is ready in time
+              const patch_range_t *const pr = &range[k];
+              accumulate_patch_sse2(out,in,col_sums+k,pr->offset,MAX(col_shared_end,pr->col_min),pr->col_max,
+                                    &distortion[k],radius,stride,center_norm,params->center_weight,
+                                    params->sharpness,group);
             }
           }
-          const int pcol_min = chunk_left - MIN(radius,MIN(chunk_left,chunk_left+scol));
-          const int pcol_max = chunk_right + MIN(radius,MIN(width-chunk_right,width-(chunk_right+scol)));
-          if (row < MIN(row_top, row_bot))
+          else
           {
-            // top edge of patch was above top of RoI, so it had a value of zero; just add in the new row
-            const float *bot_row = inbuf + (row+1+radius)*stride;
-            for (int col = pcol_min; col < pcol_max; col++)
+            for (int k = 0; k < group_size; k++)
             {
-              const float *const bot_px = bot_row + 4*col;
-              const float diff = pixel_difference_sse2(bot_px,bot_px+offset,params->norm);
-              _mm_prefetch(bot_px+stride, _MM_HINT_T0);
-#ifdef CACHE_PIXDIFFS_SSE
-              set_pixdiff(col_sums,radius,row+radius+1,col,diff);
-#endif
-              col_sums[col] += diff;
-              _mm_prefetch(bot_px+offset+stride, _MM_HINT_T0);
+              const patch_range_t *const pr = &range[k];
+              if (row < pr->row_min || row >= pr->row_max) continue;
+              float distortion = init_distortion_sse2(col_sums+k,pr,radius,group);
+              accumulate_patch_sse2(out,in,col_sums+k,pr->offset,pr->col_min,pr->col_max,&distortion,radius,
+                                    stride,center_norm,params->center_weight,params->sharpness,group);
             }
           }
-          else if (row < row_bot)
+          // move the column sums down to the next row
+          if (active == group && row >= row_shared && row < row_shared_end)
           {
-#ifndef CACHE_PIXDIFFS_SSE
-            const float *const top_row = inbuf + (row-radius)*stride   /* +(2*radius+1)*stride*/ ;
-#endif /* !CACHE_PIXDIFFS_SSE */
-            const float *const bot_row = inbuf + (row+1+radius)*stride ;
-            // both prior and new positions are entirely within the RoI, so subtract the old row and add the new one
-            for (int col = pcol_min; col < pcol_max; col++)
+            for (int k = 0; k < group; k++)
             {
-#ifdef CACHE_PIXDIFFS_SSE
-              const float *const bot_px = bot_row + 4*col;
-              const float diff = pixel_difference_sse2(bot_px,bot_px+offset,params->norm);
-              col_sums[col] += diff - get_pixdiff(col_sums,radius,row-radius,col);
-              _mm_prefetch(bot_px+stride, _MM_HINT_T0);
-              set_pixdiff(col_sums,radius,row+1+radius,col,diff);
-#else
-              const float *const top_px = top_row + 4*col;
-              const float *const bot_px = bot_row + 4*col;
-              __m128 dif = (channel_difference_sse2(bot_px,bot_px+offset,params->norm)
-                            - channel_difference_sse2(top_px,top_px+offset,params->norm));
-              _mm_prefetch(bot_px+stride, _MM_HINT_T0);
-              col_sums[col] += (dif[0] + dif[1] + dif[2]);
-#endif /* CACHE_PIXDIFFS_SSE */
-              _mm_prefetch(bot_px+offset+stride, _MM_HINT_T0);
+              const patch_range_t *const pr = &range[k];
+              update_patch_sums_sse2(col_sums+k,inbuf,pr,row,pr->pcol_min,MIN(pcol_shared,pr->pcol_max),
+                                     radius,stride,params->norm,group);
+              update_patch_sums_sse2(col_sums+k,inbuf,pr,row,MAX(pcol_shared_end,pr->pcol_min),pr->pcol_max,
+                                     radius,stride,params->norm,group);
             }
+            update_group_sums(group,col_sums,inbuf,offsets,row,pcol_shared,pcol_shared_end,radius,stride,
+                              params->norm);
           }
-          else if (row >= row_top && row + 1 < row_max) // don't bother updating if last iteration
+          else
           {
-            // new row of the patch is below the bottom of RoI, so its value is zero; just subtract the old row
-#ifndef CACHE_PIXDIFFS_SSE
-            const float *top_row = inbuf + (row-radius)*stride;
-#endif /* !CACHE_PIXDIFFS_SSE */
-            for (int col = pcol_min; col < pcol_max; col++)
+            for (int k = 0; k < group_size; k++)
             {
-#ifdef CACHE_PIXDIFFS_SSE
-              col_sums[col] -= get_pixdiff(col_sums,radius,row-radius,col);
-#else
-              const float *const top_px = top_row + 4*col;
-              col_sums[col] -= pixel_difference_sse2(top_px,top_px+offset,params->norm);
-#endif /* CACHE_PIXDIFFS_SSE */
+              const patch_range_t *const pr = &range[k];
+              if (row < pr->row_min || row >= pr->row_max) continue;
+              update_patch_sums_sse2(col_sums+k,inbuf,pr,row,pr->pcol_min,pr->pcol_max,radius,stride,
+                                     params->norm,group);
             }
           }
         }
@@ -828,6 +1301,23 @@ void nlmeans_denoise_sse2(const float *const inbuf, float *const outbuf,
 }
 #endif /* __SSE2__ */
 
+#if defined(__SSE2__)
+void nlmeans_denoise_sse2(const float *const inbuf, float *const outbuf,
+                          const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out,
+                          const dt_nlmeans_param_t *const params)
+{
+  // use the widest groups of patches enabled in darktable.codepath
+#ifdef DT_HAVE_AVX_KERNELS
+  if(darktable.codepath.AVX512)
+    _nlmeans_denoise_groups(inbuf, outbuf, roi_in, roi_out, params, 16);
+  else if(darktable.codepath.AVX2)
+    _nlmeans_denoise_groups(inbuf, outbuf, roi_in, roi_out, params, 8);
+  else
+#endif
+    _nlmeans_denoise_groups(inbuf, outbuf, roi_in, roi_out, params, PATCH_GROUP);
+}
+#endif /* __SSE2__ */
+
 /**************************************************************/
 /**************************************************************/
 /*      Everything from here to end of file is WIP!!          */
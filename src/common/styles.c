@@ -907,6 +907,7 @@ void dt_styles_apply_to_image(const char *name, const gboolean duplicate, const
 
     // write history and forms to db
     dt_dev_write_history_ext(dev_dest, newimgid);
+    dt_dev_history_pasted(newimgid);
 
     dt_history_snapshot_undo_create(hist->imgid, &hist->after, &hist->after_history_end);
     dt_undo_start_group(darktable.undo, DT_UNDO_LT_HISTORY);
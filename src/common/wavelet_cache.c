@@ -0,0 +1,208 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2023 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "common/wavelet_cache.h"
+#include "develop/imageop.h"
+#include "develop/pixelpipe_cache.h"
+#include "develop/pixelpipe_hb.h"
+
+/*
+ * Decomposing an image into wavelet scales costs a few passes over the whole buffer per scale. Modules working
+ * on the scales of their input (retouch) do that again on every pipe run, while in the darkroom the input
+ * mostly stays the same: only the module's own parameters or its shapes change.
+ *
+ * Entries are keyed on the basic hash of the pipe up to the last enabled module before the one asking, the same
+ * hash the pixelpipe cache uses for that module's input, together with the pipe type and the roi. Only the full
+ * and preview pipes are cached, the other ones don't run twice on the same input. The cache takes at most a
+ * quarter of the memory available to the pipes, see dt_get_available_mem().
+ */
+
+static struct
+{
+  GMutex lock;
+  GHashTable *entries;
+  GQueue lru;  // most recently used first, only the entries without users
+  size_t used;
+} _cache = { .lru = G_QUEUE_INIT };
+
+static inline size_t _budget()
+{
+  return dt_get_available_mem() / 4;
+}
+
+uint64_t dt_wavelet_cache_key(const dt_dev_pixelpipe_iop_t *const piece, const dt_iop_roi_t *const roi_in,
+                              const dt_wavelet_type_t type, const int scales)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+  if(!(pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_PREVIEW))) return 0;
+
+  uint64_t hash = dt_dev_pixelpipe_cache_basichash_prior(pipe->image.id, pipe, piece->module);
+  // bernstein hash (djb2), like the pixelpipe cache
+  const int tail[3] = { pipe->type, type, scales };
+  const char *str = (const char *)tail;
+  for(size_t i = 0; i < sizeof(tail); i++) hash = ((hash << 5) + hash) ^ str[i];
+  str = (const char *)roi_in;
+  for(size_t i = 0; i < sizeof(dt_iop_roi_t); i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash ? hash : 1;
+}
+
+static void _entry_free(dt_wavelet_cache_entry_t *entry)
+{
+  if(entry->layers)
+    for(int l = 0; l <= entry->scales; l++) dt_free_align(entry->layers[l]);
+  free(entry->layers);
+  free(entry);
+}
+
+// call with the lock held
+static void _remove(dt_wavelet_cache_entry_t *entry)
+{
+  if(entry->link) g_queue_delete_link(&_cache.lru, entry->link);
+  entry->link = NULL;
+  _cache.used -= entry->size;
+  g_hash_table_remove(_cache.entries, &entry->key);
+  _entry_free(entry);
+}
+
+// call with the lock held. entries in use stay, so this may not get below the budget
+static void _evict(const size_t needed, const size_t budget)
+{
+  while(_cache.used + needed > budget && !g_queue_is_empty(&_cache.lru))
+    _remove((dt_wavelet_cache_entry_t *)g_queue_peek_tail(&_cache.lru));
+}
+
+const dt_wavelet_cache_entry_t *dt_wavelet_cache_get(const uint64_t key)
+{
+  g_mutex_lock(&_cache.lock);
+  dt_wavelet_cache_entry_t *entry = _cache.entries ? g_hash_table_lookup(_cache.entries, &key) : NULL;
+  if(entry && entry->ready)
+  {
+    if(entry->link)
+    {
+      g_queue_delete_link(&_cache.lru, entry->link);
+      entry->link = NULL;
+    }
+    entry->users++;
+  }
+  else
+    entry = NULL;
+  g_mutex_unlock(&_cache.lock);
+  return entry;
+}
+
+dt_wavelet_cache_entry_t *dt_wavelet_cache_new(const uint64_t key, const dt_wavelet_type_t type, const int width,
+                                               const int height, const int ch, const int scales)
+{
+  const size_t layer = (size_t)width * height * ch;
+  const size_t size = sizeof(float) * layer * (scales + 1);
+  const size_t budget = _budget();
+  if(!key || size > budget) return NULL;
+
+  g_mutex_lock(&_cache.lock);
+  if(!_cache.entries) _cache.entries = g_hash_table_new(g_int64_hash, g_int64_equal);
+  if(g_hash_table_contains(_cache.entries, &key))
+  {
+    g_mutex_unlock(&_cache.lock);
+    return NULL;
+  }
+  _evict(size, budget);
+  if(_cache.used + size > budget)
+  {
+    g_mutex_unlock(&_cache.lock);
+    return NULL;
+  }
+
+  // reserve the memory and the key before allocating outside of the lock
+  dt_wavelet_cache_entry_t *entry = calloc(1, sizeof(dt_wavelet_cache_entry_t));
+  if(!entry)
+  {
+    g_mutex_unlock(&_cache.lock);
+    return NULL;
+  }
+  entry->key = key;
+  entry->type = type;
+  entry->width = width;
+  entry->height = height;
+  entry->ch = ch;
+  entry->scales = scales;
+  entry->size = size;
+  entry->users = 1;
+  g_hash_table_insert(_cache.entries, &entry->key, entry);
+  _cache.used += size;
+  g_mutex_unlock(&_cache.lock);
+
+  gboolean ok = (entry->layers = calloc(scales + 1, sizeof(float *))) != NULL;
+  for(int l = 0; ok && l <= scales; l++) ok = (entry->layers[l] = dt_alloc_align_float(layer)) != NULL;
+  if(!ok)
+  {
+    dt_wavelet_cache_release(entry);
+    return NULL;
+  }
+  return entry;
+}
+
+void dt_wavelet_cache_publish(dt_wavelet_cache_entry_t *entry)
+{
+  g_mutex_lock(&_cache.lock);
+  entry->ready = TRUE;
+  g_mutex_unlock(&_cache.lock);
+  dt_wavelet_cache_release(entry);
+}
+
+void dt_wavelet_cache_release(const dt_wavelet_cache_entry_t *const centry)
+{
+  if(!centry) return;
+  dt_wavelet_cache_entry_t *entry = (dt_wavelet_cache_entry_t *)centry;
+  g_mutex_lock(&_cache.lock);
+  if(--entry->users == 0)
+  {
+    if(!entry->ready)
+      _remove(entry);
+    else
+    {
+      g_queue_push_head(&_cache.lru, entry);
+      entry->link = _cache.lru.head;
+      // the budget may have shrunk meanwhile
+      _evict(0, _budget());
+    }
+  }
+  g_mutex_unlock(&_cache.lock);
+}
+
+void dt_wavelet_cache_cleanup()
+{
+  g_mutex_lock(&_cache.lock);
+  if(_cache.entries)
+  {
+    // all pipes are gone by now, so there are no users left
+    GHashTableIter iter;
+    gpointer value;
+    g_hash_table_iter_init(&iter, _cache.entries);
+    while(g_hash_table_iter_next(&iter, NULL, &value)) _entry_free((dt_wavelet_cache_entry_t *)value);
+    g_hash_table_destroy(_cache.entries);
+  }
+  g_queue_clear(&_cache.lru);
+  _cache.entries = NULL;
+  _cache.used = 0;
+  g_mutex_unlock(&_cache.lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
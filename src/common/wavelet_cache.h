@@ -0,0 +1,76 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2023 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include "common/darktable.h"
+
+struct dt_dev_pixelpipe_iop_t;
+struct dt_iop_roi_t;
+
+/**
+ * cache of wavelet decompositions of module inputs, shared by all modules and pipes.
+ *
+ * an entry holds the read-only detail scales and the residual of one input, keyed by the hash of the pipe up
+ * to the module (which identifies its input buffer), the roi, the kind of wavelet and the number of scales.
+ * entries are reference counted, the ones not in use are dropped least recently used first once the cache goes
+ * over its share of the pixelpipe memory budget.
+ */
+
+typedef enum dt_wavelet_type_t
+{
+  DT_WAVELET_DWT = 0,    // à trous with the 1 2 1 hat kernel (common/dwt.c)
+  DT_WAVELET_BSPLINE = 1 // à trous with the 1 4 6 4 1 b-spline kernel (common/bspline.h)
+} dt_wavelet_type_t;
+
+typedef struct dt_wavelet_cache_entry_t
+{
+  uint64_t key;
+  dt_wavelet_type_t type;
+  int width, height, ch;
+  int scales;
+  float **layers;   // detail scales 1..scales in layers[0..scales-1], the residual in layers[scales]
+  // private
+  size_t size;
+  int users;
+  gboolean ready;   // all layers have been written
+  GList *link;      // in the lru queue
+} dt_wavelet_cache_entry_t;
+
+/** key of the decomposition of the input of piece at roi_in. returns 0 for pipes which only run once
+ * (export, thumbnails), which are not cached */
+uint64_t dt_wavelet_cache_key(const struct dt_dev_pixelpipe_iop_t *const piece,
+                              const struct dt_iop_roi_t *const roi_in, const dt_wavelet_type_t type,
+                              const int scales);
+/** returns the complete decomposition for key, or NULL. release it with dt_wavelet_cache_release() */
+const dt_wavelet_cache_entry_t *dt_wavelet_cache_get(const uint64_t key);
+/** allocate a new entry for key, to be filled by the caller and then handed over with dt_wavelet_cache_publish().
+ * returns NULL if the key is already there (another pipe computes it) or the entry doesn't fit the budget */
+dt_wavelet_cache_entry_t *dt_wavelet_cache_new(const uint64_t key, const dt_wavelet_type_t type, const int width,
+                                               const int height, const int ch, const int scales);
+/** mark a new entry as complete and release it */
+void dt_wavelet_cache_publish(dt_wavelet_cache_entry_t *entry);
+/** release an entry. entries which haven't been published are dropped */
+void dt_wavelet_cache_release(const dt_wavelet_cache_entry_t *entry);
+void dt_wavelet_cache_cleanup();
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -1436,7 +1436,9 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   }
   g_list_free_full(metadata.list, g_free);
 
-  if(mstorage->finalize_store) mstorage->finalize_store(mstorage, sdata);
+  // files written behind the job may still fail
+  if(mstorage->finalize_store && mstorage->finalize_store(mstorage, sdata) != 0)
+    dt_control_job_cancel(job);
 
 end:
   // all threads free their fdata
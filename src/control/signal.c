@@ -376,6 +376,12 @@ void dt_control_signal_raise(const dt_control_signal_t *ctlsig, dt_signal_t sign
   }
 }
 
+gboolean dt_control_signal_has_handlers(const dt_control_signal_t *ctlsig, const dt_signal_t signal)
+{
+  const guint signal_id = g_signal_lookup(_signal_description[signal].name, _signal_type);
+  return g_signal_has_handler_pending(G_OBJECT(ctlsig->sink), signal_id, 0, FALSE);
+}
+
 void dt_control_signal_connect(const dt_control_signal_t *ctlsig, dt_signal_t signal, GCallback cb,
                                gpointer user_data)
 {
@@ -265,6 +265,8 @@ typedef enum dt_debug_signal_action_t
 struct dt_control_signal_t *dt_control_signal_init();
 /* raises a signal */
 void dt_control_signal_raise(const struct dt_control_signal_t *ctlsig, const dt_signal_t signal, ...);
+/* whether any callback is connected to a signal */
+gboolean dt_control_signal_has_handlers(const struct dt_control_signal_t *ctlsig, const dt_signal_t signal);
 /* connects a callback to a signal */
 void dt_control_signal_connect(const struct dt_control_signal_t *ctlsig, const dt_signal_t signal,
                                GCallback cb, gpointer user_data);
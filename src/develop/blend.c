@@ -197,6 +197,17 @@ void dt_develop_blendif_process_parameters(float *const restrict parameters,
   }
 }
 
+unsigned int dt_develop_blendif_active_channels(const float *const parameters, const unsigned int blendif)
+{
+  unsigned int channels = blendif;
+  for(size_t i = 0, j = 0; i < DEVELOP_BLENDIF_SIZE; i++, j += DEVELOP_BLENDIF_PARAMETER_ITEMS)
+  {
+    if((blendif >> 16) & (1 << i)) continue;
+    if(parameters[j + 1] == -INFINITY && parameters[j + 2] == INFINITY) channels &= ~(1 << i);
+  }
+  return channels;
+}
+
 // See function definition in blend.h for important information
 int dt_develop_blendif_init_masking_profile(struct dt_dev_pixelpipe_iop_t *piece,
                                             dt_iop_order_iccprofile_info_t *blending_profile,
@@ -669,6 +680,64 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
   }
 }
 
+gboolean dt_develop_blend_mask_bounds(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                                      const struct dt_iop_roi_t *const roi_out, struct dt_iop_roi_t *bounds)
+{
+  const dt_develop_blend_params_t *const d = (const dt_develop_blend_params_t *const)piece->blendop_data;
+  if(!d || !(d->mask_mode & DEVELOP_MASK_ENABLED) || !(d->mask_mode & DEVELOP_MASK_MASK)
+     || (d->mask_mode & DEVELOP_MASK_RASTER) || (self->flags() & IOP_FLAGS_NO_MASKS))
+    return FALSE;
+
+  // inverted or inclusive masks, reverse blending, and feathering, blur or brightness of the mask all give
+  // weight to pixels outside of the drawn shapes
+  _develop_mask_post_processing post_operations[3];
+  if((d->mask_combine & (DEVELOP_COMBINE_INV | DEVELOP_COMBINE_INCL | DEVELOP_COMBINE_MASKS_POS))
+     || (d->blend_mode & DEVELOP_BLEND_REVERSE) || _develop_mask_get_post_operations(d, piece, post_operations))
+    return FALSE;
+
+  // the focused module may display its mask or channels, suppress the mask or bypass the blending
+  if(self->dev->gui_attached && self == self->dev->gui_module) return FALSE;
+
+  // a drawn mask without shapes selects everything
+  dt_masks_form_t *form = dt_masks_get_from_id_ext(piece->pipe->forms, d->mask_id);
+  if(!form) return FALSE;
+
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+  float *const restrict mask = dt_alloc_align_float((size_t)width * height);
+  if(!mask) return FALSE;
+
+  // the shapes land in the mask cache, the blend step gets them from there
+  dt_masks_group_render_roi(self, piece, form, roi_out, mask);
+
+  int xmin = width, xmax = -1, ymin = height, ymax = -1;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) dt_omp_firstprivate(mask, width, height) \
+  reduction(min : xmin, ymin) reduction(max : xmax, ymax) schedule(static)
+#endif
+  for(int j = 0; j < height; j++)
+  {
+    const float *const row = mask + (size_t)j * width;
+    int first = 0;
+    while(first < width && row[first] == 0.0f) first++;
+    if(first == width) continue;
+    int last = width - 1;
+    while(row[last] == 0.0f) last--;
+    xmin = MIN(xmin, first);
+    xmax = MAX(xmax, last);
+    ymin = MIN(ymin, j);
+    ymax = MAX(ymax, j);
+  }
+  dt_free_align(mask);
+
+  *bounds = *roi_out;
+  bounds->x = roi_out->x + (xmax < 0 ? 0 : xmin);
+  bounds->y = roi_out->y + (ymax < 0 ? 0 : ymin);
+  bounds->width = xmax < 0 ? 0 : xmax - xmin + 1;
+  bounds->height = ymax < 0 ? 0 : ymax - ymin + 1;
+  return TRUE;
+}
+
 #ifdef HAVE_OPENCL
 static void _refine_with_detail_mask_cl(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, float *mask, const struct dt_iop_roi_t *roi_in,
                                 const struct dt_iop_roi_t *roi_out, const float level, const int devid)
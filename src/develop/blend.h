@@ -368,6 +368,12 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
                               const void *const i, void *const o, const struct dt_iop_roi_t *const roi_in,
                               const struct dt_iop_roi_t *const roi_out);
 
+/** if the blend mask of the module is zero outside of a rectangle of roi_out whatever the module output,
+ * store that rectangle (in the coordinates of roi_out, possibly empty) into bounds and return TRUE. the blend
+ * step then gives back the input out there, and the module only has to be processed on bounds. */
+gboolean dt_develop_blend_mask_bounds(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                                      const struct dt_iop_roi_t *const roi_out, struct dt_iop_roi_t *bounds);
+
 /** get blend version */
 int dt_develop_blend_version(void);
 
@@ -405,6 +411,10 @@ int dt_develop_blend_legacy_params_from_so(dt_iop_module_so_t *module_so, const
 /** initializes the parameter array (of size DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_SIZE) */
 void dt_develop_blendif_process_parameters(float *const parameters, const dt_develop_blend_params_t *const params);
 
+/** returns blendif without the channels whose parameters select their whole range and are not inverted: they
+ * leave the mask unchanged and the mask building can skip them */
+unsigned int dt_develop_blendif_active_channels(const float *const parameters, const unsigned int blendif);
+
 /**
  * Set up a profile adapted to the blending.
  *
@@ -64,32 +64,14 @@ static inline void _PX_COPY(const float *const restrict src, float *const restri
 static inline float _blendif_compute_factor(const float value, const unsigned int invert_mask,
                                             const float *const restrict parameters)
 {
-  float factor = 0.0f;
-  if(value <= parameters[0])
-  {
-   // we are below the keyframe
-   factor = 0.0f;
-  }
-  else if(value < parameters[1])
-  {
-   // we are on the bottom slope of the keyframe
-   factor = (value - parameters[0]) * parameters[4];
-  }
-  else if(value <= parameters[2])
-  {
-   // we are on the ramp - constant part - of the keyframe
-   factor = 1.0f;
-  }
-  else if(value < parameters[3])
-  {
-   // we are on the top slope of the keyframe
-   factor = 1.0f - (value - parameters[2]) * parameters[5];
-  }
-  else
-  {
-   // we are above the keyframe
-   factor = 0.0f;
-  }
+  // 0 below the keyframe, bottom slope up to parameters[1], 1 on the ramp up to parameters[2], top slope up to
+  // parameters[3] and 0 above. both slopes are computed and then selected without branches, so that the loops
+  // over the pixels get vectorized.
+  const float bottom_slope = clamp_simd((value - parameters[0]) * parameters[4]);
+  const float top_slope = clamp_simd(1.0f - (value - parameters[2]) * parameters[5]);
+  const float bottom = value < parameters[1] ? bottom_slope : 1.0f;
+  const float top = value <= parameters[2] ? 1.0f : (value < parameters[3] ? top_slope : 0.0f);
+  const float factor = bottom < top ? bottom : top;
   return invert_mask ? 1.0f - factor : factor; // inverted channel?
 }
 
@@ -237,6 +219,41 @@ static void _blendif_combine_channels(const float *const restrict pixels, float
   }
 }
 
+typedef void(_blendif_combine_func)(const float *const restrict pixels, float *const restrict mask,
+                                    const size_t stride, const unsigned int blendif,
+                                    const float *const restrict parameters,
+                                    const dt_iop_order_iccprofile_info_t *const restrict profile);
+
+#ifdef DT_HAVE_AVX_KERNELS
+// the same code built for wider vectors, all the channel functions are inlined into these
+__DT_TARGET_AVX2__ __attribute__((flatten))
+static void _blendif_combine_channels_avx2(const float *const restrict pixels, float *const restrict mask,
+                                           const size_t stride, const unsigned int blendif,
+                                           const float *const restrict parameters,
+                                           const dt_iop_order_iccprofile_info_t *const restrict profile)
+{
+  _blendif_combine_channels(pixels, mask, stride, blendif, parameters, profile);
+}
+
+__DT_TARGET_AVX512__ __attribute__((flatten))
+static void _blendif_combine_channels_avx512(const float *const restrict pixels, float *const restrict mask,
+                                             const size_t stride, const unsigned int blendif,
+                                             const float *const restrict parameters,
+                                             const dt_iop_order_iccprofile_info_t *const restrict profile)
+{
+  _blendif_combine_channels(pixels, mask, stride, blendif, parameters, profile);
+}
+#endif
+
+static _blendif_combine_func *_choose_combine_func(void)
+{
+#ifdef DT_HAVE_AVX_KERNELS
+  if(darktable.codepath.AVX512) return _blendif_combine_channels_avx512;
+  if(darktable.codepath.AVX2) return _blendif_combine_channels_avx2;
+#endif
+  return _blendif_combine_channels;
+}
+
 void dt_develop_blendif_rgb_hsl_make_mask(struct dt_dev_pixelpipe_iop_t *piece, const float *const restrict a,
                                           const float *const restrict b, const struct dt_iop_roi_t *const roi_in,
                                           const struct dt_iop_roi_t *const roi_out, float *const restrict mask)
@@ -297,6 +314,10 @@ void dt_develop_blendif_rgb_hsl_make_mask(struct dt_dev_pixelpipe_iop_t *piece,
     float parameters[DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_SIZE] DT_ALIGNED_ARRAY;
     dt_develop_blendif_process_parameters(parameters, d);
 
+    // skip the channels which select everything, and pick the widest kernel once for all rows
+    const unsigned int channels = dt_develop_blendif_active_channels(parameters, blendif);
+    _blendif_combine_func *const combine = _choose_combine_func();
+
     dt_iop_order_iccprofile_info_t blend_profile;
     const int use_profile = dt_develop_blendif_init_masking_profile(piece, &blend_profile,
                                                                     DEVELOP_BLEND_CS_RGB_DISPLAY);
@@ -312,7 +333,7 @@ void dt_develop_blendif_rgb_hsl_make_mask(struct dt_dev_pixelpipe_iop_t *piece,
 #ifdef _OPENMP
 #pragma omp parallel default(none) \
   dt_omp_firstprivate(temp_mask, mask, a, b, oheight, owidth, iwidth, yoffs, xoffs, buffsize, \
-                      blendif, profile, parameters, mask_inclusive, mask_inversed, global_opacity)
+                      channels, combine, profile, parameters, mask_inclusive, mask_inversed, global_opacity)
 #endif
     {
 #ifdef __SSE2__
@@ -334,7 +355,7 @@ void dt_develop_blendif_rgb_hsl_make_mask(struct dt_dev_pixelpipe_iop_t *piece,
       for(size_t y = 0; y < oheight; y++)
       {
         const size_t start = ((y + yoffs) * iwidth + xoffs) * DT_BLENDIF_RGB_CH;
-        _blendif_combine_channels(a + start, temp_mask + (y * owidth), owidth, blendif, parameters, profile);
+        combine(a + start, temp_mask + (y * owidth), owidth, channels, parameters, profile);
       }
 #ifdef _OPENMP
 #pragma omp for schedule(static)
@@ -342,9 +363,9 @@ void dt_develop_blendif_rgb_hsl_make_mask(struct dt_dev_pixelpipe_iop_t *piece,
       for(size_t y = 0; y < oheight; y++)
       {
         const size_t start = (y * owidth) * DT_BLENDIF_RGB_CH;
-        _blendif_combine_channels(b + start, temp_mask + (y * owidth), owidth, blendif >> DEVELOP_BLENDIF_GRAY_out,
-                                  parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_out,
-                                  profile);
+        combine(b + start, temp_mask + (y * owidth), owidth, channels >> DEVELOP_BLENDIF_GRAY_out,
+                parameters + DEVELOP_BLENDIF_PARAMETER_ITEMS * DEVELOP_BLENDIF_GRAY_out,
+                profile);
       }
 
       // apply global opacity
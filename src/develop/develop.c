@@ -1206,6 +1206,35 @@ void dt_dev_write_history(dt_develop_t *dev)
   dt_dev_write_history_ext(dev, dev->image_storage.id);
 }
 
+void dt_dev_history_pasted(const int32_t imgid)
+{
+  // work on the history as written, the same way the history is merged when pasting
+  dt_develop_t _dev = { 0 };
+  dt_develop_t *dev = &_dev;
+
+  dt_dev_init(dev, FALSE);
+  dev->iop = dt_iop_load_modules_ext(dev, TRUE);
+  dev->image_storage.id = imgid;
+
+  dt_dev_read_history_ext(dev, imgid, TRUE);
+  dt_dev_pop_history_items_ext(dev, dev->history_end);
+
+  gboolean changed = FALSE;
+  for(GList *modules = dev->iop; modules; modules = g_list_next(modules))
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
+    if(module->history_pasted && module->history_pasted(module))
+    {
+      dt_dev_add_history_item_ext(dev, module, FALSE, TRUE);
+      changed = TRUE;
+    }
+  }
+
+  if(changed) dt_dev_write_history_ext(dev, imgid);
+
+  dt_dev_cleanup(dev);
+}
+
 static int _dev_get_module_nb_records()
 {
   sqlite3_stmt *stmt;
@@ -344,6 +344,8 @@ void dt_dev_pop_history_items_ext(dt_develop_t *dev, int32_t cnt);
 void dt_dev_pop_history_items(dt_develop_t *dev, int32_t cnt);
 void dt_dev_write_history_ext(dt_develop_t *dev, const int imgid);
 void dt_dev_write_history(dt_develop_t *dev);
+// let the modules adapt the params of a history just pasted or styled to the image, see history_pasted()
+void dt_dev_history_pasted(const int32_t imgid);
 void dt_dev_read_history_ext(dt_develop_t *dev, const int imgid, gboolean no_image);
 void dt_dev_read_history(dt_develop_t *dev);
 void dt_dev_free_history_item(gpointer data);
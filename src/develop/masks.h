@@ -329,12 +329,70 @@ int dt_masks_get_area(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt
                       int *width, int *height, int *posx, int *posy);
 int dt_masks_get_source_area(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                              int *width, int *height, int *posx, int *posy);
+
+/** cache of rasterised shapes, shared by all pipes (develop/masks/cache.c) */
+typedef enum dt_masks_cache_state_t
+{
+  DT_MASKS_CACHE_MISS = 0,
+  DT_MASKS_CACHE_HIT = 1,  // the group is unchanged
+  DT_MASKS_CACHE_STALE = 2 // the group slot holds an older combination
+} dt_masks_cache_state_t;
+
+/** key of the form for the given module, upstream distortions and roi (NULL for dt_masks_get_mask). without
+ * content, the key of the slot of a group. to be freed with g_bytes_unref */
+GBytes *dt_masks_cache_key(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                           const dt_masks_form_t *const form, const dt_iop_roi_t *const roi,
+                           const gboolean content);
+/** fill buffer, zeroed by the caller, with the cached mask. returns FALSE on a miss */
+gboolean dt_masks_cache_get_roi(GBytes *key, const dt_iop_roi_t *const roi, float *const buffer);
+/** same for the rect part of the roi only, buffer being rect->width x rect->height */
+gboolean dt_masks_cache_get_rect(GBytes *key, const dt_iop_roi_t *const roi, const dt_iop_roi_t *const rect,
+                                 float *const buffer);
+/** the non-zero area of the cached mask */
+gboolean dt_masks_cache_get_bounds(GBytes *key, const dt_iop_roi_t *const roi, dt_iop_roi_t *const bounds);
+void dt_masks_cache_put_roi(GBytes *key, const dt_iop_roi_t *const roi, const float *const buffer);
+/** combination of a group stored in its slot, with the layout and member keys it was made from. on a stale
+ * slot, buffer gets the older combination and layout and members are referenced for the caller */
+dt_masks_cache_state_t dt_masks_cache_get_group(GBytes *slot, GBytes *key, const dt_iop_roi_t *const roi,
+                                                float *const buffer, GBytes **layout, GPtrArray **members);
+void dt_masks_cache_put_group(GBytes *slot, GBytes *key, const dt_iop_roi_t *const roi, const float *const buffer,
+                              GBytes *layout, GPtrArray *members);
+/** same for the output of dt_masks_get_mask. on a hit, *buffer is allocated and has to be freed with dt_free_align */
+gboolean dt_masks_cache_get_mask(GBytes *key, float **buffer, int *width, int *height, int *posx, int *posy);
+void dt_masks_cache_put_mask(GBytes *key, const float *const buffer, const int width, const int height,
+                             const int posx, const int posy);
+void dt_masks_cache_cleanup();
+
+/** rasterisation of path and brush shapes (develop/masks/raster.c), both only visit the tiles touched by the shape */
+/** draw the falloff band made of the count rays going from inner[i] (full opacity) to outer[i] (transparent),
+ * if closed the band also joins the last and first rays. payload holds the hardness and density of each ray, NULL
+ * means 0 and 1. the buffer is combined with max. */
+void dt_masks_draw_falloff(float *const buffer, const int width, const int height, const float *const inner,
+                           const float *const outer, const float *const payload, const int count,
+                           const gboolean closed);
+/** fill the closed polygon of count points with the even-odd rule and anti-aliased horizontal edges. the buffer
+ * has to be zero inside the polygon */
+void dt_masks_fill_polygon(float *const buffer, const int width, const int height, const float *const points,
+                           const int count);
+
 /** get the transparency mask of the form and his border */
 static inline int dt_masks_get_mask(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
                       dt_masks_form_t *const form,
                       float **buffer, int *width, int *height, int *posx, int *posy)
 {
-  return form->functions ? form->functions->get_mask(module, piece, form, buffer, width, height, posx, posy) : 0;
+  if(!form->functions) return 0;
+  if(form->type & DT_MASKS_GROUP)
+    return form->functions->get_mask(module, piece, form, buffer, width, height, posx, posy);
+
+  GBytes *key = dt_masks_cache_key(module, piece, form, NULL, TRUE);
+  int ok = dt_masks_cache_get_mask(key, buffer, width, height, posx, posy);
+  if(!ok)
+  {
+    ok = form->functions->get_mask(module, piece, form, buffer, width, height, posx, posy);
+    if(ok) dt_masks_cache_put_mask(key, *buffer, *width, *height, *posx, *posy);
+  }
+  g_bytes_unref(key);
+  return ok;
 }
 static inline int dt_masks_get_mask_roi(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
                           dt_masks_form_t *const form, const dt_iop_roi_t *roi, float *buffer)
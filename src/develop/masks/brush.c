@@ -2677,31 +2677,27 @@ static int _brush_get_area(const dt_iop_module_t *const module, const dt_dev_pix
   return _get_area(module, piece, form, width, height, posx, posy, 0);
 }
 
-/** we write a falloff segment */
-static void _brush_falloff(float *const restrict buffer, int p0[2], int p1[2], int posx, int posy, int bw,
-                           float hardness, float density)
+/** we fill the falloff between the brush line and its border, respecting limits of buffer */
+static void _brush_fill_falloff(float *const buffer, const int width, const int height, const float *const points,
+                                const float *const border, const float *const payload, const int first,
+                                const int border_count)
 {
-  // segment length
-  const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
-  const int solid = (int)l * hardness;
-  const int soft = l - solid;
-
-  const float lx = p1[0] - p0[0];
-  const float ly = p1[1] - p0[1];
-
-  for(int i = 0; i < l; i++)
-  {
-    // position
-    const int x = (int)((float)i * lx / (float)l) + p0[0] - posx;
-    const int y = (int)((float)i * ly / (float)l) + p0[1] - posy;
-    const float op = density * ((i <= solid) ? 1.0f : 1.0 - (float)(i - solid) / (float)soft);
-    buffer[y * bw + x] = MAX(buffer[y * bw + x], op);
-    if(x > 0)
-      buffer[y * bw + x - 1]
-          = MAX(buffer[y * bw + x - 1], op); // this one is to avoid gap due to int rounding
-    if(y > 0)
-      buffer[(y - 1) * bw + x]
-          = MAX(buffer[(y - 1) * bw + x], op); // this one is to avoid gap due to int rounding
+  // the border goes up one side of the stroke and down the other, it is a closed loop
+  dt_masks_draw_falloff(buffer, width, height, points + 2 * first, border + 2 * first, payload + 2 * first,
+                        border_count - first, TRUE);
+
+  // strokes thinner than a pixel may fall between the sampled pixels: keep their center line visible
+  for(int i = first; i < border_count; i++)
+  {
+    const float dx = border[i * 2] - points[i * 2];
+    const float dy = border[i * 2 + 1] - points[i * 2 + 1];
+    if(dx * dx + dy * dy >= 1.0f) continue;
+
+    const int x = floorf(points[i * 2] + 0.5f);
+    const int y = floorf(points[i * 2 + 1] + 0.5f);
+    if(x < 0 || x >= width || y < 0 || y >= height) continue;
+    float *buf = buffer + (size_t)y * width + x;
+    *buf = MAX(*buf, payload[i * 2 + 1]);
   }
 }
 
@@ -2751,18 +2747,15 @@ static int _brush_get_mask(const dt_iop_module_t *const module, const dt_dev_pix
     return 0;
   }
 
-  // now we fill the falloff
-  int p0[2], p1[2];
-
+  // we move the brush into the buffer and fill the falloff
   for(int i = nb_corner * 3; i < border_count; i++)
   {
-    p0[0] = points[i * 2];
-    p0[1] = points[i * 2 + 1];
-    p1[0] = border[i * 2];
-    p1[1] = border[i * 2 + 1];
-
-    _brush_falloff(*buffer, p0, p1, *posx, *posy, *width, payload[i * 2], payload[i * 2 + 1]);
+    points[i * 2] -= *posx;
+    points[i * 2 + 1] -= *posy;
+    border[i * 2] -= *posx;
+    border[i * 2 + 1] -= *posy;
   }
+  _brush_fill_falloff(*buffer, *width, *height, points, border, payload, nb_corner * 3, border_count);
 
   dt_free_align(points);
   dt_free_align(border);
@@ -2775,49 +2768,6 @@ static int _brush_get_mask(const dt_iop_module_t *const module, const dt_dev_pix
   return 1;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static inline void _brush_falloff_roi(float *buffer, const int *p0, const int *p1, int bw, int bh, float hardness,
-                                      float density)
-{
-  // segment length (increase by 1 to avoid division-by-zero special case handling)
-  const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
-  const int solid = hardness * l;
-
-  const float lx = (float)(p1[0] - p0[0]) / (float)l;
-  const float ly = (float)(p1[1] - p0[1]) / (float)l;
-
-  const int dx = lx <= 0 ? -1 : 1;
-  const int dy = ly <= 0 ? -1 : 1;
-  const int dpx = dx;
-  const int dpy = dy * bw;
-
-  float fx = p0[0];
-  float fy = p0[1];
-
-  float op = density;
-  const float dop = density / (float)(l - solid);
-
-  for(int i = 0; i < l; i++)
-  {
-    const int x = fx;
-    const int y = fy;
-
-    fx += lx;
-    fy += ly;
-    if(i > solid) op -= dop;
-
-    if(x < 0 || x >= bw || y < 0 || y >= bh) continue;
-
-    float *buf = buffer + (size_t)y * bw + x;
-
-    *buf = MAX(*buf, op);
-    if(x + dx >= 0 && x + dx < bw)
-      buf[dpx] = MAX(buf[dpx], op); // this one is to avoid gaps due to int rounding
-    if(y + dy >= 0 && y + dy < bh)
-      buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gaps due to int rounding
-  }
-}
-
 // build a stamp which can be combined with other shapes in the same group
 // prerequisite: 'buffer' is all zeros
 static int _brush_get_mask_roi(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
@@ -2894,26 +2844,7 @@ static int _brush_get_mask_roi(const dt_iop_module_t *const module, const dt_dev
   }
 
   // now we fill the falloff
-#ifdef _OPENMP
-#if !defined(__SUNOS__) && !defined(__NetBSD__)
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(nb_corner, border_count, width, height) \
-  shared(buffer, points, border, payload) schedule(static)
-#else
-#pragma omp parallel for shared(buffer)
-#endif
-#endif
-  for(int i = nb_corner * 3; i < border_count; i++)
-  {
-    const int p0[] = { points[i * 2], points[i * 2 + 1] };
-    const int p1[] = { border[i * 2], border[i * 2 + 1] };
-
-    if(MAX(p0[0], p1[0]) < 0 || MIN(p0[0], p1[0]) >= width || MAX(p0[1], p1[1]) < 0
-       || MIN(p0[1], p1[1]) >= height)
-      continue;
-
-    _brush_falloff_roi(buffer, p0, p1, width, height, payload[i * 2], payload[i * 2 + 1]);
-  }
+  _brush_fill_falloff(buffer, width, height, points, border, payload, nb_corner * 3, border_count);
 
   dt_free_align(points);
   dt_free_align(border);
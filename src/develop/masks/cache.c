@@ -0,0 +1,348 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2023 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "develop/imageop.h"
+#include "develop/masks.h"
+#include "develop/pixelpipe_hb.h"
+
+/*
+ * Rasterised shapes are kept around between pipe runs. Most pipe runs (any slider of any module) don't change
+ * the shapes, and redrawing tens of brush strokes for each of them is a large share of the pipe time.
+ *
+ * Entries are keyed on the geometry of the shape and on everything upstream that changes where it lands in
+ * the buffer: image, input size and scale, position of the module in the pipe, parameters of the enabled
+ * distorting modules before it, and the region of interest. The key holds all of these bytes and is compared
+ * in full on lookup, the hash only picks the bucket. Entries only hold the non-zero area of the mask, so that
+ * a brush stroke costs its bounding box and not the full ROI.
+ *
+ * Groups are stored in a slot keyed without their content, holding the last combination with the keys of the
+ * shapes it was made of. When one shape of the group is edited, the combination is only redone on the bounding
+ * boxes of its old and new versions, see _group_get_mask_roi().
+ *
+ * Least recently used entries are dropped beyond an eighth of the memory available to the pipes, see
+ * dt_get_available_mem().
+ */
+
+typedef struct _masks_cache_entry_t
+{
+  GBytes *key;
+  int x, y, width, height;   // area of the buffer we hold, the rest is zero
+  int buf_width, buf_height; // size of the whole buffer
+  int posx, posy;            // position of the buffer, for dt_masks_get_mask
+  float *data;
+  GBytes *content;           // for group slots: key of what was combined, its layout and member keys
+  GBytes *layout;
+  GPtrArray *members;
+  GList *link;               // in the lru queue
+} _masks_cache_entry_t;
+
+static struct
+{
+  GMutex lock;
+  GHashTable *entries;
+  GQueue lru;  // most recently used first
+  size_t used;
+} _cache = { .lru = G_QUEUE_INIT };
+
+static inline size_t _budget()
+{
+  return dt_get_available_mem() / 8;
+}
+
+static void _key_form(const dt_iop_module_t *const module, const dt_masks_form_t *const form, GByteArray *key)
+{
+  g_byte_array_append(key, (const guint8 *)&form->type, sizeof(form->type));
+  g_byte_array_append(key, (const guint8 *)&form->formid, sizeof(form->formid));
+  g_byte_array_append(key, (const guint8 *)&form->version, sizeof(form->version));
+  g_byte_array_append(key, (const guint8 *)form->source, sizeof(form->source));
+
+  for(const GList *points = form->points; points; points = g_list_next(points))
+  {
+    if(form->type & DT_MASKS_GROUP)
+    {
+      const dt_masks_point_group_t *grpt = (dt_masks_point_group_t *)points->data;
+      g_byte_array_append(key, (const guint8 *)&grpt->formid, sizeof(grpt->formid));
+      g_byte_array_append(key, (const guint8 *)&grpt->state, sizeof(grpt->state));
+      g_byte_array_append(key, (const guint8 *)&grpt->opacity, sizeof(grpt->opacity));
+      const dt_masks_form_t *sel = dt_masks_get_from_id(module->dev, grpt->formid);
+      if(sel) _key_form(module, sel, key);
+    }
+    else if(form->functions)
+      g_byte_array_append(key, (const guint8 *)points->data, form->functions->point_struct_size);
+  }
+}
+
+GBytes *dt_masks_cache_key(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                           const dt_masks_form_t *const form, const dt_iop_roi_t *const roi,
+                           const gboolean content)
+{
+  const dt_dev_pixelpipe_t *const pipe = piece->pipe;
+  GByteArray *key = g_byte_array_sized_new(256);
+  g_byte_array_append(key, (const guint8 *)&pipe->image.id, sizeof(pipe->image.id));
+  g_byte_array_append(key, (const guint8 *)&pipe->iwidth, sizeof(pipe->iwidth));
+  g_byte_array_append(key, (const guint8 *)&pipe->iheight, sizeof(pipe->iheight));
+  g_byte_array_append(key, (const guint8 *)&pipe->iscale, sizeof(pipe->iscale));
+  g_byte_array_append(key, (const guint8 *)&module->iop_order, sizeof(module->iop_order));
+
+  // shapes are drawn in input coordinates and distorted by all the modules before this one
+  for(const GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+  {
+    const dt_dev_pixelpipe_iop_t *const p = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    if(p->module == module) break;
+    if(p->enabled && (p->module->operation_tags() & IOP_TAG_DISTORT))
+      g_byte_array_append(key, (const guint8 *)&p->hash, sizeof(p->hash));
+  }
+
+  const dt_iop_roi_t none = { 0 };
+  g_byte_array_append(key, (const guint8 *)(roi ? roi : &none), sizeof(dt_iop_roi_t));
+
+  if(content)
+    _key_form(module, form, key);
+  else
+    g_byte_array_append(key, (const guint8 *)&form->formid, sizeof(form->formid));
+
+  return g_byte_array_free_to_bytes(key);
+}
+
+static void _entry_free(_masks_cache_entry_t *entry)
+{
+  g_bytes_unref(entry->key);
+  if(entry->content) g_bytes_unref(entry->content);
+  if(entry->layout) g_bytes_unref(entry->layout);
+  if(entry->members) g_ptr_array_unref(entry->members);
+  dt_free_align(entry->data);
+  free(entry);
+}
+
+// call with the lock held
+static void _evict(const size_t needed)
+{
+  const size_t budget = _budget();
+  while(_cache.used + needed > budget && !g_queue_is_empty(&_cache.lru))
+  {
+    _masks_cache_entry_t *entry = (_masks_cache_entry_t *)g_queue_pop_tail(&_cache.lru);
+    _cache.used -= sizeof(float) * entry->width * entry->height;
+    g_hash_table_remove(_cache.entries, entry->key);
+    _entry_free(entry);
+  }
+}
+
+// call with the lock held. the entry for key if it was rendered for a buffer of that size
+static _masks_cache_entry_t *_find(GBytes *key, const int buf_width, const int buf_height)
+{
+  _masks_cache_entry_t *entry = _cache.entries ? g_hash_table_lookup(_cache.entries, key) : NULL;
+  if(!entry || entry->buf_width != buf_width || entry->buf_height != buf_height) return NULL;
+  g_queue_unlink(&_cache.lru, entry->link);
+  g_queue_push_head_link(&_cache.lru, entry->link);
+  return entry;
+}
+
+// copy the part of the entry inside rect into out, a zeroed rect->width x rect->height buffer
+static void _copy_rect(const _masks_cache_entry_t *const entry, const dt_iop_roi_t *const rect, float *const out)
+{
+  const int x0 = MAX(entry->x, rect->x);
+  const int y0 = MAX(entry->y, rect->y);
+  const int x1 = MIN(entry->x + entry->width, rect->x + rect->width);
+  const int y1 = MIN(entry->y + entry->height, rect->y + rect->height);
+  for(int j = y0; j < y1; j++)
+    memcpy(out + (size_t)(j - rect->y) * rect->width + (x0 - rect->x),
+           entry->data + (size_t)(j - entry->y) * entry->width + (x0 - entry->x), sizeof(float) * (x1 - x0));
+}
+
+static _masks_cache_entry_t *_entry_new(GBytes *key, const float *const buffer, const int width,
+                                        const int height)
+{
+  // find the non-zero area of the mask
+  int x0 = width, x1 = -1, y0 = height, y1 = -1;
+  for(int j = 0; j < height; j++)
+  {
+    const float *row = buffer + (size_t)j * width;
+    int first = 0;
+    while(first < width && row[first] == 0.0f) first++;
+    if(first == width) continue;
+    int last = width - 1;
+    while(row[last] == 0.0f) last--;
+    x0 = MIN(x0, first);
+    x1 = MAX(x1, last);
+    y0 = MIN(y0, j);
+    y1 = j;
+  }
+  if(x1 < 0) x0 = y0 = x1 = y1 = 0; // empty mask: store a single zero pixel
+
+  const int cw = x1 - x0 + 1;
+  const int ch = y1 - y0 + 1;
+  if(sizeof(float) * cw * ch > _budget() / 4) return NULL;
+
+  _masks_cache_entry_t *entry = calloc(1, sizeof(_masks_cache_entry_t));
+  float *data = dt_alloc_align_float((size_t)cw * ch);
+  if(!entry || !data)
+  {
+    free(entry);
+    dt_free_align(data);
+    return NULL;
+  }
+  for(int j = 0; j < ch; j++)
+    memcpy(data + (size_t)j * cw, buffer + (size_t)(y0 + j) * width + x0, sizeof(float) * cw);
+
+  entry->key = g_bytes_ref(key);
+  entry->x = x0;
+  entry->y = y0;
+  entry->width = cw;
+  entry->height = ch;
+  entry->buf_width = width;
+  entry->buf_height = height;
+  entry->data = data;
+  return entry;
+}
+
+static void _insert(_masks_cache_entry_t *entry)
+{
+  const size_t size = sizeof(float) * entry->width * entry->height;
+
+  g_mutex_lock(&_cache.lock);
+  if(!_cache.entries) _cache.entries = g_hash_table_new(g_bytes_hash, g_bytes_equal);
+
+  // another pipe may have rendered the same shape meanwhile, or this is a group slot being updated
+  _masks_cache_entry_t *old = g_hash_table_lookup(_cache.entries, entry->key);
+  if(old)
+  {
+    g_queue_delete_link(&_cache.lru, old->link);
+    _cache.used -= sizeof(float) * old->width * old->height;
+    g_hash_table_remove(_cache.entries, old->key);
+    _entry_free(old);
+  }
+
+  _evict(size);
+  g_queue_push_head(&_cache.lru, entry);
+  entry->link = _cache.lru.head;
+  g_hash_table_insert(_cache.entries, entry->key, entry);
+  _cache.used += size;
+  g_mutex_unlock(&_cache.lock);
+}
+
+gboolean dt_masks_cache_get_roi(GBytes *key, const dt_iop_roi_t *const roi, float *const buffer)
+{
+  const dt_iop_roi_t rect = { 0, 0, roi->width, roi->height };
+  return dt_masks_cache_get_rect(key, roi, &rect, buffer);
+}
+
+gboolean dt_masks_cache_get_rect(GBytes *key, const dt_iop_roi_t *const roi, const dt_iop_roi_t *const rect,
+                                 float *const buffer)
+{
+  g_mutex_lock(&_cache.lock);
+  const _masks_cache_entry_t *entry = _find(key, roi->width, roi->height);
+  if(entry) _copy_rect(entry, rect, buffer);
+  g_mutex_unlock(&_cache.lock);
+  return entry != NULL;
+}
+
+gboolean dt_masks_cache_get_bounds(GBytes *key, const dt_iop_roi_t *const roi, dt_iop_roi_t *const bounds)
+{
+  g_mutex_lock(&_cache.lock);
+  const _masks_cache_entry_t *entry = _find(key, roi->width, roi->height);
+  if(entry) *bounds = (dt_iop_roi_t){ entry->x, entry->y, entry->width, entry->height, roi->scale };
+  g_mutex_unlock(&_cache.lock);
+  return entry != NULL;
+}
+
+void dt_masks_cache_put_roi(GBytes *key, const dt_iop_roi_t *const roi, const float *const buffer)
+{
+  _masks_cache_entry_t *entry = _entry_new(key, buffer, roi->width, roi->height);
+  if(entry) _insert(entry);
+}
+
+dt_masks_cache_state_t dt_masks_cache_get_group(GBytes *slot, GBytes *key, const dt_iop_roi_t *const roi,
+                                                float *const buffer, GBytes **layout, GPtrArray **members)
+{
+  dt_masks_cache_state_t state = DT_MASKS_CACHE_MISS;
+  g_mutex_lock(&_cache.lock);
+  const _masks_cache_entry_t *entry = _find(slot, roi->width, roi->height);
+  if(entry && entry->content)
+  {
+    const dt_iop_roi_t rect = { 0, 0, roi->width, roi->height };
+    _copy_rect(entry, &rect, buffer);
+    if(g_bytes_equal(entry->content, key))
+      state = DT_MASKS_CACHE_HIT;
+    else
+    {
+      *layout = g_bytes_ref(entry->layout);
+      *members = g_ptr_array_ref(entry->members);
+      state = DT_MASKS_CACHE_STALE;
+    }
+  }
+  g_mutex_unlock(&_cache.lock);
+  return state;
+}
+
+void dt_masks_cache_put_group(GBytes *slot, GBytes *key, const dt_iop_roi_t *const roi, const float *const buffer,
+                              GBytes *layout, GPtrArray *members)
+{
+  _masks_cache_entry_t *entry = _entry_new(slot, buffer, roi->width, roi->height);
+  if(!entry) return;
+  entry->content = g_bytes_ref(key);
+  entry->layout = g_bytes_ref(layout);
+  entry->members = g_ptr_array_ref(members);
+  _insert(entry);
+}
+
+gboolean dt_masks_cache_get_mask(GBytes *key, float **buffer, int *width, int *height, int *posx, int *posy)
+{
+  g_mutex_lock(&_cache.lock);
+  _masks_cache_entry_t *entry = _cache.entries ? g_hash_table_lookup(_cache.entries, key) : NULL;
+  float *buf = NULL;
+  if(entry && (buf = dt_calloc_align_float((size_t)entry->buf_width * entry->buf_height)))
+  {
+    const dt_iop_roi_t rect = { 0, 0, entry->buf_width, entry->buf_height };
+    _copy_rect(entry, &rect, buf);
+    g_queue_unlink(&_cache.lru, entry->link);
+    g_queue_push_head_link(&_cache.lru, entry->link);
+    *buffer = buf;
+    *width = entry->buf_width;
+    *height = entry->buf_height;
+    *posx = entry->posx;
+    *posy = entry->posy;
+  }
+  g_mutex_unlock(&_cache.lock);
+  return buf != NULL;
+}
+
+void dt_masks_cache_put_mask(GBytes *key, const float *const buffer, const int width, const int height,
+                             const int posx, const int posy)
+{
+  _masks_cache_entry_t *entry = _entry_new(key, buffer, width, height);
+  if(!entry) return;
+  entry->posx = posx;
+  entry->posy = posy;
+  _insert(entry);
+}
+
+void dt_masks_cache_cleanup()
+{
+  g_mutex_lock(&_cache.lock);
+  _masks_cache_entry_t *entry;
+  while((entry = (_masks_cache_entry_t *)g_queue_pop_head(&_cache.lru))) _entry_free(entry);
+  if(_cache.entries) g_hash_table_destroy(_cache.entries);
+  _cache.entries = NULL;
+  _cache.used = 0;
+  g_mutex_unlock(&_cache.lock);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
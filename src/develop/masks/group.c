@@ -579,6 +579,67 @@ static void _combine_masks_exclusion(float *const restrict dest, float *const re
   }
 }
 
+// fill out, a zeroed rect->width x rect->height buffer, with the part of the shape sel inside rect. bufs is a
+// scratch buffer of the size of the roi to draw the shape in when it isn't cached, it can be out itself when
+// rect is the whole roi. nested groups are not looked up here (key is NULL), they are cached by their own call
+static int _group_member_rect(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                              dt_masks_form_t *const sel, GBytes *key, const dt_iop_roi_t *const roi,
+                              const dt_iop_roi_t *const rect, float *const bufs, float *const out)
+{
+  if(key && dt_masks_cache_get_rect(key, roi, rect, out)) return 1;
+
+  memset(bufs, 0, sizeof(float) * roi->width * roi->height);
+  if(!dt_masks_get_mask_roi(module, piece, sel, roi, bufs)) return 0;
+  if(key) dt_masks_cache_put_roi(key, roi, bufs);
+
+  if(out != bufs)
+    for(int j = 0; j < rect->height; j++)
+      memcpy(out + (size_t)j * rect->width, bufs + (size_t)(rect->y + j) * roi->width + rect->x,
+             sizeof(float) * rect->width);
+  return 1;
+}
+
+// the group was combined before with old_members: find the rectangle of the roi where the combination can have
+// changed, that is the old and new areas of the shapes that were edited. returns FALSE if it has to be done
+// again on the whole roi.
+static gboolean _group_changed_rect(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
+                                    dt_masks_form_t *const form, const dt_iop_roi_t *const roi,
+                                    GPtrArray *members, GPtrArray *old_members, float *const bufs,
+                                    dt_iop_roi_t *const rect)
+{
+  int x0 = roi->width, y0 = roi->height, x1 = 0, y1 = 0;
+  int k = 0;
+  for(GList *fpts = form->points; fpts; fpts = g_list_next(fpts), k++)
+  {
+    GBytes *key = g_ptr_array_index(members, k);
+    GBytes *old = g_ptr_array_index(old_members, k);
+    if(g_bytes_equal(key, old)) continue;
+
+    // an inverted shape is non-zero everywhere, and nested groups have no area of their own
+    const dt_masks_point_group_t *fpt = (dt_masks_point_group_t *)fpts->data;
+    dt_masks_form_t *sel = dt_masks_get_from_id(module->dev, fpt->formid);
+    if(!sel || (sel->type & DT_MASKS_GROUP) || (fpt->state & DT_MASKS_STATE_INVERSE)) return FALSE;
+
+    dt_iop_roi_t before, after;
+    if(!dt_masks_cache_get_bounds(old, roi, &before)) return FALSE;
+    if(!dt_masks_cache_get_bounds(key, roi, &after))
+    {
+      // draw the edited shape now, the combination picks it up from the cache
+      const dt_iop_roi_t whole = { 0, 0, roi->width, roi->height, roi->scale };
+      if(!_group_member_rect(module, piece, sel, key, roi, &whole, bufs, bufs)
+         || !dt_masks_cache_get_bounds(key, roi, &after))
+        return FALSE;
+    }
+    x0 = MIN(x0, MIN(before.x, after.x));
+    y0 = MIN(y0, MIN(before.y, after.y));
+    x1 = MAX(x1, MAX(before.x + before.width, after.x + after.width));
+    y1 = MAX(y1, MAX(before.y + before.height, after.y + after.height));
+  }
+
+  *rect = (dt_iop_roi_t){ x0, y0, MAX(x1 - x0, 0), MAX(y1 - y0, 0), roi->scale };
+  return TRUE;
+}
+
 static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
                                const dt_dev_pixelpipe_iop_t *const restrict piece,
                                dt_masks_form_t *const form, const dt_iop_roi_t *const roi,
@@ -592,21 +653,85 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
   const int height = roi->height;
   const size_t npixels = (size_t)width * height;
 
+  // how the shapes are combined, and the keys of the shapes
+  GByteArray *layout_bytes = g_byte_array_new();
+  GPtrArray *members = g_ptr_array_new_with_free_func((GDestroyNotify)g_bytes_unref);
+  for(GList *fpts = form->points; fpts; fpts = g_list_next(fpts))
+  {
+    const dt_masks_point_group_t *fpt = (dt_masks_point_group_t *)fpts->data;
+    const dt_masks_form_t *sel = dt_masks_get_from_id(module->dev, fpt->formid);
+    g_byte_array_append(layout_bytes, (const guint8 *)&fpt->formid, sizeof(fpt->formid));
+    g_byte_array_append(layout_bytes, (const guint8 *)&fpt->state, sizeof(fpt->state));
+    g_byte_array_append(layout_bytes, (const guint8 *)&fpt->opacity, sizeof(fpt->opacity));
+    g_ptr_array_add(members, sel ? dt_masks_cache_key(module, piece, sel, roi, TRUE) : g_bytes_new(NULL, 0));
+  }
+  GBytes *layout = g_byte_array_free_to_bytes(layout_bytes);
+  GBytes *slot = dt_masks_cache_key(module, piece, form, roi, FALSE);
+  GBytes *key = dt_masks_cache_key(module, piece, form, roi, TRUE);
+
+  // nothing changed in the group since the last run: reuse the whole combination. if only some shapes were
+  // edited, the buffer gets the last combination and we only redo it where they are
+  GBytes *old_layout = NULL;
+  GPtrArray *old_members = NULL;
+  const dt_masks_cache_state_t cached
+      = dt_masks_cache_get_group(slot, key, roi, buffer, &old_layout, &old_members);
+
+  float *restrict bufs = NULL;
+  float *restrict rbuf = NULL;
+  float *restrict rres = NULL;
+  gboolean partial = FALSE;
+  if(cached == DT_MASKS_CACHE_HIT)
+  {
+    nb_ok = 1;
+    goto end;
+  }
+
   // we need to allocate a zeroed temporary buffer for intermediate creation of individual shapes
-  float *const restrict bufs = dt_alloc_align_float(npixels);
-  if(bufs == NULL) return 0;
+  bufs = dt_alloc_align_float(npixels);
+  if(bufs == NULL) goto end;
+
+  dt_iop_roi_t rect = { 0, 0, width, height, roi->scale };
+  partial = cached == DT_MASKS_CACHE_STALE && g_bytes_equal(layout, old_layout)
+            && _group_changed_rect(module, piece, form, roi, members, old_members, bufs, &rect);
+  if(!partial && cached == DT_MASKS_CACHE_STALE) memset(buffer, 0, sizeof(float) * npixels);
+
+  const size_t rpixels = (size_t)rect.width * rect.height;
+  if(partial && rpixels == 0)
+  {
+    // nothing to combine again, the last combination holds
+    nb_ok = 1;
+  }
+  else if(partial)
+  {
+    rbuf = dt_alloc_align_float(rpixels);
+    rres = dt_calloc_align_float(rpixels);
+    if(!rbuf || !rres) goto end;
+  }
+  else
+  {
+    rbuf = bufs;
+    rres = buffer;
+  }
+
+  if(darktable.unmuted & DT_DEBUG_PERF)
+    dt_print(DT_DEBUG_MASKS, "[masks] combining group %d on %dx%d of %dx%d\n", form->formid, rect.width,
+             rect.height, width, height);
 
   // and we get all masks
-  for(GList *fpts = form->points; fpts; fpts = g_list_next(fpts))
+  int k = 0;
+  for(GList *fpts = form->points; fpts && rpixels; fpts = g_list_next(fpts), k++)
   {
     dt_masks_point_group_t *fpt = (dt_masks_point_group_t *)fpts->data;
     dt_masks_form_t *sel = dt_masks_get_from_id(module->dev, fpt->formid);
 
     if(sel)
     {
-      // ensure that we start with a zeroed buffer regardless of what was previously written into 'bufs'
-      memset(bufs, 0, npixels*sizeof(float));
-      const int ok = dt_masks_get_mask_roi(module, piece, sel, roi, bufs);
+      // ensure that we start with a zeroed buffer regardless of what was previously written into 'rbuf'
+      memset(rbuf, 0, rpixels * sizeof(float));
+
+      // only the shapes which changed are drawn again
+      GBytes *sel_key = (sel->type & DT_MASKS_GROUP) ? NULL : g_ptr_array_index(members, k);
+      const int ok = _group_member_rect(module, piece, sel, sel_key, roi, &rect, bufs, rbuf);
       const float op = fpt->opacity;
       const int state = fpt->state;
 
@@ -617,34 +742,34 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
 
         if(state & DT_MASKS_STATE_UNION)
         {
-          _combine_masks_union(buffer, bufs, npixels, op, inverted);
+          _combine_masks_union(rres, rbuf, rpixels, op, inverted);
         }
         else if(state & DT_MASKS_STATE_INTERSECTION)
         {
-          _combine_masks_intersect(buffer, bufs, npixels, op, inverted);
+          _combine_masks_intersect(rres, rbuf, rpixels, op, inverted);
         }
         else if(state & DT_MASKS_STATE_DIFFERENCE)
         {
-          _combine_masks_difference(buffer, bufs, npixels, op, inverted);
+          _combine_masks_difference(rres, rbuf, rpixels, op, inverted);
         }
         else if(state & DT_MASKS_STATE_EXCLUSION)
         {
-          _combine_masks_exclusion(buffer, bufs, npixels, op, inverted);
+          _combine_masks_exclusion(rres, rbuf, rpixels, op, inverted);
         }
         else // if we are here, this mean that we just have to copy the shape and null other parts
         {
 #ifdef _OPENMP
 #if !defined(__SUNOS__) && !defined(__NetBSD__)
 #pragma omp parallel for simd default(none) \
-          dt_omp_firstprivate(npixels, op, inverted) \
-          dt_omp_sharedconst(buffer, bufs) schedule(simd:static) aligned(buffer, bufs : 64)
+          dt_omp_firstprivate(rpixels, op, inverted) \
+          dt_omp_sharedconst(rres, rbuf) schedule(simd:static) aligned(rres, rbuf : 64)
 #else
-#pragma omp parallel for shared(bufs, buffer)
+#pragma omp parallel for shared(rbuf, rres)
 #endif
 #endif
-          for(int index = 0; index < npixels; index++)
+          for(int index = 0; index < rpixels; index++)
           {
-            buffer[index] = op * (inverted ? (1.0f - bufs[index]) : bufs[index]);
+            rres[index] = op * (inverted ? (1.0f - rbuf[index]) : rbuf[index]);
           }
         }
 
@@ -656,9 +781,28 @@ static int _group_get_mask_roi(const dt_iop_module_t *const restrict module,
       }
     }
   }
-  // and we free the intermediate buffer
-  dt_free_align(bufs);
 
+  if(partial && rpixels)
+    for(int j = 0; j < rect.height; j++)
+      memcpy(buffer + (size_t)(rect.y + j) * width + rect.x, rres + (size_t)j * rect.width,
+             sizeof(float) * rect.width);
+
+  if(nb_ok) dt_masks_cache_put_group(slot, key, roi, buffer, layout, members);
+
+end:
+  // and we free the intermediate buffers
+  if(partial)
+  {
+    dt_free_align(rbuf);
+    dt_free_align(rres);
+  }
+  dt_free_align(bufs);
+  if(old_layout) g_bytes_unref(old_layout);
+  if(old_members) g_ptr_array_unref(old_members);
+  g_ptr_array_unref(members);
+  g_bytes_unref(layout);
+  g_bytes_unref(slot);
+  g_bytes_unref(key);
   return nb_ok != 0;
 }
 
@@ -668,6 +812,8 @@ int dt_masks_group_render_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *p
   const double start = dt_get_wtime();
   if(!form) return 0;
 
+  // shapes are combined into the buffer, and cached results only hold their non-zero area
+  memset(buffer, 0, sizeof(float) * roi->width * roi->height);
   const int ok = dt_masks_get_mask_roi(module, piece, form, roi, buffer);
 
   if(darktable.unmuted & DT_DEBUG_PERF)
@@ -2334,28 +2334,81 @@ static int _path_get_area(const dt_iop_module_t *const module, const dt_dev_pixe
   return _get_area(module, piece, form, width, height, posx, posy, FALSE);
 }
 
-/** we write a falloff segment */
-/*static*/ void _path_falloff(float *const restrict buffer, int *p0, int *p1, int posx, int posy, int bw)
+// move the path and border points into the buffer coordinates
+static void _path_to_buffer(float *const points, const int points_count, float *const border, const int border_count,
+                            const int nb_corner, const float scale, const int px, const int py)
 {
-  // segment length
-  int l = sqrtf(sqf(p1[0] - p0[0]) + sqf(p1[1] - p0[1])) + 1;
+  for(int i = nb_corner * 3; i < border_count; i++)
+  {
+    const float xx = border[2 * i];
+    const float yy = border[2 * i + 1];
+    if(isnan(xx))
+    {
+      if(isnan(yy)) break; // that means we have to skip the end of the border path
+      i = yy - 1;
+      continue;
+    }
+    border[2 * i] = xx * scale - px;
+    border[2 * i + 1] = yy * scale - py;
+  }
+  for(int i = nb_corner * 3; i < points_count; i++)
+  {
+    points[2 * i] = points[2 * i] * scale - px;
+    points[2 * i + 1] = points[2 * i + 1] * scale - py;
+  }
+}
 
-  const float lx = p1[0] - p0[0];
-  const float ly = p1[1] - p0[1];
+// draw the falloff of the path, from each point of the path to its border point. where the border has been cut
+// because of self-intersections, the points of the path fall back to the border point we jump to.
+static int _path_draw_falloff(float *const buffer, const int width, const int height, const float *const points,
+                              const int points_count, const float *const border, const int border_count,
+                              const int nb_corner)
+{
+  // with less than 3 nodes the border isn't computed, there is no band to draw
+  if(nb_corner < 3) return 1;
+
+  // the band goes around the path only if there is a border point for each point of the path
+  const gboolean closed = border_count == points_count;
+  const int nrays = MIN(border_count, points_count) - nb_corner * 3;
+  if(nrays < 2) return 1;
+
+  float *const outer = dt_alloc_align_float((size_t)2 * nrays);
+  if(outer == NULL) return 0;
 
-  for(int i = 0; i < l; i++)
+  int next = 0;
+  for(int i = nb_corner * 3; i < nb_corner * 3 + nrays; i++)
   {
-    // position
-    const int x = (int)((float)i * lx / (float)l) + p0[0] - posx;
-    const int y = (int)((float)i * ly / (float)l) + p0[1] - posy;
-    const float op = 1.0 - (float)i / (float)l;
-    size_t idx = y * bw + x;
-    buffer[idx] = fmaxf(buffer[idx], op);
-    if(x > 0)
-      buffer[idx - 1] = fmaxf(buffer[idx - 1], op); // this one is to avoid gap due to int rounding
-    if(y > 0)
-      buffer[idx - bw] = fmaxf(buffer[idx - bw], op); // this one is to avoid gap due to int rounding
+    float pf1[2];
+    if(next > 0)
+    {
+      pf1[0] = border[next * 2];
+      pf1[1] = border[next * 2 + 1];
+    }
+    else
+    {
+      pf1[0] = border[i * 2];
+      pf1[1] = border[i * 2 + 1];
+    }
+
+    // now we check p1 value to know if we have to skip a part
+    if(next == i) next = 0;
+    while(isnan(pf1[0]))
+    {
+      if(isnan(pf1[1]))
+        next = i - 1;
+      else
+        next = pf1[1];
+      pf1[0] = border[next * 2];
+      pf1[1] = border[next * 2 + 1];
+    }
+
+    outer[2 * (i - nb_corner * 3)] = pf1[0];
+    outer[2 * (i - nb_corner * 3) + 1] = pf1[1];
   }
+
+  dt_masks_draw_falloff(buffer, width, height, points + 2 * nb_corner * 3, outer, NULL, nrays, closed);
+  dt_free_align(outer);
+  return 1;
 }
 
 static int _path_get_mask(const dt_iop_module_t *const module, const dt_dev_pixelpipe_iop_t *const piece,
@@ -2390,9 +2443,6 @@ static int _path_get_mask(const dt_iop_module_t *const module, const dt_dev_pixe
   const guint nb_corner = g_list_length(form->points);
   _path_bounding_box(points, border, nb_corner, points_count, border_count, width, height, posx, posy);
 
-  const int hb = *height;
-  const int wb = *width;
-
   if(darktable.unmuted & DT_DEBUG_PERF)
   {
     dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill min max took %0.04f sec\n", form->name,
@@ -2403,7 +2453,7 @@ static int _path_get_mask(const dt_iop_module_t *const module, const dt_dev_pixe
   // we allocate the buffer
   const size_t bufsize = (size_t)(*width) * (*height);
   // ensure that the buffer is zeroed, as the following code only actually sets the path+falloff pixels
-  float *const restrict bufptr = *buffer = dt_calloc_align_float(bufsize);
+  *buffer = dt_calloc_align_float(bufsize);
   if(*buffer == NULL)
   {
     dt_free_align(points);
@@ -2411,129 +2461,9 @@ static int _path_get_mask(const dt_iop_module_t *const module, const dt_dev_pixe
     return 0;
   }
 
-  // we write all the point around the path into the buffer
-  const int nbp = border_count;
-  if(nbp > 2)
-  {
-    int lastx = (int)points[(nbp - 1) * 2];
-    int lasty = (int)points[(nbp - 1) * 2 + 1];
-    int lasty2 = (int)points[(nbp - 2) * 2 + 1];
-
-    int just_change_dir = 0;
-    for(int ii = nb_corner * 3; ii < 2 * nbp - nb_corner * 3; ii++)
-    {
-      // we are writing more than 1 loop in the case the dir in y change
-      // exactly at start/end point
-      int i = ii;
-      if(ii >= nbp) i = (ii - nb_corner * 3) % (nbp - nb_corner * 3) + nb_corner * 3;
-      const int xx = (int)points[i * 2];
-      const int yy = (int)points[i * 2 + 1];
-
-      // we don't store the point if it has the same y value as the last one
-      if(yy == lasty) continue;
-
-      // we want to be sure that there is no y jump
-      if(yy - lasty > 1 || yy - lasty < -1)
-      {
-        if(yy < lasty)
-        {
-          for(int j = yy + 1; j < lasty; j++)
-          {
-            const int nx = (j - yy) * (lastx - xx) / (float)(lasty - yy) + xx;
-            const size_t idx = (size_t)(j - (*posy)) * (*width) + nx - (*posx);
-            assert(idx < bufsize);
-            bufptr[idx] = 1.0f;
-          }
-          lasty2 = yy + 2;
-          lasty = yy + 1;
-        }
-        else
-        {
-          for(int j = lasty + 1; j < yy; j++)
-          {
-            const int nx = (j - lasty) * (xx - lastx) / (float)(yy - lasty) + lastx;
-            const size_t idx = (size_t)(j - (*posy)) * (*width) + nx - (*posx);
-            assert(idx < bufsize);
-            bufptr[idx] = 1.0f;
-          }
-          lasty2 = yy - 2;
-          lasty = yy - 1;
-        }
-      }
-      // if we change the direction of the path (in y), then we add a extra point
-      if((lasty - lasty2) * (lasty - yy) > 0)
-      {
-        const size_t idx = (size_t)(lasty - (*posy)) * (*width) + lastx + 1 - (*posx);
-        assert(idx < bufsize);
-        bufptr[idx] = 1.0f;
-        just_change_dir = 1;
-      }
-      // we add the point
-      if(just_change_dir && ii == i)
-      {
-        // if we have changed the direction, we have to be careful that point can be at the same place
-        // as the previous one, especially on sharp edges
-        const size_t idx = (size_t)(yy - (*posy)) * (*width) + xx - (*posx);
-        assert(idx < bufsize);
-        float v = bufptr[idx];
-        if(v > 0.0)
-        {
-          if(xx - (*posx) > 0)
-          {
-            const size_t idx_ = (size_t)(yy - (*posy)) * (*width) + xx - 1 - (*posx);
-            assert(idx_ < bufsize);
-            bufptr[idx_] = 1.0f;
-          }
-          else if(xx - (*posx) < (*width) - 1)
-          {
-            const size_t idx_ = (size_t)(yy - (*posy)) * (*width) + xx + 1 - (*posx);
-            assert(idx_ < bufsize);
-            bufptr[idx_] = 1.0f;
-          }
-        }
-        else
-        {
-          const size_t idx_ = (size_t)(yy - (*posy)) * (*width) + xx - (*posx);
-          assert(idx_ < bufsize);
-          bufptr[idx_] = 1.0f;
-          just_change_dir = 0;
-        }
-      }
-      else
-      {
-        const size_t idx_ = (size_t)(yy - (*posy)) * (*width) + xx - (*posx);
-        assert(idx_ < bufsize);
-        bufptr[idx_] = 1.0f;
-      }
-      // we change last values
-      lasty2 = lasty;
-      lasty = yy;
-      lastx = xx;
-      if(ii != i) break;
-    }
-  }
-  if(darktable.unmuted & DT_DEBUG_PERF)
-  {
-    dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill draw path took %0.04f sec\n", form->name,
-             dt_get_wtime() - start2);
-    start2 = dt_get_wtime();
-  }
-
-#ifdef _OPENMP
-#pragma omp parallel for \
-  dt_omp_firstprivate(hb, wb, bufptr) \
-  schedule(static)
-#endif
-  for(int yy = 0; yy < hb; yy++)
-  {
-    int state = 0;
-    for(int xx = 0; xx < wb; xx++)
-    {
-      const float v = bufptr[yy * wb + xx];
-      if(v == 1.0f) state = !state;
-      if(state) bufptr[yy * wb + xx] = 1.0f;
-    }
-  }
+  // same rasterisation as _path_get_mask_roi(), in the coordinates of the bounding box
+  _path_to_buffer(points, points_count, border, border_count, nb_corner, 1.0f, *posx, *posy);
+  dt_masks_fill_polygon(*buffer, *width, *height, points + 2 * nb_corner * 3, points_count - nb_corner * 3);
 
   if(darktable.unmuted & DT_DEBUG_PERF)
   {
@@ -2542,41 +2472,11 @@ static int _path_get_mask(const dt_iop_module_t *const module, const dt_dev_pixe
     start2 = dt_get_wtime();
   }
 
-  // now we fill the falloff
-  int p0[2] = { 0 }, p1[2] = { 0 };
-  float pf1[2] = { 0.0f };
-  int last0[2] = { -100, -100 }, last1[2] = { -100, -100 };
-  int next = 0;
-  for(int i = nb_corner * 3; i < border_count; i++)
+  const int res = _path_draw_falloff(*buffer, *width, *height, points, points_count, border, border_count, nb_corner);
+  if(!res)
   {
-    p0[0] = points[i * 2];
-    p0[1] = points[i * 2 + 1];
-    if(next > 0)
-      p1[0] = pf1[0] = border[next * 2], p1[1] = pf1[1] = border[next * 2 + 1];
-    else
-      p1[0] = pf1[0] = border[i * 2], p1[1] = pf1[1] = border[i * 2 + 1];
-
-    // now we check p1 value to know if we have to skip a part
-    if(next == i) next = 0;
-    while(isnan(pf1[0]))
-    {
-      if(isnan(pf1[1]))
-        next = i - 1;
-      else
-        next = p1[1];
-      p1[0] = pf1[0] = border[next * 2];
-      p1[1] = pf1[1] = border[next * 2 + 1];
-    }
-
-    // and we draw the falloff
-    if(last0[0] != p0[0] || last0[1] != p0[1] || last1[0] != p1[0] || last1[1] != p1[1])
-    {
-      _path_falloff(bufptr, p0, p1, *posx, *posy, *width);
-      last0[0] = p0[0];
-      last0[1] = p0[1];
-      last1[0] = p1[0];
-      last1[1] = p1[1];
-    }
+    dt_free_align(*buffer);
+    *buffer = NULL;
   }
 
   if(darktable.unmuted & DT_DEBUG_PERF)
@@ -2590,180 +2490,9 @@ static int _path_get_mask(const dt_iop_module_t *const module, const dt_dev_pixe
     dt_print(DT_DEBUG_MASKS, "[masks %s] path fill buffer took %0.04f sec\n", form->name,
              dt_get_wtime() - start);
 
-  return 1;
-}
-
-
-/** crop path to roi given by xmin, xmax, ymin, ymax. path segments outside of roi are replaced by
-    nodes lying on roi borders. */
-static int _path_crop_to_roi(float *path, const int point_count, float xmin, float xmax, float ymin,
-                             float ymax)
-{
-  int point_start = -1;
-  int l = -1, r = -1;
-
-
-  // first try to find a node clearly inside roi
-  for(int k = 0; k < point_count; k++)
-  {
-    float x = path[2 * k];
-    float y = path[2 * k + 1];
-
-    if(x >= xmin + 1 && y >= ymin + 1
-       && x <= xmax - 1 && y <= ymax - 1)
-    {
-      point_start = k;
-      break;
-    }
-  }
-
-  // printf("crop to xmin %f, xmax %f, ymin %f, ymax %f - start %d (%f, %f)\n", xmin, xmax, ymin, ymax,
-  // point_start, path[2*point_start], path[2*point_start+1]);
-
-  if(point_start < 0) return 0; // no point means roi lies completely within path
-
-  // find the crossing points with xmin and replace segment by nodes on border
-  for(int k = 0; k < point_count; k++)
-  {
-    const int kk = (k + point_start) % point_count;
-
-    if(l < 0 && path[2 * kk] < xmin) l = k;       // where we leave roi
-    if(l >= 0 && path[2 * kk] >= xmin) r = k - 1; // where we re-enter roi
-
-    // replace that segment
-    if(l >= 0 && r >= 0)
-    {
-      const int count = r - l + 1;
-      const int ll = (l - 1 + point_start) % point_count;
-      const int rr = (r + 1 + point_start) % point_count;
-      const float delta_y = (count == 1) ? 0 : (path[2 * rr + 1] - path[2 * ll + 1]) / (count - 1);
-      const float start_y = path[2 * ll + 1];
-
-      for(int n = 0; n < count; n++)
-      {
-        const int nn = (n + l + point_start) % point_count;
-        path[2 * nn] = xmin;
-        path[2 * nn + 1] = start_y + n * delta_y;
-      }
-
-      l = r = -1;
-    }
-  }
-
-  // find the crossing points with xmax and replace segment by nodes on border
-  for(int k = 0; k < point_count; k++)
-  {
-    const int kk = (k + point_start) % point_count;
-
-    if(l < 0 && path[2 * kk] > xmax) l = k;       // where we leave roi
-    if(l >= 0 && path[2 * kk] <= xmax) r = k - 1; // where we re-enter roi
-
-    // replace that segment
-    if(l >= 0 && r >= 0)
-    {
-      const int count = r - l + 1;
-      const int ll = (l - 1 + point_start) % point_count;
-      const int rr = (r + 1 + point_start) % point_count;
-      const float delta_y = (count == 1) ? 0 : (path[2 * rr + 1] - path[2 * ll + 1]) / (count - 1);
-      const float start_y = path[2 * ll + 1];
-
-      for(int n = 0; n < count; n++)
-      {
-        const int nn = (n + l + point_start) % point_count;
-        path[2 * nn] = xmax;
-        path[2 * nn + 1] = start_y + n * delta_y;
-      }
-
-      l = r = -1;
-    }
-  }
-
-  // find the crossing points with ymin and replace segment by nodes on border
-  for(int k = 0; k < point_count; k++)
-  {
-    const int kk = (k + point_start) % point_count;
-
-    if(l < 0 && path[2 * kk + 1] < ymin) l = k;       // where we leave roi
-    if(l >= 0 && path[2 * kk + 1] >= ymin) r = k - 1; // where we re-enter roi
-
-    // replace that segment
-    if(l >= 0 && r >= 0)
-    {
-      const int count = r - l + 1;
-      const int ll = (l - 1 + point_start) % point_count;
-      const int rr = (r + 1 + point_start) % point_count;
-      const float delta_x = (count == 1) ? 0 : (path[2 * rr] - path[2 * ll]) / (count - 1);
-      const float start_x = path[2 * ll];
-
-      for(int n = 0; n < count; n++)
-      {
-        const int nn = (n + l + point_start) % point_count;
-        path[2 * nn] = start_x + n * delta_x;
-        path[2 * nn + 1] = ymin;
-      }
-
-      l = r = -1;
-    }
-  }
-
-  // find the crossing points with ymax and replace segment by nodes on border
-  for(int k = 0; k < point_count; k++)
-  {
-    const int kk = (k + point_start) % point_count;
-
-    if(l < 0 && path[2 * kk + 1] > ymax) l = k;       // where we leave roi
-    if(l >= 0 && path[2 * kk + 1] <= ymax) r = k - 1; // where we re-enter roi
-
-    // replace that segment
-    if(l >= 0 && r >= 0)
-    {
-      const int count = r - l + 1;
-      const int ll = (l - 1 + point_start) % point_count;
-      const int rr = (r + 1 + point_start) % point_count;
-      const float delta_x = (count == 1) ? 0 : (path[2 * rr] - path[2 * ll]) / (count - 1);
-      const float start_x = path[2 * ll];
-
-      for(int n = 0; n < count; n++)
-      {
-        const int nn = (n + l + point_start) % point_count;
-        path[2 * nn] = start_x + n * delta_x;
-        path[2 * nn + 1] = ymax;
-      }
-
-      l = r = -1;
-    }
-  }
-  return 1;
+  return res;
 }
 
-/** we write a falloff segment respecting limits of buffer */
-static void _path_falloff_roi(float *buffer, int *p0, int *p1, int bw, int bh)
-{
-  // segment length
-  const int l = sqrt((p1[0] - p0[0]) * (p1[0] - p0[0]) + (p1[1] - p0[1]) * (p1[1] - p0[1])) + 1;
-
-  const float lx = p1[0] - p0[0];
-  const float ly = p1[1] - p0[1];
-
-  const int dx = lx < 0 ? -1 : 1;
-  const int dy = ly < 0 ? -1 : 1;
-  const int dpy = dy * bw;
-
-  for(int i = 0; i < l; i++)
-  {
-    // position
-    const int x = (int)((float)i * lx / (float)l) + p0[0];
-    const int y = (int)((float)i * ly / (float)l) + p0[1];
-    const float op = 1.0f - (float)i / (float)l;
-    float *buf = buffer + (size_t)y * bw + x;
-    if(x >= 0 && x < bw && y >= 0 && y < bh)
-      buf[0] = MAX(buf[0], op);
-    if(x + dx >= 0 && x + dx < bw && y >= 0 && y < bh)
-      buf[dx] = MAX(buf[dx], op); // this one is to avoid gap due to int rounding
-    if(x >= 0 && x < bw && y + dy >= 0 && y + dy < bh)
-      buf[dpy] = MAX(buf[dpy], op); // this one is to avoid gap due to int rounding
-  }
-}
 
 // build a stamp which can be combined with other shapes in the same group
 // prerequisite: 'buffer' is all zeros
@@ -2811,26 +2540,7 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module, const dt_dev_
   const guint nb_corner = g_list_length(form->points);
 
   // we shift and scale down path and border
-  for(int i = nb_corner * 3; i < border_count; i++)
-  {
-    const float xx = border[2 * i];
-    const float yy = border[2 * i + 1];
-    if(isnan(xx))
-    {
-      if(isnan(yy)) break; // that means we have to skip the end of the border path
-      i = yy - 1;
-      continue;
-    }
-    border[2 * i] = xx * scale - px;
-    border[2 * i + 1] = yy * scale - py;
-  }
-  for(int i = nb_corner * 3; i < points_count; i++)
-  {
-    const float xx = points[2 * i];
-    const float yy = points[2 * i + 1];
-    points[2 * i] = xx * scale - px;
-    points[2 * i + 1] = yy * scale - py;
-  }
+  _path_to_buffer(points, points_count, border, border_count, nb_corner, scale, px, py);
 
   // now check if path is at least partially within roi
   for(int i = nb_corner * 3; i < points_count; i++)
@@ -2896,219 +2606,29 @@ static int _path_get_mask_roi(const dt_iop_module_t *const module, const dt_dev_
     return 1;
   }
 
-  // now get min/max values
-  float xmin, xmax, ymin, ymax;
-  _path_bounding_box_raw(points, border, nb_corner, points_count, border_count, &xmin, &xmax, &ymin, &ymax);
-
-  if(darktable.unmuted & DT_DEBUG_PERF)
-  {
-    dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill min max took %0.04f sec\n", form->name,
-             dt_get_wtime() - start2);
-    start2 = dt_get_wtime();
-  }
-
-  if(darktable.unmuted & DT_DEBUG_PERF)
-  {
-    dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill clear mask took %0.04f sec\n", form->name,
-             dt_get_wtime() - start2);
-    start2 = dt_get_wtime();
-  }
-
   // deal with path if it does not lie outside of roi
   if(path_in_roi)
   {
-    // second copy of path which we can modify when cropping to roi
-    float *cpoints = dt_alloc_align_float((size_t)2 * points_count);
-    if(cpoints == NULL)
-    {
-      dt_free_align(points);
-      dt_free_align(border);
-      return 0;
-    }
-    memcpy(cpoints, points, sizeof(float) * 2 * points_count);
-
-    // now we clip cpoints to roi -> catch special case when roi lies completely within path.
-    // dirty trick: we allow path to extend one pixel beyond height-1. this avoids need of special handling
-    // of the last roi line in the following edge-flag polygon fill algorithm.
-    const int crop_success = _path_crop_to_roi(cpoints + 2 * (nb_corner * 3),
-                                               points_count - nb_corner * 3, 0,
-                                               width - 1, 0, height);
-    path_encircles_roi = path_encircles_roi || !crop_success;
+    dt_masks_fill_polygon(buffer, width, height, points + 2 * nb_corner * 3, points_count - nb_corner * 3);
 
     if(darktable.unmuted & DT_DEBUG_PERF)
     {
-      dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill crop to roi took %0.04f sec\n", form->name,
+      dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill fill plain took %0.04f sec\n", form->name,
                dt_get_wtime() - start2);
       start2 = dt_get_wtime();
     }
-
-    if(path_encircles_roi)
-    {
-      // roi lies completely within path
-      for(size_t k = 0; k < (size_t)width * height; k++) buffer[k] = 1.0f;
-    }
-    else
-    {
-      // all other cases
-
-      // edge-flag polygon fill: we write all the point around the path into the buffer
-      float xlast = cpoints[(points_count - 1) * 2];
-      float ylast = cpoints[(points_count - 1) * 2 + 1];
-
-      for(int i = nb_corner * 3; i < points_count; i++)
-      {
-        float xstart = xlast;
-        float ystart = ylast;
-
-        float xend = xlast = cpoints[i * 2];
-        float yend = ylast = cpoints[i * 2 + 1];
-
-        if(ystart > yend)
-        {
-          float tmp;
-          tmp = ystart, ystart = yend, yend = tmp;
-          tmp = xstart, xstart = xend, xend = tmp;
-        }
-
-        const float m = (xstart - xend) / (ystart - yend); // we don't need special handling of ystart==yend
-                                                           // as following loop will take care
-
-        for(int yy = (int)ceilf(ystart); (float)yy < yend;
-            yy++) // this would normally never touch the last roi line => see comment further above
-        {
-          const float xcross = xstart + m * (yy - ystart);
-
-          int xx = floorf(xcross);
-          if((float)xx + 0.5f <= xcross) xx++;
-
-          if(xx < 0 || xx >= width || yy < 0 || yy >= height)
-            continue; // sanity check just to be on the safe side
-
-          const size_t index = (size_t)yy * width + xx;
-
-          buffer[index] = 1.0f - buffer[index];
-        }
-      }
-
-      if(darktable.unmuted & DT_DEBUG_PERF)
-      {
-        dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill draw path took %0.04f sec\n", form->name,
-                 dt_get_wtime() - start2);
-        start2 = dt_get_wtime();
-      }
-
-      // we fill the inside plain
-      // we don't need to deal with parts of shape outside of roi
-      const int xxmin = MAX(xmin, 0);
-      const int xxmax = MIN(xmax, width - 1);
-      const int yymin = MAX(ymin, 0);
-      const int yymax = MIN(ymax, height - 1);
-
-#ifdef _OPENMP
-#if !defined(__SUNOS__) && !defined(__NetBSD__)
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(xxmin, xxmax, yymin, yymax, width) \
-  shared(buffer) schedule(static) num_threads(MIN(8,darktable.num_openmp_threads))
-#else
-#pragma omp parallel for shared(buffer)
-#endif
-#endif
-      for(int yy = yymin; yy <= yymax; yy++)
-      {
-        int state = 0;
-        for(int xx = xxmin; xx <= xxmax; xx++)
-        {
-          const size_t index = (size_t)yy * width + xx;
-          const float v = buffer[index];
-          if(v > 0.5f) state = !state;
-          if(state) buffer[index] = 1.0f;
-        }
-      }
-
-      if(darktable.unmuted & DT_DEBUG_PERF)
-      {
-        dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill fill plain took %0.04f sec\n", form->name,
-                 dt_get_wtime() - start2);
-        start2 = dt_get_wtime();
-      }
-    }
-    dt_free_align(cpoints);
   }
 
   // deal with feather if it does not lie outside of roi
   if(!path_encircles_roi)
   {
-    int *dpoints = dt_alloc_align(64, sizeof(int) * 4 * border_count);
-    if(dpoints == NULL)
+    if(!_path_draw_falloff(buffer, width, height, points, points_count, border, border_count, nb_corner))
     {
       dt_free_align(points);
       dt_free_align(border);
       return 0;
     }
 
-    int dindex = 0;
-    int p0[2], p1[2];
-    float pf1[2];
-    int last0[2] = { -100, -100 };
-    int last1[2] = { -100, -100 };
-    int next = 0;
-    for(int i = nb_corner * 3; i < border_count; i++)
-    {
-      p0[0] = floorf(points[i * 2] + 0.5f);
-      p0[1] = ceilf(points[i * 2 + 1]);
-      if(next > 0)
-      {
-        p1[0] = pf1[0] = border[next * 2];
-        p1[1] = pf1[1] = border[next * 2 + 1];
-      }
-      else
-      {
-        p1[0] = pf1[0] = border[i * 2];
-        p1[1] = pf1[1] = border[i * 2 + 1];
-      }
-
-      // now we check p1 value to know if we have to skip a part
-      if(next == i) next = 0;
-      while(isnan(pf1[0]))
-      {
-        if(isnan(pf1[1]))
-          next = i - 1;
-        else
-          next = p1[1];
-        p1[0] = pf1[0] = border[next * 2];
-        p1[1] = pf1[1] = border[next * 2 + 1];
-      }
-
-      // and we draw the falloff
-      if(last0[0] != p0[0] || last0[1] != p0[1] || last1[0] != p1[0] || last1[1] != p1[1])
-      {
-        dpoints[dindex] = p0[0];
-        dpoints[dindex + 1] = p0[1];
-        dpoints[dindex + 2] = p1[0];
-        dpoints[dindex + 3] = p1[1];
-        dindex += 4;
-
-        last0[0] = p0[0];
-        last0[1] = p0[1];
-        last1[0] = p1[0];
-        last1[1] = p1[1];
-      }
-    }
-
-#ifdef _OPENMP
-#if !defined(__SUNOS__) && !defined(__NetBSD__)
-#pragma omp parallel for default(none) \
-  dt_omp_firstprivate(width, height, dindex) \
-  shared(buffer, dpoints)
-#else
-#pragma omp parallel for shared(buffer)
-#endif
-#endif
-    for(int n = 0; n < dindex; n += 4)
-      _path_falloff_roi(buffer, dpoints + n, dpoints + n + 2, width, height);
-
-    dt_free_align(dpoints);
-
     if(darktable.unmuted & DT_DEBUG_PERF)
     {
       dt_print(DT_DEBUG_MASKS, "[masks %s] path_fill fill falloff took %0.04f sec\n", form->name,
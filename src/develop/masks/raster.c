@@ -0,0 +1,341 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2023 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "common/darktable.h"
+#include "develop/masks.h"
+
+/*
+ * Rasterisation of path and brush shapes.
+ *
+ * The buffer is split in tiles (or bands of rows for the polygon fill), and the edges or falloff cells of the
+ * shape are sorted into the tiles they touch. Only those tiles are visited, each by a single thread, so the
+ * cost follows the perimeter and the feathered area of the shape instead of the size of the buffer, and no
+ * two threads write to the same pixel.
+ *
+ * Pixels are sampled at their integer coordinates, like the circle and ellipse shapes.
+ */
+
+#define DT_MASKS_RASTER_TILE 64
+
+// sort the items (edges or cells) into the tiles they touch. ranges holds, per item, the inclusive tile range
+// x0, x1, y0, y1 (x1 < x0 means the item is not drawn). returns the CSR index: tile k owns the items
+// list[start[k]] to list[start[k + 1] - 1].
+static gboolean _bin_items(const int *const ranges, const int count, const int tiles_x, const int tiles_y,
+                           int **start_out, int **list_out)
+{
+  const size_t ntiles = (size_t)tiles_x * tiles_y;
+  int *start = calloc(ntiles + 1, sizeof(int));
+  if(!start) return FALSE;
+
+  for(int i = 0; i < count; i++)
+  {
+    const int *r = ranges + 4 * i;
+    for(int ty = r[2]; ty <= r[3]; ty++)
+      for(int tx = r[0]; tx <= r[1]; tx++) start[(size_t)ty * tiles_x + tx + 1]++;
+  }
+  for(size_t k = 0; k < ntiles; k++) start[k + 1] += start[k];
+
+  int *list = malloc(sizeof(int) * MAX(start[ntiles], 1));
+  int *fill = malloc(sizeof(int) * ntiles);
+  if(!list || !fill)
+  {
+    free(start);
+    free(list);
+    free(fill);
+    return FALSE;
+  }
+  memcpy(fill, start, sizeof(int) * ntiles);
+
+  for(int i = 0; i < count; i++)
+  {
+    const int *r = ranges + 4 * i;
+    for(int ty = r[2]; ty <= r[3]; ty++)
+      for(int tx = r[0]; tx <= r[1]; tx++) list[fill[(size_t)ty * tiles_x + tx]++] = i;
+  }
+  free(fill);
+
+  *start_out = start;
+  *list_out = list;
+  return TRUE;
+}
+
+static inline float _span_x(const float *const p, const float *const q, const float y)
+{
+  return p[0] + (y - p[1]) * (q[0] - p[0]) / (q[1] - p[1]);
+}
+
+// one triangle of a falloff cell. attr holds, for each vertex, the position in the falloff (0 on the inner
+// point, 1 on the outer one), the hardness and the density; they are interpolated linearly.
+static void _falloff_triangle(float *const buffer, const int width, const int tx0, const int tx1, const int ty0,
+                              const int ty1, const float *const v0, const float *const v1, const float *const v2,
+                              const float attr[3][3])
+{
+  const float e1x = v1[0] - v0[0], e1y = v1[1] - v0[1];
+  const float e2x = v2[0] - v0[0], e2y = v2[1] - v0[1];
+  const float det = e1x * e2y - e2x * e1y;
+  if(fabsf(det) < 1e-6f) return;
+
+  // gradients of the attributes
+  float gx[3], gy[3];
+  for(int k = 0; k < 3; k++)
+  {
+    const float d1 = attr[1][k] - attr[0][k];
+    const float d2 = attr[2][k] - attr[0][k];
+    gx[k] = (d1 * e2y - d2 * e1y) / det;
+    gy[k] = (d2 * e1x - d1 * e2x) / det;
+  }
+
+  const float *const v[3] = { v0, v1, v2 };
+  const float ymin = fminf(v0[1], fminf(v1[1], v2[1]));
+  const float ymax = fmaxf(v0[1], fmaxf(v1[1], v2[1]));
+  const int ya = MAX(ty0, (int)ceilf(ymin));
+  const int yb = MIN(ty1, (int)floorf(ymax));
+
+  for(int y = ya; y <= yb; y++)
+  {
+    // horizontal extent of the triangle on this row
+    float xl = FLT_MAX, xr = -FLT_MAX;
+    for(int k = 0; k < 3; k++)
+    {
+      const float *p = v[k];
+      const float *q = v[(k + 1) % 3];
+      if((p[1] > y && q[1] > y) || (p[1] < y && q[1] < y)) continue;
+      if(p[1] == q[1])
+      {
+        xl = fminf(xl, fminf(p[0], q[0]));
+        xr = fmaxf(xr, fmaxf(p[0], q[0]));
+      }
+      else
+      {
+        const float x = _span_x(p, q, y);
+        xl = fminf(xl, x);
+        xr = fmaxf(xr, x);
+      }
+    }
+    const int xa = MAX(tx0, (int)ceilf(xl));
+    const int xb = MIN(tx1, (int)floorf(xr));
+
+    float *row = buffer + (size_t)y * width;
+    for(int x = xa; x <= xb; x++)
+    {
+      const float dx = x - v0[0];
+      const float dy = y - v0[1];
+      const float t = CLAMP(attr[0][0] + gx[0] * dx + gy[0] * dy, 0.0f, 1.0f);
+      const float hardness = CLAMP(attr[0][1] + gx[1] * dx + gy[1] * dy, 0.0f, 1.0f);
+      const float density = CLAMP(attr[0][2] + gx[2] * dx + gy[2] * dy, 0.0f, 1.0f);
+      const float op = (t <= hardness) ? density : density * (1.0f - t) / (1.0f - hardness);
+      row[x] = MAX(row[x], op);
+    }
+  }
+}
+
+void dt_masks_draw_falloff(float *const buffer, const int width, const int height, const float *const inner,
+                           const float *const outer, const float *const payload, const int count,
+                           const gboolean closed)
+{
+  if(count < 2) return;
+
+  const int tiles_x = (width + DT_MASKS_RASTER_TILE - 1) / DT_MASKS_RASTER_TILE;
+  const int tiles_y = (height + DT_MASKS_RASTER_TILE - 1) / DT_MASKS_RASTER_TILE;
+
+  // cell i is the quad between the rays i and i + 1, the last one closes the band if it is closed
+  const int cells = closed ? count : count - 1;
+  int *ranges = dt_alloc_align(64, sizeof(int) * 4 * cells);
+  if(!ranges) return;
+
+  for(int i = 0; i < cells; i++)
+  {
+    const int j = (i + 1) % count;
+    const float *const pts[4] = { inner + 2 * i, inner + 2 * j, outer + 2 * i, outer + 2 * j };
+    float xmin = FLT_MAX, xmax = -FLT_MAX, ymin = FLT_MAX, ymax = -FLT_MAX;
+    gboolean valid = TRUE;
+    for(int k = 0; k < 4; k++)
+    {
+      valid = valid && isfinite(pts[k][0]) && isfinite(pts[k][1]);
+      xmin = fminf(xmin, pts[k][0]);
+      xmax = fmaxf(xmax, pts[k][0]);
+      ymin = fminf(ymin, pts[k][1]);
+      ymax = fmaxf(ymax, pts[k][1]);
+    }
+    int *r = ranges + 4 * i;
+    if(!valid || xmax < 0.0f || ymax < 0.0f || xmin > width - 1 || ymin > height - 1)
+    {
+      r[0] = r[2] = 0;
+      r[1] = r[3] = -1;
+      continue;
+    }
+    r[0] = CLAMP((int)ceilf(xmin), 0, width - 1) / DT_MASKS_RASTER_TILE;
+    r[1] = CLAMP((int)floorf(xmax), 0, width - 1) / DT_MASKS_RASTER_TILE;
+    r[2] = CLAMP((int)ceilf(ymin), 0, height - 1) / DT_MASKS_RASTER_TILE;
+    r[3] = CLAMP((int)floorf(ymax), 0, height - 1) / DT_MASKS_RASTER_TILE;
+  }
+
+  int *start = NULL, *list = NULL;
+  const gboolean binned = _bin_items(ranges, cells, tiles_x, tiles_y, &start, &list);
+  dt_free_align(ranges);
+  if(!binned) return;
+
+  const int ntiles = tiles_x * tiles_y;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(buffer, width, height, inner, outer, payload, count, tiles_x, ntiles, start, list) \
+  schedule(dynamic)
+#endif
+  for(int tile = 0; tile < ntiles; tile++)
+  {
+    if(start[tile] == start[tile + 1]) continue;
+
+    const int tx0 = (tile % tiles_x) * DT_MASKS_RASTER_TILE;
+    const int ty0 = (tile / tiles_x) * DT_MASKS_RASTER_TILE;
+    const int tx1 = MIN(tx0 + DT_MASKS_RASTER_TILE, width) - 1;
+    const int ty1 = MIN(ty0 + DT_MASKS_RASTER_TILE, height) - 1;
+
+    for(int k = start[tile]; k < start[tile + 1]; k++)
+    {
+      const int i = list[k];
+      const int j = (i + 1) % count;
+      const float hi = payload ? payload[2 * i] : 0.0f, di = payload ? payload[2 * i + 1] : 1.0f;
+      const float hj = payload ? payload[2 * j] : 0.0f, dj = payload ? payload[2 * j + 1] : 1.0f;
+
+      // split the quad along the inner(j) -> outer(i) diagonal
+      const float a1[3][3] = { { 0.0f, hi, di }, { 0.0f, hj, dj }, { 1.0f, hi, di } };
+      _falloff_triangle(buffer, width, tx0, tx1, ty0, ty1, inner + 2 * i, inner + 2 * j, outer + 2 * i, a1);
+      const float a2[3][3] = { { 0.0f, hj, dj }, { 1.0f, hj, dj }, { 1.0f, hi, di } };
+      _falloff_triangle(buffer, width, tx0, tx1, ty0, ty1, inner + 2 * j, outer + 2 * j, outer + 2 * i, a2);
+    }
+  }
+
+  free(start);
+  free(list);
+}
+
+static int _compare_float(const void *a, const void *b)
+{
+  const float fa = *(const float *)a, fb = *(const float *)b;
+  return (fa > fb) - (fa < fb);
+}
+
+// add the coverage of the span [a, b] to a row, pixel x covers [x - 0.5, x + 0.5]
+static inline void _fill_span(float *const row, const int width, float a, float b)
+{
+  a = MAX(a, -0.5f);
+  b = MIN(b, width - 0.5f);
+  if(b <= a) return;
+
+  const int pa = (int)floorf(a + 0.5f);
+  const int pb = MIN((int)floorf(b + 0.5f), width);
+  if(pa == pb)
+  {
+    row[pa] = MIN(row[pa] + b - a, 1.0f);
+    return;
+  }
+  row[pa] = MIN(row[pa] + pa + 0.5f - a, 1.0f);
+  for(int x = pa + 1; x < pb; x++) row[x] = 1.0f;
+  if(pb < width) row[pb] = MIN(row[pb] + b - pb + 0.5f, 1.0f);
+}
+
+void dt_masks_fill_polygon(float *const buffer, const int width, const int height, const float *const points,
+                           const int count)
+{
+  if(count < 3) return;
+
+  // edge i goes from point i to point i + 1 and crosses the rows y with ymin <= y < ymax. rows are gathered
+  // in bands of DT_MASKS_RASTER_TILE rows. edges left or right of the buffer still count for the parity.
+  const int bands = (height + DT_MASKS_RASTER_TILE - 1) / DT_MASKS_RASTER_TILE;
+  int *ranges = dt_alloc_align(64, sizeof(int) * 4 * count);
+  if(!ranges) return;
+
+  for(int i = 0; i < count; i++)
+  {
+    const float *p = points + 2 * i;
+    const float *q = points + 2 * ((i + 1) % count);
+    int *r = ranges + 4 * i;
+    r[0] = r[1] = 0;
+    r[2] = 0;
+    r[3] = -1;
+    if(!isfinite(p[0]) || !isfinite(p[1]) || !isfinite(q[0]) || !isfinite(q[1])) continue;
+
+    const int y0 = MAX((int)ceilf(fminf(p[1], q[1])), 0);
+    const int y1 = MIN((int)ceilf(fmaxf(p[1], q[1])) - 1, height - 1);
+    if(y1 < y0) continue;
+    r[2] = y0 / DT_MASKS_RASTER_TILE;
+    r[3] = y1 / DT_MASKS_RASTER_TILE;
+  }
+
+  int *start = NULL, *list = NULL;
+  const gboolean binned = _bin_items(ranges, count, 1, bands, &start, &list);
+  dt_free_align(ranges);
+  if(!binned) return;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(buffer, width, height, points, count, bands, start, list) \
+  schedule(dynamic)
+#endif
+  for(int band = 0; band < bands; band++)
+  {
+    const int nedges = start[band + 1] - start[band];
+    if(nedges < 2) continue;
+
+    float *xs = malloc(sizeof(float) * nedges);
+    if(!xs) continue;
+
+    const int y0 = band * DT_MASKS_RASTER_TILE;
+    const int y1 = MIN(y0 + DT_MASKS_RASTER_TILE, height);
+    for(int y = y0; y < y1; y++)
+    {
+      // crossings of the row with the active edges
+      int n = 0;
+      for(int k = start[band]; k < start[band + 1]; k++)
+      {
+        const int i = list[k];
+        const float *p = points + 2 * i;
+        const float *q = points + 2 * ((i + 1) % count);
+        const float ymin = fminf(p[1], q[1]);
+        const float ymax = fmaxf(p[1], q[1]);
+        if(y >= ymin && y < ymax) xs[n++] = _span_x(p, q, y);
+      }
+      if(n < 2) continue;
+
+      // few crossings per row in practice
+      if(n > 16)
+        qsort(xs, n, sizeof(float), _compare_float);
+      else
+        for(int a = 1; a < n; a++)
+        {
+          const float v = xs[a];
+          int b = a - 1;
+          for(; b >= 0 && xs[b] > v; b--) xs[b + 1] = xs[b];
+          xs[b + 1] = v;
+        }
+
+      // even-odd rule
+      float *row = buffer + (size_t)y * width;
+      for(int k = 0; k + 1 < n; k += 2) _fill_span(row, width, xs[k], xs[k + 1]);
+    }
+    free(xs);
+  }
+
+  free(start);
+  free(list);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -140,7 +140,10 @@ static inline float fminabsf(const float a, const float b)
 #endif
 static inline float clamp_simd(const float x)
 {
-  return fminf(fmaxf(x, 0.0f), 1.0f);
+  // comparisons rather than fminf/fmaxf: without -ffinite-math-only the compiler can't turn those into vector
+  // min/max instructions and the loops using them stay scalar. NaN still gives 0.
+  const float y = x > 0.0f ? x : 0.0f;
+  return y < 1.0f ? y : 1.0f;
 }
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
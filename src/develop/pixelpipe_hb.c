@@ -922,6 +922,89 @@ static void collect_histogram_on_CPU(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev
   return;
 }
 
+// a module blended through drawn shapes only changes the pixels under them. when those cover a small part of
+// the image, process the module on their bounding box only, plus the overlap and alignment it asks for when
+// tiling, and pass the input through everywhere else: the blend step gives the input back there anyway.
+// returns FALSE if the module has to be processed on the whole roi.
+static gboolean _process_masked_area(dt_dev_pixelpipe_t *pipe, dt_iop_module_t *module,
+                                     dt_dev_pixelpipe_iop_t *piece, const void *input, void *output,
+                                     const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out, const size_t in_bpp,
+                                     const size_t bpp, const dt_develop_tiling_t *tiling)
+{
+  // the preview pipe is where modules gather data for their gui, they need to see the whole image
+  if((pipe->type & DT_DEV_PIXELPIPE_PREVIEW) == DT_DEV_PIXELPIPE_PREVIEW
+     || !(module->flags() & IOP_FLAGS_ALLOW_TILING) || (module->operation_tags() & IOP_TAG_DISTORT))
+    return FALSE;
+
+  // passing the input through needs the same geometry, pixel format and colorspace on both sides
+  if(roi_in->x != roi_out->x || roi_in->y != roi_out->y || roi_in->width != roi_out->width
+     || roi_in->height != roi_out->height || roi_in->scale != roi_out->scale || in_bpp != bpp
+     || module->input_colorspace(module, pipe, piece) != module->output_colorspace(module, pipe, piece))
+    return FALSE;
+
+  dt_iop_roi_t bounds;
+  if(!dt_develop_blend_mask_bounds(module, piece, roi_out, &bounds)) return FALSE;
+
+  dt_iop_roi_t area = bounds;
+  dt_iop_roi_t area_in = bounds;
+  if(bounds.width > 0)
+  {
+    // keep the area on the alignment grid of the module (the CFA pattern for raw modules) as tiles are
+    dt_tiling_get_area(tiling, roi_out, &bounds, &area);
+
+    // not worth it for large shapes
+    if((size_t)area.width * area.height > (size_t)roi_out->width * roi_out->height / 2) return FALSE;
+
+    module->modify_roi_in(module, piece, &area, &area_in);
+    if(area_in.scale != roi_in->scale || area_in.x < roi_in->x || area_in.y < roi_in->y
+       || area_in.x + area_in.width > roi_in->x + roi_in->width
+       || area_in.y + area_in.height > roi_in->y + roi_in->height)
+      return FALSE;
+  }
+
+  void *area_input = NULL;
+  void *area_output = NULL;
+  if(bounds.width > 0)
+  {
+    area_input = dt_alloc_align(64, (size_t)area_in.width * area_in.height * in_bpp);
+    area_output = dt_alloc_align(64, (size_t)area.width * area.height * bpp);
+    if(!area_input || !area_output)
+    {
+      dt_free_align(area_input);
+      dt_free_align(area_output);
+      return FALSE;
+    }
+  }
+
+  dt_print(DT_DEBUG_PERF, "[pixelpipe] processing `%s' on %dx%d of its %dx%d roi for its drawn mask\n",
+           module->op, area.width, area.height, roi_out->width, roi_out->height);
+
+  memcpy(output, input, (size_t)roi_out->width * roi_out->height * bpp);
+  if(bounds.width == 0) return TRUE;
+
+  const size_t ipitch = (size_t)roi_in->width * in_bpp;
+  const size_t opitch = (size_t)roi_out->width * bpp;
+  const char *const in = (const char *)input + (area_in.y - roi_in->y) * ipitch + (area_in.x - roi_in->x) * in_bpp;
+  for(int j = 0; j < area_in.height; j++)
+    memcpy((char *)area_input + (size_t)j * area_in.width * in_bpp, in + j * ipitch,
+           (size_t)area_in.width * in_bpp);
+
+  pipe->tiling = 1;
+  module->process(module, piece, area_input, area_output, &area_in, &area);
+  pipe->tiling = 0;
+
+  // only keep the bounds, the overlap around them is missing its own neighbourhood
+  const size_t apitch = (size_t)area.width * bpp;
+  const char *const res = (const char *)area_output + (bounds.y - area.y) * apitch + (bounds.x - area.x) * bpp;
+  char *const out = (char *)output + (bounds.y - roi_out->y) * opitch + (bounds.x - roi_out->x) * bpp;
+  for(int j = 0; j < bounds.height; j++)
+    memcpy(out + j * opitch, res + j * apitch, (size_t)bounds.width * bpp);
+
+  dt_free_align(area_input);
+  dt_free_align(area_output);
+  return TRUE;
+}
+
 static int pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev,
                                     float *input, dt_iop_buffer_dsc_t *input_format, const dt_iop_roi_t *roi_in,
                                     void **output, dt_iop_buffer_dsc_t **out_format, const dt_iop_roi_t *roi_out,
@@ -971,7 +1054,8 @@ static int pixelpipe_process_on_CPU(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev,
     if(!fitting)
       fprintf(stderr, "[pixelpipe_process_on_CPU] Warning: processes `%s' even if memory requirements are not met\n", module->op);
 
-    module->process(module, piece, input, *output, roi_in, roi_out);
+    if(!_process_masked_area(pipe, module, piece, input, *output, roi_in, roi_out, in_bpp, bpp, tiling))
+      module->process(module, piece, input, *output, roi_in, roi_out);
     *pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU);
     *pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
   }
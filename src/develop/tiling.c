@@ -2067,6 +2067,27 @@ int dt_tiling_piece_fits_host_memory(const size_t width, const size_t height, co
     return FALSE;
 }
 
+/* the part of roi needed to process the pixels in bounds: bounds grown by the overlap, then out to the
+   alignment grid of roi, the same as tiles are. roi edges are kept as they are. */
+void dt_tiling_get_area(const dt_develop_tiling_t *tiling, const dt_iop_roi_t *const roi,
+                        const dt_iop_roi_t *const bounds, dt_iop_roi_t *area)
+{
+  const int xyalign = MAX(_lcm(tiling->xalign, tiling->yalign), 1);
+  const int overlap = tiling->overlap;
+
+  const int x0 = _align_down(_max(bounds->x - overlap - roi->x, 0), xyalign);
+  const int y0 = _align_down(_max(bounds->y - overlap - roi->y, 0), xyalign);
+  const int x1 = _min(_align_down(bounds->x + bounds->width + overlap - roi->x + xyalign - 1, xyalign), roi->width);
+  const int y1 = _min(_align_down(bounds->y + bounds->height + overlap - roi->y + xyalign - 1, xyalign),
+                      roi->height);
+
+  *area = *roi;
+  area->x = roi->x + x0;
+  area->y = roi->y + y0;
+  area->width = x1 - x0;
+  area->height = y1 - y0;
+}
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
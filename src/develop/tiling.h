@@ -74,6 +74,10 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
 int dt_tiling_piece_fits_host_memory(const size_t width, const size_t height, const unsigned bpp,
                                      const float factor, const size_t overhead);
 
+/** the part of roi a module needs to process bounds, with the overlap and alignment of tiling */
+void dt_tiling_get_area(const dt_develop_tiling_t *tiling, const dt_iop_roi_t *const roi,
+                        const dt_iop_roi_t *const bounds, dt_iop_roi_t *area);
+
 // clang-format off
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
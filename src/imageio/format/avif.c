@@ -214,7 +214,7 @@ int write_image(struct dt_imageio_module_data_t *data,
                 int num,
                 int total,
                 struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+                const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
   dt_imageio_avif_t *d = (dt_imageio_avif_t *)data;
 
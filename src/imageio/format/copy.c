@@ -33,7 +33,7 @@ DT_MODULE(1)
 int write_image(dt_imageio_module_data_t *data, const char *filename, const void *in,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+                const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
   int status = 1;
   gboolean from_cache = TRUE;
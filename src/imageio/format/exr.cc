@@ -28,6 +28,7 @@
 #include <OpenEXR/ImfStandardAttributes.h>
 #include <OpenEXR/ImfThreading.h>
 #include <OpenEXR/ImfOutputFile.h>
+#include <OpenEXR/ImfTiledOutputFile.h>
 
 extern "C" {
 #include "bauhaus/bauhaus.h"
@@ -46,7 +47,10 @@ extern "C" {
 extern "C" {
 #endif
 
-DT_MODULE(5)
+DT_MODULE(6)
+
+// edge length of the tiles in tiled files
+#define EXR_TILE_SIZE 64
 
 enum dt_imageio_exr_compression_t
 {
@@ -75,17 +79,27 @@ enum dt_imageio_exr_pixeltype_t
   NUM_PIXELTYPES    // number of different pixel types
 };                  // copy of Imf::PixelType
 
+enum dt_imageio_exr_tiling_t
+{
+  EXR_SCANLINES = 0,     // scanline file
+  EXR_TILES = 1,         // tiled file, full resolution only
+  EXR_TILES_MIPMAP = 2,  // tiled file with mip-map levels
+  NUM_TILINGS
+};
+
 typedef struct dt_imageio_exr_t
 {
   dt_imageio_module_data_t global;
   dt_imageio_exr_compression_t compression;
   dt_imageio_exr_pixeltype_t pixel_type;
+  dt_imageio_exr_tiling_t tiling;
 } dt_imageio_exr_t;
 
 typedef struct dt_imageio_exr_gui_t
 {
   GtkWidget *bpp;
   GtkWidget *compression;
+  GtkWidget *tiling;
 } dt_imageio_exr_gui_t;
 
 void init(dt_imageio_module_format_t *self)
@@ -112,6 +126,14 @@ void init(dt_imageio_module_format_t *self)
 
   dt_lua_register_module_member(darktable.lua_state.state, self, dt_imageio_exr_t, pixel_type,
                                 dt_imageio_exr_pixeltype_t);
+
+  luaA_enum(darktable.lua_state.state, dt_imageio_exr_tiling_t);
+  luaA_enum_value_name(darktable.lua_state.state, dt_imageio_exr_tiling_t, EXR_SCANLINES, "scanlines");
+  luaA_enum_value_name(darktable.lua_state.state, dt_imageio_exr_tiling_t, EXR_TILES, "tiles");
+  luaA_enum_value_name(darktable.lua_state.state, dt_imageio_exr_tiling_t, EXR_TILES_MIPMAP, "mipmap");
+
+  dt_lua_register_module_member(darktable.lua_state.state, self, dt_imageio_exr_t, tiling,
+                                dt_imageio_exr_tiling_t);
 #endif
   Imf::BlobAttribute::registerAttributeType();
 }
@@ -120,14 +142,127 @@ void cleanup(dt_imageio_module_format_t *self)
 {
 }
 
+// convert the RGB channels of the pipe output to packed half floats
+static unsigned short *_exr_to_half(const float *const in, const size_t width, const size_t height)
+{
+  unsigned short *out = (unsigned short *)malloc(3 * sizeof(unsigned short) * width * height);
+  if(out == NULL)
+    return NULL;
+
+#ifdef _OPENMP
+#pragma omp parallel for simd default(none) \
+  dt_omp_firstprivate(in, out, width, height) \
+  schedule(simd:static) \
+  collapse(2)
+#endif
+  for(size_t y = 0; y < height; y++)
+  {
+    for(size_t x = 0; x < width; x++)
+    {
+      const float *in_pixel = in + 4 * ((y * width) + x);
+      unsigned short *out_pixel = out + 3 * ((y * width) + x);
+
+      out_pixel[0] = half(in_pixel[0]).bits();
+      out_pixel[1] = half(in_pixel[1]).bits();
+      out_pixel[2] = half(in_pixel[2]).bits();
+    }
+  }
+  return out;
+}
+
+// halve a 4 channels float buffer with a box filter, to build the next mip-map level
+static void _exr_downscale(const float *const in, const size_t in_width, const size_t in_height,
+                           float *const out, const size_t out_width, const size_t out_height)
+{
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(in, in_width, in_height, out, out_width, out_height) \
+  schedule(static)
+#endif
+  for(size_t y = 0; y < out_height; y++)
+  {
+    const float *row0 = in + 4 * in_width * MIN(2 * y, in_height - 1);
+    const float *row1 = in + 4 * in_width * MIN(2 * y + 1, in_height - 1);
+    for(size_t x = 0; x < out_width; x++)
+    {
+      const size_t x0 = 4 * MIN(2 * x, in_width - 1);
+      const size_t x1 = 4 * MIN(2 * x + 1, in_width - 1);
+      float *out_pixel = out + 4 * (y * out_width + x);
+      for(int c = 0; c < 4; c++)
+        out_pixel[c] = 0.25f * (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]);
+    }
+  }
+}
+
+// describe a buffer of RGB pixels, packed by `stride` bytes, to OpenEXR
+static void _exr_insert_slices(Imf::FrameBuffer &data, const Imf::PixelType pixel_type, const char *base,
+                               const size_t stride, const size_t width)
+{
+  const size_t channel_size = (pixel_type == Imf::PixelType::FLOAT) ? sizeof(float) : sizeof(unsigned short);
+  data.insert("R", Imf::Slice(pixel_type, (char *)base, stride, stride * width));
+  data.insert("G", Imf::Slice(pixel_type, (char *)base + channel_size, stride, stride * width));
+  data.insert("B", Imf::Slice(pixel_type, (char *)base + 2 * channel_size, stride, stride * width));
+}
+
+// write all the levels of a tiled file, computing the mip-maps from the full resolution image
+static int _exr_write_tiles(Imf::TiledOutputFile &file, const Imf::PixelType pixel_type, const float *const in,
+                            const size_t width, const size_t height)
+{
+  const float *level = in;
+  float *scaled = NULL;
+  size_t level_width = width, level_height = height;
+
+  for(int l = 0; l < file.numLevels(); l++)
+  {
+    if(l > 0)
+    {
+      const size_t next_width = file.levelWidth(l), next_height = file.levelHeight(l);
+      float *next = dt_alloc_align_float(4 * next_width * next_height);
+      if(next == NULL)
+      {
+        dt_free_align(scaled);
+        return 1;
+      }
+      _exr_downscale(level, level_width, level_height, next, next_width, next_height);
+      dt_free_align(scaled);
+      level = scaled = next;
+      level_width = next_width;
+      level_height = next_height;
+    }
+
+    Imf::FrameBuffer data;
+    unsigned short *out = NULL;
+    if(pixel_type == Imf::PixelType::FLOAT)
+      _exr_insert_slices(data, pixel_type, (const char *)level, 4 * sizeof(float), level_width);
+    else
+    {
+      out = _exr_to_half(level, level_width, level_height);
+      if(out == NULL)
+      {
+        dt_free_align(scaled);
+        return 1;
+      }
+      _exr_insert_slices(data, pixel_type, (const char *)out, 3 * sizeof(unsigned short), level_width);
+    }
+
+    file.setFrameBuffer(data);
+    file.writeTiles(0, file.numXTiles(l) - 1, 0, file.numYTiles(l) - 1, l);
+    free(out);
+  }
+
+  dt_free_align(scaled);
+  return 0;
+}
+
 int write_image(dt_imageio_module_data_t *tmp, const char *filename, const void *in_tmp,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+                const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
   const dt_imageio_exr_t *exr = (dt_imageio_exr_t *)tmp;
 
-  Imf::setGlobalThreadCount(dt_get_num_threads());
+  // the encoder compresses blocks of scanlines or tiles in parallel on the global thread pool
+  Imf::setGlobalThreadCount(darktable.num_openmp_threads);
 
   Imf::Header header(exr->global.width, exr->global.height, 1, Imath::V2f(0, 0), 1, Imf::INCREASING_Y,
                      (Imf::Compression)exr->compression);
@@ -222,67 +357,40 @@ icc_end:
   header.channels().insert("G", Imf::Channel(pixel_type, 1, 1, true));
   header.channels().insert("B", Imf::Channel(pixel_type, 1, 1, true));
 
+  const size_t width = exr->global.width;
+  const size_t height = exr->global.height;
+
+  if(exr->tiling != EXR_SCANLINES)
+  {
+    header.setTileDescription(Imf::TileDescription(EXR_TILE_SIZE, EXR_TILE_SIZE,
+                                                   exr->tiling == EXR_TILES_MIPMAP ? Imf::MIPMAP_LEVELS
+                                                                                   : Imf::ONE_LEVEL,
+                                                   Imf::ROUND_DOWN));
+    Imf::TiledOutputFile file(filename, header);
+    return _exr_write_tiles(file, pixel_type, (const float *)in_tmp, width, height);
+  }
+
   Imf::OutputFile file(filename, header);
 
   Imf::FrameBuffer data;
-  size_t stride;
 
   if(pixel_type == Imf::PixelType::FLOAT)
   {
-    stride = 4 * sizeof(float);
-    const float *in = (const float *)in_tmp;
-
-    data.insert("R", Imf::Slice(pixel_type, (char *)(in + 0), stride,
-                                stride * exr->global.width));
-
-    data.insert("G", Imf::Slice(pixel_type, (char *)(in + 1), stride,
-                                stride * exr->global.width));
-
-    data.insert("B", Imf::Slice(pixel_type, (char *)(in + 2), stride,
-                                stride * exr->global.width));
+    _exr_insert_slices(data, pixel_type, (const char *)in_tmp, 4 * sizeof(float), width);
 
     file.setFrameBuffer(data);
-    file.writePixels(exr->global.height);
+    file.writePixels(height);
   }
   else
   {
-    const size_t width = exr->global.width;
-    const size_t height = exr->global.height;
-    stride = 3 * sizeof(unsigned short);
-    unsigned short *out = (unsigned short *)malloc(stride * width * height);
+    unsigned short *out = _exr_to_half((const float *)in_tmp, width, height);
     if(out == NULL)
       return 1;
 
-#ifdef _OPENMP
-#pragma omp parallel for simd default(none) \
-  dt_omp_firstprivate(in_tmp, out, width, height) \
-  schedule(simd:static) \
-  collapse(2)
-#endif
-    for(size_t y = 0; y < height; y++)
-    {
-      for(size_t x = 0; x < width; x++)
-      {
-        const float *in_pixel = (const float *)in_tmp + 4 * ((y * width) + x);
-        unsigned short *out_pixel = out + 3 * ((y * width) + x);
-
-        out_pixel[0] = half(in_pixel[0]).bits();
-        out_pixel[1] = half(in_pixel[1]).bits();
-        out_pixel[2] = half(in_pixel[2]).bits();
-      }
-    }
-
-    data.insert("R", Imf::Slice(pixel_type, (char *)(out + 0), stride,
-                                stride * exr->global.width));
-
-    data.insert("G", Imf::Slice(pixel_type, (char *)(out + 1), stride,
-                                stride * exr->global.width));
-
-    data.insert("B", Imf::Slice(pixel_type, (char *)(out + 2), stride,
-                                stride * exr->global.width));
+    _exr_insert_slices(data, pixel_type, (const char *)out, 3 * sizeof(unsigned short), width);
 
     file.setFrameBuffer(data);
-    file.writePixels(exr->global.height);
+    file.writePixels(height);
 
     free(out);
   }
@@ -299,7 +407,7 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
                     const size_t old_params_size, const int old_version, const int new_version,
                     size_t *new_size)
 {
-  if(old_version == 1 && new_version == 5)
+  if(old_version == 1 && new_version == 6)
   {
     struct dt_imageio_exr_v1_t
     {
@@ -319,10 +427,11 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
     n->global.style_append = FALSE;
     n->compression = PIZ_COMPRESSION;
     n->pixel_type = EXR_PT_FLOAT;
+    n->tiling = EXR_SCANLINES;
     *new_size = self->params_size(self);
     return n;
   }
-  if(old_version == 2 && new_version == 5)
+  if(old_version == 2 && new_version == 6)
   {
     struct dt_imageio_exr_v2_t
     {
@@ -345,10 +454,11 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
     n->global.style_append = FALSE;
     n->compression = o->compression;
     n->pixel_type = o->pixel_type >= EXR_PT_HALF ? o->pixel_type : EXR_PT_FLOAT;
+    n->tiling = EXR_SCANLINES;
     *new_size = self->params_size(self);
     return n;
   }
-  if(old_version == 3 && new_version == 5)
+  if(old_version == 3 && new_version == 6)
   {
     struct dt_imageio_exr_v3_t
     {
@@ -369,10 +479,11 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
     n->global.style_append = FALSE;
     n->compression = o->compression;
     n->pixel_type = EXR_PT_FLOAT;
+    n->tiling = EXR_SCANLINES;
     *new_size = self->params_size(self);
     return n;
   }
-  if(old_version == 4 && new_version == 5)
+  if(old_version == 4 && new_version == 6)
   {
     struct dt_imageio_exr_v4_t
     {
@@ -391,6 +502,26 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
     n->global.style_append = o->global.style_append;
     n->compression = o->compression;
     n->pixel_type = EXR_PT_FLOAT;
+    n->tiling = EXR_SCANLINES;
+    *new_size = self->params_size(self);
+    return n;
+  }
+  if(old_version == 5 && new_version == 6)
+  {
+    struct dt_imageio_exr_v5_t
+    {
+      dt_imageio_module_data_t global;
+      dt_imageio_exr_compression_t compression;
+      dt_imageio_exr_pixeltype_t pixel_type;
+    };
+
+    const dt_imageio_exr_v5_t *o = (dt_imageio_exr_v5_t *)old_params;
+    dt_imageio_exr_t *n = (dt_imageio_exr_t *)malloc(sizeof(dt_imageio_exr_t));
+
+    n->global = o->global;
+    n->compression = o->compression;
+    n->pixel_type = o->pixel_type;
+    n->tiling = EXR_SCANLINES;
     *new_size = self->params_size(self);
     return n;
   }
@@ -403,6 +534,7 @@ void *get_params(dt_imageio_module_format_t *self)
   d->compression = (dt_imageio_exr_compression_t)dt_conf_get_int("plugins/imageio/format/exr/compression");
   const int bpp = dt_conf_get_int("plugins/imageio/format/exr/bpp");
   d->pixel_type = (dt_imageio_exr_pixeltype_t)(bpp >> 4);
+  d->tiling = (dt_imageio_exr_tiling_t)CLAMP(dt_conf_get_int("plugins/imageio/format/exr/tiling"), 0, NUM_TILINGS - 1);
   return d;
 }
 
@@ -418,6 +550,7 @@ int set_params(dt_imageio_module_format_t *self, const void *params, const int s
   dt_imageio_exr_gui_t *g = (dt_imageio_exr_gui_t *)self->gui_data;
   dt_bauhaus_combobox_set(g->bpp, d->pixel_type - EXR_PT_HALF);
   dt_bauhaus_combobox_set(g->compression, d->compression);
+  dt_bauhaus_combobox_set(g->tiling, d->tiling);
   return 0;
 }
 
@@ -458,6 +591,12 @@ static void compression_combobox_changed(GtkWidget *widget, gpointer user_data)
   dt_conf_set_int("plugins/imageio/format/exr/compression", compression);
 }
 
+static void tiling_combobox_changed(GtkWidget *widget, gpointer user_data)
+{
+  const int tiling = dt_bauhaus_combobox_get(widget);
+  dt_conf_set_int("plugins/imageio/format/exr/tiling", tiling);
+}
+
 void gui_init(dt_imageio_module_format_t *self)
 {
   self->gui_data = malloc(sizeof(dt_imageio_exr_gui_t));
@@ -496,6 +635,21 @@ void gui_init(dt_imageio_module_format_t *self)
   dt_bauhaus_combobox_set(gui->compression, compression_last);
   gtk_box_pack_start(GTK_BOX(self->widget), gui->compression, TRUE, TRUE, 0);
   g_signal_connect(G_OBJECT(gui->compression), "value-changed", G_CALLBACK(compression_combobox_changed), NULL);
+
+  // Tiling combo box
+  const int tiling_last = dt_conf_get_int("plugins/imageio/format/exr/tiling");
+
+  gui->tiling = dt_bauhaus_combobox_new(NULL);
+  dt_bauhaus_widget_set_label(gui->tiling, NULL, N_("layout"));
+
+  dt_bauhaus_combobox_add(gui->tiling, _("scanlines"));
+  dt_bauhaus_combobox_add(gui->tiling, _("tiles"));
+  dt_bauhaus_combobox_add(gui->tiling, _("tiles with mip-maps"));
+  dt_bauhaus_combobox_set(gui->tiling, tiling_last);
+  gtk_widget_set_tooltip_text(gui->tiling, _("tiled files let compositing applications load regions\n"
+                                             "and reduced resolutions of the image on demand"));
+  gtk_box_pack_start(GTK_BOX(self->widget), gui->tiling, TRUE, TRUE, 0);
+  g_signal_connect(G_OBJECT(gui->tiling), "value-changed", G_CALLBACK(tiling_combobox_changed), NULL);
 }
 
 void gui_cleanup(dt_imageio_module_format_t *self)
@@ -509,6 +663,7 @@ void gui_reset(dt_imageio_module_format_t *self)
   const int bpp = dt_confgen_get_int("plugins/imageio/format/exr/bpp", DT_DEFAULT);
   dt_bauhaus_combobox_set(gui->bpp, (bpp >> 4) - EXR_PT_HALF);
   dt_bauhaus_combobox_set(gui->compression, dt_confgen_get_int("plugins/imageio/format/exr/compression", DT_DEFAULT));
+  dt_bauhaus_combobox_set(gui->tiling, dt_confgen_get_int("plugins/imageio/format/exr/tiling", DT_DEFAULT));
 }
 
 
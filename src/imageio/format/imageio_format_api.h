@@ -30,6 +30,7 @@ extern "C" {
 struct dt_imageio_module_format_t;
 struct dt_imageio_module_data_t;
 struct dt_dev_pixelpipe_t;
+struct dt_export_metadata_t;
 
 #include "common/colorspaces.h" // because forward declaring enums doesn't work in C++ :(
 
@@ -75,11 +76,12 @@ OPTIONAL(int, dimension, struct dt_imageio_module_format_t *self, struct dt_imag
 // writing functions:
 /* bits per pixel and color channel we want to write: 8: char x3, 16: uint16_t x3, 32: float x3. */
 REQUIRED(int, bpp, struct dt_imageio_module_data_t *data);
-/* write to file, with exif if not NULL, and icc profile if supported. */
+/* write to file, with exif if not NULL, and icc profile if supported. formats flagged with
+   FORMAT_FLAGS_EMBED_XMP also embed the xmp data of imgid when metadata is not NULL. */
 REQUIRED(int, write_image, struct dt_imageio_module_data_t *data, const char *filename, const void *in,
                            dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                            void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                           const gboolean export_masks);
+                           const gboolean export_masks, struct dt_export_metadata_t *metadata);
 /* flag that describes the available precision/levels of output format. mainly used for dithering. */
 OPTIONAL(int, levels, struct dt_imageio_module_data_t *data);
 
@@ -321,7 +321,7 @@ static void cinema_setup_encoder(opj_cparameters_t *parameters, opj_image_t *ima
 int write_image(dt_imageio_module_data_t *j2k_tmp, const char *filename, const void *in_tmp,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+                const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
   int rc = 1;
   const float *in = (const float *)in_tmp;
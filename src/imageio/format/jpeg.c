@@ -304,23 +304,26 @@ read_icc_profile (j_decompress_ptr cinfo,
 int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const void *in_tmp,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+                const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
   dt_imageio_jpeg_t *jpg = (dt_imageio_jpeg_t *)jpg_tmp;
   const uint8_t *in = (const uint8_t *)in_tmp;
   struct dt_imageio_jpeg_error_mgr jerr;
 
+  // encode in memory, so the metadata can be embedded before the file is written, once
+  unsigned char *encoded = NULL;
+  unsigned long encoded_size = 0;
+
   jpg->cinfo.err = jpeg_std_error(&jerr.pub);
   jerr.pub.error_exit = dt_imageio_jpeg_error_exit;
   if(setjmp(jerr.setjmp_buffer))
   {
     jpeg_destroy_compress(&(jpg->cinfo));
+    free(encoded);
     return 1;
   }
   jpeg_create_compress(&(jpg->cinfo));
-  FILE *f = g_fopen(filename, "wb");
-  if(!f) return 1;
-  jpeg_stdio_dest(&(jpg->cinfo), f);
+  jpeg_mem_dest(&(jpg->cinfo), &encoded, &encoded_size);
 
   jpg->cinfo.image_width = jpg->global.width;
   jpg->cinfo.image_height = jpg->global.height;
@@ -372,11 +375,18 @@ int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const v
   jpeg_finish_compress(&(jpg->cinfo));
   dt_free_align(row);
   jpeg_destroy_compress(&(jpg->cinfo));
-  fclose(f);
-
-  dt_exif_write_blob(exif, exif_len, filename, 1);
 
-  return 0;
+  size_t size = 0;
+  uint8_t *complete = NULL;
+  if(exif || metadata)
+    complete = dt_exif_embed_metadata(encoded, encoded_size, exif, exif_len, 1, imgid, metadata, &size);
+  if(complete)
+  {
+    free(encoded);
+    return dt_imageio_write_buffer(filename, complete, size, g_free);
+  }
+  // write the image without metadata rather than nothing
+  return dt_imageio_write_buffer(filename, encoded, encoded_size, free);
 }
 
 static int __attribute__((__unused__)) read_header(const char *filename, dt_imageio_jpeg_t *jpg)
@@ -533,7 +543,7 @@ const char *extension(dt_imageio_module_data_t *data)
 
 int flags(dt_imageio_module_data_t *data)
 {
-  return FORMAT_FLAGS_SUPPORT_XMP;
+  return FORMAT_FLAGS_SUPPORT_XMP | FORMAT_FLAGS_EMBED_XMP;
 }
 
 void init(dt_imageio_module_format_t *self)
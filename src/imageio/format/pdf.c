@@ -232,7 +232,7 @@ static int _paper_size(dt_imageio_pdf_params_t *d, float *page_width, float *pag
 int write_image(dt_imageio_module_data_t *data, const char *filename, const void *in,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+                const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
   dt_imageio_pdf_t *d = (dt_imageio_pdf_t *)data;
 
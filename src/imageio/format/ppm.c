@@ -36,7 +36,7 @@ void cleanup(dt_imageio_module_format_t *self)
 int write_image(dt_imageio_module_data_t *ppm, const char *filename, const void *in_tmp,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+                const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
   const uint16_t *in = (const uint16_t *)in_tmp;
   int status = 0;
@@ -31,12 +31,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <tiffio.h>
+#include <zlib.h>
 
 // it would be nice to save space by storing the masks as single channel float data,
 // but at least GIMP can't open TIFF files where not all layers have the same format.
 #define MASKS_USE_SAME_FORMAT
 
-DT_MODULE(3)
+// edge length of the tiles written in tiled mode, must be a multiple of 16
+#define TIFF_TILE_SIZE 256
+
+DT_MODULE(4)
 
 typedef struct dt_imageio_tiff_t
 {
@@ -45,6 +49,7 @@ typedef struct dt_imageio_tiff_t
   int compress;
   int compresslevel;
   int shortfile;
+  int tiled;
   TIFF *handle;
 } dt_imageio_tiff_t;
 
@@ -54,13 +59,529 @@ typedef struct dt_imageio_tiff_gui_t
   GtkWidget *compress;
   GtkWidget *compresslevel;
   GtkWidget *shortfiles;
+  GtkWidget *tiled;
 } dt_imageio_tiff_gui_t;
 
+/* Unless it is very large, the file is built in memory, so that exif and xmp can be embedded before it
+   is written to disk, once. These are the libtiff client procedures for a growable memory buffer. */
+typedef struct _tiff_memstream_t
+{
+  uint8_t *data;
+  toff_t size;     // bytes of valid data
+  toff_t capacity; // allocated bytes
+  toff_t pos;
+} _tiff_memstream_t;
+
+static tmsize_t _mem_read(thandle_t handle, void *buf, tmsize_t n)
+{
+  _tiff_memstream_t *ms = (_tiff_memstream_t *)handle;
+  const tmsize_t avail = ms->pos < ms->size ? (tmsize_t)(ms->size - ms->pos) : 0;
+  const tmsize_t count = MIN(n, avail);
+  memcpy(buf, ms->data + ms->pos, count);
+  ms->pos += count;
+  return count;
+}
+
+static tmsize_t _mem_write(thandle_t handle, void *buf, tmsize_t n)
+{
+  _tiff_memstream_t *ms = (_tiff_memstream_t *)handle;
+  const toff_t end = ms->pos + n;
+  if(end > ms->capacity)
+  {
+    const toff_t capacity = MAX(end, 2 * ms->capacity);
+    uint8_t *data = g_try_realloc(ms->data, capacity);
+    if(!data) return -1;
+    ms->data = data;
+    ms->capacity = capacity;
+  }
+  // libtiff may seek past the end before writing
+  if(ms->pos > ms->size) memset(ms->data + ms->size, 0, ms->pos - ms->size);
+  memcpy(ms->data + ms->pos, buf, n);
+  ms->pos = end;
+  ms->size = MAX(ms->size, end);
+  return n;
+}
+
+static toff_t _mem_seek(thandle_t handle, toff_t offset, int whence)
+{
+  _tiff_memstream_t *ms = (_tiff_memstream_t *)handle;
+  if(whence == SEEK_CUR)
+    ms->pos += offset;
+  else if(whence == SEEK_END)
+    ms->pos = ms->size + offset;
+  else
+    ms->pos = offset;
+  return ms->pos;
+}
+
+static int _mem_close(thandle_t handle)
+{
+  return 0;
+}
+
+static toff_t _mem_size(thandle_t handle)
+{
+  return ((_tiff_memstream_t *)handle)->size;
+}
+
+static int _mem_map(thandle_t handle, void **base, toff_t *size)
+{
+  return 0; // no mapping, libtiff falls back to reading
+}
+
+static void _mem_unmap(thandle_t handle, void *base, toff_t size)
+{
+}
+
+static TIFF *_mem_open(const char *name, const char *mode, _tiff_memstream_t *ms)
+{
+  ms->pos = 0;
+  return TIFFClientOpen(name, mode, (thandle_t)ms, _mem_read, _mem_write, _mem_seek, _mem_close, _mem_size,
+                        _mem_map, _mem_unmap);
+}
+
+// open the file to write, or the memory stream ms if not NULL
+static TIFF *_tiff_open(const char *filename, const char *mode, _tiff_memstream_t *ms)
+{
+  if(ms) return _mem_open(filename, mode, ms);
+#ifdef _WIN32
+  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
+  TIFF *tif = TIFFOpenW(wfilename, mode);
+  g_free(wfilename);
+  return tif;
+#else
+  return TIFFOpen(filename, mode);
+#endif
+}
+
+/* Layout of the main image in the file: a list of chunks, each being either a strip
+   (full width, rows_per_chunk rows) or a tile (chunk_width x rows_per_chunk).
+   Chunks are independent from each other, so they can be packed, predicted and
+   deflated in parallel, then handed to libtiff in order as raw, pre-encoded data. */
+typedef struct _tiff_chunks_t
+{
+  const void *in;          // 4 channels pipe output, 8/16/32 bits per channel
+  size_t width, height;    // image size
+  size_t chunk_width;      // = width for strips
+  size_t rows_per_chunk;
+  size_t chunks_across;    // = 1 for strips
+  size_t num_chunks;
+  size_t chunk_size;       // uncompressed size of a chunk, in bytes
+  gboolean tiled;
+  int layers;
+  int bpp;
+  int compress;            // 0: none, 1: deflate, 2: deflate with predictor
+  int compresslevel;
+} _tiff_chunks_t;
+
+// copy the pixels of chunk `index` into `out`, dropping the 4th channel and
+// zero-padding what lies outside the image (right and bottom tiles).
+static void _pack_chunk(const _tiff_chunks_t *const c, const size_t index, uint8_t *const out)
+{
+  const size_t bytes = c->bpp / 8;
+  const size_t x0 = (index % c->chunks_across) * c->chunk_width;
+  const size_t y0 = (index / c->chunks_across) * c->rows_per_chunk;
+  const size_t row_bytes = c->chunk_width * c->layers * bytes;
+  const size_t cols = MIN(c->chunk_width, c->width - x0);
+  const size_t rows = MIN(c->rows_per_chunk, c->height - y0);
+
+  // strips are truncated at the end of the image, tiles are always full size
+  if(c->tiled) memset(out, 0, c->chunk_size);
+
+  for(size_t j = 0; j < rows; j++)
+  {
+    const uint8_t *in = (const uint8_t *)c->in + (((y0 + j) * c->width + x0) * 4 * bytes);
+    uint8_t *o = out + j * row_bytes;
+    for(size_t i = 0; i < cols; i++, in += 4 * bytes, o += c->layers * bytes)
+      memcpy(o, in, c->layers * bytes);
+  }
+}
+
+// TIFF predictor 2 (horizontal differencing), applied in place to one row of samples.
+// Same as what libtiff does when PREDICTOR_HORIZONTAL is set.
+static void _predict_horizontal(uint8_t *const row, const size_t samples, const int layers, const int bpp)
+{
+  if(bpp == 16)
+  {
+    uint16_t *w = (uint16_t *)row;
+    for(size_t i = samples - 1; i >= (size_t)layers; i--) w[i] -= w[i - layers];
+  }
+  else
+  {
+    for(size_t i = samples - 1; i >= (size_t)layers; i--) row[i] -= row[i - layers];
+  }
+}
+
+// TIFF predictor 3 (floating point), applied in place to one row of samples: the bytes of the
+// floats are split into planes, most significant first, then differenced byte-wise.
+// `tmp` needs to hold one row.
+static void _predict_float(uint8_t *const row, uint8_t *const tmp, const size_t samples, const int layers)
+{
+  const size_t row_bytes = samples * sizeof(float);
+  memcpy(tmp, row, row_bytes);
+  for(size_t i = 0; i < samples; i++)
+    for(size_t b = 0; b < sizeof(float); b++)
+    {
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+      row[b * samples + i] = tmp[sizeof(float) * i + b];
+#else
+      row[(sizeof(float) - b - 1) * samples + i] = tmp[sizeof(float) * i + b];
+#endif
+    }
+  for(size_t i = row_bytes - 1; i >= (size_t)layers; i--) row[i] -= row[i - layers];
+}
+
+// pack, predict and deflate one chunk. returns the number of bytes stored into `dest`, 0 on error.
+static size_t _encode_chunk(const _tiff_chunks_t *const c, const size_t index, uint8_t *const scratch,
+                            uint8_t *const dest, const size_t dest_size)
+{
+  const size_t samples = c->chunk_width * c->layers;
+  const size_t row_bytes = samples * c->bpp / 8;
+  const size_t y0 = (index / c->chunks_across) * c->rows_per_chunk;
+  const size_t rows = c->tiled ? c->rows_per_chunk : MIN(c->rows_per_chunk, c->height - y0);
+  const size_t size = rows * row_bytes;
+
+  uint8_t *const raw = (c->compress == 0) ? dest : scratch;
+  _pack_chunk(c, index, raw);
+  if(c->compress == 0) return size;
+
+  if(c->compress == 2)
+  {
+    for(size_t j = 0; j < rows; j++)
+    {
+      if(c->bpp == 32)
+        _predict_float(raw + j * row_bytes, scratch + c->chunk_size, samples, c->layers);
+      else
+        _predict_horizontal(raw + j * row_bytes, samples, c->layers, c->bpp);
+    }
+  }
+
+  uLongf dest_len = dest_size;
+  if(compress2(dest, &dest_len, raw, size, c->compresslevel) != Z_OK) return 0;
+  return dest_len;
+}
+
+/* Write the main image as independent strips or tiles. libtiff compresses everything
+   on the calling thread, which makes deflate the bottleneck of large 16/32 bit exports,
+   so we do the encoding ourselves in parallel and feed the result to TIFFWriteRaw*().
+   Chunks are processed in batches to bound the memory held by compressed buffers. */
+static int _write_chunks(TIFF *tif, const _tiff_chunks_t *const c)
+{
+  const gboolean tiled = c->tiled;
+
+  // libtiff would have to byte-swap our output: let it do all the work then.
+  if(TIFFIsByteSwapped(tif))
+  {
+    uint8_t *buf = malloc(c->chunk_size);
+    if(!buf) return 1;
+    int err = 0;
+    for(size_t k = 0; k < c->num_chunks && !err; k++)
+    {
+      const size_t y0 = (k / c->chunks_across) * c->rows_per_chunk;
+      const size_t rows = tiled ? c->rows_per_chunk : MIN(c->rows_per_chunk, c->height - y0);
+      const tmsize_t size = rows * c->chunk_width * c->layers * c->bpp / 8;
+      _pack_chunk(c, k, buf);
+      err = tiled ? (TIFFWriteEncodedTile(tif, k, buf, size) == -1)
+                  : (TIFFWriteEncodedStrip(tif, k, buf, size) == -1);
+    }
+    free(buf);
+    return err;
+  }
+
+  const size_t nthreads = dt_get_num_threads();
+  const size_t batch = MIN(c->num_chunks, 4 * nthreads);
+  const size_t dest_size = compressBound(c->chunk_size);
+  // per thread: one chunk, plus one row for the floating point predictor
+  const size_t scratch_size = c->chunk_size + c->chunk_width * c->layers * sizeof(float);
+
+  uint8_t *dest = malloc(batch * dest_size);
+  uint8_t *scratch = malloc(nthreads * scratch_size);
+  size_t *lengths = malloc(batch * sizeof(size_t));
+  int err = (!dest || !scratch || !lengths);
+
+  for(size_t start = 0; start < c->num_chunks && !err; start += batch)
+  {
+    const size_t count = MIN(batch, c->num_chunks - start);
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(c, start, count, dest, dest_size, scratch, scratch_size, lengths) \
+  schedule(dynamic)
+#endif
+    for(size_t k = 0; k < count; k++)
+      lengths[k] = _encode_chunk(c, start + k, scratch + dt_get_thread_num() * scratch_size,
+                                 dest + k * dest_size, dest_size);
+
+    for(size_t k = 0; k < count && !err; k++)
+    {
+      if(lengths[k] == 0)
+        err = 1;
+      else if(tiled)
+        err = TIFFWriteRawTile(tif, start + k, dest + k * dest_size, lengths[k]) == -1;
+      else
+        err = TIFFWriteRawStrip(tif, start + k, dest + k * dest_size, lengths[k]) == -1;
+    }
+  }
+
+  free(lengths);
+  free(scratch);
+  free(dest);
+  return err;
+}
+
+
+// the exif tags of the image directory taken from the metadata, write_image() sets the others itself
+static gboolean _is_image_tag(const uint16_t tag)
+{
+  switch(tag)
+  {
+    case TIFFTAG_IMAGEDESCRIPTION:
+    case TIFFTAG_MAKE:
+    case TIFFTAG_MODEL:
+    case TIFFTAG_SOFTWARE:
+    case TIFFTAG_DATETIME:
+    case TIFFTAG_ARTIST:
+    case TIFFTAG_HOSTCOMPUTER:
+    case TIFFTAG_COPYRIGHT:
+      return TRUE;
+    default:
+      return FALSE;
+  }
+}
+
+static double _exif_value(const dt_exif_tag_t *t, const uint32_t k)
+{
+  switch(t->type)
+  {
+    case TIFF_BYTE:
+    case TIFF_UNDEFINED:
+      return t->data[k];
+    case TIFF_SBYTE:
+      return ((const int8_t *)t->data)[k];
+    case TIFF_SHORT:
+      return ((const uint16_t *)t->data)[k];
+    case TIFF_SSHORT:
+      return ((const int16_t *)t->data)[k];
+    case TIFF_LONG:
+      return ((const uint32_t *)t->data)[k];
+    case TIFF_SLONG:
+      return ((const int32_t *)t->data)[k];
+    case TIFF_RATIONAL:
+    {
+      const uint32_t *r = (const uint32_t *)t->data + 2 * k;
+      return r[1] ? (double)r[0] / r[1] : 0.0;
+    }
+    case TIFF_SRATIONAL:
+    {
+      const int32_t *r = (const int32_t *)t->data + 2 * k;
+      return r[1] ? (double)r[0] / r[1] : 0.0;
+    }
+    case TIFF_FLOAT:
+      return ((const float *)t->data)[k];
+    case TIFF_DOUBLE:
+      return ((const double *)t->data)[k];
+    default:
+      return 0.0;
+  }
+}
+
+// set an exif tag in the current directory, converted to what libtiff expects for it. returns FALSE for the
+// tags libtiff doesn't know in this directory.
+static gboolean _set_exif_tag(TIFF *tif, const dt_exif_tag_t *t)
+{
+  const TIFFField *fip = TIFFFindField(tif, t->tag, TIFF_ANY);
+  if(!fip) return FALSE;
+
+  const TIFFDataType type = TIFFFieldDataType(fip);
+  if(type == TIFF_ASCII || t->type == TIFF_ASCII)
+  {
+    if(type != t->type) return FALSE;
+    char *value = g_strndup((const char *)t->data, t->count);
+    const int ok = TIFFSetField(tif, t->tag, value);
+    g_free(value);
+    return ok;
+  }
+
+  const int passcount = TIFFFieldPassCount(fip);
+  const int readcount = TIFFFieldReadCount(fip);
+  if(!passcount && readcount == 1)
+  {
+    const double v = _exif_value(t, 0);
+    switch(type)
+    {
+      case TIFF_RATIONAL:
+      case TIFF_SRATIONAL:
+      case TIFF_FLOAT:
+      case TIFF_DOUBLE:
+        return TIFFSetField(tif, t->tag, v);
+      case TIFF_LONG:
+        return TIFFSetField(tif, t->tag, (uint32_t)v);
+      case TIFF_SLONG:
+        return TIFFSetField(tif, t->tag, (int32_t)v);
+      default:
+        return TIFFSetField(tif, t->tag, (int)v);
+    }
+  }
+  // arrays of a fixed size only take that size
+  if(!passcount && readcount != (int)t->count) return FALSE;
+  if(passcount && readcount != TIFF_VARIABLE2 && t->count > UINT16_MAX) return FALSE;
+
+  size_t size;
+  switch(type)
+  {
+    case TIFF_BYTE:
+    case TIFF_SBYTE:
+    case TIFF_UNDEFINED:
+      size = 1;
+      break;
+    case TIFF_SHORT:
+    case TIFF_SSHORT:
+      size = 2;
+      break;
+    case TIFF_LONG:
+    case TIFF_SLONG:
+      size = 4;
+      break;
+    case TIFF_RATIONAL:
+    case TIFF_SRATIONAL:
+    case TIFF_FLOAT:
+      // rational arrays are floats, unless libtiff says they are doubles
+#if TIFFLIB_VERSION >= 20201219
+      size = TIFFFieldSetGetSize(fip);
+#else
+      size = 4;
+#endif
+      break;
+    case TIFF_DOUBLE:
+      size = 8;
+      break;
+    default:
+      return FALSE;
+  }
+
+  uint8_t *values = g_malloc(size * t->count);
+  for(uint32_t k = 0; k < t->count; k++)
+  {
+    const double v = _exif_value(t, k);
+    void *out = values + k * size;
+    switch(type)
+    {
+      case TIFF_SBYTE:
+        *(int8_t *)out = (int8_t)v;
+        break;
+      case TIFF_SHORT:
+        *(uint16_t *)out = (uint16_t)v;
+        break;
+      case TIFF_SSHORT:
+        *(int16_t *)out = (int16_t)v;
+        break;
+      case TIFF_LONG:
+        *(uint32_t *)out = (uint32_t)v;
+        break;
+      case TIFF_SLONG:
+        *(int32_t *)out = (int32_t)v;
+        break;
+      case TIFF_RATIONAL:
+      case TIFF_SRATIONAL:
+      case TIFF_FLOAT:
+      case TIFF_DOUBLE:
+        if(size == 8)
+          *(double *)out = v;
+        else
+          *(float *)out = (float)v;
+        break;
+      default:
+        *(uint8_t *)out = (uint8_t)v;
+        break;
+    }
+  }
+
+  int ok;
+  if(!passcount)
+    ok = TIFFSetField(tif, t->tag, values);
+  else if(readcount == TIFF_VARIABLE2)
+    ok = TIFFSetField(tif, t->tag, (uint32_t)t->count, values);
+  else
+    ok = TIFFSetField(tif, t->tag, (int)t->count, values);
+  g_free(values);
+  return ok;
+}
+
+static int _set_exif_tags(TIFF *tif, GList *tags, const dt_exif_ifd_t ifd)
+{
+  int count = 0;
+  for(GList *iter = tags; iter; iter = g_list_next(iter))
+  {
+    const dt_exif_tag_t *t = (dt_exif_tag_t *)iter->data;
+    if(t->ifd != ifd || (ifd == DT_EXIF_IFD_IMAGE && !_is_image_tag(t->tag))) continue;
+    if(_set_exif_tag(tif, t)) count++;
+  }
+  return count;
+}
+
+static gboolean _has_exif_tags(GList *tags, const dt_exif_ifd_t ifd)
+{
+  for(GList *iter = tags; iter; iter = g_list_next(iter))
+    if(((dt_exif_tag_t *)iter->data)->ifd == ifd) return TRUE;
+  return FALSE;
+}
+
+static int _set_iptc(TIFF *tif, const uint8_t *iptc, const size_t iptc_size)
+{
+  const TIFFField *fip = TIFFFindField(tif, TIFFTAG_RICHTIFFIPTC, TIFF_ANY);
+  if(!fip || iptc_size == 0) return 0;
+
+  // the block is padded to whole longs, as some libtiff versions declare it as such
+  const size_t padded = (iptc_size + 3) & ~(size_t)3;
+  uint8_t *block = g_malloc0(padded);
+  memcpy(block, iptc, iptc_size);
+  int ok;
+  if(TIFFFieldDataType(fip) == TIFF_LONG)
+    ok = TIFFSetField(tif, TIFFTAG_RICHTIFFIPTC, (uint32_t)(padded / 4), block);
+  else
+    ok = TIFFSetField(tif, TIFFTAG_RICHTIFFIPTC, (uint32_t)padded, block);
+  g_free(block);
+  return !ok;
+}
+
+// writes the image directory, then the exif and gps directories, and links them from the image directory.
+// only the directories are written again, not the image data.
+static int _write_exif_directories(TIFF *tif, GList *tags)
+{
+  toff_t exif_offset = 0, gps_offset = 0;
+
+  if(!TIFFWriteDirectory(tif)) return 1;
+
+  if(_has_exif_tags(tags, DT_EXIF_IFD_PHOTO))
+  {
+    if(TIFFCreateEXIFDirectory(tif)) return 1;
+    _set_exif_tags(tif, tags, DT_EXIF_IFD_PHOTO);
+    if(!TIFFWriteCustomDirectory(tif, &exif_offset)) return 1;
+    TIFFFreeDirectory(tif);
+  }
+
+#if TIFFLIB_VERSION >= 20191103
+  if(_has_exif_tags(tags, DT_EXIF_IFD_GPS))
+  {
+    if(TIFFCreateGPSDirectory(tif)) return 1;
+    _set_exif_tags(tif, tags, DT_EXIF_IFD_GPS);
+    if(!TIFFWriteCustomDirectory(tif, &gps_offset)) return 1;
+    TIFFFreeDirectory(tif);
+  }
+#endif
+
+  if(!exif_offset && !gps_offset) return 0;
+
+  // back to the image directory to add the links
+  if(!TIFFSetDirectory(tif, 0)) return 1;
+  if(exif_offset) TIFFSetField(tif, TIFFTAG_EXIFIFD, (uint64_t)exif_offset);
+  if(gps_offset) TIFFSetField(tif, TIFFTAG_GPSIFD, (uint64_t)gps_offset);
+  return !TIFFRewriteDirectory(tif);
+}
 
 int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const void *in_void,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+                const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
   const dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
 
@@ -70,12 +591,12 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   TIFF *tif = NULL;
 
   void *rowdata = NULL;
+  GList *exif_tags = NULL;
 
   gboolean free_mask = FALSE;
   float *raster_mask = NULL;
-#ifdef _WIN32
-  wchar_t *wfilename = g_utf8_to_utf16(filename, -1, NULL, NULL, NULL);
-#endif
+  _tiff_memstream_t ms = { 0 };
+  gboolean in_memory = FALSE;
   int rc = 1; // default to error
 
   if(imgid > 0)
@@ -102,12 +623,14 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
       n_pages += g_hash_table_size(((dt_dev_pixelpipe_iop_t *)iter->data)->raster_masks);
   }
 
+  /* The memory stream costs up to three copies of the file at the end: libtiff's, the one exiv2 writes the
+     metadata into and the result. Larger files are written directly, with the metadata set as tiff tags. */
+  const size_t file_size = (size_t)d->global.width * d->global.height * (3 * d->bpp / 8 + (n_pages - 1) * 4);
+  in_memory = 3 * file_size <= dt_get_available_mem() / 4;
+  _tiff_memstream_t *mem = in_memory ? &ms : NULL;
+
   // Create little endian tiff image
-#ifdef _WIN32
-  tif = TIFFOpenW(wfilename, "wl");
-#else
-  tif = TIFFOpen(filename, "wl");
-#endif
+  tif = _tiff_open(filename, "wl", mem);
 
   if(!tif)
   {
@@ -239,102 +762,98 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
 
   TIFFSetField(tif, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG);
   TIFFSetField(tif, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT);
-  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
+
+  _tiff_chunks_t chunks = { .in = in_void,
+                            .width = d->global.width,
+                            .height = d->global.height,
+                            .tiled = d->tiled,
+                            .layers = layers,
+                            .bpp = d->bpp,
+                            .compress = d->compress,
+                            .compresslevel = d->compresslevel };
+  if(d->tiled)
+  {
+    TIFFSetField(tif, TIFFTAG_TILEWIDTH, (uint32_t)TIFF_TILE_SIZE);
+    TIFFSetField(tif, TIFFTAG_TILELENGTH, (uint32_t)TIFF_TILE_SIZE);
+    chunks.chunk_width = chunks.rows_per_chunk = TIFF_TILE_SIZE;
+    chunks.chunks_across = (chunks.width + TIFF_TILE_SIZE - 1) / TIFF_TILE_SIZE;
+    chunks.num_chunks = chunks.chunks_across * ((chunks.height + TIFF_TILE_SIZE - 1) / TIFF_TILE_SIZE);
+  }
+  else
+  {
+    chunks.rows_per_chunk = TIFFDefaultStripSize(tif, 0);
+    TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32_t)chunks.rows_per_chunk);
+    chunks.chunk_width = chunks.width;
+    chunks.chunks_across = 1;
+    chunks.num_chunks = (chunks.height + chunks.rows_per_chunk - 1) / chunks.rows_per_chunk;
+  }
+  chunks.chunk_size = chunks.chunk_width * chunks.rows_per_chunk * layers * d->bpp / 8;
 
   const int resolution = dt_conf_get_int("metadata/resolution");
   TIFFSetField(tif, TIFFTAG_XRESOLUTION, (float)resolution);
   TIFFSetField(tif, TIFFTAG_YRESOLUTION, (float)resolution);
   TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, RESUNIT_INCH);
 
-  const size_t rowsize = (d->global.width * layers) * d->bpp / 8;
-  if((rowdata = malloc(rowsize)) == NULL)
-  {
-    rc = 1;
-    goto exit;
-  }
-
-  if(d->bpp == 32)
+  if(!in_memory && (exif || metadata))
   {
-    for(int y = 0; y < d->global.height; y++)
+    char *xmp = NULL;
+    uint8_t *iptc = NULL;
+    size_t xmp_size = 0, iptc_size = 0;
+    if(dt_exif_get_export_metadata(exif, exif_len, d->compress > 0, imgid, metadata, &exif_tags, &xmp, &xmp_size,
+                                   &iptc, &iptc_size)
+       && exif)
     {
-      float *in = (float *)in_void + (size_t)4 * y * d->global.width;
-      float *out = (float *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        memcpy(out, in, sizeof(float) * layers);
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
+      rc = 1;
+      goto exit;
     }
+    _set_exif_tags(tif, exif_tags, DT_EXIF_IFD_IMAGE);
+    if(xmp) TIFFSetField(tif, TIFFTAG_XMLPACKET, (uint32_t)xmp_size, xmp);
+    _set_iptc(tif, iptc, iptc_size);
+    g_free(xmp);
+    g_free(iptc);
   }
-  else if(d->bpp == 16)
-  {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      uint16_t *in = (uint16_t *)in_void + (size_t)4 * y * d->global.width;
-      uint16_t *out = (uint16_t *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        memcpy(out, in, sizeof(uint16_t) * layers);
-      }
 
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-  else
+  if(_write_chunks(tif, &chunks))
   {
-    for(int y = 0; y < d->global.height; y++)
-    {
-      uint8_t *in = (uint8_t *)in_void + (size_t)4 * y * d->global.width;
-      uint8_t *out = (uint8_t *)rowdata;
-
-      for(int x = 0; x < d->global.width; x++, in += 4, out += layers)
-      {
-        memcpy(out, in, sizeof(uint8_t) * layers);
-      }
+    rc = 1;
+    goto exit;
+  }
 
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
+  // the exif and gps directories go after the image data, in the same write
+  if(exif_tags && _write_exif_directories(tif, exif_tags))
+  {
+    rc = 1;
+    goto exit;
   }
 
   rc = 0;
 
-  // close the file before adding exif data
+  // close the image before adding exif data
   if(tif)
   {
     TIFFClose(tif);
     tif = NULL;
   }
-  if(exif)
+  if(in_memory && (exif || metadata))
   {
-    rc = dt_exif_write_blob(exif, exif_len, filename, d->compress > 0);
-    // Until we get symbolic error status codes, if rc is 1, return 0
-    rc = (rc == 1) ? 0 : 1;
+    size_t size = 0;
+    uint8_t *complete = dt_exif_embed_metadata(ms.data, ms.size, exif, exif_len, d->compress > 0, imgid, metadata,
+                                               &size);
+    if(complete)
+    {
+      g_free(ms.data);
+      ms.data = complete;
+      ms.size = ms.capacity = size;
+    }
+    else if(exif)
+      rc = 1;
   }
 
   // exiv2 doesn't support multi page tiffs. so we have to write in two steps. :-(
 
   if(rc == 0 && n_pages > 1)
   {
-#ifdef _WIN32
-    tif = TIFFOpenW(wfilename, "al");
-#else
-    tif = TIFFOpen(filename, "al");
-#endif
+    tif = _tiff_open(filename, "al", mem);
 
     if(!tif)
     {
@@ -421,11 +940,12 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
           TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, PHOTOMETRIC_MINISBLACK);
         TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, TIFFDefaultStripSize(tif, 0));
 
-        if(w != d->global.width)
+        // the scanline of the mask page, converted to the format of the image
+        free(rowdata);
+        if((rowdata = malloc((w * layers) * d->bpp / 8)) == NULL)
         {
-          free(rowdata);
-          const size_t _rowsize = (w * layers) * d->bpp / 8;
-          rowdata = malloc(_rowsize);
+          rc = 1;
+          goto exit;
         }
 
         if(d->bpp == 32)
@@ -527,13 +1047,17 @@ exit:
     TIFFClose(tif);
     tif = NULL;
   }
+  if(rc == 0 && in_memory)
+  {
+    rc = dt_imageio_write_buffer(filename, ms.data, ms.size, g_free);
+    ms.data = NULL;
+  }
+  g_free(ms.data);
   free(profile);
   profile = NULL;
   free(rowdata);
   rowdata = NULL;
-#ifdef _WIN32
-  g_free(wfilename);
-#endif
+  g_list_free_full(exif_tags, g_free);
   if(free_mask)
     dt_free_align(raster_mask);
 
@@ -568,7 +1092,7 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
                     const size_t old_params_size, const int old_version, const int new_version,
                     size_t *new_size)
 {
-  if(old_version == 1 && new_version == 3)
+  if(old_version == 1 && new_version == 4)
   {
     typedef struct dt_imageio_tiff_v1_t
     {
@@ -596,7 +1120,7 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
     *new_size = self->params_size(self);
     return n;
   }
-  else if(old_version == 2 && new_version == 3)
+  else if(old_version == 2 && new_version == 4)
   {
     typedef struct dt_imageio_tiff_v2_t
     {
@@ -625,6 +1149,31 @@ void *legacy_params(dt_imageio_module_format_t *self, const void *const old_para
     *new_size = self->params_size(self);
     return n;
   }
+  else if(old_version == 3 && new_version == 4)
+  {
+    typedef struct dt_imageio_tiff_v3_t
+    {
+      dt_imageio_module_data_t global;
+      int bpp;
+      int compress;
+      int compresslevel;
+      int shortfile;
+      TIFF *handle;
+    } dt_imageio_tiff_v3_t;
+
+    const dt_imageio_tiff_v3_t *o = (dt_imageio_tiff_v3_t *)old_params;
+    dt_imageio_tiff_t *n = (dt_imageio_tiff_t *)calloc(1, sizeof(dt_imageio_tiff_t));
+
+    n->global = o->global;
+    n->bpp = o->bpp;
+    n->compress = o->compress;
+    n->compresslevel = o->compresslevel;
+    n->shortfile = o->shortfile;
+    n->tiled = 0;
+    n->handle = o->handle;
+    *new_size = self->params_size(self);
+    return n;
+  }
   return NULL;
 }
 
@@ -661,6 +1210,8 @@ void *get_params(dt_imageio_module_format_t *self)
     d->shortfile = dt_conf_get_int("plugins/imageio/format/tiff/shortfile");
   }
 
+  d->tiled = dt_conf_get_int("plugins/imageio/format/tiff/tiled");
+
   return d;
 }
 
@@ -687,6 +1238,8 @@ int set_params(dt_imageio_module_format_t *self, const void *params, const int s
   dt_bauhaus_slider_set(g->compresslevel, d->compresslevel);
 
   dt_bauhaus_combobox_set(g->shortfiles, d->shortfile);
+
+  dt_bauhaus_combobox_set(g->tiled, d->tiled);
   return 0;
 }
 
@@ -742,6 +1295,12 @@ static void shortfile_combobox_changed(GtkWidget *widget, gpointer user_data)
   dt_conf_set_int("plugins/imageio/format/tiff/shortfile", mode);
 }
 
+static void tiled_combobox_changed(GtkWidget *widget, gpointer user_data)
+{
+  const int tiled = dt_bauhaus_combobox_get(widget);
+  dt_conf_set_int("plugins/imageio/format/tiff/tiled", tiled);
+}
+
 static void compress_combobox_changed(GtkWidget *widget, gpointer user_data)
 {
   const int compress = dt_bauhaus_combobox_get(widget);
@@ -846,6 +1405,17 @@ void gui_init(dt_imageio_module_format_t *self)
   dt_bauhaus_combobox_set(gui->shortfiles, shortmode);
   gtk_box_pack_start(GTK_BOX(self->widget), gui->shortfiles, TRUE, TRUE, 0);
   g_signal_connect(G_OBJECT(gui->shortfiles), "value-changed", G_CALLBACK(shortfile_combobox_changed), NULL);
+
+  // strips or tiles layout combo box
+  gui->tiled = dt_bauhaus_combobox_new(NULL);
+  dt_bauhaus_widget_set_label(gui->tiled, NULL, N_("layout"));
+  dt_bauhaus_combobox_add(gui->tiled, _("strips"));
+  dt_bauhaus_combobox_add(gui->tiled, _("tiles"));
+  dt_bauhaus_combobox_set(gui->tiled, dt_conf_get_int("plugins/imageio/format/tiff/tiled"));
+  gtk_widget_set_tooltip_text(gui->tiled, _("tiled files let other applications read a region\n"
+                                            "of the image without decoding the whole file"));
+  gtk_box_pack_start(GTK_BOX(self->widget), gui->tiled, TRUE, TRUE, 0);
+  g_signal_connect(G_OBJECT(gui->tiled), "value-changed", G_CALLBACK(tiled_combobox_changed), NULL);
 }
 
 void gui_cleanup(dt_imageio_module_format_t *self)
@@ -859,11 +1429,12 @@ void gui_reset(dt_imageio_module_format_t *self)
   dt_bauhaus_combobox_set(gui->bpp, 0); //8bpp
   dt_bauhaus_slider_set(gui->compresslevel, dt_confgen_get_int("plugins/imageio/format/tiff/compresslevel", DT_DEFAULT));
   dt_bauhaus_combobox_set(gui->shortfiles, dt_confgen_get_int("plugins/imageio/format/tiff/shortfile", DT_DEFAULT));
+  dt_bauhaus_combobox_set(gui->tiled, dt_confgen_get_int("plugins/imageio/format/tiff/tiled", DT_DEFAULT));
 }
 
 int flags(dt_imageio_module_data_t *data)
 {
-  return FORMAT_FLAGS_SUPPORT_XMP | FORMAT_FLAGS_SUPPORT_LAYERS;
+  return FORMAT_FLAGS_SUPPORT_XMP | FORMAT_FLAGS_SUPPORT_LAYERS | FORMAT_FLAGS_EMBED_XMP;
 }
 
 // clang-format off
@@ -115,28 +115,20 @@ void cleanup(dt_imageio_module_format_t *self)
 {
 }
 
-static int FileWriter(const uint8_t *data, size_t data_size, const WebPPicture *const pic)
-{
-  FILE *const out = (FILE *)pic->custom_ptr;
-  return data_size ? (fwrite(data, data_size, 1, out) == 1) : 1;
-}
 
 int write_image(dt_imageio_module_data_t *webp, const char *filename, const void *in_tmp,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+                const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
-  FILE *out = NULL;
   WebPPicture pic;
   int pic_init = 0;
+  // encode in memory, so the metadata can be embedded before the file is written, once
+  WebPMemoryWriter writer;
+  WebPMemoryWriterInit(&writer);
+  uint8_t *complete = NULL;
 
   dt_imageio_webp_t *webp_data = (dt_imageio_webp_t *)webp;
-  out = g_fopen(filename, "w+b");
-  if (!out)
-  {
-    fprintf(stderr, "[webp export] error saving to %s\n", filename);
-    goto error;
-  }
 
   // Create, configure and validate a WebPConfig instance
   WebPConfig config;
@@ -162,8 +154,8 @@ int write_image(dt_imageio_module_data_t *webp, const char *filename, const void
   pic.width = webp_data->global.width;
   pic.height = webp_data->global.height;
   pic.use_argb = !!(config.lossless);
-  pic.writer = FileWriter;
-  pic.custom_ptr = out;
+  pic.writer = WebPMemoryWrite;
+  pic.custom_ptr = &writer;
 
   WebPPictureImportRGBX(&pic, (const uint8_t *)in_tmp, webp_data->global.width * 4);
   if(!config.lossless)
@@ -183,15 +175,32 @@ int write_image(dt_imageio_module_data_t *webp, const char *filename, const void
   }
 
   WebPPictureFree(&pic);
-  fclose(out);
+  pic_init = 0;
 
-  dt_exif_write_blob(exif, exif_len, filename, 1);
+  size_t size = 0;
+  if(exif || metadata)
+    complete = dt_exif_embed_metadata(writer.mem, writer.size, exif, exif_len, 1, imgid, metadata, &size);
+  if(!complete)
+  {
+    // write the image without metadata rather than nothing. the encoded data belongs to libwebp
+    size = writer.size;
+    complete = g_try_malloc(size);
+    if(!complete) goto error;
+    memcpy(complete, writer.mem, size);
+  }
+  WebPMemoryWriterClear(&writer);
 
+  if(dt_imageio_write_buffer(filename, complete, size, g_free))
+  {
+    fprintf(stderr, "[webp export] error saving to %s\n", filename);
+    return 1;
+  }
   return 0;
 
 error:
   if (pic_init) WebPPictureFree(&pic);
-  if(out) fclose(out);
+  g_free(complete);
+  WebPMemoryWriterClear(&writer);
   return 1;
 }
 
@@ -382,7 +391,7 @@ void gui_reset(dt_imageio_module_format_t *self)
 int flags(dt_imageio_module_data_t *data)
 {
   // TODO(jinxos): support embedded ICC
-  return FORMAT_FLAGS_SUPPORT_XMP;
+  return FORMAT_FLAGS_SUPPORT_XMP | FORMAT_FLAGS_EMBED_XMP;
 }
 
 // clang-format off
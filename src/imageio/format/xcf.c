@@ -49,7 +49,7 @@ typedef struct dt_imageio_xcf_t
 int write_image(dt_imageio_module_data_t *data, const char *filename, const void *ivoid,
                 dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                 void *exif, int exif_len, int imgid, int num, int total, struct dt_dev_pixelpipe_t *pipe,
-                const gboolean export_masks)
+                const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
   const dt_imageio_xcf_t *const d = (dt_imageio_xcf_t *)data;
 
@@ -37,11 +37,15 @@
 #endif
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 DT_MODULE(3)
 
+// maximum number of encoded files held in memory, waiting to be written to their destination
+#define DISK_MAX_PENDING_WRITES 4
+
 typedef enum dt_disk_onconflict_actions_t
 {
   DT_EXPORT_ONCONFLICT_UNIQUEFILENAME = 0,
@@ -62,8 +66,24 @@ typedef struct dt_imageio_disk_t
   char filename[DT_MAX_PATH_FOR_PARAMS];
   dt_disk_onconflict_actions_t onsave_action;
   dt_variables_params_t *vp;
+
+  // runtime state of the write-behind queue, not part of the saved params
+  GThreadPool *writer;        // single I/O thread writing exported files to their destination
+  GHashTable *pending;        // destination filenames reserved but not written yet
+  int queued;                 // number of files waiting for the I/O thread
+  int failed;                 // number of files the I/O thread could not write
+  dt_pthread_mutex_t lock;
+  pthread_cond_t written;
 } dt_imageio_disk_t;
 
+// an exported file encoded in memory, waiting to be written to its destination
+typedef struct _disk_write_t
+{
+  dt_imageio_held_write_t *write;
+  int num;
+  int total;
+} _disk_write_t;
+
 
 const char *name(const struct dt_imageio_module_storage_t *self)
 {
@@ -113,6 +133,70 @@ void *legacy_params(dt_imageio_module_storage_t *self, const void *const old_par
   return NULL;
 }
 
+static gboolean _is_pending(dt_imageio_disk_t *d, const char *filename)
+{
+  dt_pthread_mutex_lock(&d->lock);
+  const gboolean pending = g_hash_table_contains(d->pending, filename);
+  dt_pthread_mutex_unlock(&d->lock);
+  return pending;
+}
+
+static void _release_pending(dt_imageio_disk_t *d, const char *filename, const gboolean queued,
+                             const gboolean failed)
+{
+  dt_pthread_mutex_lock(&d->lock);
+  g_hash_table_remove(d->pending, filename);
+  if(queued) d->queued--;
+  if(failed) d->failed++;
+  pthread_cond_broadcast(&d->written);
+  dt_pthread_mutex_unlock(&d->lock);
+}
+
+static int _failed_writes(dt_imageio_disk_t *d)
+{
+  dt_pthread_mutex_lock(&d->lock);
+  const int failed = d->failed;
+  dt_pthread_mutex_unlock(&d->lock);
+  return failed;
+}
+
+// runs on the I/O thread: writing to a slow destination (network share, usb stick) now overlaps with the
+// processing of the next image.
+static void _write_behind(gpointer data, gpointer user_data)
+{
+  _disk_write_t *job = (_disk_write_t *)data;
+  dt_imageio_disk_t *d = (dt_imageio_disk_t *)user_data;
+  const char *filename = job->write->filename;
+
+  const gboolean failed = dt_imageio_held_write_save(job->write) != 0;
+  if(!failed)
+  {
+    fprintf(stderr, "[export_job] exported to `%s'\n", filename);
+    dt_control_log(ngettext("%d/%d exported to `%s'", "%d/%d exported to `%s'", job->num),
+                   job->num, job->total, filename);
+  }
+  else
+  {
+    fprintf(stderr, "[imageio_storage_disk] could not write to file: `%s'!\n", filename);
+    dt_control_log(_("could not export to file `%s'!"), filename);
+  }
+
+  _release_pending(d, filename, TRUE, failed);
+
+  dt_imageio_held_write_free(job->write);
+  free(job);
+}
+
+// wait for the I/O thread to write all the queued files
+static void _flush_writes(dt_imageio_disk_t *d)
+{
+  if(d->writer)
+  {
+    g_thread_pool_free(d->writer, FALSE, TRUE);
+    d->writer = NULL;
+  }
+}
+
 static void button_clicked(GtkWidget *widget, dt_imageio_module_storage_t *self)
 {
   disk_t *d = (disk_t *)self->gui_data;
@@ -297,7 +381,7 @@ try_again:
     if(!fail && d->onsave_action == DT_EXPORT_ONCONFLICT_UNIQUEFILENAME)
     {
       int seq = 1;
-      while(g_file_test(filename, G_FILE_TEST_EXISTS))
+      while(g_file_test(filename, G_FILE_TEST_EXISTS) || _is_pending(d, filename))
       {
         snprintf(c, filename_free_space, "_%.2d.%s", seq, ext);
         seq++;
@@ -306,7 +390,7 @@ try_again:
 
     if(!fail && d->onsave_action == DT_EXPORT_ONCONFLICT_SKIP)
     {
-      if(g_file_test(filename, G_FILE_TEST_EXISTS))
+      if(g_file_test(filename, G_FILE_TEST_EXISTS) || _is_pending(d, filename))
       {
         dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
         fprintf(stderr, "[export_job] skipping `%s'\n", filename);
@@ -315,28 +399,74 @@ try_again:
         return 0;
       }
     }
+
+    // reserve the filename until the I/O thread has written it
+    if(!fail)
+    {
+      dt_pthread_mutex_lock(&d->lock);
+      g_hash_table_add(d->pending, g_strdup(filename));
+      dt_pthread_mutex_unlock(&d->lock);
+    }
   } // end of critical block
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
   if(fail) return 1;
 
+  /* write-behind: formats building their file in memory hand it over instead of writing it, and the I/O
+     thread writes it while we process the next image. The others (png, pdf, ...) write it themselves. */
+  const gboolean write_behind = dt_conf_get_bool("plugins/imageio/storage/disk/write_behind");
+
   /* export image to file */
-  if(dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, TRUE, export_masks, icc_type,
-                       icc_filename, icc_intent, self, sdata, num, total, metadata) != 0)
+  dt_imageio_hold_writes(write_behind);
+  const int res = dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, TRUE, export_masks,
+                                    icc_type, icc_filename, icc_intent, self, sdata, num, total, metadata);
+  dt_imageio_hold_writes(FALSE);
+  dt_imageio_held_write_t *write = dt_imageio_take_held_write();
+
+  if(res != 0)
   {
     fprintf(stderr, "[imageio_storage_disk] could not export to file: `%s'!\n", filename);
     dt_control_log(_("could not export to file `%s'!"), filename);
+    dt_imageio_held_write_free(write);
+    _release_pending(d, filename, FALSE, FALSE);
     return 1;
   }
 
+  if(write)
+  {
+    // bound the memory held by the encoded files when the destination is slow
+    dt_pthread_mutex_lock(&d->lock);
+    while(d->queued >= DISK_MAX_PENDING_WRITES) dt_pthread_cond_wait(&d->written, &d->lock);
+    d->queued++;
+    if(!d->writer) d->writer = g_thread_pool_new(_write_behind, d, 1, FALSE, NULL);
+    dt_pthread_mutex_unlock(&d->lock);
+
+    _disk_write_t *job = (_disk_write_t *)malloc(sizeof(_disk_write_t));
+    job->write = write;
+    job->num = num;
+    job->total = total;
+    g_thread_pool_push(d->writer, job, NULL);
+    // report the files the I/O thread failed to write so far, so that the export stops
+    return _failed_writes(d) ? 1 : 0;
+  }
+
+  _release_pending(d, filename, FALSE, FALSE);
+
   fprintf(stderr, "[export_job] exported to `%s'\n", filename);
   dt_control_log(ngettext("%d/%d exported to `%s'", "%d/%d exported to `%s'", num),
                  num, total, filename);
-  return 0;
+  return _failed_writes(d) ? 1 : 0;
+}
+
+int finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *data)
+{
+  dt_imageio_disk_t *d = (dt_imageio_disk_t *)data;
+  _flush_writes(d);
+  return _failed_writes(d) ? 1 : 0;
 }
 
 size_t params_size(dt_imageio_module_storage_t *self)
 {
-  return sizeof(dt_imageio_disk_t) - sizeof(void *);
+  return offsetof(dt_imageio_disk_t, vp);
 }
 
 void init(dt_imageio_module_storage_t *self)
@@ -359,6 +489,13 @@ void *get_params(dt_imageio_module_storage_t *self)
   d->vp = NULL;
   dt_variables_params_init(&d->vp);
 
+  d->writer = NULL;
+  d->pending = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  d->queued = 0;
+  d->failed = 0;
+  dt_pthread_mutex_init(&d->lock, NULL);
+  pthread_cond_init(&d->written, NULL);
+
   return d;
 }
 
@@ -366,6 +503,10 @@ void free_params(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *pa
 {
   if(!params) return;
   dt_imageio_disk_t *d = (dt_imageio_disk_t *)params;
+  _flush_writes(d);
+  g_hash_table_destroy(d->pending);
+  dt_pthread_mutex_destroy(&d->lock);
+  pthread_cond_destroy(&d->written);
   dt_variables_params_destroy(d->vp);
   free(params);
 }
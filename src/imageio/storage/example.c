@@ -181,7 +181,7 @@ void free_params(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *pa
   free(params);
 }
 
-void finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *params)
+int finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *params)
 {
   dt_imageio_email_t *d = (dt_imageio_email_t *)params;
 
@@ -250,6 +250,7 @@ void finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t
   {
     dt_control_log(_("could not launch email client!"));
   }
+  return 0;
 }
 
 int supported(struct dt_imageio_module_storage_t *storage, struct dt_imageio_module_format_t *format)
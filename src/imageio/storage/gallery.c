@@ -396,7 +396,7 @@ int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, co
   return 0;
 }
 
-void finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *dd)
+int finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *dd)
 {
   dt_imageio_gallery_t *d = (dt_imageio_gallery_t *)dd;
   char filename[PATH_MAX] = { 0 };
@@ -438,7 +438,7 @@ void finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t
   const char *title = d->title;
 
   FILE *f = g_fopen(filename, "wb");
-  if(!f) return;
+  if(!f) return 1;
   fprintf(f,
           "<!DOCTYPE html PUBLIC \"-//W3C//DTD XHTML 1.0 Transitional//EN\" "
           "\"http://www.w3.org/TR/xhtml1/DTD/xhtml1-transitional.dtd\">\n"
@@ -537,6 +537,7 @@ void finalize_store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t
              "</script>\n"
              "</html>\n");
   fclose(f);
+  return 0;
 }
 
 size_t params_size(dt_imageio_module_storage_t *self)
@@ -71,8 +71,9 @@ REQUIRED(int, store, struct dt_imageio_module_storage_t *self, struct dt_imageio
                      const int total, const gboolean high_quality, const gboolean upscale, const gboolean export_masks,
                      const enum dt_colorspaces_color_profile_type_t icc_type, const gchar *icc_filename,
                      enum dt_iop_color_intent_t icc_intent, struct dt_export_metadata_t *metadata);
-/* called once at the end (after exporting all images), if implemented. */
-OPTIONAL(void, finalize_store, struct dt_imageio_module_storage_t *self, struct dt_imageio_module_data_t *data);
+/* called once at the end (after exporting all images), if implemented. returns non-zero if some images
+   could not be stored after all. */
+OPTIONAL(int, finalize_store, struct dt_imageio_module_storage_t *self, struct dt_imageio_module_data_t *data);
 
 OPTIONAL(void *, legacy_params, struct dt_imageio_module_storage_t *self, const void *const old_params,
                  const size_t old_params_size, const int old_version, const int new_version,
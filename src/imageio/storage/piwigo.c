@@ -942,9 +942,10 @@ static gboolean _finalize_store(gpointer user_data)
   return FALSE;
 }
 
-void finalize_store(struct dt_imageio_module_storage_t *self, dt_imageio_module_data_t *data)
+int finalize_store(struct dt_imageio_module_storage_t *self, dt_imageio_module_data_t *data)
 {
   g_main_context_invoke(NULL, _finalize_store, self->gui_data);
+  return 0;
 }
 
 int store(dt_imageio_module_storage_t *self, dt_imageio_module_data_t *sdata, const int imgid,
@@ -26,6 +26,7 @@
 #include "common/imagebuf.h"
 #include "common/interpolation.h"
 #include "common/math.h"
+#include "common/mipmap_cache.h"
 #include "common/opencl.h"
 #include "control/control.h"
 #include "develop/develop.h"
@@ -113,7 +114,7 @@
 #include "ashift_nmsimplex.c"
 
 
-DT_MODULE_INTROSPECTION(5, dt_iop_ashift_params_t)
+DT_MODULE_INTROSPECTION(6, dt_iop_ashift_params_t)
 
 
 const char *name()
@@ -256,6 +257,16 @@ typedef enum dt_iop_ashift_crop_t
   ASHIFT_CROP_ASPECT = 2  // $DESCRIPTION: "original format"
 } dt_iop_ashift_crop_t;
 
+// fit applied to the lines of each image the params are copied to, through a style
+// or a copy of the history
+typedef enum dt_iop_ashift_autofit_t
+{
+  ASHIFT_AUTOFIT_OFF = 0,          // $DESCRIPTION: "off"
+  ASHIFT_AUTOFIT_VERTICALLY = 1,   // $DESCRIPTION: "vertical"
+  ASHIFT_AUTOFIT_HORIZONTALLY = 2, // $DESCRIPTION: "horizontal"
+  ASHIFT_AUTOFIT_BOTH = 3          // $DESCRIPTION: "both"
+} dt_iop_ashift_autofit_t;
+
 typedef enum dt_iop_ashift_bounding_t
 {
   ASHIFT_BOUNDING_OFF = 0,
@@ -331,6 +342,27 @@ typedef struct dt_iop_ashift_params4_t
   float cb;
 } dt_iop_ashift_params4_t;
 
+typedef struct dt_iop_ashift_params5_t
+{
+  float rotation;
+  float lensshift_v;
+  float lensshift_h;
+  float shear;
+  float f_length;
+  float crop_factor;
+  float orthocorr;
+  float aspect;
+  dt_iop_ashift_mode_t mode;
+  dt_iop_ashift_crop_t cropmode;
+  float cl;
+  float cr;
+  float ct;
+  float cb;
+  float last_drawn_lines[MAX_SAVED_LINES * 4];
+  int last_drawn_lines_count;
+  float last_quad_lines[8];
+} dt_iop_ashift_params5_t;
+
 typedef struct dt_iop_ashift_params_t
 {
   float rotation;    // $MIN: -ROTATION_RANGE_SOFT $MAX: ROTATION_RANGE_SOFT $DEFAULT: 0.0
@@ -350,6 +382,12 @@ typedef struct dt_iop_ashift_params_t
   float last_drawn_lines[MAX_SAVED_LINES * 4];
   int last_drawn_lines_count;
   float last_quad_lines[8];
+  dt_iop_ashift_autofit_t autofit; // $DEFAULT: ASHIFT_AUTOFIT_OFF $DESCRIPTION: "fit other images"
+  // lines of the last automatic detection, relative to the size of the pipe input
+  float last_auto_lines[MAX_SAVED_LINES * 4];
+  float last_auto_weights[MAX_SAVED_LINES];
+  int last_auto_lines_count;
+  int last_auto_imgid;             // the image they were detected on
 } dt_iop_ashift_params_t;
 
 typedef struct dt_iop_ashift_line_t
@@ -410,6 +448,41 @@ typedef struct dt_iop_ashift_cropfit_params_t
   float edges[4][3];
 } dt_iop_ashift_cropfit_params_t;
 
+// the lines found by the automatic detection on a preview buffer. as long as the
+// preview input doesn't change, a new detection (or fit) starts from a copy of them
+// instead of running LSD again.
+typedef struct dt_iop_ashift_detection_t
+{
+  uint64_t buf_hash;
+  int width;
+  int height;
+  int x_off;
+  int y_off;
+  float scale;
+  dt_iop_ashift_enhance_t enhance;
+  dt_iop_ashift_line_t *lines;
+  int lines_count;
+  int vertical_count;
+  int horizontal_count;
+  float vertical_weight;
+  float horizontal_weight;
+} dt_iop_ashift_detection_t;
+
+// a set of lines to fit the model to, in input coordinates of the pipe they were found in
+typedef struct dt_iop_ashift_structure_t
+{
+  dt_iop_ashift_line_t *lines;
+  int lines_count;
+  int width;
+  int height;
+  int x_off;
+  int y_off;
+  int vertical_count;
+  int horizontal_count;
+  float vertical_weight;
+  float horizontal_weight;
+} dt_iop_ashift_structure_t;
+
 typedef struct dt_iop_ashift_gui_data_t
 {
   GtkWidget *rotation;
@@ -417,6 +490,7 @@ typedef struct dt_iop_ashift_gui_data_t
   GtkWidget *lensshift_h;
   GtkWidget *shear;
   GtkWidget *cropmode;
+  GtkWidget *autofit;
   GtkWidget *mode;
   GtkWidget *specifics;
   GtkWidget *f_length;
@@ -454,6 +528,7 @@ typedef struct dt_iop_ashift_gui_data_t
   int lines_version;
   float vertical_weight;
   float horizontal_weight;
+  dt_iop_ashift_detection_t detection;
   float *points;
   dt_iop_ashift_points_idx_t *points_idx;
   int points_lines_count;
@@ -513,10 +588,19 @@ typedef struct dt_iop_ashift_global_data_t
   int kernel_ashift_lanczos3;
 } dt_iop_ashift_global_data_t;
 
+static void _clear_auto_lines(dt_iop_ashift_params_t *p)
+{
+  p->autofit = ASHIFT_AUTOFIT_OFF;
+  for(int i = 0; i < MAX_SAVED_LINES * 4; i++) p->last_auto_lines[i] = 0.0f;
+  for(int i = 0; i < MAX_SAVED_LINES; i++) p->last_auto_weights[i] = 0.0f;
+  p->last_auto_lines_count = 0;
+  p->last_auto_imgid = 0;
+}
+
 int legacy_params(dt_iop_module_t *self, const void *const old_params, const int old_version,
                   void *new_params, const int new_version)
 {
-  if(old_version == 1 && new_version == 5)
+  if(old_version == 1 && new_version == 6)
   {
     const dt_iop_ashift_params1_t *old = old_params;
     dt_iop_ashift_params_t *new = new_params;
@@ -537,9 +621,10 @@ int legacy_params(dt_iop_module_t *self, const void *const old_params, const int
     for(int i = 0; i < MAX_SAVED_LINES * 4; i++) new->last_drawn_lines[i] = 0.0f;
     for(int i = 0; i < 8; i++) new->last_quad_lines[i] = 0.0f;
     new->last_drawn_lines_count = 0;
+    _clear_auto_lines(new);
     return 0;
   }
-  if(old_version == 2 && new_version == 5)
+  if(old_version == 2 && new_version == 6)
   {
     const dt_iop_ashift_params2_t *old = old_params;
     dt_iop_ashift_params_t *new = new_params;
@@ -560,9 +645,10 @@ int legacy_params(dt_iop_module_t *self, const void *const old_params, const int
     for(int i = 0; i < MAX_SAVED_LINES * 4; i++) new->last_drawn_lines[i] = 0.0f;
     for(int i = 0; i < 8; i++) new->last_quad_lines[i] = 0.0f;
     new->last_drawn_lines_count = 0;
+    _clear_auto_lines(new);
     return 0;
   }
-  if(old_version == 3 && new_version == 5)
+  if(old_version == 3 && new_version == 6)
   {
     const dt_iop_ashift_params3_t *old = old_params;
     dt_iop_ashift_params_t *new = new_params;
@@ -583,9 +669,10 @@ int legacy_params(dt_iop_module_t *self, const void *const old_params, const int
     for(int i = 0; i < MAX_SAVED_LINES * 4; i++) new->last_drawn_lines[i] = 0.0f;
     for(int i = 0; i < 8; i++) new->last_quad_lines[i] = 0.0f;
     new->last_drawn_lines_count = 0;
+    _clear_auto_lines(new);
     return 0;
   }
-  if(old_version == 4 && new_version == 5)
+  if(old_version == 4 && new_version == 6)
   {
     const dt_iop_ashift_params4_t *old = old_params;
     dt_iop_ashift_params_t *new = new_params;
@@ -606,6 +693,15 @@ int legacy_params(dt_iop_module_t *self, const void *const old_params, const int
     for(int i = 0; i < MAX_SAVED_LINES * 4; i++) new->last_drawn_lines[i] = 0.0f;
     for(int i = 0; i < 8; i++) new->last_quad_lines[i] = 0.0f;
     new->last_drawn_lines_count = 0;
+    _clear_auto_lines(new);
+    return 0;
+  }
+  if(old_version == 5 && new_version == 6)
+  {
+    const dt_iop_ashift_params5_t *old = old_params;
+    dt_iop_ashift_params_t *new = new_params;
+    memcpy(new, old, sizeof(dt_iop_ashift_params5_t));
+    _clear_auto_lines(new);
     return 0;
   }
 
@@ -955,6 +1051,35 @@ static inline int isneutral(const dt_iop_ashift_data_t *data)
          1.0f - data->cb < eps);
 }
 
+// the homography parameters of the model, as the pipe uses them
+static void _params_to_data(const dt_iop_ashift_params_t *const p, dt_iop_ashift_data_t *d)
+{
+  d->rotation = p->rotation;
+  d->lensshift_v = p->lensshift_v;
+  d->lensshift_h = p->lensshift_h;
+  d->shear = p->shear;
+  d->f_length_kb = (p->mode == ASHIFT_MODE_GENERIC) ? DEFAULT_F_LENGTH : p->f_length * p->crop_factor;
+  d->orthocorr = (p->mode == ASHIFT_MODE_GENERIC) ? 0.0f : p->orthocorr;
+  d->aspect = (p->mode == ASHIFT_MODE_GENERIC) ? 1.0f : p->aspect;
+}
+
+// the fit done for each setting of the automatic fit, same as the default of the fit buttons
+static inline dt_iop_ashift_fitaxis_t _autofit_axis(const dt_iop_ashift_autofit_t autofit)
+{
+  switch(autofit)
+  {
+    case ASHIFT_AUTOFIT_VERTICALLY:
+      return ASHIFT_FIT_VERTICALLY;
+    case ASHIFT_AUTOFIT_HORIZONTALLY:
+      return ASHIFT_FIT_HORIZONTALLY;
+    case ASHIFT_AUTOFIT_BOTH:
+      return ASHIFT_FIT_BOTH_SHEAR;
+    case ASHIFT_AUTOFIT_OFF:
+    default:
+      return ASHIFT_FIT_NONE;
+  }
+}
+
 
 int distort_transform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, float *const restrict points, size_t points_count)
 {
@@ -1611,6 +1736,7 @@ error:
 static int _get_structure(dt_iop_module_t *module, dt_iop_ashift_enhance_t enhance)
 {
   dt_iop_ashift_gui_data_t *g = (dt_iop_ashift_gui_data_t *)module->gui_data;
+  dt_iop_ashift_detection_t *d = &g->detection;
 
   float *buffer = NULL;
   int width = 0;
@@ -1618,6 +1744,8 @@ static int _get_structure(dt_iop_module_t *module, dt_iop_ashift_enhance_t enhan
   int x_off = 0;
   int y_off = 0;
   float scale = 0.0f;
+  uint64_t hash = 0;
+  gboolean cached = FALSE;
 
   dt_iop_gui_enter_critical_section(module);
   // read buffer data if they are available
@@ -1628,15 +1756,22 @@ static int _get_structure(dt_iop_module_t *module, dt_iop_ashift_enhance_t enhan
     x_off = g->buf_x_off;
     y_off = g->buf_y_off;
     scale = g->buf_scale;
+    hash = g->buf_hash;
+
+    cached = d->lines != NULL && d->buf_hash == hash && d->enhance == enhance && d->width == width
+             && d->height == height && d->x_off == x_off && d->y_off == y_off && d->scale == scale;
 
     // create a temporary buffer to hold image data
-    buffer = malloc(sizeof(float) * 4 * (size_t)width * height);
-    if(buffer != NULL)
-      dt_iop_image_copy_by_size(buffer, g->buf, width, height, 4);
+    if(!cached)
+    {
+      buffer = malloc(sizeof(float) * 4 * (size_t)width * height);
+      if(buffer != NULL)
+        dt_iop_image_copy_by_size(buffer, g->buf, width, height, 4);
+    }
   }
   dt_iop_gui_leave_critical_section(module);
 
-  if(buffer == NULL) goto error;
+  if(buffer == NULL && !cached) goto error;
 
   // get rid of old structural data
   g->lines_count = 0;
@@ -1645,29 +1780,46 @@ static int _get_structure(dt_iop_module_t *module, dt_iop_ashift_enhance_t enhan
   free(g->lines);
   g->lines = NULL;
 
-  dt_iop_ashift_line_t *lines;
-  int lines_count;
-  int vertical_count;
-  int horizontal_count;
-  float vertical_weight;
-  float horizontal_weight;
+  if(!cached)
+  {
+    dt_iop_ashift_line_t *lines;
+    int lines_count;
+    int vertical_count;
+    int horizontal_count;
+    float vertical_weight;
+    float horizontal_weight;
 
-  // get new structural data
-  if(!line_detect(buffer, width, height, x_off, y_off, scale, &lines, &lines_count,
-                  &vertical_count, &horizontal_count, &vertical_weight, &horizontal_weight,
-                  enhance, dt_image_is_raw(&module->dev->image_storage)))
-    goto error;
+    // get new structural data
+    if(!line_detect(buffer, width, height, x_off, y_off, scale, &lines, &lines_count,
+                    &vertical_count, &horizontal_count, &vertical_weight, &horizontal_weight,
+                    enhance, dt_image_is_raw(&module->dev->image_storage)))
+      goto error;
+
+    free(d->lines);
+    *d = (dt_iop_ashift_detection_t){ .buf_hash = hash, .width = width, .height = height,
+                                      .x_off = x_off, .y_off = y_off, .scale = scale,
+                                      .enhance = enhance, .lines = lines, .lines_count = lines_count,
+                                      .vertical_count = vertical_count,
+                                      .horizontal_count = horizontal_count,
+                                      .vertical_weight = vertical_weight,
+                                      .horizontal_weight = horizontal_weight };
+  }
+
+  // the module changes the type of its lines, keep the detected ones untouched
+  dt_iop_ashift_line_t *lines = malloc(sizeof(dt_iop_ashift_line_t) * d->lines_count);
+  if(lines == NULL) goto error;
+  memcpy(lines, d->lines, sizeof(dt_iop_ashift_line_t) * d->lines_count);
 
   // save new structural data
   g->lines_in_width = width;
   g->lines_in_height = height;
   g->lines_x_off = x_off;
   g->lines_y_off = y_off;
-  g->lines_count = lines_count;
-  g->vertical_count = vertical_count;
-  g->horizontal_count = horizontal_count;
-  g->vertical_weight = vertical_weight;
-  g->horizontal_weight = horizontal_weight;
+  g->lines_count = d->lines_count;
+  g->vertical_count = d->vertical_count;
+  g->horizontal_count = d->horizontal_count;
+  g->vertical_weight = d->vertical_weight;
+  g->horizontal_weight = d->horizontal_weight;
   g->lines_version++;
   g->lines = lines;
 
@@ -1910,34 +2062,32 @@ static void ransac(const dt_iop_ashift_line_t *lines, int *index_set, int *inout
 
 // try to clean up structural data by eliminating outliers and thereby increasing
 // the chance of a convergent fitting
-static int _remove_outliers(dt_iop_module_t *module)
+static int _remove_outliers_structure(dt_iop_ashift_structure_t *s)
 {
-  dt_iop_ashift_gui_data_t *g = (dt_iop_ashift_gui_data_t *)module->gui_data;
-
-  const int width = g->lines_in_width;
-  const int height = g->lines_in_height;
-  const int xmin = g->lines_x_off;
-  const int ymin = g->lines_y_off;
+  const int width = s->width;
+  const int height = s->height;
+  const int xmin = s->x_off;
+  const int ymin = s->y_off;
   const int xmax = xmin + width;
   const int ymax = ymin + height;
 
   // holds the index set of lines we want to work on
-  int *lines_set = malloc(sizeof(int) * g->lines_count);
+  int *lines_set = malloc(sizeof(int) * s->lines_count);
   // holds the result of ransac
-  int *inout_set = malloc(sizeof(int) * g->lines_count);
+  int *inout_set = malloc(sizeof(int) * s->lines_count);
 
   // some accounting variables
   int vnb = 0, vcount = 0;
   int hnb = 0, hcount = 0;
 
   // just to be on the safe side
-  if(g->lines == NULL) goto error;
+  if(s->lines == NULL) goto error;
 
   // generate index list for the vertical lines
-  for(int n = 0; n < g->lines_count; n++)
+  for(int n = 0; n < s->lines_count; n++)
   {
     // is this a selected vertical line?
-    if((g->lines[n].type & ASHIFT_LINE_MASK) != ASHIFT_LINE_VERTICAL_SELECTED)
+    if((s->lines[n].type & ASHIFT_LINE_MASK) != ASHIFT_LINE_VERTICAL_SELECTED)
       continue;
 
     lines_set[vnb] = n;
@@ -1947,7 +2097,7 @@ static int _remove_outliers(dt_iop_module_t *module)
 
   // it only makes sense to call ransac if we have more than two lines
   if(vnb > 2)
-    ransac(g->lines, lines_set, inout_set, vnb, g->vertical_weight,
+    ransac(s->lines, lines_set, inout_set, vnb, s->vertical_weight,
            xmin, xmax, ymin, ymax);
 
   // adjust line selected flag according to the ransac results
@@ -1956,21 +2106,20 @@ static int _remove_outliers(dt_iop_module_t *module)
     const int m = lines_set[n];
     if(inout_set[n] == 1)
     {
-      g->lines[m].type |= ASHIFT_LINE_SELECTED;
+      s->lines[m].type |= ASHIFT_LINE_SELECTED;
       vcount++;
     }
     else
-      g->lines[m].type &= ~ASHIFT_LINE_SELECTED;
+      s->lines[m].type &= ~ASHIFT_LINE_SELECTED;
   }
   // update number of vertical lines
-  g->vertical_count = vcount;
-  g->lines_version++;
+  s->vertical_count = vcount;
 
   // now generate index list for the horizontal lines
-  for(int n = 0; n < g->lines_count; n++)
+  for(int n = 0; n < s->lines_count; n++)
   {
     // is this a selected horizontal line?
-    if((g->lines[n].type & ASHIFT_LINE_MASK) != ASHIFT_LINE_HORIZONTAL_SELECTED)
+    if((s->lines[n].type & ASHIFT_LINE_MASK) != ASHIFT_LINE_HORIZONTAL_SELECTED)
       continue;
 
     lines_set[hnb] = n;
@@ -1980,7 +2129,7 @@ static int _remove_outliers(dt_iop_module_t *module)
 
   // it only makes sense to call ransac if we have more than two lines
   if(hnb > 2)
-    ransac(g->lines, lines_set, inout_set, hnb, g->horizontal_weight,
+    ransac(s->lines, lines_set, inout_set, hnb, s->horizontal_weight,
            xmin, xmax, ymin, ymax);
 
   // adjust line selected flag according to the ransac results
@@ -1989,15 +2138,14 @@ static int _remove_outliers(dt_iop_module_t *module)
     const int m = lines_set[n];
     if(inout_set[n] == 1)
     {
-      g->lines[m].type |= ASHIFT_LINE_SELECTED;
+      s->lines[m].type |= ASHIFT_LINE_SELECTED;
       hcount++;
     }
     else
-      g->lines[m].type &= ~ASHIFT_LINE_SELECTED;
+      s->lines[m].type &= ~ASHIFT_LINE_SELECTED;
   }
   // update number of horizontal lines
-  g->horizontal_count = hcount;
-  g->lines_version++;
+  s->horizontal_count = hcount;
 
   free(inout_set);
   free(lines_set);
@@ -2010,6 +2158,32 @@ error:
   return FALSE;
 }
 
+// the structure the gui works on
+static inline dt_iop_ashift_structure_t _gui_structure(const dt_iop_ashift_gui_data_t *const g)
+{
+  return (dt_iop_ashift_structure_t){ .lines = g->lines, .lines_count = g->lines_count,
+                                      .width = g->lines_in_width, .height = g->lines_in_height,
+                                      .x_off = g->lines_x_off, .y_off = g->lines_y_off,
+                                      .vertical_count = g->vertical_count,
+                                      .horizontal_count = g->horizontal_count,
+                                      .vertical_weight = g->vertical_weight,
+                                      .horizontal_weight = g->horizontal_weight };
+}
+
+// the same on the lines of the gui
+static int _remove_outliers(dt_iop_module_t *module)
+{
+  dt_iop_ashift_gui_data_t *g = (dt_iop_ashift_gui_data_t *)module->gui_data;
+
+  dt_iop_ashift_structure_t s = _gui_structure(g);
+  if(!_remove_outliers_structure(&s)) return FALSE;
+
+  g->vertical_count = s.vertical_count;
+  g->horizontal_count = s.horizontal_count;
+  g->lines_version++;
+  return TRUE;
+}
+
 // utility function to map a variable in [min; max] to [-INF; + INF]
 static inline double logit(double x, double min, double max)
 {
@@ -2159,11 +2333,13 @@ static double model_fitness(double *params, void *data)
 }
 
 // setup all data structures for fitting and call NM simplex
-static dt_iop_ashift_nmsresult_t nmsfit(dt_iop_module_t *module, dt_iop_ashift_params_t *p, dt_iop_ashift_fitaxis_t dir)
+// ranges holds the allowed ranges of rotation, vertical and horizontal lens shift, and shear.
+// the fitted parameters of d are replaced on success.
+static dt_iop_ashift_nmsresult_t _nmsfit_structure(const dt_iop_ashift_structure_t *const s,
+                                                   dt_iop_ashift_data_t *d, const float *const ranges,
+                                                   const int isflipped, dt_iop_ashift_fitaxis_t dir)
 {
-  dt_iop_ashift_gui_data_t *g = (dt_iop_ashift_gui_data_t *)module->gui_data;
-
-  if(!g->lines) return NMS_NOT_ENOUGH_LINES;
+  if(!s->lines) return NMS_NOT_ENOUGH_LINES;
   if(dir == ASHIFT_FIT_NONE) return NMS_SUCCESS;
 
   double params[4];
@@ -2172,21 +2348,21 @@ static dt_iop_ashift_nmsresult_t nmsfit(dt_iop_module_t *module, dt_iop_ashift_p
 
   // initialize fit parameters
   dt_iop_ashift_fit_params_t fit;
-  fit.lines = g->lines;
-  fit.lines_count = g->lines_count;
-  fit.width = g->lines_in_width;
-  fit.height = g->lines_in_height;
-  fit.f_length_kb = (p->mode == ASHIFT_MODE_GENERIC) ? DEFAULT_F_LENGTH : p->f_length * p->crop_factor;
-  fit.orthocorr = (p->mode == ASHIFT_MODE_GENERIC) ? 0.0f : p->orthocorr;
-  fit.aspect = (p->mode == ASHIFT_MODE_GENERIC) ? 1.0f : p->aspect;
-  fit.rotation = p->rotation;
-  fit.lensshift_v = p->lensshift_v;
-  fit.lensshift_h = p->lensshift_h;
-  fit.shear = p->shear;
-  fit.rotation_range = g->rotation_range;
-  fit.lensshift_v_range = g->lensshift_v_range;
-  fit.lensshift_h_range = g->lensshift_h_range;
-  fit.shear_range = g->shear_range;
+  fit.lines = s->lines;
+  fit.lines_count = s->lines_count;
+  fit.width = s->width;
+  fit.height = s->height;
+  fit.f_length_kb = d->f_length_kb;
+  fit.orthocorr = d->orthocorr;
+  fit.aspect = d->aspect;
+  fit.rotation = d->rotation;
+  fit.lensshift_v = d->lensshift_v;
+  fit.lensshift_h = d->lensshift_h;
+  fit.shear = d->shear;
+  fit.rotation_range = ranges[0];
+  fit.lensshift_v_range = ranges[1];
+  fit.lensshift_h_range = ranges[2];
+  fit.shear_range = ranges[3];
   fit.linetype = ASHIFT_LINE_RELEVANT | ASHIFT_LINE_SELECTED;
   fit.linemask = ASHIFT_LINE_MASK;
   fit.params_count = 0;
@@ -2199,7 +2375,7 @@ static dt_iop_ashift_nmsresult_t nmsfit(dt_iop_module_t *module, dt_iop_ashift_p
      (mdir & ASHIFT_FIT_LENS_BOTH) != 0)
   {
     // flip all directions
-    mdir ^= g->isflipped ? ASHIFT_FIT_FLIP : 0;
+    mdir ^= isflipped ? ASHIFT_FIT_FLIP : 0;
     // special case that needs to be corrected
     mdir |= (mdir & ASHIFT_FIT_LINES_BOTH) == 0 ? ASHIFT_FIT_LINES_BOTH : 0;
   }
@@ -2250,16 +2426,16 @@ static dt_iop_ashift_nmsresult_t nmsfit(dt_iop_module_t *module, dt_iop_ashift_p
   {
     // we use vertical lines for fitting
     fit.linetype |= ASHIFT_LINE_DIRVERT;
-    fit.weight += g->vertical_weight;
-    enough_lines = enough_lines && (g->vertical_count >= MINIMUM_FITLINES);
+    fit.weight += s->vertical_weight;
+    enough_lines = enough_lines && (s->vertical_count >= MINIMUM_FITLINES);
   }
 
   if(mdir & ASHIFT_FIT_LINES_HOR)
   {
     // we use horizontal lines for fitting
     fit.linetype |= 0;
-    fit.weight += g->horizontal_weight;
-    enough_lines = enough_lines && (g->horizontal_count >= MINIMUM_FITLINES);
+    fit.weight += s->horizontal_weight;
+    enough_lines = enough_lines && (s->horizontal_count >= MINIMUM_FITLINES);
   }
 
   // this needs to come after ASHIFT_FIT_LINES_VERT and ASHIFT_FIT_LINES_HOR
@@ -2336,11 +2512,31 @@ static dt_iop_ashift_nmsresult_t nmsfit(dt_iop_module_t *module, dt_iop_ashift_p
     return NMS_INSANE;
   }
 
-  // now write the results into structure p
-  p->rotation = fit.rotation;
-  p->lensshift_v = fit.lensshift_v;
-  p->lensshift_h = fit.lensshift_h;
-  p->shear = fit.shear;
+  // now write the results into structure d
+  d->rotation = fit.rotation;
+  d->lensshift_v = fit.lensshift_v;
+  d->lensshift_h = fit.lensshift_h;
+  d->shear = fit.shear;
+  return NMS_SUCCESS;
+}
+
+// fit the params to the lines of the gui
+static dt_iop_ashift_nmsresult_t nmsfit(dt_iop_module_t *module, dt_iop_ashift_params_t *p, dt_iop_ashift_fitaxis_t dir)
+{
+  dt_iop_ashift_gui_data_t *g = (dt_iop_ashift_gui_data_t *)module->gui_data;
+
+  const dt_iop_ashift_structure_t s = _gui_structure(g);
+  const float ranges[4] = { g->rotation_range, g->lensshift_v_range, g->lensshift_h_range, g->shear_range };
+  dt_iop_ashift_data_t d = { 0 };
+  _params_to_data(p, &d);
+
+  const dt_iop_ashift_nmsresult_t res = _nmsfit_structure(&s, &d, ranges, g->isflipped, dir);
+  if(res != NMS_SUCCESS) return res;
+
+  p->rotation = d.rotation;
+  p->lensshift_v = d.lensshift_v;
+  p->lensshift_h = d.lensshift_h;
+  p->shear = d.shear;
   return NMS_SUCCESS;
 }
 
@@ -2516,44 +2712,20 @@ static double crop_fitness(double *params, void *data)
 // we calculate the largest crop area that still lies within the output image;
 // now we allow a Nelder-Mead simplex to search for the center coordinates
 // (and optionally the aspect angle) that delivers the largest overall crop area.
-static void do_crop(dt_iop_module_t *module, dt_iop_ashift_params_t *p)
+// the clipping margins of data are set on success.
+static gboolean _crop_fit(dt_iop_ashift_data_t *data, const dt_iop_ashift_crop_t cropmode,
+                          const int width, const int height)
 {
-  dt_iop_ashift_gui_data_t *g = (dt_iop_ashift_gui_data_t *)module->gui_data;
-
-  // if sizes are not ready (module disabled), just ignore this
-  if(g->buf_width == 0 || g->buf_height == 0) return;
-
-  // skip if fitting is still running
-  if(g->fitting) return;
-
-  // reset fit margins if auto-cropping is off
-  if(p->cropmode == ASHIFT_CROP_OFF)
-  {
-    _clear_shadow_crop_box(g);
-    _commit_crop_box(p, g);
-    return;
-  }
-
-  g->fitting = 1;
-
   double params[3];
   int pcount;
 
-  // get parameters for the homograph
-  const float f_length_kb = (p->mode == ASHIFT_MODE_GENERIC) ? DEFAULT_F_LENGTH : p->f_length * p->crop_factor;
-  const float orthocorr = (p->mode == ASHIFT_MODE_GENERIC) ? 0.0f : p->orthocorr;
-  const float aspect = (p->mode == ASHIFT_MODE_GENERIC) ? 1.0f : p->aspect;
-  const float rotation = p->rotation;
-  const float lensshift_v = p->lensshift_v;
-  const float lensshift_h = p->lensshift_h;
-  const float shear = p->shear;
-
   // prepare structure of constant parameters
   dt_iop_ashift_cropfit_params_t cropfit;
-  cropfit.width = g->buf_width;
-  cropfit.height = g->buf_height;
-  homography((float *)cropfit.homograph, rotation, lensshift_v, lensshift_h, shear, f_length_kb,
-             orthocorr, aspect, cropfit.width, cropfit.height, ASHIFT_HOMOGRAPH_FORWARD);
+  cropfit.width = width;
+  cropfit.height = height;
+  homography((float *)cropfit.homograph, data->rotation, data->lensshift_v, data->lensshift_h, data->shear,
+             data->f_length_kb, data->orthocorr, data->aspect, cropfit.width, cropfit.height,
+             ASHIFT_HOMOGRAPH_FORWARD);
 
   const float wd = cropfit.width;
   const float ht = cropfit.height;
@@ -2591,7 +2763,7 @@ static void do_crop(dt_iop_module_t *module, dt_iop_ashift_params_t *p)
 
   // initial fit parameters: crop area is centered and aspect angle is that of the original image
   // number of parameters: fit only crop center coordinates with a fixed aspect ratio, or fit all three variables
-  if(p->cropmode == ASHIFT_CROP_LARGEST)
+  if(cropmode == ASHIFT_CROP_LARGEST)
   {
     params[0] = 0.5;
     params[1] = 0.5;
@@ -2601,7 +2773,7 @@ static void do_crop(dt_iop_module_t *module, dt_iop_ashift_params_t *p)
     cropfit.alpha = NAN;
     pcount = 3;
   }
-  else //(p->cropmode == ASHIFT_CROP_ASPECT)
+  else //(cropmode == ASHIFT_CROP_ASPECT)
   {
     params[0] = 0.5;
     params[1] = 0.5;
@@ -2615,7 +2787,7 @@ static void do_crop(dt_iop_module_t *module, dt_iop_ashift_params_t *p)
   const int iter = simplex(crop_fitness, params, pcount, NMS_CROP_EPSILON, NMS_CROP_SCALE, NMS_CROP_ITERATIONS,
                            crop_constraint, (void*)&cropfit);
   // in case the fit did not converge -> failed
-  if(iter >= NMS_CROP_ITERATIONS) goto failed;
+  if(iter >= NMS_CROP_ITERATIONS) return FALSE;
 
   // the fit did converge -> get clipping margins out of params:
   cropfit.x = isnan(cropfit.x) ? params[0] : cropfit.x;
@@ -2626,7 +2798,7 @@ static void do_crop(dt_iop_module_t *module, dt_iop_ashift_params_t *p)
   const float A = fabs(crop_fitness(params, (void*)&cropfit));
 
   // unlikely to happen but we need to catch this case
-  if(A == 0.0f) goto failed;
+  if(A == 0.0f) return FALSE;
 
   // we need the half diagonal of that rectangle (this is in output image dimensions);
   // no need to check for division by zero here as this case implies A == 0.0f, caught above
@@ -2642,20 +2814,53 @@ static void do_crop(dt_iop_module_t *module, dt_iop_ashift_params_t *p)
   P[1] /= P[2];
 
   // calculate clipping margins relative to output image dimensions
-  g->cl = CLAMP((P[0] - d * cosf(cropfit.alpha)) / owd, 0.0f, 1.0f);
-  g->cr = CLAMP((P[0] + d * cosf(cropfit.alpha)) / owd, 0.0f, 1.0f);
-  g->ct = CLAMP((P[1] - d * sinf(cropfit.alpha)) / oht, 0.0f, 1.0f);
-  g->cb = CLAMP((P[1] + d * sinf(cropfit.alpha)) / oht, 0.0f, 1.0f);
+  data->cl = CLAMP((P[0] - d * cosf(cropfit.alpha)) / owd, 0.0f, 1.0f);
+  data->cr = CLAMP((P[0] + d * cosf(cropfit.alpha)) / owd, 0.0f, 1.0f);
+  data->ct = CLAMP((P[1] - d * sinf(cropfit.alpha)) / oht, 0.0f, 1.0f);
+  data->cb = CLAMP((P[1] + d * sinf(cropfit.alpha)) / oht, 0.0f, 1.0f);
 
   // final sanity check
-  if(g->cr - g->cl <= 0.0f || g->cb - g->ct <= 0.0f) goto failed;
-
-  g->fitting = 0;
+  if(data->cr - data->cl <= 0.0f || data->cb - data->ct <= 0.0f) return FALSE;
 
 #ifdef ASHIFT_DEBUG
   printf("margins after crop fitting: iter %d, x %f, y %f, angle %f, crop area (%f %f %f %f), width %f, height %f\n",
-         iter, cropfit.x, cropfit.y, cropfit.alpha, g->cl, g->cr, g->ct, g->cb, wd, ht);
+         iter, cropfit.x, cropfit.y, cropfit.alpha, data->cl, data->cr, data->ct, data->cb, wd, ht);
 #endif
+  return TRUE;
+}
+
+// fit the crop box of the gui to the params
+static void do_crop(dt_iop_module_t *module, dt_iop_ashift_params_t *p)
+{
+  dt_iop_ashift_gui_data_t *g = (dt_iop_ashift_gui_data_t *)module->gui_data;
+
+  // if sizes are not ready (module disabled), just ignore this
+  if(g->buf_width == 0 || g->buf_height == 0) return;
+
+  // skip if fitting is still running
+  if(g->fitting) return;
+
+  // reset fit margins if auto-cropping is off
+  if(p->cropmode == ASHIFT_CROP_OFF)
+  {
+    _clear_shadow_crop_box(g);
+    _commit_crop_box(p, g);
+    return;
+  }
+
+  g->fitting = 1;
+
+  dt_iop_ashift_data_t data = { 0 };
+  _params_to_data(p, &data);
+  if(!_crop_fit(&data, p->cropmode, g->buf_width, g->buf_height)) goto failed;
+
+  g->cl = data.cl;
+  g->cr = data.cr;
+  g->ct = data.ct;
+  g->cb = data.cb;
+
+  g->fitting = 0;
+
   dt_control_queue_redraw_center();
   return;
 
@@ -2671,6 +2876,249 @@ failed:
   return;
 }
 
+// find out if the final output of the pipe is flipped in relation to this iop
+static int _is_flipped(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece)
+{
+  // origin of image and opposite corner as reference points
+  dt_boundingbox_t points = { 0.0f, 0.0f, (float)piece->buf_in.width, (float)piece->buf_in.height };
+  float ivec[2] = { points[2] - points[0], points[3] - points[1] };
+  float ivecl = sqrtf(ivec[0] * ivec[0] + ivec[1] * ivec[1]);
+
+  // where do they go?
+  dt_dev_distort_backtransform_plus(self->dev, piece->pipe, self->iop_order,
+                                    DT_DEV_TRANSFORM_DIR_FORW_EXCL, points, 2);
+
+  float ovec[2] = { points[2] - points[0], points[3] - points[1] };
+  float ovecl = sqrtf(ovec[0] * ovec[0] + ovec[1] * ovec[1]);
+
+  // angle between input vector and output vector
+  float alpha = acos(CLAMP((ivec[0] * ovec[0] + ivec[1] * ovec[1]) / (ivecl * ovecl), -1.0f, 1.0f));
+
+  // we are interested if |alpha| is in the range of 90° +/- 45° -> we assume the image is flipped
+  return fabs(fmod(alpha + M_PI, M_PI) - M_PI / 2.0f) < M_PI / 4.0f ? 1 : 0;
+}
+
+// sort lines by decreasing weight
+static int _line_weight_cmp(const void *a, const void *b)
+{
+  const float wa = ((const dt_iop_ashift_line_t *)a)->weight;
+  const float wb = ((const dt_iop_ashift_line_t *)b)->weight;
+  return (wa < wb) - (wa > wb);
+}
+
+static void _store_auto_lines(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_iop_ashift_params_t *p,
+                              const dt_iop_ashift_line_t *lines, const int lines_count)
+{
+  // keep the selected lines of an automatic detection, so fitting again later on does
+  // not need a new detection. like the drawn lines they are saved in "original image"
+  // reference, but relative to its size to be independent of the pipe they were found in.
+
+  if(!lines || pipe->iwidth <= 0 || pipe->iheight <= 0) return;
+
+  dt_iop_ashift_line_t *selected = malloc(sizeof(dt_iop_ashift_line_t) * lines_count);
+  if(selected == NULL) return;
+
+  int count = 0;
+  for(int i = 0; i < lines_count; i++)
+  {
+    const dt_iop_ashift_linetype_t type = lines[i].type & ASHIFT_LINE_MASK;
+    if(type == ASHIFT_LINE_VERTICAL_SELECTED || type == ASHIFT_LINE_HORIZONTAL_SELECTED)
+      selected[count++] = lines[i];
+  }
+
+  // too many of them: keep the ones weighting most in the fit
+  if(count > MAX_SAVED_LINES)
+  {
+    qsort(selected, count, sizeof(dt_iop_ashift_line_t), _line_weight_cmp);
+    count = MAX_SAVED_LINES;
+  }
+
+  float pts[MAX_SAVED_LINES * 4] = { 0.0f };
+  for(int i = 0; i < count; i++)
+  {
+    pts[i * 4    ] = selected[i].p1[0];
+    pts[i * 4 + 1] = selected[i].p1[1];
+    pts[i * 4 + 2] = selected[i].p2[0];
+    pts[i * 4 + 3] = selected[i].p2[1];
+  }
+
+  if(count > 0
+     && dt_dev_distort_backtransform_plus(self->dev, pipe, self->iop_order, DT_DEV_TRANSFORM_DIR_BACK_EXCL,
+                                          pts, count * 2))
+  {
+    for(int i = 0; i < count; i++)
+    {
+      p->last_auto_lines[i * 4    ] = pts[i * 4    ] / pipe->iwidth;
+      p->last_auto_lines[i * 4 + 1] = pts[i * 4 + 1] / pipe->iheight;
+      p->last_auto_lines[i * 4 + 2] = pts[i * 4 + 2] / pipe->iwidth;
+      p->last_auto_lines[i * 4 + 3] = pts[i * 4 + 3] / pipe->iheight;
+      p->last_auto_weights[i] = selected[i].weight;
+    }
+    p->last_auto_lines_count = count;
+    p->last_auto_imgid = self->dev->image_storage.id;
+  }
+
+  free(selected);
+}
+
+// detect the lines of the image without gui, the way the gui does on its preview: run
+// the preview sized image through the modules before this one and look at their output.
+// the selected lines are kept in p.
+static gboolean _autofit_get_structure(dt_iop_module_t *self, dt_iop_ashift_structure_t *s, int *isflipped,
+                                       dt_iop_ashift_params_t *p)
+{
+  dt_develop_t *dev = self->dev;
+  const int imgid = dev->image_storage.id;
+
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_F, DT_MIPMAP_BLOCKING, 'r');
+  if(!buf.buf || buf.width == 0 || buf.height == 0)
+  {
+    dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+    return FALSE;
+  }
+
+  dt_dev_pixelpipe_t pipe;
+  if(!dt_dev_pixelpipe_init_thumbnail(&pipe, buf.width, buf.height))
+  {
+    dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+    return FALSE;
+  }
+
+  gboolean res = FALSE;
+  float *in = NULL;
+  int width = 0;
+  int height = 0;
+
+  dt_dev_pixelpipe_set_input(&pipe, dev, (float *)buf.buf, buf.width, buf.height, buf.iscale);
+  dt_dev_pixelpipe_create_nodes(&pipe, dev);
+  dt_dev_pixelpipe_synch_all(&pipe, dev);
+
+  dt_dev_pixelpipe_iop_t *piece = dt_dev_distort_get_iop_pipe(dev, &pipe, self);
+  if(piece == NULL) goto cleanup;
+
+  // the fit is done on the final orientation, as in the gui
+  dt_dev_pixelpipe_get_dimensions(&pipe, dev, pipe.iwidth, pipe.iheight, &pipe.processed_width,
+                                  &pipe.processed_height);
+  *isflipped = _is_flipped(self, piece);
+
+  // the lines are detected on the input of this module, leave out the rest of the pipe
+  for(GList *nodes = pipe.nodes; nodes; nodes = g_list_next(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *node = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    if(node->module->iop_order >= self->iop_order) node->enabled = 0;
+  }
+  dt_dev_pixelpipe_get_dimensions(&pipe, dev, pipe.iwidth, pipe.iheight, &pipe.processed_width,
+                                  &pipe.processed_height);
+
+  if(dt_dev_pixelpipe_process_no_gamma(&pipe, dev, 0, 0, pipe.processed_width, pipe.processed_height, 1.0f)
+     || pipe.backbuf == NULL || pipe.dsc.channels != 4 || pipe.dsc.datatype != TYPE_FLOAT
+     || pipe.dsc.cst != IOP_CS_RGB)
+    goto cleanup;
+
+  width = pipe.backbuf_width;
+  height = pipe.backbuf_height;
+  in = malloc(sizeof(float) * 4 * (size_t)width * height);
+  if(in == NULL) goto cleanup;
+  dt_iop_image_copy_by_size(in, (const float *)pipe.backbuf, width, height, 4);
+
+  dt_iop_ashift_line_t *lines;
+  int lines_count;
+  int vertical_count;
+  int horizontal_count;
+  float vertical_weight;
+  float horizontal_weight;
+
+  if(!line_detect(in, width, height, 0, 0, 1.0f, &lines, &lines_count, &vertical_count, &horizontal_count,
+                  &vertical_weight, &horizontal_weight, ASHIFT_ENHANCE_NONE,
+                  dt_image_is_raw(&dev->image_storage)))
+    goto cleanup;
+
+  *s = (dt_iop_ashift_structure_t){ .lines = lines, .lines_count = lines_count,
+                                    .width = width, .height = height, .x_off = 0, .y_off = 0,
+                                    .vertical_count = vertical_count,
+                                    .horizontal_count = horizontal_count,
+                                    .vertical_weight = vertical_weight,
+                                    .horizontal_weight = horizontal_weight };
+
+  res = _remove_outliers_structure(s);
+  if(res)
+    _store_auto_lines(self, &pipe, p, s->lines, s->lines_count);
+  else
+  {
+    free(s->lines);
+    s->lines = NULL;
+  }
+
+cleanup:
+  free(in);
+  dt_dev_pixelpipe_cleanup(&pipe);
+  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  return res;
+}
+
+// params set on another image with "fit other images" on are fitted to the image they
+// are pasted or applied to as a style, and saved in its history. called without gui, on
+// the module of the history being written.
+int history_pasted(dt_iop_module_t *self)
+{
+  dt_iop_ashift_params_t *p = (dt_iop_ashift_params_t *)self->params;
+  const int imgid = self->dev->image_storage.id;
+
+  if(!self->enabled || p->autofit == ASHIFT_AUTOFIT_OFF || p->last_auto_imgid == imgid) return FALSE;
+
+  // the lines are detected on the image as the history written so far renders it
+  dt_develop_t dev;
+  dt_dev_init(&dev, FALSE);
+  dt_dev_load_image(&dev, imgid);
+
+  gboolean res = FALSE;
+  dt_iop_module_t *module = dt_iop_get_module_by_op_priority(dev.iop, self->op, self->multi_priority);
+  dt_iop_ashift_structure_t s = { 0 };
+  int isflipped = 0;
+
+  if(module && _autofit_get_structure(module, &s, &isflipped, p))
+  {
+    const float ranges[4] = { ROTATION_RANGE_SOFT, LENSSHIFT_RANGE_SOFT, LENSSHIFT_RANGE_SOFT, SHEAR_RANGE_SOFT };
+    dt_iop_ashift_data_t fit = { 0 };
+    _params_to_data(p, &fit);
+
+    if(_nmsfit_structure(&s, &fit, ranges, isflipped, _autofit_axis(p->autofit)) == NMS_SUCCESS)
+    {
+      // crop as the gui does after a fit, to the full image if that fails
+      fit.cl = 0.0f;
+      fit.cr = 1.0f;
+      fit.ct = 0.0f;
+      fit.cb = 1.0f;
+      if(p->cropmode != ASHIFT_CROP_OFF && !_crop_fit(&fit, p->cropmode, s.width, s.height))
+      {
+        fit.cl = 0.0f;
+        fit.cr = 1.0f;
+        fit.ct = 0.0f;
+        fit.cb = 1.0f;
+      }
+
+      p->rotation = fit.rotation;
+      p->lensshift_v = fit.lensshift_v;
+      p->lensshift_h = fit.lensshift_h;
+      p->shear = fit.shear;
+      p->cl = fit.cl;
+      p->cr = fit.cr;
+      p->ct = fit.ct;
+      p->cb = fit.cb;
+      res = TRUE;
+    }
+#ifdef ASHIFT_DEBUG
+    else
+      printf("automatic fit of image %d failed, keeping its params\n", imgid);
+#endif
+    free(s.lines);
+  }
+
+  dt_dev_cleanup(&dev);
+  return res;
+}
+
 // manually adjust crop area by shifting its center
 static void crop_adjust(dt_iop_module_t *module, const dt_iop_ashift_params_t *const p,
                         const float newx, const float newy)
@@ -2902,6 +3350,15 @@ static void _draw_save_lines_to_params(dt_iop_module_t *self)
     }
   }
 }
+static void _draw_save_auto_lines_to_params(dt_iop_module_t *self)
+{
+  dt_iop_ashift_gui_data_t *g = (dt_iop_ashift_gui_data_t *)self->gui_data;
+  dt_iop_ashift_params_t *p = (dt_iop_ashift_params_t *)self->params;
+  if(!g || !p) return;
+
+  _store_auto_lines(self, self->dev->preview_pipe, p, g->lines, g->lines_count);
+}
+
 static gboolean _draw_retrieve_lines_from_params(dt_iop_module_t *self, dt_iop_ashift_method_t method)
 {
   // parameters contains lines extremas positions in "original image" reference
@@ -2991,6 +3448,65 @@ static gboolean _draw_retrieve_lines_from_params(dt_iop_module_t *self, dt_iop_a
       return TRUE;
     }
   }
+
+  // the lines of the last automatic detection are only valid for the image they were found in
+  if(method == ASHIFT_METHOD_AUTO && p->last_auto_lines_count > 0
+     && p->last_auto_imgid == self->dev->image_storage.id)
+  {
+    const dt_dev_pixelpipe_t *pipe = self->dev->preview_pipe;
+    const int count = MIN(p->last_auto_lines_count, MAX_SAVED_LINES);
+    float pts[MAX_SAVED_LINES * 4] = { 0.0f };
+
+    for(int i = 0; i < count; i++)
+    {
+      pts[i * 4    ] = p->last_auto_lines[i * 4    ] * pipe->iwidth;
+      pts[i * 4 + 1] = p->last_auto_lines[i * 4 + 1] * pipe->iheight;
+      pts[i * 4 + 2] = p->last_auto_lines[i * 4 + 2] * pipe->iwidth;
+      pts[i * 4 + 3] = p->last_auto_lines[i * 4 + 3] * pipe->iheight;
+    }
+
+    if(dt_dev_distort_transform_plus(self->dev, self->dev->preview_pipe, self->iop_order,
+                                     DT_DEV_TRANSFORM_DIR_BACK_EXCL, pts, count * 2))
+    {
+      if(g->lines) free(g->lines);
+      g->lines = (dt_iop_ashift_line_t *)g_malloc0(sizeof(dt_iop_ashift_line_t) * count);
+
+      int vnb = 0; // number of vertical lines
+      int hnb = 0; // number of horizontal lines
+      float vweight = 0.0f;
+      float hweight = 0.0f;
+      for(int i = 0; i < count; i++)
+      {
+        _draw_basic_line(&g->lines[i], pts[i * 4], pts[i * 4 + 1], pts[i * 4 + 2], pts[i * 4 + 3],
+                         ASHIFT_LINE_VERTICAL_SELECTED);
+        _draw_retrieve_line_type(&g->lines[i]);
+        g->lines[i].weight = p->last_auto_weights[i];
+        if(g->lines[i].type == ASHIFT_LINE_VERTICAL_SELECTED)
+        {
+          vnb++;
+          vweight += g->lines[i].weight;
+        }
+        else
+        {
+          hnb++;
+          hweight += g->lines[i].weight;
+        }
+      }
+
+      g->lines_count = count;
+      g->vertical_count = vnb;
+      g->horizontal_count = hnb;
+      g->vertical_weight = vweight;
+      g->horizontal_weight = hweight;
+      g->lines_in_width = piece->iwidth;
+      g->lines_in_height = piece->iheight;
+      g->lines_x_off = 0;
+      g->lines_y_off = 0;
+      g->lines_version++;
+      g->current_structure_method = method;
+      return TRUE;
+    }
+  }
   return FALSE;
 }
 
@@ -3061,6 +3577,8 @@ static int _do_get_structure_auto(dt_iop_module_t *module, dt_iop_ashift_params_
     goto error;
   }
 
+  _draw_save_auto_lines_to_params(module);
+
   g->fitting = 0;
   return TRUE;
 
@@ -3198,8 +3716,8 @@ static void do_fit(dt_iop_module_t *module, dt_iop_ashift_params_t *p, dt_iop_as
 
   if(g->fitting) return;
 
-  // if no structure available get it
-  if(g->lines == NULL)
+  // if no structure available get it, from the history first
+  if(g->lines == NULL && !_draw_retrieve_lines_from_params(module, ASHIFT_METHOD_AUTO))
     if(!_do_get_structure_auto(module, p, ASHIFT_ENHANCE_NONE)) return;
 
   g->fitting = 1;
@@ -3256,23 +3774,7 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
     const int y_off = roi_in->y;
     const float scale = roi_in->scale;
 
-    // origin of image and opposite corner as reference points
-    dt_boundingbox_t points = { 0.0f, 0.0f, (float)piece->buf_in.width, (float)piece->buf_in.height };
-    float ivec[2] = { points[2] - points[0], points[3] - points[1] };
-    float ivecl = sqrtf(ivec[0] * ivec[0] + ivec[1] * ivec[1]);
-
-    // where do they go?
-    dt_dev_distort_backtransform_plus(self->dev, self->dev->preview_pipe, self->iop_order,
-                                      DT_DEV_TRANSFORM_DIR_FORW_EXCL, points, 2);
-
-    float ovec[2] = { points[2] - points[0], points[3] - points[1] };
-    float ovecl = sqrtf(ovec[0] * ovec[0] + ovec[1] * ovec[1]);
-
-    // angle between input vector and output vector
-    float alpha = acos(CLAMP((ivec[0] * ovec[0] + ivec[1] * ovec[1]) / (ivecl * ovecl), -1.0f, 1.0f));
-
-    // we are interested if |alpha| is in the range of 90° +/- 45° -> we assume the image is flipped
-    const int isflipped = fabs(fmod(alpha + M_PI, M_PI) - M_PI / 2.0f) < M_PI / 4.0f ? 1 : 0;
+    const int isflipped = _is_flipped(self, piece);
 
     // did modules prior to this one in pixelpipe have changed? -> check via hash value
     uint64_t hash = dt_dev_hash_plus(self->dev, self->dev->preview_pipe, self->iop_order, DT_DEV_TRANSFORM_DIR_BACK_EXCL);
@@ -5019,6 +5521,14 @@ void gui_changed(dt_iop_module_t *self, GtkWidget *w, void *previous)
   {
     gtk_widget_set_visible(g->specifics, p->mode == ASHIFT_MODE_SPECIFIC);
   }
+  else if(w == g->autofit && p->autofit != ASHIFT_AUTOFIT_OFF)
+  {
+    // the fit is for the images the params go to, not the one they are set on,
+    // whichever way it was corrected. lines found on another image are dropped.
+    const int imgid = self->dev->image_storage.id;
+    if(p->last_auto_imgid != imgid) p->last_auto_lines_count = 0;
+    p->last_auto_imgid = imgid;
+  }
 }
 
 void gui_reset(struct dt_iop_module_t *self)
@@ -5283,7 +5793,8 @@ static void _event_process_after_preview_callback(gpointer instance, gpointer us
       break;
 
     case ASHIFT_JOBCODE_GET_STRUCTURE:
-      (void)_do_get_structure_auto(self, p, (dt_iop_ashift_enhance_t)jobparams);
+      if(_do_get_structure_auto(self, p, (dt_iop_ashift_enhance_t)jobparams))
+        dt_dev_add_history_item(darktable.develop, self, TRUE);
       break;
 
     case ASHIFT_JOBCODE_FIT:
@@ -5305,13 +5816,7 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
   dt_iop_ashift_params_t *p = (dt_iop_ashift_params_t *)p1;
   dt_iop_ashift_data_t *d = (dt_iop_ashift_data_t *)piece->data;
 
-  d->rotation = p->rotation;
-  d->lensshift_v = p->lensshift_v;
-  d->lensshift_h = p->lensshift_h;
-  d->shear = p->shear;
-  d->f_length_kb = (p->mode == ASHIFT_MODE_GENERIC) ? DEFAULT_F_LENGTH : p->f_length * p->crop_factor;
-  d->orthocorr = (p->mode == ASHIFT_MODE_GENERIC) ? 0.0f : p->orthocorr;
-  d->aspect = (p->mode == ASHIFT_MODE_GENERIC) ? 1.0f : p->aspect;
+  _params_to_data(p, d);
 
   if(gui_has_focus(self))
   {
@@ -5422,6 +5927,8 @@ void reload_defaults(dt_iop_module_t *module)
     g->lines_count =0;
     g->horizontal_count = 0;
     g->vertical_count = 0;
+    free(g->detection.lines);
+    g->detection = (dt_iop_ashift_detection_t){ 0 };
     g->grid_hash = 0;
     g->lines_hash = 0;
     g->rotation_range = ROTATION_RANGE_SOFT;
@@ -5669,6 +6176,7 @@ void gui_init(struct dt_iop_module_t *self)
 
   g->cropmode = dt_bauhaus_combobox_from_params(self, "cropmode");
   g_signal_connect(G_OBJECT(g->cropmode), "value-changed", G_CALLBACK(cropmode_callback), self);
+  g->autofit = dt_bauhaus_combobox_from_params(self, "autofit");
 
   GtkWidget *main_box = self->widget;
 
@@ -5763,6 +6271,8 @@ void gui_init(struct dt_iop_module_t *self)
   gtk_widget_set_tooltip_text(g->lensshift_h, _("apply lens shift correction in one direction"));
   gtk_widget_set_tooltip_text(g->shear, _("shear the image along one diagonal"));
   gtk_widget_set_tooltip_text(g->cropmode, _("automatically crop to avoid black edges"));
+  gtk_widget_set_tooltip_text(g->autofit, _("when these settings are pasted or applied as a style,\n"
+                                            "fit them again to the lines of each image"));
   gtk_widget_set_tooltip_text(g->mode, _("lens model of the perspective correction: "
                                          "generic or according to the focal length"));
   gtk_widget_set_tooltip_text(g->f_length, _("focal length of the lens, "
@@ -5825,6 +6335,7 @@ void gui_cleanup(struct dt_iop_module_t *self)
   dt_iop_ashift_gui_data_t *g = (dt_iop_ashift_gui_data_t *)self->gui_data;
   if(g->lines) free(g->lines);
   if(g->buf) free(g->buf);
+  free(g->detection.lines);
   if(g->points) free(g->points);
   if(g->points_idx) free(g->points_idx);
 
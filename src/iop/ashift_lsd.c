@@ -167,15 +167,6 @@
 /** Label for pixels already used in detection. */
 #define USED    1
 
-/*----------------------------------------------------------------------------*/
-/** Chained list of coordinates.
- */
-struct coorlist
-{
-  int x,y;
-  struct coorlist * next;
-};
-
 /*----------------------------------------------------------------------------*/
 /** A point (or pixel).
  */
@@ -648,7 +639,9 @@ static image_double gaussian_sampler( image_double in, double scale,
   ntuple_list kernel;
   unsigned int N,M,h,n,x,y,i;
   int xc,yc,j,double_x_size,double_y_size;
-  double sigma,xx,yy,sum,prec;
+  double sigma,xx,yy,prec;
+  double * weights;
+  int * taps;
 
   /* check parameters */
   if( in == NULL || in->data == NULL || in->xsize == 0 || in->ysize == 0 )
@@ -681,6 +674,12 @@ static image_double gaussian_sampler( image_double in, double scale,
   n = 1+2*h; /* kernel size */
   kernel = new_ntuple_list(n);
 
+  /* the kernel weights and source pixels of all output columns or rows,
+     so that both passes can filter whole rows in parallel */
+  weights = (double *) malloc( (size_t) MAX(N,M) * n * sizeof(double) );
+  taps = (int *) malloc( (size_t) MAX(N,M) * n * sizeof(int) );
+  if( weights == NULL || taps == NULL ) error("not enough memory.");
+
   /* auxiliary double image size variables */
   double_x_size = (int) (2 * in->xsize);
   double_y_size = (int) (2 * in->ysize);
@@ -701,21 +700,39 @@ static image_double gaussian_sampler( image_double in, double scale,
       /* the kernel must be computed for each x because the fine
          offset xx-xc is different in each case */
 
-      for(y=0;y<aux->ysize;y++)
+      for(i=0;i<kernel->dim;i++)
         {
-          sum = 0.0;
-          for(i=0;i<kernel->dim;i++)
-            {
-              j = xc - h + i;
+          j = xc - h + i;
 
-              /* symmetry boundary condition */
-              while( j < 0 ) j += double_x_size;
-              while( j >= double_x_size ) j -= double_x_size;
-              if( j >= (int) in->xsize ) j = double_x_size-1-j;
+          /* symmetry boundary condition */
+          while( j < 0 ) j += double_x_size;
+          while( j >= double_x_size ) j -= double_x_size;
+          if( j >= (int) in->xsize ) j = double_x_size-1-j;
 
-              sum += in->data[ j + y * in->xsize ] * kernel->values[i];
-            }
-          aux->data[ x + y * aux->xsize ] = sum;
+          weights[x*n+i] = kernel->values[i];
+          taps[x*n+i] = j;
+        }
+    }
+
+  const double *const indata = in->data;
+  double *const auxdata = aux->data;
+  const unsigned int in_x = in->xsize;
+  const unsigned int in_y = in->ysize;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(N, n, in_x, in_y, indata, auxdata, weights, taps) \
+  schedule(static)
+#endif
+  for(unsigned int row=0;row<in_y;row++)
+    {
+      const double *const src = indata + (size_t)row * in_x;
+      double *const dst = auxdata + (size_t)row * N;
+      for(unsigned int col=0;col<N;col++)
+        {
+          double sum = 0.0;
+          for(unsigned int t=0;t<n;t++)
+            sum += src[ taps[col*n+t] ] * weights[col*n+t];
+          dst[col] = sum;
         }
     }
 
@@ -735,25 +752,42 @@ static image_double gaussian_sampler( image_double in, double scale,
       /* the kernel must be computed for each y because the fine
          offset yy-yc is different in each case */
 
-      for(x=0;x<out->xsize;x++)
+      for(i=0;i<kernel->dim;i++)
         {
-          sum = 0.0;
-          for(i=0;i<kernel->dim;i++)
-            {
-              j = yc - h + i;
+          j = yc - h + i;
 
-              /* symmetry boundary condition */
-              while( j < 0 ) j += double_y_size;
-              while( j >= double_y_size ) j -= double_y_size;
-              if( j >= (int) in->ysize ) j = double_y_size-1-j;
+          /* symmetry boundary condition */
+          while( j < 0 ) j += double_y_size;
+          while( j >= double_y_size ) j -= double_y_size;
+          if( j >= (int) in->ysize ) j = double_y_size-1-j;
 
-              sum += aux->data[ x + j * aux->xsize ] * kernel->values[i];
-            }
-          out->data[ x + y * out->xsize ] = sum;
+          weights[y*n+i] = kernel->values[i];
+          taps[y*n+i] = j;
+        }
+    }
+
+  double *const outdata = out->data;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(N, M, n, auxdata, outdata, weights, taps) \
+  schedule(static)
+#endif
+  for(unsigned int row=0;row<M;row++)
+    {
+      /* accumulate the taps in the same order as the column by column loop */
+      double *const dst = outdata + (size_t)row * N;
+      for(unsigned int col=0;col<N;col++) dst[col] = 0.0;
+      for(unsigned int t=0;t<n;t++)
+        {
+          const double *const src = auxdata + (size_t)taps[row*n+t] * N;
+          const double w = weights[row*n+t];
+          for(unsigned int col=0;col<N;col++) dst[col] += src[col] * w;
         }
     }
 
   /* free memory */
+  free( (void *) weights );
+  free( (void *) taps );
   free_ntuple_list(kernel);
   free_image_double(aux);
 
@@ -772,31 +806,32 @@ static image_double gaussian_sampler( image_double in, double scale,
     - an image_double with the angle at each pixel, or NOTDEF if not defined.
     - the image_double 'modgrad' (a pointer is passed as argument)
       with the gradient magnitude at each point.
-    - a list of pixels 'list_p' roughly ordered by decreasing
-      gradient magnitude. (The order is made by classifying points
-      into bins by gradient magnitude. The parameters 'n_bins' and
-      'max_grad' specify the number of bins and the gradient modulus
-      at the highest bin. The pixels in the list would be in
+    - an array 'list_p' of the 'list_size' pixels with a defined angle,
+      roughly ordered by decreasing gradient magnitude. (The order is made
+      by classifying points into bins by gradient magnitude. The parameters
+      'n_bins' and 'max_grad' specify the number of bins and the gradient
+      modulus at the highest bin. The pixels in the list would be in
       decreasing gradient magnitude, up to a precision of the size of
       the bins.)
-    - a pointer 'mem_p' to the memory used by 'list_p' to be able to
-      free the memory when it is not used anymore.
+
+    The original implementation chained the pixels of each bin in a linked
+    list, and walking its scattered nodes took more time than the whole
+    gradient computation. The bins are now filled by a counting sort into
+    one array. Inside of a bin the pixels keep the column by column order
+    of the linked list, so the detected segments are the same. Pixels with
+    an undefined angle can't start a region and are left out of the list.
  */
 static image_double ll_angle( image_double in, double threshold,
-                              struct coorlist ** list_p, void ** mem_p,
+                              struct point ** list_p, unsigned int * list_size,
                               image_double * modgrad, unsigned int n_bins )
 {
   image_double g;
-  unsigned int n,p,x,y,adr,i;
-  double com1,com2,gx,gy,norm,norm2;
+  unsigned int n,p,x,y,i,size;
   /* the rest of the variables are used for pseudo-ordering
      the gradient magnitude values */
-  int list_count = 0;
-  struct coorlist * list;
-  struct coorlist ** range_l_s; /* array of pointers to start of bin list */
-  struct coorlist ** range_l_e; /* array of pointers to end of bin list */
-  struct coorlist * start;
-  struct coorlist * end;
+  struct point * list;
+  unsigned int * bin;     /* bin of each pixel, n_bins if the angle is not defined */
+  unsigned int * range_s; /* position of the next pixel of each bin in the list */
   double max_grad = 0.0;
 
   /* check parameters */
@@ -804,7 +839,7 @@ static image_double ll_angle( image_double in, double threshold,
     error("ll_angle: invalid image.");
   if( threshold < 0.0 ) error("ll_angle: 'threshold' must be positive.");
   if( list_p == NULL ) error("ll_angle: NULL pointer 'list_p'.");
-  if( mem_p == NULL ) error("ll_angle: NULL pointer 'mem_p'.");
+  if( list_size == NULL ) error("ll_angle: NULL pointer 'list_size'.");
   if( modgrad == NULL ) error("ll_angle: NULL pointer 'modgrad'.");
   if( n_bins == 0 ) error("ll_angle: 'n_bins' must be positive.");
 
@@ -818,26 +853,30 @@ static image_double ll_angle( image_double in, double threshold,
   /* get memory for the image of gradient modulus */
   *modgrad = new_image_double(in->xsize,in->ysize);
 
-  /* get memory for "ordered" list of pixels */
-  list = (struct coorlist *) calloc( (size_t) (n*p), sizeof(struct coorlist) );
-  *mem_p = (void *) list;
-  range_l_s = (struct coorlist **) calloc( (size_t) n_bins,
-                                           sizeof(struct coorlist *) );
-  range_l_e = (struct coorlist **) calloc( (size_t) n_bins,
-                                           sizeof(struct coorlist *) );
-  if( list == NULL || range_l_s == NULL || range_l_e == NULL )
-    error("not enough memory.");
-  for(i=0;i<n_bins;i++) range_l_s[i] = range_l_e[i] = NULL;
+  /* get memory for the pseudo-ordering */
+  bin = (unsigned int *) malloc( (size_t) (n*p) * sizeof(unsigned int) );
+  range_s = (unsigned int *) calloc( (size_t) n_bins, sizeof(unsigned int) );
+  if( bin == NULL || range_s == NULL ) error("not enough memory.");
 
   /* 'undefined' on the down and right boundaries */
   for(x=0;x<p;x++) g->data[(n-1)*p+x] = NOTDEF;
   for(y=0;y<n;y++) g->data[p*y+p-1]   = NOTDEF;
 
+  const double *const data = in->data;
+  double *const angle = g->data;
+  double *const norms = (*modgrad)->data;
+
   /* compute gradient on the remaining pixels */
-  for(x=0;x<p-1;x++)
-    for(y=0;y<n-1;y++)
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(n, p, threshold, data, angle, norms) \
+  reduction(max : max_grad) \
+  schedule(static)
+#endif
+  for(int yy=0;yy<(int)n-1;yy++)
+    for(unsigned int xx=0;xx<p-1;xx++)
       {
-        adr = y*p+x;
+        const size_t adr = (size_t)yy*p+xx;
 
         /*
            Norm 2 computation using 2x2 pixel window:
@@ -850,72 +889,83 @@ static image_double ll_angle( image_double in, double threshold,
              gy = C+D - (A+B)   vertical difference
            com1 and com2 are just to avoid 2 additions.
          */
-        com1 = in->data[adr+p+1] - in->data[adr];
-        com2 = in->data[adr+1]   - in->data[adr+p];
+        const double com1 = data[adr+p+1] - data[adr];
+        const double com2 = data[adr+1]   - data[adr+p];
 
-        gx = com1+com2; /* gradient x component */
-        gy = com1-com2; /* gradient y component */
-        norm2 = gx*gx+gy*gy;
-        norm = sqrt( norm2 / 4.0 ); /* gradient norm */
+        const double gx = com1+com2; /* gradient x component */
+        const double gy = com1-com2; /* gradient y component */
+        const double norm2 = gx*gx+gy*gy;
+        const double norm = sqrt( norm2 / 4.0 ); /* gradient norm */
 
-        (*modgrad)->data[adr] = norm; /* store gradient norm */
+        norms[adr] = norm; /* store gradient norm */
 
         if( norm <= threshold ) /* norm too small, gradient no defined */
-          g->data[adr] = NOTDEF; /* gradient angle not defined */
+          angle[adr] = NOTDEF; /* gradient angle not defined */
         else
           {
             /* gradient angle computation */
-            g->data[adr] = atan2(gx,-gy);
+            angle[adr] = atan2(gx,-gy);
 
             /* look for the maximum of the gradient */
             if( norm > max_grad ) max_grad = norm;
           }
       }
 
-  /* compute histogram of gradient values */
-  for(x=0;x<p-1;x++)
-    for(y=0;y<n-1;y++)
+  /* find the bin of each point according to its norm */
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(n, p, n_bins, max_grad, angle, norms, bin) \
+  schedule(static)
+#endif
+  for(int yy=0;yy<(int)n-1;yy++)
+    for(unsigned int xx=0;xx<p-1;xx++)
       {
-        norm = (*modgrad)->data[y*p+x];
-
-        /* store the point in the right bin according to its norm */
-        i = (unsigned int) (norm * (double) n_bins / max_grad);
-        if( i >= n_bins ) i = n_bins-1;
-        if( range_l_e[i] == NULL )
-          range_l_s[i] = range_l_e[i] = list+list_count++;
-        else
+        const size_t adr = (size_t)yy*p+xx;
+        unsigned int b = n_bins;
+        if( angle[adr] != NOTDEF )
           {
-            range_l_e[i]->next = list+list_count;
-            range_l_e[i] = list+list_count++;
+            b = (unsigned int) (norms[adr] * (double) n_bins / max_grad);
+            if( b >= n_bins ) b = n_bins-1;
           }
-        range_l_e[i]->x = (int) x;
-        range_l_e[i]->y = (int) y;
-        range_l_e[i]->next = NULL;
+        bin[adr] = b;
       }
 
+  /* compute histogram of gradient values */
+  for(y=0;y<n-1;y++)
+    for(x=0;x<p-1;x++)
+      if( bin[y*p+x] < n_bins ) range_s[bin[y*p+x]]++;
+
   /* Make the list of pixels (almost) ordered by norm value.
      It starts by the larger bin, so the list starts by the
      pixels with the highest gradient value. Pixels would be ordered
      by norm value, up to a precision given by max_grad/n_bins.
    */
-  for(i=n_bins-1; i>0 && range_l_s[i]==NULL; i--);
-  start = range_l_s[i];
-  end = range_l_e[i];
-  if( start != NULL )
-    while(i>0)
+  size = 0;
+  for(i=n_bins; i-- > 0; )
+    {
+      const unsigned int count = range_s[i];
+      range_s[i] = size;
+      size += count;
+    }
+  list = (struct point *) malloc( (size_t) (size ? size : 1) * sizeof(struct point) );
+  if( list == NULL ) error("not enough memory.");
+  for(x=0;x<p-1;x++)
+    for(y=0;y<n-1;y++)
       {
-        --i;
-        if( range_l_s[i] != NULL )
+        const unsigned int b = bin[y*p+x];
+        if( b < n_bins )
           {
-            end->next = range_l_s[i];
-            end = range_l_e[i];
+            list[range_s[b]].x = (int) x;
+            list[range_s[b]].y = (int) y;
+            range_s[b]++;
           }
       }
-  *list_p = start;
+  *list_p = list;
+  *list_size = size;
 
   /* free memory */
-  free( (void *) range_l_s );
-  free( (void *) range_l_e );
+  free( (void *) bin );
+  free( (void *) range_s );
 
   return g;
 }
@@ -1064,12 +1114,18 @@ static double log_gamma_windschitl(double x)
 
 // clang-format on
 
-static double *inv = NULL; /* table to keep computed inverse values */
+static double *inv = NULL; /* table of the inverse values */
 
+// the table is filled once up front rather than lazily in nfa(): it is read
+// by concurrent detections, and the lazy version tested entries of the
+// uninitialised buffer against 0.0.
 __attribute__((constructor)) static void invConstructor()
 {
   if(inv) return;
   inv = malloc(sizeof(double) * TABSIZE);
+  if(inv == NULL) return;
+  inv[0] = 0.0;
+  for(int i = 1; i < TABSIZE; i++) inv[i] = 1.0 / (double)i;
 }
 
 __attribute__((destructor)) static void invDestructor()
@@ -1174,13 +1230,11 @@ static double nfa(int n, int k, double p, double logNT)
            term_i / term_i-1 = (n-i+1)/i * p/(1-p)
          and
            term_i = term_i-1 * (n-i+1)/i * p/(1-p).
-         1/i is stored in a table as they are computed,
-         because divisions are expensive.
+         1/i is taken from a table, because divisions are expensive.
          p/(1-p) is computed only once and stored in 'p_term'.
        */
-      bin_term = (double) (n-i+1) * ( i<TABSIZE ?
-                   ( inv[i]!=0.0 ? inv[i] : ( inv[i] = 1.0 / (double) i ) ) :
-                   1.0 / (double) i );
+      bin_term = (double) (n-i+1) * ( i<TABSIZE && inv ?
+                   inv[i] : 1.0 / (double) i );
 
       mult_term = bin_term * p_term;
       term *= mult_term;
@@ -2090,8 +2144,8 @@ double * LineSegmentDetection( int * n_out,
   image_double scaled_image,angles,modgrad;
   image_char used;
   image_int region = NULL;
-  struct coorlist * list_p;
-  void * mem_p;
+  struct point * list_p;
+  unsigned int list_size,k;
   struct rect rec;
   struct point * reg;
   int reg_size,min_reg_size,i;
@@ -2123,12 +2177,12 @@ double * LineSegmentDetection( int * n_out,
   if( scale != 1.0 )
     {
       scaled_image = gaussian_sampler( image, scale, sigma_scale );
-      angles = ll_angle( scaled_image, rho, &list_p, &mem_p,
+      angles = ll_angle( scaled_image, rho, &list_p, &list_size,
                          &modgrad, (unsigned int) n_bins );
       free_image_double(scaled_image);
     }
   else
-    angles = ll_angle( image, rho, &list_p, &mem_p, &modgrad,
+    angles = ll_angle( image, rho, &list_p, &list_size, &modgrad,
                        (unsigned int) n_bins );
   xsize = angles->xsize;
   ysize = angles->ysize;
@@ -2161,14 +2215,12 @@ double * LineSegmentDetection( int * n_out,
 
 
   /* search for line segments */
-  for(; list_p != NULL; list_p = list_p->next )
-    if( used->data[ list_p->x + list_p->y * used->xsize ] == NOTUSED &&
-        angles->data[ list_p->x + list_p->y * angles->xsize ] != NOTDEF )
-       /* there is no risk of double comparison problems here
-          because we are only interested in the exact NOTDEF value */
+  /* the list only holds pixels with a defined angle */
+  for(k=0; k<list_size; k++)
+    if( used->data[ list_p[k].x + list_p[k].y * used->xsize ] == NOTUSED )
       {
         /* find the region of connected point and ~equal angle */
-        region_grow( list_p->x, list_p->y, angles, reg, &reg_size,
+        region_grow( list_p[k].x, list_p[k].y, angles, reg, &reg_size,
                      &reg_angle, used, prec );
 
         /* reject small regions */
@@ -2231,7 +2283,7 @@ double * LineSegmentDetection( int * n_out,
   free_image_double(modgrad);
   free_image_char(used);
   free( (void *) reg );
-  free( (void *) mem_p );
+  free( (void *) list_p );
 
   /* return the result */
   if( reg_img != NULL && reg_x != NULL && reg_y != NULL )
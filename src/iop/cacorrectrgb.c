@@ -23,6 +23,7 @@
 #endif
 
 #include "bauhaus/bauhaus.h"
+#include "control/control.h"
 #include "develop/imageop.h"
 #include "develop/imageop_gui.h"
 #include "gui/color_picker_proxy.h"
@@ -646,7 +647,8 @@ dt_omp_firstprivate(in, out, blurred_in_out, width, height, guide, safety) \
   dt_free_align(blurred_in_out);
 }
 
-static void reduce_chromatic_aberrations(const float* const restrict in,
+// returns 0 on success, 1 if out could not be written for lack of memory
+static int reduce_chromatic_aberrations(const float* const restrict in,
                           const size_t width, const size_t height,
                           const size_t ch, const float sigma, const float sigma2,
                           const dt_iop_cacorrectrgb_guide_channel_t guide,
@@ -663,22 +665,32 @@ static void reduce_chromatic_aberrations(const float* const restrict in,
   // we use only one variable for both higher and lower manifolds in order
   // to save time by doing only one bilinear interpolation instead of 2.
   float *const restrict ds_manifolds = dt_alloc_align_float(ds_width * ds_height * 6);
+  float *const restrict manifolds = dt_alloc_align_float(width * height * 6);
+  int err = 0;
+
   // Downsample the image for speed-up
-  interpolate_bilinear(in, width, height, ds_in, ds_width, ds_height, 4);
+  if(!ds_in || !ds_manifolds || !manifolds
+     || interpolate_bilinear(in, width, height, ds_in, ds_width, ds_height, 4))
+  {
+    err = 1;
+    goto clean;
+  }
 
   // Compute manifolds
   get_manifolds(ds_in, ds_width, ds_height, sigma / downsize, sigma2 / downsize, guide, ds_manifolds, refine_manifolds);
-  dt_free_align(ds_in);
 
   // upscale manifolds
-  float *const restrict manifolds = dt_alloc_align_float(width * height * 6);
-  interpolate_bilinear(ds_manifolds, ds_width, ds_height, manifolds, width, height, 6);
-  dt_free_align(ds_manifolds);
+  err = interpolate_bilinear(ds_manifolds, ds_width, ds_height, manifolds, width, height, 6);
+  if(err) goto clean;
 
   apply_correction(in, manifolds, width, height, sigma, guide, mode, out);
-  dt_free_align(manifolds);
-
   reduce_artifacts(in, width, height, sigma, guide, safety, out);
+
+clean:
+  dt_free_align(ds_in);
+  dt_free_align(ds_manifolds);
+  dt_free_align(manifolds);
+  return err;
 }
 
 void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid, void *const ovoid,
@@ -702,7 +714,12 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   // whether to be very conservative in preserving the original image, or to
   // keep algorithm result even if it overshoots
   const float safety = powf(20.0f, 1.0f - d->strength);
-  reduce_chromatic_aberrations(in, width, height, ch, sigma, sigma2, d->guide_channel, d->mode, d->refine_manifolds, safety, out);
+  if(reduce_chromatic_aberrations(in, width, height, ch, sigma, sigma2, d->guide_channel, d->mode,
+                                  d->refine_manifolds, safety, out))
+  {
+    dt_control_log(_("chromatic aberrations failed to allocate memory, check your RAM settings"));
+    dt_iop_copy_image_roi(out, in, ch, roi_in, roi_out, TRUE);
+  }
 }
 
 void gui_update(dt_iop_module_t *self)
@@ -37,25 +37,34 @@
 
 #define ROUND_POSISTIVE(f) ((unsigned int)((f)+0.5))
 
-DT_MODULE(1)
+DT_MODULE(2)
+
+typedef enum dt_iop_rlce_mode_t
+{
+  DT_RLCE_SLIDING = 0, // the window around every pixel, slow. edits made before version 2
+  DT_RLCE_TILED = 1    // the windows on a grid of one radius, interpolated in between
+} dt_iop_rlce_mode_t;
 
 typedef struct dt_iop_rlce_params_t
 {
   double radius;
   double slope;
+  dt_iop_rlce_mode_t mode;
 } dt_iop_rlce_params_t;
 
 typedef struct dt_iop_rlce_gui_data_t
 {
   GtkBox *vbox1, *vbox2;
-  GtkWidget *label1, *label2;
+  GtkWidget *label1, *label2, *label3;
   GtkWidget *scale1, *scale2; // radie pixels, slope
+  GtkWidget *mode;
 } dt_iop_rlce_gui_data_t;
 
 typedef struct dt_iop_rlce_data_t
 {
   double radius;
   double slope;
+  dt_iop_rlce_mode_t mode;
 } dt_iop_rlce_data_t;
 
 
@@ -84,8 +93,216 @@ int default_colorspace(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_p
   return IOP_CS_RGB;
 }
 
-void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
-             void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+int legacy_params(dt_iop_module_t *self, const void *const old_params, const int old_version,
+                  void *new_params, const int new_version)
+{
+  if(old_version == 1 && new_version == 2)
+  {
+    typedef struct dt_iop_rlce_params_v1_t
+    {
+      double radius;
+      double slope;
+    } dt_iop_rlce_params_v1_t;
+
+    const dt_iop_rlce_params_v1_t *old = old_params;
+    dt_iop_rlce_params_t *new = new_params;
+    new->radius = old->radius;
+    new->slope = old->slope;
+    // the tiled equalisation differs slightly, keep the look of existing edits
+    new->mode = DT_RLCE_SLIDING;
+    return 0;
+  }
+  return 1;
+}
+
+#define BINS (256)
+
+// clip the histogram at limit and redistribute the clipped entries evenly, until nothing is left to clip
+static void _clip_histogram(int *const hist, const int limit)
+{
+  int ce = 0, ceb = 0;
+  do
+  {
+    ceb = ce;
+    ce = 0;
+    for(int b = 0; b <= BINS; b++)
+    {
+      int d = hist[b] - limit;
+      if(d > 0)
+      {
+        ce += d;
+        hist[b] = limit;
+      }
+    }
+
+    int d = (ce / (float)(BINS + 1));
+    int m = ce % (BINS + 1);
+    for(int b = 0; b <= BINS; b++) hist[b] += d;
+
+    if(m != 0)
+    {
+      int s = BINS / (float)m;
+      for(int b = 0; b <= BINS; b += s) ++hist[b];
+    }
+  } while(ce != ceb);
+}
+
+// contrast limited equalisation of the window of radius rad around x, y: maps the luminance bins to [0,1]
+static void _window_mapping(const uint16_t *const bins, const int width, const int height, const int x,
+                            const int y, const int rad, const float slope, float *const map)
+{
+  const int xMin = MAX(0, x - rad), xMax = MIN(width, x + rad + 1);
+  const int yMin = MAX(0, y - rad), yMax = MIN(height, y + rad + 1);
+
+  int hist[BINS + 1] = { 0 };
+  for(int yi = yMin; yi < yMax; yi++)
+  {
+    const uint16_t *const row = bins + (size_t)yi * width;
+    for(int xi = xMin; xi < xMax; xi++) hist[row[xi]]++;
+  }
+
+  const int n = (xMax - xMin) * (yMax - yMin);
+  const int limit = (int)(slope * n / BINS + 0.5f);
+  _clip_histogram(hist, limit);
+
+  /* build cdf of clipped histogram */
+  int hMin = 0;
+  while(hMin < BINS && hist[hMin] == 0) hMin++;
+  const int cdfMin = hist[hMin];
+  int cdfMax = 0;
+  for(int b = 0; b <= BINS; b++) cdfMax += hist[b];
+  const float norm = 1.0f / MAX(cdfMax - cdfMin, 1);
+
+  int cdf = 0;
+  for(int b = 0; b <= BINS; b++)
+  {
+    cdf += hist[b];
+    map[b] = (cdf - cdfMin) * norm;
+  }
+}
+
+// grid of window centres along one axis: every step pixels, and the last pixel
+static inline int _grid_size(const int size, const int step)
+{
+  return (size - 1 + step - 1) / step + 1;
+}
+
+static inline int _grid_pos(const int k, const int size, const int step)
+{
+  return MIN(k * step, size - 1);
+}
+
+// version 2: equalise the windows on a grid and interpolate in between
+static void _process_tiled(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
+                           void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_rlce_data_t *const data = (dt_iop_rlce_data_t *)piece->data;
+  const int ch = piece->colors;
+  const int width = roi_out->width;
+  const int height = roi_out->height;
+
+  // Params
+  const int rad = data->radius * roi_in->scale / piece->iscale;
+  const float slope = data->slope;
+
+  // the equalisation is computed once for the windows on a grid of rad pixels, and bilinearly
+  // interpolated in between. the windows are the ones the pixels on the grid used to get.
+  const int step = MAX(rad, 1);
+  const int gw = _grid_size(width, step);
+  const int gh = _grid_size(height, step);
+
+  // two rows of mappings, the ones above and below the current band of pixels
+  uint16_t *const restrict bins = dt_alloc_align(64, sizeof(uint16_t) * width * height);
+  float *const restrict maps = dt_alloc_align_float((size_t)2 * gw * (BINS + 1));
+  if(!bins || !maps)
+  {
+    dt_free_align(bins);
+    dt_free_align(maps);
+    dt_iop_copy_image_roi(ovoid, ivoid, ch, roi_in, roi_out, TRUE);
+    return;
+  }
+
+  // PASS1: Get a luminance map of image...
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(bins, ch, ivoid, width, height) \
+  schedule(static)
+#endif
+  for(size_t k = 0; k < (size_t)width * height; k++)
+  {
+    const float *const in = (const float *)ivoid + k * ch;
+    const float pmax = CLIP(MAX(in[0], MAX(in[1], in[2]))); // Max value in RGB set
+    const float pmin = CLIP(MIN(in[0], MIN(in[1], in[2]))); // Min value in RGB set
+    bins[k] = ROUND_POSISTIVE((pmax + pmin) * 0.5f * (float)BINS); // Pixel luminocity
+  }
+
+  // CLAHE
+  for(int gy = 0; gy < gh; gy++)
+  {
+    const int y0 = _grid_pos(gy, height, step);
+    const int y1 = _grid_pos(MIN(gy + 1, gh - 1), height, step);
+    float *const restrict top = maps + (size_t)(gy & 1) * gw * (BINS + 1);
+    float *const restrict bottom = maps + (size_t)((gy + 1) & 1) * gw * (BINS + 1);
+
+    // the first row of windows, the next ones are the bottom of the band above
+    const int first = gy == 0 ? 0 : 1;
+    for(int r = first; r < 2; r++)
+    {
+      if(r == 1 && gy + 1 >= gh) break;
+      float *const restrict row = r ? bottom : top;
+      const int y = r ? y1 : y0;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+      dt_omp_firstprivate(bins, width, height, gw, step, y, rad, slope, row) \
+      schedule(static)
+#endif
+      for(int gx = 0; gx < gw; gx++)
+        _window_mapping(bins, width, height, _grid_pos(gx, width, step), y, rad, slope,
+                        row + (size_t)gx * (BINS + 1));
+    }
+    // the last row of windows is on the last row of pixels
+    const float *const restrict below = gy + 1 < gh ? bottom : top;
+    const int yend = gy + 1 < gh ? y1 : height;
+    const float ystep = MAX(y1 - y0, 1);
+
+    // Apply rows
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(bins, ch, ivoid, ovoid, width, gw, step, y0, yend, ystep, top, below) \
+    schedule(static)
+#endif
+    for(int j = y0; j < yend; j++)
+    {
+      const float fy = (j - y0) / ystep;
+      const float *in = (const float *)ivoid + (size_t)j * width * ch;
+      float *out = (float *)ovoid + (size_t)j * width * ch;
+      for(int i = 0; i < width; i++, in += ch, out += ch)
+      {
+        const int gx0 = MIN(i / step, MAX(gw - 2, 0));
+        const int gx1 = MIN(gx0 + 1, gw - 1);
+        const int x0 = _grid_pos(gx0, width, step);
+        const float fx = (i - x0) / (float)MAX(_grid_pos(gx1, width, step) - x0, 1);
+        const int v = bins[(size_t)j * width + i];
+        const float t = top[(size_t)gx0 * (BINS + 1) + v] * (1.0f - fx)
+                        + top[(size_t)gx1 * (BINS + 1) + v] * fx;
+        const float b = below[(size_t)gx0 * (BINS + 1) + v] * (1.0f - fx)
+                        + below[(size_t)gx1 * (BINS + 1) + v] * fx;
+
+        float H, S, L;
+        rgb2hsl(in, &H, &S, &L);
+        hsl2rgb(out, H, S, t * (1.0f - fy) + b * fy);
+      }
+    }
+  }
+
+  dt_free_align(maps);
+  dt_free_align(bins);
+}
+
+// version 1: equalise the sliding window around every pixel
+static void _process_sliding(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
+                             void *const ovoid, const dt_iop_roi_t *const roi_in,
+                             const dt_iop_roi_t *const roi_out)
 {
   dt_iop_rlce_data_t *data = (dt_iop_rlce_data_t *)piece->data;
   const int ch = piece->colors;
@@ -117,8 +334,6 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   // Params
   const int rad = data->radius * roi_in->scale / piece->iscale;
 
-#define BINS (256)
-
   const float slope = data->slope;
 
   size_t destbuf_size;
@@ -249,10 +464,20 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
 
   // Cleanup
   free(luminance);
+}
 
-#undef BINS
+void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
+             void *const ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_rlce_data_t *const data = (dt_iop_rlce_data_t *)piece->data;
+  if(data->mode == DT_RLCE_SLIDING)
+    _process_sliding(self, piece, ivoid, ovoid, roi_in, roi_out);
+  else
+    _process_tiled(self, piece, ivoid, ovoid, roi_in, roi_out);
 }
 
+#undef BINS
+
 static void radius_callback(GtkWidget *slider, gpointer user_data)
 {
   dt_iop_module_t *self = (dt_iop_module_t *)user_data;
@@ -271,6 +496,15 @@ static void slope_callback(GtkWidget *slider, gpointer user_data)
   dt_dev_add_history_item(darktable.develop, self, TRUE);
 }
 
+static void mode_callback(GtkWidget *combo, gpointer user_data)
+{
+  dt_iop_module_t *self = (dt_iop_module_t *)user_data;
+  if(darktable.gui->reset) return;
+  dt_iop_rlce_params_t *p = (dt_iop_rlce_params_t *)self->params;
+  p->mode = dt_bauhaus_combobox_get(combo);
+  dt_dev_add_history_item(darktable.develop, self, TRUE);
+}
+
 
 
 void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pixelpipe_t *pipe,
@@ -281,6 +515,7 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 
   d->radius = p->radius;
   d->slope = p->slope;
+  d->mode = p->mode;
 }
 
 void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
@@ -300,6 +535,7 @@ void gui_update(struct dt_iop_module_t *self)
   dt_iop_rlce_params_t *p = (dt_iop_rlce_params_t *)self->params;
   dt_bauhaus_slider_set(g->scale1, p->radius);
   dt_bauhaus_slider_set(g->scale2, p->slope);
+  dt_bauhaus_combobox_set(g->mode, p->mode);
 }
 
 void init(dt_iop_module_t *module)
@@ -309,7 +545,7 @@ void init(dt_iop_module_t *module)
   module->default_enabled = 0;
   module->params_size = sizeof(dt_iop_rlce_params_t);
   module->gui_data = NULL;
-  *((dt_iop_rlce_params_t *)module->default_params) = (dt_iop_rlce_params_t){ 64, 1.25 };
+  *((dt_iop_rlce_params_t *)module->default_params) = (dt_iop_rlce_params_t){ 64, 1.25, DT_RLCE_TILED };
 }
 
 void cleanup(dt_iop_module_t *module)
@@ -336,6 +572,8 @@ void gui_init(struct dt_iop_module_t *self)
   gtk_box_pack_start(GTK_BOX(g->vbox1), g->label1, TRUE, TRUE, 0);
   g->label2 = dtgtk_reset_label_new(_("amount"), self, &p->slope, sizeof(float));
   gtk_box_pack_start(GTK_BOX(g->vbox1), g->label2, TRUE, TRUE, 0);
+  g->label3 = dtgtk_reset_label_new(_("method"), self, &p->mode, sizeof(dt_iop_rlce_mode_t));
+  gtk_box_pack_start(GTK_BOX(g->vbox1), g->label3, TRUE, TRUE, 0);
 
   g->scale1 = dt_bauhaus_slider_new_with_range(NULL, 0.0, 256.0, 0, p->radius, 0);
   g->scale2 = dt_bauhaus_slider_new_with_range(NULL, 1.0, 3.0, 0, p->slope, 2);
@@ -343,11 +581,21 @@ void gui_init(struct dt_iop_module_t *self)
 
   gtk_box_pack_start(GTK_BOX(g->vbox2), GTK_WIDGET(g->scale1), TRUE, TRUE, 0);
   gtk_box_pack_start(GTK_BOX(g->vbox2), GTK_WIDGET(g->scale2), TRUE, TRUE, 0);
+
+  g->mode = dt_bauhaus_combobox_new(self);
+  dt_bauhaus_combobox_add(g->mode, _("sliding window"));
+  dt_bauhaus_combobox_add(g->mode, _("tiled"));
+  dt_bauhaus_combobox_set(g->mode, p->mode);
+  gtk_box_pack_start(GTK_BOX(g->vbox2), GTK_WIDGET(g->mode), TRUE, TRUE, 0);
   gtk_widget_set_tooltip_text(GTK_WIDGET(g->scale1), _("size of features to preserve"));
   gtk_widget_set_tooltip_text(GTK_WIDGET(g->scale2), _("strength of the effect"));
+  gtk_widget_set_tooltip_text(GTK_WIDGET(g->mode), _("sliding window equalises the neighbourhood of every pixel,"
+                                                     " as edits made before this option did.\n"
+                                                     "tiled is much faster and looks very close"));
 
   g_signal_connect(G_OBJECT(g->scale1), "value-changed", G_CALLBACK(radius_callback), self);
   g_signal_connect(G_OBJECT(g->scale2), "value-changed", G_CALLBACK(slope_callback), self);
+  g_signal_connect(G_OBJECT(g->mode), "value-changed", G_CALLBACK(mode_callback), self);
 }
 
 // clang-format off
@@ -1177,6 +1177,99 @@ static void process_sse2_cmatrix_fastpath_clipping(struct dt_iop_module_t *self,
   _mm_sfence();
 }
 
+#ifdef DT_HAVE_AVX_KERNELS
+// the two fast paths above on two pixels at once, leftover pixels go through the SSE2 code
+__DT_TARGET_AVX2__
+static void process_avx2_cmatrix_fastpath(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
+                                          const void *const ivoid, void *const ovoid,
+                                          const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_colorin_data_t *const d = (dt_iop_colorin_data_t *)piece->data;
+  const int clipping = (d->nrgb != NULL);
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+  const size_t pairs = npixels / 2;
+
+  // first matrix: to XYZ, or to the clipping rgb which lmatrix then takes to XYZ
+  const dt_aligned_pixel_t *const m1 = clipping ? d->nmatrix : d->cmatrix;
+  const __m256 m10 = _mm256_setr_ps(m1[0][0], m1[1][0], m1[2][0], 0.0f, m1[0][0], m1[1][0], m1[2][0], 0.0f);
+  const __m256 m11 = _mm256_setr_ps(m1[0][1], m1[1][1], m1[2][1], 0.0f, m1[0][1], m1[1][1], m1[2][1], 0.0f);
+  const __m256 m12 = _mm256_setr_ps(m1[0][2], m1[1][2], m1[2][2], 0.0f, m1[0][2], m1[1][2], m1[2][2], 0.0f);
+
+  const __m256 lm0 = _mm256_setr_ps(d->lmatrix[0][0], d->lmatrix[1][0], d->lmatrix[2][0], 0.0f,
+                                    d->lmatrix[0][0], d->lmatrix[1][0], d->lmatrix[2][0], 0.0f);
+  const __m256 lm1 = _mm256_setr_ps(d->lmatrix[0][1], d->lmatrix[1][1], d->lmatrix[2][1], 0.0f,
+                                    d->lmatrix[0][1], d->lmatrix[1][1], d->lmatrix[2][1], 0.0f);
+  const __m256 lm2 = _mm256_setr_ps(d->lmatrix[0][2], d->lmatrix[1][2], d->lmatrix[2][2], 0.0f,
+                                    d->lmatrix[0][2], d->lmatrix[1][2], d->lmatrix[2][2], 0.0f);
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(clipping, ivoid, lm0, lm1, lm2, m10, m11, m12, ovoid, pairs) \
+  schedule(static)
+#endif
+  for(size_t k = 0; k < pairs; k++)
+  {
+    const __m256 input = _mm256_load_ps((float *)ivoid + 8 * k);
+
+    __m256 xyz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(m10, _mm256_shuffle_ps(input, input, _MM_SHUFFLE(0, 0, 0, 0))),
+                                             _mm256_mul_ps(m11, _mm256_shuffle_ps(input, input, _MM_SHUFFLE(1, 1, 1, 1)))),
+                               _mm256_mul_ps(m12, _mm256_shuffle_ps(input, input, _MM_SHUFFLE(2, 2, 2, 2))));
+    if(clipping)
+    {
+      const __m256 crgb = _mm256_min_ps(_mm256_max_ps(xyz, _mm256_set1_ps(0.0f)), _mm256_set1_ps(1.0f));
+      xyz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(lm0, _mm256_shuffle_ps(crgb, crgb, _MM_SHUFFLE(0, 0, 0, 0))),
+                                        _mm256_mul_ps(lm1, _mm256_shuffle_ps(crgb, crgb, _MM_SHUFFLE(1, 1, 1, 1)))),
+                          _mm256_mul_ps(lm2, _mm256_shuffle_ps(crgb, crgb, _MM_SHUFFLE(2, 2, 2, 2))));
+    }
+    _mm256_stream_ps((float *)ovoid + 8 * k, dt_XYZ_to_Lab_avx2(xyz));
+  }
+  _mm_sfence();
+}
+
+__DT_TARGET_AVX512__
+static void process_avx512_cmatrix_fastpath(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
+                                            const void *const ivoid, void *const ovoid,
+                                            const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
+{
+  const dt_iop_colorin_data_t *const d = (dt_iop_colorin_data_t *)piece->data;
+  const int clipping = (d->nrgb != NULL);
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+  const size_t quads = npixels / 4;
+
+  const dt_aligned_pixel_t *const m1 = clipping ? d->nmatrix : d->cmatrix;
+  const __m512 m10 = _mm512_setr4_ps(m1[0][0], m1[1][0], m1[2][0], 0.0f);
+  const __m512 m11 = _mm512_setr4_ps(m1[0][1], m1[1][1], m1[2][1], 0.0f);
+  const __m512 m12 = _mm512_setr4_ps(m1[0][2], m1[1][2], m1[2][2], 0.0f);
+
+  const __m512 lm0 = _mm512_setr4_ps(d->lmatrix[0][0], d->lmatrix[1][0], d->lmatrix[2][0], 0.0f);
+  const __m512 lm1 = _mm512_setr4_ps(d->lmatrix[0][1], d->lmatrix[1][1], d->lmatrix[2][1], 0.0f);
+  const __m512 lm2 = _mm512_setr4_ps(d->lmatrix[0][2], d->lmatrix[1][2], d->lmatrix[2][2], 0.0f);
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(clipping, ivoid, lm0, lm1, lm2, m10, m11, m12, ovoid, quads) \
+  schedule(static)
+#endif
+  for(size_t k = 0; k < quads; k++)
+  {
+    const __m512 input = _mm512_load_ps((float *)ivoid + 16 * k);
+
+    __m512 xyz = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(m10, _mm512_shuffle_ps(input, input, _MM_SHUFFLE(0, 0, 0, 0))),
+                                             _mm512_mul_ps(m11, _mm512_shuffle_ps(input, input, _MM_SHUFFLE(1, 1, 1, 1)))),
+                               _mm512_mul_ps(m12, _mm512_shuffle_ps(input, input, _MM_SHUFFLE(2, 2, 2, 2))));
+    if(clipping)
+    {
+      const __m512 crgb = _mm512_min_ps(_mm512_max_ps(xyz, _mm512_set1_ps(0.0f)), _mm512_set1_ps(1.0f));
+      xyz = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(lm0, _mm512_shuffle_ps(crgb, crgb, _MM_SHUFFLE(0, 0, 0, 0))),
+                                        _mm512_mul_ps(lm1, _mm512_shuffle_ps(crgb, crgb, _MM_SHUFFLE(1, 1, 1, 1)))),
+                          _mm512_mul_ps(lm2, _mm512_shuffle_ps(crgb, crgb, _MM_SHUFFLE(2, 2, 2, 2))));
+    }
+    _mm512_stream_ps((float *)ovoid + 16 * k, dt_XYZ_to_Lab_avx512(xyz));
+  }
+  _mm_sfence();
+}
+#endif // DT_HAVE_AVX_KERNELS
+
 static void process_sse2_cmatrix_fastpath(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
                                           const void *const ivoid, void *const ovoid,
                                           const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
@@ -1184,13 +1277,41 @@ static void process_sse2_cmatrix_fastpath(struct dt_iop_module_t *self, dt_dev_p
   const dt_iop_colorin_data_t *const d = (dt_iop_colorin_data_t *)piece->data;
   const int clipping = (d->nrgb != NULL);
 
+#ifdef DT_HAVE_AVX_KERNELS
+  // the wide paths do the bulk of the image, the SSE2 ones below the last pixels
+  const size_t npixels = (size_t)roi_out->width * roi_out->height;
+  size_t done = 0;
+  if(piece->colors == 4 && darktable.codepath.AVX512)
+  {
+    process_avx512_cmatrix_fastpath(self, piece, ivoid, ovoid, roi_in, roi_out);
+    done = npixels - npixels % 4;
+  }
+  else if(piece->colors == 4 && darktable.codepath.AVX2)
+  {
+    process_avx2_cmatrix_fastpath(self, piece, ivoid, ovoid, roi_in, roi_out);
+    done = npixels - npixels % 2;
+  }
+  if(done == npixels) return;
+
+  const dt_iop_roi_t rest = { 0, 0, npixels - done, 1, roi_out->scale };
+  const void *const in = (const float *)ivoid + 4 * done;
+  void *const out = (float *)ovoid + 4 * done;
+  const dt_iop_roi_t *const rest_in = done ? &rest : roi_in;
+  const dt_iop_roi_t *const rest_out = done ? &rest : roi_out;
+#else
+  const void *const in = ivoid;
+  void *const out = ovoid;
+  const dt_iop_roi_t *const rest_in = roi_in;
+  const dt_iop_roi_t *const rest_out = roi_out;
+#endif
+
   if(!clipping)
   {
-    process_sse2_cmatrix_fastpath_simple(self, piece, ivoid, ovoid, roi_in, roi_out);
+    process_sse2_cmatrix_fastpath_simple(self, piece, in, out, rest_in, rest_out);
   }
   else
   {
-    process_sse2_cmatrix_fastpath_clipping(self, piece, ivoid, ovoid, roi_in, roi_out);
+    process_sse2_cmatrix_fastpath_clipping(self, piece, in, out, rest_in, rest_out);
   }
 }
 
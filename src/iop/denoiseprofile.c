@@ -338,7 +338,7 @@ typedef struct dt_iop_denoiseprofile_global_data_t
   int kernel_denoiseprofile_backtransform_v2;
   int kernel_denoiseprofile_backtransform_Y0U0V0;
   int kernel_denoiseprofile_decompose;
-  int kernel_denoiseprofile_synthesize;
+  int kernel_denoiseprofile_accumulate;
   int kernel_denoiseprofile_reduce_first;
   int kernel_denoiseprofile_reduce_second;
 } dt_iop_denoiseprofile_global_data_t;
@@ -789,7 +789,7 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
     const int max_filter_radius = (1u << max_scale); // 2 * 2^max_scale
 
     tiling->factor = 5.0f; // in + out + precond + tmp + reducebuffer
-    tiling->factor_cl = 3.5f + max_scale; // in + out + tmp + reducebuffer + scale buffers
+    tiling->factor_cl = 4.5f; // in + out + tmp + accumulated details + reducebuffer
     tiling->maxbuf = 1.0f;
     tiling->maxbuf_cl = 1.0f;
     tiling->overhead = 0;
@@ -826,8 +826,23 @@ static inline void precondition(const float *const in, float *const buf, const i
   }
 }
 
-static inline void backtransform(float *const buf, const int wd, const int ht, const dt_aligned_pixel_t a,
-                                 const dt_aligned_pixel_t b)
+// the backtransforms work in place on buf. if detail is not NULL, it is thresholded by thrs and added to buf
+// before the transform, and so is residue if not NULL: these are the finest remaining detail scale and the
+// coarsest scale of the wavelet decomposition, which saves separate passes over the image.
+static inline float _backtransform_input(const float *const buf, const float *const detail,
+                                         const float *const thrs, const float *const residue, const size_t k,
+                                         const int c)
+{
+  float x = buf[k];
+  // same as eaw_synthesize() with a boost of 1
+  if(detail) x += MAX(detail[k] - thrs[c], 0.0f) + MIN(detail[k] + thrs[c], 0.0f);
+  if(residue) x += residue[k];
+  return x;
+}
+
+static inline void backtransform(float *const buf, const float *const detail, const float *const thrs,
+                                 const float *const residue, const int wd, const int ht,
+                                 const dt_aligned_pixel_t a, const dt_aligned_pixel_t b)
 {
   const dt_aligned_pixel_t sigma2_plus_1_8
       = { (b[0] / a[0]) * (b[0] / a[0]) + 1.f / 8.f,
@@ -839,7 +854,7 @@ static inline void backtransform(float *const buf, const int wd, const int ht, c
 
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(buf, npixels, sigma2_plus_1_8, sqrt_3_2)   \
+  dt_omp_firstprivate(buf, detail, thrs, residue, npixels, sigma2_plus_1_8, sqrt_3_2)   \
   shared(a) \
   schedule(static)
 #endif
@@ -847,7 +862,7 @@ static inline void backtransform(float *const buf, const int wd, const int ht, c
   {
     for_each_channel(c,aligned(buf,sigma2_plus_1_8))
     {
-      const float x = buf[j+c], x2 = x * x;
+      const float x = _backtransform_input(buf, detail, thrs, residue, j+c, c), x2 = x * x;
       // closed form approximation to unbiased inverse (input range was 0..200 for fit, not 0..1)
       buf[j+c] = (x < 0.5f)
         ? 0.0f
@@ -966,8 +981,8 @@ static inline void precondition_v2(const float *const in, float *const buf, cons
 // control the bias:
 // we replace the 2 * p * constant / (2 - p) part of delta by user
 // defined bias controller.
-static inline void backtransform_v2(float *const buf, const int wd, const int ht, const float a,
-                                    const dt_aligned_pixel_t p, const float b, const float bias,
+static inline void backtransform_v2(float *const buf, const float *const detail, const float *const thrs,
+                                    const float *const residue, const int wd, const int ht, const float a, const dt_aligned_pixel_t p, const float b, const float bias,
                                     const dt_aligned_pixel_t wb)
 {
   const size_t npixels = (size_t)wd * ht;
@@ -977,7 +992,7 @@ static inline void backtransform_v2(float *const buf, const int wd, const int ht
                                      4.0f / (sqrtf(a) * (2.0f - p[2])), 1.0f };
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(npixels, buf, b, bias, wb)   \
+  dt_omp_firstprivate(npixels, buf, detail, thrs, residue, b, bias, wb)   \
   dt_omp_sharedconst(expon,denom) \
   schedule(static)
 #endif
@@ -985,7 +1000,7 @@ static inline void backtransform_v2(float *const buf, const int wd, const int ht
   {
     for_each_channel(c,aligned(buf,wb))
     {
-      const float x = MAX(buf[j+c], 0.0f);
+      const float x = MAX(_backtransform_input(buf, detail, thrs, residue, j+c, c), 0.0f);
       const float delta = x * x + bias;
       const float z1 = (x + sqrtf(MAX(delta, 0.0f))) / denom[c];
       buf[j+c] = wb[c] * (powf(z1, expon[c]) - b);
@@ -1028,8 +1043,8 @@ static inline void precondition_Y0U0V0(const float *const in, float *const buf,
   }
 }
 
-static inline void backtransform_Y0U0V0(float *const buf, const int wd, const int ht, const float a,
-                                        const dt_aligned_pixel_t p, const float b, const float bias,
+static inline void backtransform_Y0U0V0(float *const buf, const float *const detail, const float *const thrs,
+                                        const float *const residue, const int wd, const int ht, const float a, const dt_aligned_pixel_t p, const float b, const float bias,
                                         const dt_aligned_pixel_t wb, const dt_colormatrix_t toRGB)
 {
   const dt_aligned_pixel_t bias_wb = { bias * wb[0], bias * wb[1], bias * wb[2], 0.0f };
@@ -1043,17 +1058,20 @@ static inline void backtransform_Y0U0V0(float *const buf, const int wd, const in
                                      1.0f };
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-  dt_omp_firstprivate(buf, ht, wd, b, bias_wb, toRGB, expon, scale)  \
+  dt_omp_firstprivate(buf, detail, thrs, residue, ht, wd, b, bias_wb, toRGB, expon, scale)  \
   schedule(static)
 #endif
   for(size_t j = 0; j < (size_t)4 * ht * wd; j += 4)
   {
+    dt_aligned_pixel_t px;
+    for_each_channel(c,aligned(buf))
+      px[c] = _backtransform_input(buf, detail, thrs, residue, j+c, c);
     dt_aligned_pixel_t rgb = { 0.0f }; // "unused" fourth element enables vectorization
     for(int k = 0; k < 3; k++)
     {
-      for_each_channel(c,aligned(toRGB,buf))
+      for_each_channel(c,aligned(toRGB))
       {
-        rgb[k] += toRGB[k][c] * buf[j+c];
+        rgb[k] += toRGB[k][c] * px[c];
       }
     }
     for_each_channel(c,aligned(buf))
@@ -1372,6 +1390,8 @@ static void process_wavelets(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
   // clear the output buffer, which will be accumulating all of the detail scales
   memset(out, 0, sizeof(float) * 4 * npixels);
 
+  // thresholds of the last scale, whose detail is added by the backtransform
+  dt_aligned_pixel_t thrs = { 0.0f, 0.0f, 0.0f, 0.0f };
   for(int scale = 0; scale < max_scale; scale++)
   {
     const float sigma = 1.0f;
@@ -1383,33 +1403,29 @@ static void process_wavelets(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
     debug_dump_PFM(piece,"/tmp/detail_%d.pfm",buf,width,height,scale);
 
     const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
-    dt_aligned_pixel_t thrs;
     variance_stabilizing_xform(thrs, scale, max_scale, npixels, sum_y2, d);
-    synthesize(out, out, buf, thrs, boost, width, height);
+    if(scale < max_scale - 1) synthesize(out, out, buf, thrs, boost, width, height);
 
     float *buf3 = buf2;
     buf2 = buf1;
     buf1 = buf3;
   }
 
-  // add in the final residue
-#ifdef _OPENMP
-#pragma omp simd aligned(buf1, out : 64)
-#endif
-  for (size_t k = 0; k < 4U * npixels; k++)
-    out[k] += buf1[k];
-
+  // add in the last detail scale and the final residue while transforming back
+  const float *const detail = max_scale > 0 ? buf : NULL;
   if(!d->use_new_vst)
   {
-    backtransform(out, width, height, aa, bb);
+    backtransform(out, detail, thrs, buf1, width, height, aa, bb);
   }
   else if(d->wavelet_color_mode == MODE_RGB)
   {
-    backtransform_v2(out, width, height, d->a[1] * compensate_p, p, d->b[1], d->bias - 0.5 * logf(in_scale), wb);
+    backtransform_v2(out, detail, thrs, buf1, width, height, d->a[1] * compensate_p, p, d->b[1],
+                     d->bias - 0.5 * logf(in_scale), wb);
   }
   else
   {
-    backtransform_Y0U0V0(out, width, height, d->a[1] * compensate_p, p, d->b[1], d->bias - 0.5 * logf(in_scale), wb, toRGB);
+    backtransform_Y0U0V0(out, detail, thrs, buf1, width, height, d->a[1] * compensate_p, p, d->b[1],
+                         d->bias - 0.5 * logf(in_scale), wb, toRGB);
   }
 
   dt_free_align(buf);
@@ -1561,11 +1577,11 @@ static void nlmeans_backtransform(const dt_iop_denoiseprofile_data_t *const d, f
 {
   if(!d->use_new_vst)
   {
-    backtransform((float *)ovoid, roi_in->width, roi_in->height, aa, bb);
+    backtransform((float *)ovoid, NULL, NULL, NULL, roi_in->width, roi_in->height, aa, bb);
   }
   else
   {
-    backtransform_v2((float *)ovoid, roi_in->width, roi_in->height, d->a[1] * compensate_p, p, d->b[1], d->bias - 0.5 * logf(scale), wb);
+    backtransform_v2((float *)ovoid, NULL, NULL, NULL, roi_in->width, roi_in->height, d->a[1] * compensate_p, p, d->b[1], d->bias - 0.5 * logf(scale), wb);
   }
   return;
 }
@@ -2162,7 +2178,7 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
   cl_mem dev_m = NULL;
   cl_mem dev_r = NULL;
   cl_mem dev_filter = NULL;
-  cl_mem *dev_detail = calloc(max_max_scale, sizeof(cl_mem));
+  cl_mem dev_accu = NULL;
   float *sumsum = NULL;
 
   // corner case of extremely small image. this is not really likely to happen but would cause issues later
@@ -2174,7 +2190,6 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
     size_t region[] = { width, height, 1 };
     err = dt_opencl_enqueue_copy_image(devid, dev_in, dev_out, origin, origin, region);
     if(err != CL_SUCCESS) goto error;
-    free(dev_detail);
     return TRUE;
   }
 
@@ -2221,11 +2236,9 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
   dev_filter = dt_opencl_copy_host_to_device_constant(devid, sizeof(float) * 25, mm);
   if(dev_filter == NULL) goto error;
 
-  for(int k = 0; k < max_scale; k++)
-  {
-    dev_detail[k] = dt_opencl_alloc_device(devid, width, height, sizeof(float) * 4);
-    if(dev_detail[k] == NULL) goto error;
-  }
+  // running sum of the thresholded detail scales
+  dev_accu = dt_opencl_alloc_device_buffer(devid, sizeof(float) * 4 * npixels);
+  if(dev_accu == NULL) goto error;
 
   dt_aligned_pixel_t wb;  // the "unused" fourth element enables vectorization
   const dt_aligned_pixel_t wb_weights = { 2.0f, 1.0f, 2.0f, 0.0f };
@@ -2280,10 +2293,15 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
 
   size_t sizes[] = { ROUNDUPDWD(width, devid), ROUNDUPDHT(height, devid), 1 };
 
+  // the images ping-pong between dev_out and dev_tmp, one swap per scale. start such that the coarsest scale
+  // ends up in dev_tmp, so that the backtransform can read it and write its result to dev_out.
+  dev_buf1 = (max_scale & 1) ? dev_out : dev_tmp;
+  dev_buf2 = (max_scale & 1) ? dev_tmp : dev_out;
+
   if(!d->use_new_vst)
   {
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition, 0, sizeof(cl_mem), (void *)&dev_in);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition, 1, sizeof(cl_mem), (void *)&dev_out);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition, 1, sizeof(cl_mem), (void *)&dev_buf1);
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition, 2, sizeof(int), (void *)&width);
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition, 3, sizeof(int), (void *)&height);
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition, 4, 4 * sizeof(float), (void *)&aa);
@@ -2294,7 +2312,7 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
   else if(d->wavelet_color_mode == MODE_RGB)
   {
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_v2, 0, sizeof(cl_mem), (void *)&dev_in);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_v2, 1, sizeof(cl_mem), (void *)&dev_out);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_v2, 1, sizeof(cl_mem), (void *)&dev_buf1);
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_v2, 2, sizeof(int), (void *)&width);
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_v2, 3, sizeof(int), (void *)&height);
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_v2, 4, 4 * sizeof(float), (void *)&aa);
@@ -2311,7 +2329,7 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
     if(dev_Y0U0V0 != NULL)
     {
       dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_Y0U0V0, 0, sizeof(cl_mem), (void *)&dev_in);
-      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_Y0U0V0, 1, sizeof(cl_mem), (void *)&dev_out);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_Y0U0V0, 1, sizeof(cl_mem), (void *)&dev_buf1);
       dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_Y0U0V0, 2, sizeof(int), (void *)&width);
       dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_Y0U0V0, 3, sizeof(int), (void *)&height);
       dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_precondition_Y0U0V0, 4, 4 * sizeof(float), (void *)&aa);
@@ -2329,10 +2347,9 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
     }
   }
 
-  dev_buf1 = dev_out;
-  dev_buf2 = dev_tmp;
-
-  /* decompose image into detail scales and coarse */
+  // the scales are thresholded as soon as they are decomposed, and summed up in dev_accu.
+  // the detail coefficients are the difference of the fine and coarse images, so only the
+  // two buffers of the current scale are kept on the device.
   for(int s = 0; s < max_scale; s++)
   {
     const float sigma = 1.0f;
@@ -2342,15 +2359,13 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
 
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 0, sizeof(cl_mem), (void *)&dev_buf1);
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 1, sizeof(cl_mem), (void *)&dev_buf2);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 2, sizeof(cl_mem),
-                             (void *)&dev_detail[s]);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 3, sizeof(int), (void *)&width);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 4, sizeof(int), (void *)&height);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 5, sizeof(unsigned int),
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 2, sizeof(int), (void *)&width);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 3, sizeof(int), (void *)&height);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 4, sizeof(unsigned int),
                              (void *)&s);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 6, sizeof(float),
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 5, sizeof(float),
                              (void *)&inv_sigma2);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 7, sizeof(cl_mem),
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_decompose, 6, sizeof(cl_mem),
                              (void *)&dev_filter);
     err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_denoiseprofile_decompose, sizes);
     if(err != CL_SUCCESS) goto error;
@@ -2358,21 +2373,6 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
     // indirectly give gpu some air to breathe (and to do display related stuff)
     dt_iop_nap(dt_opencl_micro_nap(devid));
 
-    // swap buffers
-    cl_mem dev_buf3 = dev_buf2;
-    dev_buf2 = dev_buf1;
-    dev_buf1 = dev_buf3;
-  }
-
-  /* now synthesize again */
-  for(int s = max_scale - 1; s >= 0; s--)
-  {
-    // variance stabilizing transform maps sigma to unity.
-    const float sigma = 1.0f;
-    // it is then transformed by wavelet scales via the 5 tap a-trous filter:
-    const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
-    const float sigma_band = powf(varf, s) * sigma;
-
     // determine thrs as bayesshrink
     dt_aligned_pixel_t sum_y2 = { 0.0f };
 
@@ -2385,12 +2385,12 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
     llocal[0] = flocopt.sizex;
     llocal[1] = flocopt.sizey;
     llocal[2] = 1;
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_reduce_first, 0, sizeof(cl_mem),
-                             &(dev_detail[s]));
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_reduce_first, 1, sizeof(int), &width);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_reduce_first, 2, sizeof(int), &height);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_reduce_first, 3, sizeof(cl_mem), &dev_m);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_reduce_first, 4,
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_reduce_first, 0, sizeof(cl_mem), &dev_buf1);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_reduce_first, 1, sizeof(cl_mem), &dev_buf2);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_reduce_first, 2, sizeof(int), &width);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_reduce_first, 3, sizeof(int), &height);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_reduce_first, 4, sizeof(cl_mem), &dev_m);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_reduce_first, 5,
                              sizeof(float) * 4 * flocopt.sizex * flocopt.sizey, NULL);
     err = dt_opencl_enqueue_kernel_2d_with_local(devid, gd->kernel_denoiseprofile_reduce_first, lsizes,
                                                  llocal);
@@ -2425,113 +2425,40 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
       }
     }
 
-    const float sb2 = sigma_band * sigma_band;
-    const dt_aligned_pixel_t var_y = { sum_y2[0] / (npixels - 1.0f), sum_y2[1] / (npixels - 1.0f),
-                                       sum_y2[2] / (npixels - 1.0f), 0.0f };
-    const dt_aligned_pixel_t std_x = { sqrtf(MAX(1e-6f, var_y[0] - sb2)), sqrtf(MAX(1e-6f, var_y[1] - sb2)),
-                                       sqrtf(MAX(1e-6f, var_y[2] - sb2)), 1.0f };
-    // add 8.0 here because it seemed a little weak
-    dt_aligned_pixel_t adjt = { 8.0f, 8.0f, 8.0f, 0.0f };
-
-    const int offset_scale = DT_IOP_DENOISE_PROFILE_BANDS - max_scale;
-    const int band_index = DT_IOP_DENOISE_PROFILE_BANDS - (s + offset_scale + 1);
-
-    if(d->wavelet_color_mode == MODE_RGB)
-    {
-      // current scale number is s+offset_scale
-      // for instance, largest s is DT_IOP_DENOISE_PROFILE_BANDS
-      // max_scale only indicates the number of scales to process at THIS
-      // zoom level, it does NOT corresponds to the the maximum number of scales.
-      // in other words, max_s is the maximum number of VISIBLE scales.
-      // That is why we have this "s+offset_scale"
-      float band_force_exp_2 = d->force[DT_DENOISE_PROFILE_ALL][band_index];
-      band_force_exp_2 *= band_force_exp_2;
-      band_force_exp_2 *= 4;
-      for_each_channel(ch)
-      {
-        adjt[ch] *= band_force_exp_2;
-      }
-      band_force_exp_2 = d->force[DT_DENOISE_PROFILE_R][band_index];
-      band_force_exp_2 *= band_force_exp_2;
-      band_force_exp_2 *= 4;
-      adjt[0] *= band_force_exp_2;
-      band_force_exp_2 = d->force[DT_DENOISE_PROFILE_G][band_index];
-      band_force_exp_2 *= band_force_exp_2;
-      band_force_exp_2 *= 4;
-      adjt[1] *= band_force_exp_2;
-      band_force_exp_2 = d->force[DT_DENOISE_PROFILE_B][band_index];
-      band_force_exp_2 *= band_force_exp_2;
-      band_force_exp_2 *= 4;
-      adjt[2] *= band_force_exp_2;
-    }
-    else
-    {
-      float band_force_exp_2 = d->force[DT_DENOISE_PROFILE_Y0][band_index];
-      band_force_exp_2 *= band_force_exp_2;
-      band_force_exp_2 *= 4;
-      adjt[0] *= band_force_exp_2;
-      band_force_exp_2 = d->force[DT_DENOISE_PROFILE_U0V0][band_index];
-      band_force_exp_2 *= band_force_exp_2;
-      band_force_exp_2 *= 4;
-      adjt[1] *= band_force_exp_2;
-      adjt[2] *= band_force_exp_2;
-    }
-
-    const dt_aligned_pixel_t thrs = { adjt[0] * sb2 / std_x[0], adjt[1] * sb2 / std_x[1],
-                                      adjt[2] * sb2 / std_x[2], 0.0f };
+    dt_aligned_pixel_t thrs = { 0.0f };
+    variance_stabilizing_xform(thrs, s, max_scale, npixels, sum_y2, d);
     // fprintf(stderr, "scale %d thrs %f %f %f\n", s, thrs[0], thrs[1], thrs[2]);
 
     const dt_aligned_pixel_t boost = { 1.0f, 1.0f, 1.0f, 1.0f };
-
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 0, sizeof(cl_mem),
-                             (void *)&dev_buf1);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 1, sizeof(cl_mem),
-                             (void *)&dev_detail[s]);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 2, sizeof(cl_mem),
-                             (void *)&dev_buf2);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 3, sizeof(int), (void *)&width);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 4, sizeof(int), (void *)&height);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 5, sizeof(float), (void *)&thrs[0]);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 6, sizeof(float), (void *)&thrs[1]);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 7, sizeof(float), (void *)&thrs[2]);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 8, sizeof(float), (void *)&thrs[3]);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 9, sizeof(float), (void *)&boost[0]);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 10, sizeof(float),
-                             (void *)&boost[1]);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 11, sizeof(float),
-                             (void *)&boost[2]);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_synthesize, 12, sizeof(float),
-                             (void *)&boost[3]);
-    err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_denoiseprofile_synthesize, sizes);
+    const int first = (s == 0);
+
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_accumulate, 0, sizeof(cl_mem), (void *)&dev_buf1);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_accumulate, 1, sizeof(cl_mem), (void *)&dev_buf2);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_accumulate, 2, sizeof(cl_mem), (void *)&dev_accu);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_accumulate, 3, sizeof(int), (void *)&width);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_accumulate, 4, sizeof(int), (void *)&height);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_accumulate, 5, 4 * sizeof(float), (void *)&thrs);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_accumulate, 6, 4 * sizeof(float), (void *)&boost);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_accumulate, 7, sizeof(int), (void *)&first);
+    err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_denoiseprofile_accumulate, sizes);
     if(err != CL_SUCCESS) goto error;
 
-    // indirectly give gpu some air to breathe (and to do display related stuff)
-    dt_iop_nap(dt_opencl_micro_nap(devid));
-
     // swap buffers
     cl_mem dev_buf3 = dev_buf2;
     dev_buf2 = dev_buf1;
     dev_buf1 = dev_buf3;
   }
 
-  // copy output of last run of synthesize kernel to dev_tmp (if not already there)
-  // note: we need to take swap of buffers into account, so current output lies in dev_buf1
-  if(dev_buf1 != dev_tmp)
-  {
-    size_t origin[] = { 0, 0, 0 };
-    size_t region[] = { width, height, 1 };
-    err = dt_opencl_enqueue_copy_image(devid, dev_buf1, dev_tmp, origin, origin, region);
-    if(err != CL_SUCCESS) goto error;
-  }
-
+  // the backtransform adds the coarsest scale, now in dev_tmp, to the details in dev_accu
   if(!d->use_new_vst)
   {
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 0, sizeof(cl_mem), (void *)&dev_tmp);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 1, sizeof(cl_mem), (void *)&dev_out);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 2, sizeof(int), (void *)&width);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 3, sizeof(int), (void *)&height);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 4, 4 * sizeof(float), (void *)&aa);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 5, 4 * sizeof(float), (void *)&sigma2);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 1, sizeof(cl_mem), (void *)&dev_accu);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 2, sizeof(cl_mem), (void *)&dev_out);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 3, sizeof(int), (void *)&width);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 4, sizeof(int), (void *)&height);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 5, 4 * sizeof(float), (void *)&aa);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform, 6, 4 * sizeof(float), (void *)&sigma2);
     err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_denoiseprofile_backtransform, sizes);
     if(err != CL_SUCCESS) goto error;
   }
@@ -2539,14 +2466,15 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
   {
     const float bias = d->bias - 0.5 * logf(scale);
     dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 0, sizeof(cl_mem), (void *)&dev_tmp);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 1, sizeof(cl_mem), (void *)&dev_out);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 2, sizeof(int), (void *)&width);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 3, sizeof(int), (void *)&height);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 4, 4 * sizeof(float), (void *)&aa);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 5, 4 * sizeof(float), (void *)&p);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 6, 4 * sizeof(float), (void *)&bb);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 7, sizeof(float), (void *)&bias);
-    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 8, 4 * sizeof(float), (void *)&wb);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 1, sizeof(cl_mem), (void *)&dev_accu);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 2, sizeof(cl_mem), (void *)&dev_out);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 3, sizeof(int), (void *)&width);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 4, sizeof(int), (void *)&height);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 5, 4 * sizeof(float), (void *)&aa);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 6, 4 * sizeof(float), (void *)&p);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 7, 4 * sizeof(float), (void *)&bb);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 8, sizeof(float), (void *)&bias);
+    dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_v2, 9, 4 * sizeof(float), (void *)&wb);
     err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_denoiseprofile_backtransform_v2, sizes);
     if(err != CL_SUCCESS) goto error;
   }
@@ -2558,15 +2486,16 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
     {
       const float bias = d->bias - 0.5 * logf(scale);
       dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 0, sizeof(cl_mem), (void *)&dev_tmp);
-      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 1, sizeof(cl_mem), (void *)&dev_out);
-      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 2, sizeof(int), (void *)&width);
-      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 3, sizeof(int), (void *)&height);
-      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 4, 4 * sizeof(float), (void *)&aa);
-      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 5, 4 * sizeof(float), (void *)&p);
-      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 6, 4 * sizeof(float), (void *)&bb);
-      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 7, sizeof(float), (void *)&bias);
-      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 8, 4 * sizeof(float), (void *)&wb);
-      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 9, sizeof(cl_mem), (void *)&dev_RGB);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 1, sizeof(cl_mem), (void *)&dev_accu);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 2, sizeof(cl_mem), (void *)&dev_out);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 3, sizeof(int), (void *)&width);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 4, sizeof(int), (void *)&height);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 5, 4 * sizeof(float), (void *)&aa);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 6, 4 * sizeof(float), (void *)&p);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 7, 4 * sizeof(float), (void *)&bb);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 8, sizeof(float), (void *)&bias);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 9, 4 * sizeof(float), (void *)&wb);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, 10, sizeof(cl_mem), (void *)&dev_RGB);
       err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_denoiseprofile_backtransform_Y0U0V0, sizes);
       dt_opencl_release_mem_object(dev_RGB);
       if(err != CL_SUCCESS) goto error;
@@ -2584,9 +2513,7 @@ static int process_wavelets_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_io
   dt_opencl_release_mem_object(dev_m);
   dt_opencl_release_mem_object(dev_tmp);
   dt_opencl_release_mem_object(dev_filter);
-  for(int k = 0; k < max_scale; k++)
-    dt_opencl_release_mem_object(dev_detail[k]);
-  free(dev_detail);
+  dt_opencl_release_mem_object(dev_accu);
   dt_free_align(sumsum);
   return TRUE;
 
@@ -2595,9 +2522,7 @@ error:
   dt_opencl_release_mem_object(dev_m);
   dt_opencl_release_mem_object(dev_tmp);
   dt_opencl_release_mem_object(dev_filter);
-  for(int k = 0; k < max_scale; k++)
-    dt_opencl_release_mem_object(dev_detail[k]);
-  free(dev_detail);
+  dt_opencl_release_mem_object(dev_accu);
   dt_free_align(sumsum);
   dt_print(DT_DEBUG_OPENCL, "[opencl_denoiseprofile] couldn't enqueue kernel! %d, devid %d\n", err, devid);
   return FALSE;
@@ -2644,7 +2569,8 @@ void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, c
   if(d->mode == MODE_NLMEANS || d->mode == MODE_NLMEANS_AUTO)
     process_nlmeans_sse(self, piece, ivoid, ovoid, roi_in, roi_out);
   else if(d->mode == MODE_WAVELETS || d->mode == MODE_WAVELETS_AUTO)
-    process_wavelets(self, piece, ivoid, ovoid, roi_in, roi_out, eaw_dn_decompose_sse, eaw_synthesize_sse2);
+    process_wavelets(self, piece, ivoid, ovoid, roi_in, roi_out, eaw_select_dn_decompose(),
+                     eaw_select_synthesize());
   else
     process_variance(self, piece, ivoid, ovoid, roi_in, roi_out);
 }
@@ -2776,7 +2702,7 @@ void init_global(dt_iop_module_so_t *module)
   gd->kernel_denoiseprofile_backtransform_v2 = dt_opencl_create_kernel(program, "denoiseprofile_backtransform_v2");
   gd->kernel_denoiseprofile_backtransform_Y0U0V0 = dt_opencl_create_kernel(program, "denoiseprofile_backtransform_Y0U0V0");
   gd->kernel_denoiseprofile_decompose = dt_opencl_create_kernel(program, "denoiseprofile_decompose");
-  gd->kernel_denoiseprofile_synthesize = dt_opencl_create_kernel(program, "denoiseprofile_synthesize");
+  gd->kernel_denoiseprofile_accumulate = dt_opencl_create_kernel(program, "denoiseprofile_accumulate");
   gd->kernel_denoiseprofile_reduce_first = dt_opencl_create_kernel(program, "denoiseprofile_reduce_first");
   gd->kernel_denoiseprofile_reduce_second = dt_opencl_create_kernel(program, "denoiseprofile_reduce_second");
 }
@@ -2796,7 +2722,7 @@ void cleanup_global(dt_iop_module_so_t *module)
   dt_opencl_free_kernel(gd->kernel_denoiseprofile_backtransform);
   dt_opencl_free_kernel(gd->kernel_denoiseprofile_backtransform_v2);
   dt_opencl_free_kernel(gd->kernel_denoiseprofile_decompose);
-  dt_opencl_free_kernel(gd->kernel_denoiseprofile_synthesize);
+  dt_opencl_free_kernel(gd->kernel_denoiseprofile_accumulate);
   dt_opencl_free_kernel(gd->kernel_denoiseprofile_reduce_first);
   dt_opencl_free_kernel(gd->kernel_denoiseprofile_reduce_second);
   free(module->data);
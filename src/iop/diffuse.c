@@ -49,7 +49,7 @@
 // Set to one to output intermediate image steps as PFM in /tmp
 #define DEBUG_DUMP_PFM 0
 
-DT_MODULE_INTROSPECTION(2, dt_iop_diffuse_params_t)
+DT_MODULE_INTROSPECTION(3, dt_iop_diffuse_params_t)
 
 #define MAX_NUM_SCALES 10
 typedef struct dt_iop_diffuse_params_t
@@ -76,6 +76,9 @@ typedef struct dt_iop_diffuse_params_t
   // v2
   int radius_center;        // $MIN: 0    $MAX: 1024 $DEFAULT: 0  $DESCRIPTION: "central radius"
 
+  // v3
+  gboolean coarse_to_fine;  // $DEFAULT: FALSE $DESCRIPTION: "coarse-to-fine iterations"
+
   // new versions add params mandatorily at the end, so we can memcpy old parameters at the beginning
 
 } dt_iop_diffuse_params_t;
@@ -84,7 +87,8 @@ typedef struct dt_iop_diffuse_params_t
 typedef struct dt_iop_diffuse_gui_data_t
 {
   GtkWidget *iterations, *fourth, *third, *second, *radius, *radius_center, *sharpness, *threshold, *regularization, *first,
-      *anisotropy_first, *anisotropy_second, *anisotropy_third, *anisotropy_fourth, *regularization_first, *variance_threshold;
+      *anisotropy_first, *anisotropy_second, *anisotropy_third, *anisotropy_fourth, *regularization_first, *variance_threshold,
+      *coarse_to_fine;
 } dt_iop_diffuse_gui_data_t;
 
 typedef struct dt_iop_diffuse_global_data_t
@@ -96,6 +100,8 @@ typedef struct dt_iop_diffuse_global_data_t
   int kernel_diffuse_build_mask;
   int kernel_diffuse_inpaint_mask;
   int kernel_diffuse_pde;
+  int kernel_diffuse_downsample;
+  int kernel_diffuse_upsample;
 } dt_iop_diffuse_global_data_t;
 
 
@@ -168,7 +174,7 @@ int default_colorspace(dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_p
 int legacy_params(dt_iop_module_t *self, const void *const old_params, const int old_version, void *new_params,
                   const int new_version)
 {
-  if(old_version == 1 && new_version == 2)
+  if(old_version == 1 && new_version == 3)
   {
     typedef struct dt_iop_diffuse_params_v1_t
     {
@@ -203,6 +209,48 @@ int legacy_params(dt_iop_module_t *self, const void *const old_params, const int
 
     // init only new parameters
     n->radius_center = 0;
+    n->coarse_to_fine = FALSE;
+
+    return 0;
+  }
+  if(old_version == 2 && new_version == 3)
+  {
+    typedef struct dt_iop_diffuse_params_v2_t
+    {
+      // global parameters
+      int iterations;
+      float sharpness;
+      int radius;
+      float regularization;
+      float variance_threshold;
+
+      float anisotropy_first;
+      float anisotropy_second;
+      float anisotropy_third;
+      float anisotropy_fourth;
+
+      float threshold;
+
+      float first;
+      float second;
+      float third;
+      float fourth;
+
+      // v2
+      int radius_center;
+    } dt_iop_diffuse_params_v2_t;
+
+    dt_iop_diffuse_params_v2_t *o = (dt_iop_diffuse_params_v2_t *)old_params;
+    dt_iop_diffuse_params_t *n = (dt_iop_diffuse_params_t *)new_params;
+    dt_iop_diffuse_params_t *d = (dt_iop_diffuse_params_t *)self->default_params;
+
+    *n = *d; // start with a fresh copy of default parameters
+
+    // copy common parameters
+    memcpy(n, o, sizeof(dt_iop_diffuse_params_v2_t));
+
+    // init only new parameters
+    n->coarse_to_fine = FALSE;
 
     return 0;
   }
@@ -486,6 +534,10 @@ void init_presets(dt_iop_module_so_t *self)
                              DEVELOP_BLEND_CS_RGB_SCENE);
 }
 
+// in coarse-to-fine mode, the first iterations run on downsampled copies of the image, each level half the
+// size of the previous one, and only the last ones at full resolution.
+#define MAX_NUM_LEVELS 3
+
 void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
                      const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out,
                      struct dt_develop_tiling_t *tiling)
@@ -499,15 +551,18 @@ void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t
   const int max_filter_radius = (1 << scales);
 
   // in + out + 2 * tmp + 2 * LF + s details + grey mask
-  tiling->factor = 6.25f + scales;
-  tiling->factor_cl = 6.25f + scales;
+  // + the input and output of the coarser levels and 2 tmp at half size for coarse-to-fine iterations
+  const float coarse = data->coarse_to_fine ? 1.25f : 0.f;
+  tiling->factor = 6.25f + scales + coarse;
+  tiling->factor_cl = 6.25f + scales + coarse;
 
   tiling->maxbuf = 1.0f;
   tiling->maxbuf_cl = 1.0f;
   tiling->overhead = 0;
   tiling->overlap = max_filter_radius;
-  tiling->xalign = 1;
-  tiling->yalign = 1;
+  // coarse levels halve the tile MAX_NUM_LEVELS times, keep them on the grid of the whole image
+  tiling->xalign = data->coarse_to_fine ? 1 << MAX_NUM_LEVELS : 1;
+  tiling->yalign = data->coarse_to_fine ? 1 << MAX_NUM_LEVELS : 1;
   return;
 }
 
@@ -1056,6 +1111,122 @@ static inline void inpaint_mask(float *const restrict inpainted, const float *co
   }
 }
 
+static inline int get_coarse_levels(const dt_dev_pixelpipe_iop_t *const piece, const int iterations,
+                                    const int scales, const float scale)
+{
+  const dt_iop_diffuse_data_t *const data = (dt_iop_diffuse_data_t *)piece->data;
+  if(!data->coarse_to_fine) return 0;
+  // every level needs one iteration and one wavelet scale less than the finer one
+  int levels = MIN(MIN(MAX_NUM_LEVELS, scales - 1), iterations - 1);
+  // don't go down to sizes where the wavelets have nothing left to work on. use the size of the whole image,
+  // not of the tile, so that all tiles run the same levels
+  const int size = MIN(piece->buf_in.width, piece->buf_in.height) / scale;
+  while(levels > 0 && (size >> levels) < 32) levels--;
+  return MAX(levels, 0);
+}
+
+static inline int get_level_iterations(const int iterations, const int levels, const int level)
+{
+  // the finer levels each get an eighth of the iterations, the coarsest one does the rest
+  const int fine = MAX(iterations / 8, 1);
+  return (level < levels) ? fine : iterations - levels * fine;
+}
+
+static inline void downsample_level(const float *const restrict in, float *const restrict out,
+                                    const uint8_t *const restrict mask_in, uint8_t *const restrict mask_out,
+                                    const int has_mask, const size_t width, const size_t height,
+                                    const size_t coarse_width, const size_t coarse_height)
+{
+  // average 2×2 blocks of pixels. A coarse pixel belongs to the inpainting mask if any of its pixels does.
+#ifdef _OPENMP
+#pragma omp parallel for default(none)                                                                            \
+    dt_omp_firstprivate(in, out, mask_in, mask_out, has_mask, width, height, coarse_width, coarse_height)        \
+    schedule(static)
+#endif
+  for(size_t i = 0; i < coarse_height; i++)
+  {
+    const size_t rows[2] = { 2 * i * width, MIN(2 * i + 1, height - 1) * width };
+    for(size_t j = 0; j < coarse_width; j++)
+    {
+      const size_t cols[2] = { 2 * j, MIN(2 * j + 1, width - 1) };
+      const size_t index = i * coarse_width + j;
+      for_four_channels(c, aligned(in, out : 64))
+        out[4 * index + c] = 0.25f * (in[4 * (rows[0] + cols[0]) + c] + in[4 * (rows[0] + cols[1]) + c]
+                                      + in[4 * (rows[1] + cols[0]) + c] + in[4 * (rows[1] + cols[1]) + c]);
+      if(has_mask)
+        mask_out[index] = mask_in[rows[0] + cols[0]] | mask_in[rows[0] + cols[1]]
+                          | mask_in[rows[1] + cols[0]] | mask_in[rows[1] + cols[1]];
+    }
+  }
+}
+
+static inline void upsample_level(const float *const restrict in, const float *const restrict coarse_in,
+                                  const float *const restrict coarse_out, const uint8_t *const restrict mask,
+                                  const int has_mask, float *const restrict out,
+                                  const size_t width, const size_t height,
+                                  const size_t coarse_width, const size_t coarse_height)
+{
+  // start a level from its own input plus what the iterations changed on the coarser level,
+  // interpolated bilinearly. Outside of the inpainting mask, the input is kept as is.
+#ifdef _OPENMP
+#pragma omp parallel for default(none)                                                                            \
+    dt_omp_firstprivate(in, coarse_in, coarse_out, mask, has_mask, out, width, height, coarse_width, coarse_height) \
+    schedule(static)
+#endif
+  for(size_t i = 0; i < height; i++)
+  {
+    const float y = 0.5f * i - 0.25f;
+    const int y0 = CLAMP((int)floorf(y), 0, (int)coarse_height - 1);
+    const int y1 = MIN(y0 + 1, (int)coarse_height - 1);
+    const float fy = CLAMP(y - y0, 0.f, 1.f);
+    for(size_t j = 0; j < width; j++)
+    {
+      const size_t index = i * width + j;
+      if(has_mask && !mask[index])
+      {
+        for_four_channels(c, aligned(in, out : 64))
+          out[4 * index + c] = in[4 * index + c];
+        continue;
+      }
+      const float x = 0.5f * j - 0.25f;
+      const int x0 = CLAMP((int)floorf(x), 0, (int)coarse_width - 1);
+      const int x1 = MIN(x0 + 1, (int)coarse_width - 1);
+      const float fx = CLAMP(x - x0, 0.f, 1.f);
+      const size_t corners[4] = { 4 * (y0 * coarse_width + x0), 4 * (y0 * coarse_width + x1),
+                                  4 * (y1 * coarse_width + x0), 4 * (y1 * coarse_width + x1) };
+      const float weights[4] = { (1.f - fx) * (1.f - fy), fx * (1.f - fy), (1.f - fx) * fy, fx * fy };
+      dt_aligned_pixel_t delta = { 0.f };
+      for(int k = 0; k < 4; k++)
+        for_four_channels(c, aligned(delta : 16))
+          delta[c] += weights[k] * (coarse_out[corners[k] + c] - coarse_in[corners[k] + c]);
+      for_four_channels(c, aligned(in, out : 64) aligned(delta : 16))
+        out[4 * index + c] = fmaxf(in[4 * index + c] + delta[c], 0.f);
+    }
+  }
+}
+
+static inline void diffuse_iterations(const float *const restrict in, float *const restrict out,
+                                      float *const restrict temp1, float *const restrict temp2,
+                                      const uint8_t *const restrict mask, const int has_mask,
+                                      const size_t width, const size_t height, const int iterations,
+                                      const dt_iop_diffuse_data_t *const data, const float final_radius,
+                                      const float zoom, float *const restrict HF[MAX_NUM_SCALES],
+                                      float *const restrict LF_odd, float *const restrict LF_even)
+{
+  // final_radius is given in pixels of this level, zoom is the size of one of them in pixels of the full image
+  const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
+  const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
+  // cycle between the temp buffers, the input may be one of them
+  const float *temp_in = in;
+  for(int it = 0; it < iterations; it++)
+  {
+    float *const temp_out = (it == iterations - 1) ? out : (temp_in == temp1) ? temp2 : temp1;
+    wavelets_process(temp_in, temp_out, mask, width, height, data, final_radius, zoom, scales, has_mask, HF,
+                     LF_odd, LF_even);
+    temp_in = temp_out;
+  }
+}
+
 void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const restrict ivoid,
              void *const restrict ovoid, const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -1070,9 +1241,6 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   float *const restrict temp1 = dt_alloc_align_float((size_t)roi_out->width * roi_out->height * 4);
   float *const restrict temp2 = dt_alloc_align_float((size_t)roi_out->width * roi_out->height * 4);
 
-  float *restrict temp_in = NULL;
-  float *restrict temp_out = NULL;
-
   uint8_t *const restrict mask = dt_alloc_align(64, sizeof(uint8_t) * roi_out->width * roi_out->height);
 
   const float scale = fmaxf(piece->iscale / roi_in->scale, 1.f);
@@ -1081,6 +1249,7 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   const int iterations = MAX(ceilf((float)data->iterations), 1);
   const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
   const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
+  const int levels = get_coarse_levels(piece, iterations, scales, scale);
 
   gboolean out_of_memory = FALSE;
 
@@ -1096,6 +1265,30 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
   float *const restrict LF_odd = dt_alloc_align_float(width * height * 4);
   float *const restrict LF_even = dt_alloc_align_float(width * height * 4);
 
+  // input, output and mask of the coarser levels, and temp buffers to cycle between on them
+  float *restrict level_in[MAX_NUM_LEVELS + 1] = { NULL };
+  float *restrict level_out[MAX_NUM_LEVELS + 1] = { NULL };
+  uint8_t *restrict level_mask[MAX_NUM_LEVELS + 1] = { NULL };
+  size_t level_width[MAX_NUM_LEVELS + 1] = { width };
+  size_t level_height[MAX_NUM_LEVELS + 1] = { height };
+  float *restrict level_temp1 = NULL;
+  float *restrict level_temp2 = NULL;
+  for(int l = 1; l <= levels; l++)
+  {
+    level_width[l] = (level_width[l - 1] + 1) / 2;
+    level_height[l] = (level_height[l - 1] + 1) / 2;
+    level_in[l] = dt_alloc_align_float(level_width[l] * level_height[l] * 4);
+    level_out[l] = dt_alloc_align_float(level_width[l] * level_height[l] * 4);
+    level_mask[l] = dt_alloc_align(64, sizeof(uint8_t) * level_width[l] * level_height[l]);
+    if(!level_in[l] || !level_out[l] || !level_mask[l]) out_of_memory = TRUE;
+  }
+  if(levels)
+  {
+    level_temp1 = dt_alloc_align_float(level_width[1] * level_height[1] * 4);
+    level_temp2 = dt_alloc_align_float(level_width[1] * level_height[1] * 4);
+    if(!level_temp1 || !level_temp2) out_of_memory = TRUE;
+  }
+
   // PAUSE !
   // check that all buffers exist before processing,
   // because we use a lot of memory here.
@@ -1118,30 +1311,40 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
     in = temp1;
   }
 
-  for(int it = 0; it < iterations; it++)
+  if(levels == 0)
   {
-    if(it == 0)
-    {
-      temp_in = in;
-      temp_out = temp2;
-    }
-    else if(it % 2 == 0)
-    {
-      temp_in = temp1;
-      temp_out = temp2;
-    }
-    else
+    diffuse_iterations(in, out, temp1, temp2, mask, has_mask, width, height, iterations, data, final_radius,
+                       scale, HF, LF_odd, LF_even);
+  }
+  else
+  {
+    // build the pyramid of the input
+    level_in[0] = in;
+    level_mask[0] = mask;
+    for(int l = 1; l <= levels; l++)
+      downsample_level(level_in[l - 1], level_in[l], level_mask[l - 1], level_mask[l], has_mask,
+                       level_width[l - 1], level_height[l - 1], level_width[l], level_height[l]);
+
+    // iterate from the coarsest level up, every level starting where the coarser one ended
+    for(int l = levels; l >= 0; l--)
     {
-      temp_in = temp2;
-      temp_out = temp1;
+      const int level_iterations = get_level_iterations(iterations, levels, l);
+      const float factor = (float)(1 << l);
+      // the finest level cycles between the full size temp buffers, the input may be one of them
+      float *const restrict t1 = (l == 0) ? temp1 : level_temp1;
+      float *const restrict t2 = (l == 0) ? temp2 : level_temp2;
+      const float *start = level_in[l];
+      if(l < levels)
+      {
+        float *const restrict level_start = (level_in[l] == t1) ? t2 : t1;
+        upsample_level(level_in[l], level_in[l + 1], level_out[l + 1], level_mask[l], has_mask, level_start,
+                       level_width[l], level_height[l], level_width[l + 1], level_height[l + 1]);
+        start = level_start;
+      }
+      diffuse_iterations(start, (l == 0) ? out : level_out[l], t1, t2, level_mask[l], has_mask,
+                         level_width[l], level_height[l], level_iterations, data, final_radius / factor,
+                         scale * factor, HF, LF_odd, LF_even);
     }
-
-    if(it == (int)iterations - 1)
-      temp_out = out;
-
-    wavelets_process(temp_in, temp_out, mask,
-                     roi_out->width, roi_out->height,
-                     data, final_radius, scale, scales, has_mask, HF, LF_odd, LF_even);
   }
 
 error:
@@ -1151,6 +1354,14 @@ error:
   if(LF_even) dt_free_align(LF_even);
   if(LF_odd) dt_free_align(LF_odd);
   for(int s = 0; s < scales; s++) if(HF[s]) dt_free_align(HF[s]);
+  for(int l = 1; l <= levels; l++)
+  {
+    if(level_in[l]) dt_free_align(level_in[l]);
+    if(level_out[l]) dt_free_align(level_out[l]);
+    if(level_mask[l]) dt_free_align(level_mask[l]);
+  }
+  if(level_temp1) dt_free_align(level_temp1);
+  if(level_temp2) dt_free_align(level_temp2);
 }
 
 #if HAVE_OPENCL
@@ -1311,6 +1522,31 @@ static inline cl_int wavelets_process_cl(const int devid, cl_mem in, cl_mem reco
   return err;
 }
 
+static inline cl_int diffuse_iterations_cl(const int devid, cl_mem in, cl_mem out, cl_mem temp1, cl_mem temp2,
+                                           cl_mem mask, const int has_mask, const int width, const int height,
+                                           const int iterations, const dt_iop_diffuse_data_t *const data,
+                                           dt_iop_diffuse_global_data_t *const gd, const float final_radius,
+                                           const float zoom, cl_mem HF[MAX_NUM_SCALES], cl_mem LF_odd,
+                                           cl_mem LF_even)
+{
+  cl_int err = CL_SUCCESS;
+  size_t sizes[] = { ROUNDUPDWD(width, devid), ROUNDUPDHT(height, devid), 1 };
+  // final_radius is given in pixels of this level, zoom is the size of one of them in pixels of the full image
+  const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
+  const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
+  // cycle between the temp buffers, the input may be one of them
+  cl_mem temp_in = in;
+  for(int it = 0; it < iterations; it++)
+  {
+    cl_mem temp_out = (it == iterations - 1) ? out : (temp_in == temp1) ? temp2 : temp1;
+    err = wavelets_process_cl(devid, temp_in, temp_out, mask, sizes, width, height, data, gd, final_radius, zoom,
+                              scales, has_mask, HF, LF_odd, LF_even);
+    if(err != CL_SUCCESS) return err;
+    temp_in = temp_out;
+  }
+  return err;
+}
+
 int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_mem dev_in, cl_mem dev_out,
                const dt_iop_roi_t *const roi_in, const dt_iop_roi_t *const roi_out)
 {
@@ -1332,9 +1568,6 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
   cl_mem temp1 = dt_opencl_alloc_device(devid, sizes[0], sizes[1], sizeof(float) * 4);
   cl_mem temp2 = dt_opencl_alloc_device(devid, sizes[0], sizes[1], sizeof(float) * 4);
 
-  cl_mem temp_in = NULL;
-  cl_mem temp_out = NULL;
-
   cl_mem mask = dt_opencl_alloc_device(devid, sizes[0], sizes[1], sizeof(uint8_t));
 
   const float scale = fmaxf(piece->iscale / roi_in->scale, 1.f);
@@ -1343,6 +1576,7 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
   const int iterations = MAX(ceilf((float)data->iterations), 1);
   const int diffusion_scales = num_steps_to_reach_equivalent_sigma(B_SPLINE_SIGMA, final_radius);
   const int scales = CLAMP(diffusion_scales, 1, MAX_NUM_SCALES);
+  const int levels = get_coarse_levels(piece, iterations, scales, scale);
 
   // wavelets scales buffers
   cl_mem HF[MAX_NUM_SCALES];
@@ -1356,6 +1590,30 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
   cl_mem LF_even = dt_opencl_alloc_device(devid, sizes[0], sizes[1], sizeof(float) * 4);
   cl_mem LF_odd = dt_opencl_alloc_device(devid, sizes[0], sizes[1], sizeof(float) * 4);
 
+  // input, output and mask of the coarser levels, and temp buffers to cycle between on them
+  cl_mem level_in[MAX_NUM_LEVELS + 1] = { NULL };
+  cl_mem level_out[MAX_NUM_LEVELS + 1] = { NULL };
+  cl_mem level_mask[MAX_NUM_LEVELS + 1] = { NULL };
+  int level_width[MAX_NUM_LEVELS + 1] = { width };
+  int level_height[MAX_NUM_LEVELS + 1] = { height };
+  cl_mem level_temp1 = NULL;
+  cl_mem level_temp2 = NULL;
+  for(int l = 1; l <= levels; l++)
+  {
+    level_width[l] = (level_width[l - 1] + 1) / 2;
+    level_height[l] = (level_height[l - 1] + 1) / 2;
+    level_in[l] = dt_opencl_alloc_device(devid, level_width[l], level_height[l], sizeof(float) * 4);
+    level_out[l] = dt_opencl_alloc_device(devid, level_width[l], level_height[l], sizeof(float) * 4);
+    level_mask[l] = dt_opencl_alloc_device(devid, level_width[l], level_height[l], sizeof(uint8_t));
+    if(!level_in[l] || !level_out[l] || !level_mask[l]) out_of_memory = TRUE;
+  }
+  if(levels)
+  {
+    level_temp1 = dt_opencl_alloc_device(devid, level_width[1], level_height[1], sizeof(float) * 4);
+    level_temp2 = dt_opencl_alloc_device(devid, level_width[1], level_height[1], sizeof(float) * 4);
+    if(!level_temp1 || !level_temp2) out_of_memory = TRUE;
+  }
+
   // PAUSE !
   // check that all buffers exist before processing,
   // because we use a lot of memory here.
@@ -1391,27 +1649,64 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
     in = temp1;
   }
 
-  for(int it = 0; it < iterations; it++)
+  if(levels == 0)
   {
-    if(it == 0)
-    {
-      temp_in = in;
-      temp_out = temp2;
-    }
-    else if(it % 2 == 0)
+    err = diffuse_iterations_cl(devid, in, dev_out, temp1, temp2, mask, has_mask, width, height, iterations, data,
+                                gd, final_radius, scale, HF, LF_odd, LF_even);
+    if(err != CL_SUCCESS) goto error;
+  }
+  else
+  {
+    // build the pyramid of the input
+    level_in[0] = in;
+    level_mask[0] = mask;
+    for(int l = 1; l <= levels; l++)
     {
-      temp_in = temp1;
-      temp_out = temp2;
+      size_t level_sizes[] = { ROUNDUPDWD(level_width[l], devid), ROUNDUPDHT(level_height[l], devid), 1 };
+      dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_downsample, 0, sizeof(cl_mem), (void *)&level_in[l - 1]);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_downsample, 1, sizeof(cl_mem), (void *)&level_in[l]);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_downsample, 2, sizeof(cl_mem), (void *)&level_mask[l - 1]);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_downsample, 3, sizeof(cl_mem), (void *)&level_mask[l]);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_downsample, 4, sizeof(int), (void *)&has_mask);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_downsample, 5, sizeof(int), (void *)&level_width[l - 1]);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_downsample, 6, sizeof(int), (void *)&level_height[l - 1]);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_downsample, 7, sizeof(int), (void *)&level_width[l]);
+      dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_downsample, 8, sizeof(int), (void *)&level_height[l]);
+      err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_diffuse_downsample, level_sizes);
+      if(err != CL_SUCCESS) goto error;
     }
-    else
+
+    // iterate from the coarsest level up, every level starting where the coarser one ended
+    for(int l = levels; l >= 0; l--)
     {
-      temp_in = temp2;
-      temp_out = temp1;
+      const int level_iterations = get_level_iterations(iterations, levels, l);
+      const float factor = (float)(1 << l);
+      // the finest level cycles between the full size temp buffers, the input may be one of them
+      cl_mem t1 = (l == 0) ? temp1 : level_temp1;
+      cl_mem t2 = (l == 0) ? temp2 : level_temp2;
+      cl_mem start = level_in[l];
+      if(l < levels)
+      {
+        size_t level_sizes[] = { ROUNDUPDWD(level_width[l], devid), ROUNDUPDHT(level_height[l], devid), 1 };
+        start = (level_in[l] == t1) ? t2 : t1;
+        dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_upsample, 0, sizeof(cl_mem), (void *)&level_in[l]);
+        dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_upsample, 1, sizeof(cl_mem), (void *)&level_in[l + 1]);
+        dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_upsample, 2, sizeof(cl_mem), (void *)&level_out[l + 1]);
+        dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_upsample, 3, sizeof(cl_mem), (void *)&level_mask[l]);
+        dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_upsample, 4, sizeof(int), (void *)&has_mask);
+        dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_upsample, 5, sizeof(cl_mem), (void *)&start);
+        dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_upsample, 6, sizeof(int), (void *)&level_width[l]);
+        dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_upsample, 7, sizeof(int), (void *)&level_height[l]);
+        dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_upsample, 8, sizeof(int), (void *)&level_width[l + 1]);
+        dt_opencl_set_kernel_arg(devid, gd->kernel_diffuse_upsample, 9, sizeof(int), (void *)&level_height[l + 1]);
+        err = dt_opencl_enqueue_kernel_2d(devid, gd->kernel_diffuse_upsample, level_sizes);
+        if(err != CL_SUCCESS) goto error;
+      }
+      err = diffuse_iterations_cl(devid, start, (l == 0) ? dev_out : level_out[l], t1, t2, level_mask[l], has_mask,
+                                  level_width[l], level_height[l], level_iterations, data, gd,
+                                  final_radius / factor, scale * factor, HF, LF_odd, LF_even);
+      if(err != CL_SUCCESS) goto error;
     }
-
-    if(it == (int)iterations - 1) temp_out = dev_out;
-    err = wavelets_process_cl(devid, temp_in, temp_out, mask, sizes, width, height, data, gd, final_radius, scale, scales, has_mask, HF, LF_odd, LF_even);
-    if(err != CL_SUCCESS) goto error;
   }
 
   // cleanup and exit on success
@@ -1421,6 +1716,14 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
   dt_opencl_release_mem_object(LF_even);
   dt_opencl_release_mem_object(LF_odd);
   for(int s = 0; s < scales; s++) dt_opencl_release_mem_object(HF[s]);
+  for(int l = 1; l <= levels; l++)
+  {
+    dt_opencl_release_mem_object(level_in[l]);
+    dt_opencl_release_mem_object(level_out[l]);
+    dt_opencl_release_mem_object(level_mask[l]);
+  }
+  if(level_temp1) dt_opencl_release_mem_object(level_temp1);
+  if(level_temp2) dt_opencl_release_mem_object(level_temp2);
   return TRUE;
 
 error:
@@ -1430,6 +1733,14 @@ error:
   if(LF_even) dt_opencl_release_mem_object(LF_even);
   if(LF_odd) dt_opencl_release_mem_object(LF_odd);
   for(int s = 0; s < scales; s++) if(HF[s]) dt_opencl_release_mem_object(HF[s]);
+  for(int l = 1; l <= levels; l++)
+  {
+    if(level_in[l]) dt_opencl_release_mem_object(level_in[l]);
+    if(level_out[l]) dt_opencl_release_mem_object(level_out[l]);
+    if(level_mask[l]) dt_opencl_release_mem_object(level_mask[l]);
+  }
+  if(level_temp1) dt_opencl_release_mem_object(level_temp1);
+  if(level_temp2) dt_opencl_release_mem_object(level_temp2);
 
   dt_print(DT_DEBUG_OPENCL, "[opencl_diffuse] couldn't enqueue kernel! %d\n", err);
   return FALSE;
@@ -1444,6 +1755,8 @@ void init_global(dt_iop_module_so_t *module)
   gd->kernel_diffuse_build_mask = dt_opencl_create_kernel(program, "build_mask");
   gd->kernel_diffuse_inpaint_mask = dt_opencl_create_kernel(program, "inpaint_mask");
   gd->kernel_diffuse_pde = dt_opencl_create_kernel(program, "diffuse_pde");
+  gd->kernel_diffuse_downsample = dt_opencl_create_kernel(program, "diffuse_downsample");
+  gd->kernel_diffuse_upsample = dt_opencl_create_kernel(program, "diffuse_upsample");
 
   const int wavelets = 35; // bspline.cl, from programs.conf
   gd->kernel_filmic_bspline_horizontal = dt_opencl_create_kernel(wavelets, "blur_2D_Bspline_horizontal");
@@ -1458,6 +1771,8 @@ void cleanup_global(dt_iop_module_so_t *module)
   dt_opencl_free_kernel(gd->kernel_diffuse_build_mask);
   dt_opencl_free_kernel(gd->kernel_diffuse_inpaint_mask);
   dt_opencl_free_kernel(gd->kernel_diffuse_pde);
+  dt_opencl_free_kernel(gd->kernel_diffuse_downsample);
+  dt_opencl_free_kernel(gd->kernel_diffuse_upsample);
 
   dt_opencl_free_kernel(gd->kernel_filmic_bspline_vertical);
   dt_opencl_free_kernel(gd->kernel_filmic_bspline_horizontal);
@@ -1483,6 +1798,13 @@ void gui_init(struct dt_iop_module_t *self)
                                 "if you plan on sharpening or inpainting, \n"
                                 "more iterations help reconstruction."));
 
+  g->coarse_to_fine = dt_bauhaus_toggle_from_params(self, "coarse_to_fine");
+  gtk_widget_set_tooltip_text(g->coarse_to_fine,
+                              _("run most of the iterations on downscaled copies of the image\n"
+                                "and only the last ones at full resolution.\n"
+                                "this is much faster with many iterations,\n"
+                                "but slightly less accurate on the finest details."));
+
   g->radius_center = dt_bauhaus_slider_from_params(self, "radius_center");
   dt_bauhaus_slider_set_soft_range(g->radius_center, 0., 512.);
   dt_bauhaus_slider_set_format(g->radius_center, " px");
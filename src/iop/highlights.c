@@ -1594,12 +1594,17 @@ static void process_laplacian_bayer(struct dt_iop_module_t *self, dt_dev_pixelpi
   const float *const restrict input = (const float *const restrict)ivoid;
   float *const restrict output = (float *const restrict)ovoid;
 
+  if(!interpolated || !clipping_mask || !LF_odd || !LF_even || !temp || !HF || !ds_interpolated
+     || !ds_clipping_mask)
+    goto error;
+
   _interpolate_and_mask(input, interpolated, clipping_mask, clips, wb, filters, width, height);
   dt_box_mean(clipping_mask, height, width, 4, 2, 1);
 
   // Downsample
-  interpolate_bilinear(clipping_mask, width, height, ds_clipping_mask, ds_width, ds_height, 4);
-  interpolate_bilinear(interpolated, width, height, ds_interpolated, ds_width, ds_height, 4);
+  if(interpolate_bilinear(clipping_mask, width, height, ds_clipping_mask, ds_width, ds_height, 4)
+     || interpolate_bilinear(interpolated, width, height, ds_interpolated, ds_width, ds_height, 4))
+    goto error;
 
   for(int i = 0; i < data->iterations; i++)
   {
@@ -1611,14 +1616,20 @@ static void process_laplacian_bayer(struct dt_iop_module_t *self, dt_dev_pixelpi
   }
 
   // Upsample
-  interpolate_bilinear(ds_interpolated, ds_width, ds_height, interpolated, width, height, 4);
+  if(interpolate_bilinear(ds_interpolated, ds_width, ds_height, interpolated, width, height, 4)) goto error;
   _remosaic_and_replace(input, interpolated, clipping_mask, output, wb, filters, width, height);
 
 #if DEBUG_DUMP_PFM
   dump_PFM("/tmp/interpolated.pfm", interpolated, width, height);
   dump_PFM("/tmp/clipping_mask.pfm", clipping_mask, width, height);
 #endif
+  goto clean;
+
+error:
+  dt_control_log(_("highlights reconstruction failed to allocate memory, check your RAM settings"));
+  dt_iop_image_copy_by_size(output, input, width, height, 1);
 
+clean:
   dt_free_align(interpolated);
   dt_free_align(clipping_mask);
   dt_free_align(temp);
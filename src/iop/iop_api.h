@@ -165,6 +165,9 @@ OPTIONAL(void, modify_roi_out, struct dt_iop_module_t *self, struct dt_dev_pixel
                                struct dt_iop_roi_t *roi_out, const struct dt_iop_roi_t *roi_in);
 OPTIONAL(int, legacy_params, struct dt_iop_module_t *self, const void *const old_params, const int old_version,
                              void *new_params, const int new_version);
+/** called on the modules of an image once a history was pasted or a style applied to it, see
+ * dt_dev_history_pasted(). may adapt self->params to the image, returns TRUE if it did. */
+OPTIONAL(int, history_pasted, struct dt_iop_module_t *self);
 // allow to select a shape inside an iop
 OPTIONAL(void, masks_selection_changed, struct dt_iop_module_t *self, const int form_selected_id);
 
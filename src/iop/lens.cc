@@ -367,6 +367,160 @@ static lfModifier * get_modifier(int *mods_done, int w, int h, const dt_iop_lens
   return mod;
 }
 
+/* lensfun evaluates its models for each pixel with scalar code, and this dominates the time of the module on
+   large images. the corrections are smooth though: we evaluate them with lensfun on a coarse grid of nodes and
+   interpolate them bilinearly in between. the interpolation is checked against lensfun in the middle of each
+   cell, where it is the least accurate, and the grid is refined (down to lensfun on each pixel) until it is
+   close enough.
+*/
+#define LENS_GRID_STEP 16
+#define LENS_GRID_MAX_ERROR_DISTORTION 0.01f // in pixels
+#define LENS_GRID_MAX_ERROR_VIGNETTING 1e-4f // relative to the gain
+
+typedef struct dt_iop_lensfun_grid_t
+{
+  int x, y;          // position of the first node, in the coordinates of the roi
+  int step;          // distance between nodes in pixels
+  int width, height; // number of nodes
+  int n;             // values per node: the 6 distorted coordinates, or the vignetting gain
+  float *data;       // NULL if lensfun has to be used on each pixel
+} dt_iop_lensfun_grid_t;
+
+// lensfun's values at (x, y)
+static inline void _grid_sample(const lfModifier *modifier, const int n, const float x, const float y,
+                                float *const out)
+{
+  if(n == 6)
+    modifier->ApplySubpixelGeometryDistortion(x, y, 1, 1, out);
+  else
+  {
+    // the vignetting correction is a gain on the colour channels
+    dt_aligned_pixel_t pixel = { 1.0f, 1.0f, 1.0f, 1.0f };
+    modifier->ApplyColorModification(pixel, x, y, 1, 1, LF_CR_4(RED, GREEN, BLUE, UNKNOWN), 4);
+    out[0] = pixel[0];
+  }
+}
+
+static void _grid_init(dt_iop_lensfun_grid_t *grid, const lfModifier *modifier, const int n,
+                       const dt_iop_roi_t *const roi, const float max_error)
+{
+  memset(grid, 0, sizeof(dt_iop_lensfun_grid_t));
+
+  for(int step = LENS_GRID_STEP; step > 1; step /= 2)
+  {
+    // the last node is on or beyond the last pixel
+    const int width = (roi->width - 1) / step + 2;
+    const int height = (roi->height - 1) / step + 2;
+    const float x0 = roi->x;
+    const float y0 = roi->y;
+    float *const data = dt_alloc_align_float((size_t)width * height * n);
+    if(!data) return;
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(data, width, height, n, step, x0, y0) \
+    shared(modifier) \
+    schedule(static)
+#endif
+    for(int j = 0; j < height; j++)
+      for(int i = 0; i < width; i++)
+        _grid_sample(modifier, n, x0 + i * step, y0 + j * step, data + ((size_t)j * width + i) * n);
+
+    float error = 0.0f;
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+    dt_omp_firstprivate(data, width, height, n, step, x0, y0) \
+    shared(modifier) \
+    reduction(max : error) \
+    schedule(static)
+#endif
+    for(int j = 0; j < height - 1; j++)
+      for(int i = 0; i < width - 1; i++)
+      {
+        float exact[6];
+        _grid_sample(modifier, n, x0 + (i + 0.5f) * step, y0 + (j + 0.5f) * step, exact);
+        const float *const node = data + ((size_t)j * width + i) * n;
+        const size_t row = (size_t)width * n;
+        for(int k = 0; k < n; k++)
+        {
+          const float interpolated = 0.25f * (node[k] + node[k + n] + node[k + row] + node[k + row + n]);
+          const float e = fabsf(interpolated - exact[k]) / (n == 1 ? fabsf(exact[k]) : 1.0f);
+          // lensfun gives NaN where the model is not defined, the exact path handles those per pixel
+          error = isfinite(e) ? fmaxf(error, e) : INFINITY;
+        }
+      }
+
+    if(error <= max_error)
+    {
+      grid->x = roi->x;
+      grid->y = roi->y;
+      grid->step = step;
+      grid->width = width;
+      grid->height = height;
+      grid->n = n;
+      grid->data = data;
+      return;
+    }
+    dt_free_align(data);
+
+    // a finer grid still samples the undefined area, leave it all to the exact path
+    if(!isfinite(error)) return;
+  }
+}
+
+// the values for a row of pixels: interpolate between the two rows of nodes around y, then along the row.
+// tmp holds grid->width * grid->n floats.
+static inline void _grid_row(const dt_iop_lensfun_grid_t *const grid, const int x, const int y, const int width,
+                             float *const __restrict out, float *const __restrict tmp)
+{
+  const int n = grid->n;
+  const int step = grid->step;
+  const float scale = 1.0f / step;
+  const int j = (y - grid->y) / step;
+  const float t = (y - grid->y - j * step) * scale;
+  const float *const __restrict top = grid->data + (size_t)j * grid->width * n;
+  const float *const __restrict bottom = top + (size_t)grid->width * n;
+
+  for(int k = 0; k < grid->width * n; k++) tmp[k] = top[k] + t * (bottom[k] - top[k]);
+
+  for(int i = 0; i < width; i++)
+  {
+    const int px = x + i - grid->x;
+    const int c = px / step;
+    const float s = (px - c * step) * scale;
+    const float *const __restrict left = tmp + (size_t)c * n;
+    for(int k = 0; k < n; k++) out[(size_t)i * n + k] = left[k] + s * (left[k + n] - left[k]);
+  }
+}
+
+// the distorted coordinates of the three channels for row y of roi, tmp holds grid->width * 6 floats
+static inline void _distort_row(const lfModifier *modifier, const dt_iop_lensfun_grid_t *const grid,
+                                const dt_iop_roi_t *const roi, const int y, float *const buf, float *const tmp)
+{
+  if(grid->data)
+    _grid_row(grid, roi->x, roi->y + y, roi->width, buf, tmp);
+  else
+    modifier->ApplySubpixelGeometryDistortion(roi->x, roi->y + y, roi->width, 1, buf);
+}
+
+// correct the vignetting of row y of roi, tmp holds roi->width + grid->width floats
+static inline void _vignetting_row(const lfModifier *modifier, const dt_iop_lensfun_grid_t *const grid,
+                                   const dt_iop_roi_t *const roi, const int y, float *const __restrict pixels,
+                                   const int ch, const unsigned int pixelformat, float *const __restrict tmp)
+{
+  if(!grid->data)
+  {
+    // actually this way row stride does not matter.
+    modifier->ApplyColorModification(pixels, roi->x, roi->y + y, roi->width, 1, pixelformat, ch * roi->width);
+    return;
+  }
+
+  float *const __restrict gain = tmp;
+  _grid_row(grid, roi->x, roi->y + y, roi->width, gain, tmp + roi->width);
+  for(int i = 0; i < roi->width; i++)
+    for(int c = 0; c < 3; c++) pixels[(size_t)i * ch + c] *= gain[i];
+}
+
 /* Why do we care about being a monochrome image or not?
  The lensfun library does not have an algorithm for distortion or tca correction specialized for monochrome images,
    the builtin correction works with subtle differences for the color channels leading to some colorizing of the images.
@@ -415,8 +569,11 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
     // reverse direction (useful for renderings)
     if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
     {
-      // acquire temp memory for distorted pixel coords
-      const size_t bufsize = (size_t)roi_out->width * 2 * 3;
+      dt_iop_lensfun_grid_t grid;
+      _grid_init(&grid, modifier, 6, roi_out, LENS_GRID_MAX_ERROR_DISTORTION);
+
+      // acquire temp memory for distorted pixel coords, and the row of grid nodes
+      const size_t bufsize = (size_t)roi_out->width * 2 * 3 + (size_t)grid.width * 6;
 
       size_t padded_bufsize;
       float *const buf = dt_alloc_perthread_float(bufsize, &padded_bufsize);
@@ -425,13 +582,13 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 #pragma omp parallel for default(none) \
       dt_omp_firstprivate(padded_bufsize, ch, ch_width, d, interpolation, ivoid, mask_display, ovoid, roi_in, roi_out)	\
       dt_omp_sharedconst(buf, raw_monochrome) \
-      shared(modifier) \
+      shared(modifier, grid) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, bufptr);
+        _distort_row(modifier, &grid, roi_out, y, bufptr, bufptr + (size_t)roi_out->width * 6);
 
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
@@ -472,6 +629,7 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
         }
       }
       dt_free_align(buf);
+      dt_free_align(grid.data);
     }
     else
     {
@@ -480,20 +638,28 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 
     if(modflags & LF_MODIFY_VIGNETTING)
     {
+      dt_iop_lensfun_grid_t grid;
+      _grid_init(&grid, modifier, 1, roi_out, LENS_GRID_MAX_ERROR_VIGNETTING);
+
+      size_t padded_bufsize;
+      float *const buf = dt_alloc_perthread_float((size_t)roi_out->width + grid.width, &padded_bufsize);
+
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-      dt_omp_firstprivate(ch, pixelformat, roi_out, ovoid) \
-      shared(modifier) \
+      dt_omp_firstprivate(ch, padded_bufsize, pixelformat, roi_out, ovoid) \
+      dt_omp_sharedconst(buf) \
+      shared(modifier, grid) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         /* Colour correction: vignetting */
-        // actually this way row stride does not matter.
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
-        modifier->ApplyColorModification(out, roi_out->x, roi_out->y + y, roi_out->width, 1,
-                                         pixelformat, ch * roi_out->width);
+        _vignetting_row(modifier, &grid, roi_out, y, out, ch, pixelformat,
+                        (float *)dt_get_perthread(buf, padded_bufsize));
       }
+      dt_free_align(buf);
+      dt_free_align(grid.data);
     }
   }
   else // correct distortions:
@@ -505,26 +671,37 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 
     if(modflags & LF_MODIFY_VIGNETTING)
     {
+      dt_iop_lensfun_grid_t grid;
+      _grid_init(&grid, modifier, 1, roi_in, LENS_GRID_MAX_ERROR_VIGNETTING);
+
+      size_t padded_tmpsize;
+      float *const tmp = dt_alloc_perthread_float((size_t)roi_in->width + grid.width, &padded_tmpsize);
+
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-      dt_omp_firstprivate(ch, pixelformat, roi_in) \
-      shared(buf, modifier) \
+      dt_omp_firstprivate(ch, padded_tmpsize, pixelformat, roi_in) \
+      dt_omp_sharedconst(tmp) \
+      shared(buf, modifier, grid) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_in->height; y++)
       {
         /* Colour correction: vignetting */
-        // actually this way row stride does not matter.
         float *bufptr = ((float *)buf) + (size_t)ch * roi_in->width * y;
-        modifier->ApplyColorModification(bufptr, roi_in->x, roi_in->y + y, roi_in->width, 1,
-                                         pixelformat, ch * roi_in->width);
+        _vignetting_row(modifier, &grid, roi_in, y, bufptr, ch, pixelformat,
+                        (float *)dt_get_perthread(tmp, padded_tmpsize));
       }
+      dt_free_align(tmp);
+      dt_free_align(grid.data);
     }
 
     if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
     {
-      // acquire temp memory for distorted pixel coords
-      const size_t buf2size = (size_t)roi_out->width * 2 * 3;
+      dt_iop_lensfun_grid_t grid;
+      _grid_init(&grid, modifier, 6, roi_out, LENS_GRID_MAX_ERROR_DISTORTION);
+
+      // acquire temp memory for distorted pixel coords, and the row of grid nodes
+      const size_t buf2size = (size_t)roi_out->width * 2 * 3 + (size_t)grid.width * 6;
       size_t padded_buf2size;
       float *const buf2 = dt_alloc_perthread_float(buf2size, &padded_buf2size);
 
@@ -532,14 +709,13 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
 #pragma omp parallel for default(none) \
       dt_omp_firstprivate(padded_buf2size, ch, ch_width, d, interpolation, mask_display, ovoid, roi_in, roi_out) \
       dt_omp_sharedconst(buf2, raw_monochrome) \
-      shared(buf, modifier) \
+      shared(buf, modifier, grid) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *buf2ptr = (float*)dt_get_perthread(buf2, padded_buf2size);
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width,
-                                                  1, buf2ptr);
+        _distort_row(modifier, &grid, roi_out, y, buf2ptr, buf2ptr + (size_t)roi_out->width * 6);
         // reverse transform the global coords from lf to our buffer
         float *out = ((float *)ovoid) + (size_t)y * roi_out->width * ch;
         for(int x = 0; x < roi_out->width; x++, buf2ptr += 6, out += ch)
@@ -577,6 +753,7 @@ void process(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *c
         }
       }
       dt_free_align(buf2);
+      dt_free_align(grid.data);
     }
     else
     {
@@ -683,18 +860,25 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
     // reverse direction (useful for renderings)
     if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
     {
+      dt_iop_lensfun_grid_t grid;
+      _grid_init(&grid, modifier, 6, roi_out, LENS_GRID_MAX_ERROR_DISTORTION);
+      size_t padded_nodessize;
+      float *const nodes = dt_alloc_perthread_float((size_t)grid.width * 6 + 1, &padded_nodessize);
+
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-      dt_omp_firstprivate(tmpbufwidth, roi_out) \
-      dt_omp_sharedconst(raw_monochrome) \
-      shared(tmpbuf, d, modifier) \
+      dt_omp_firstprivate(tmpbufwidth, roi_out, padded_nodessize) \
+      dt_omp_sharedconst(raw_monochrome, nodes) \
+      shared(tmpbuf, d, modifier, grid) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, pi);
+        _distort_row(modifier, &grid, roi_out, y, pi, (float *)dt_get_perthread(nodes, padded_nodessize));
       }
+      dt_free_align(nodes);
+      dt_free_align(grid.data);
 
       /* _blocking_ memory transfer: host tmpbuf buffer -> opencl dev_tmpbuf */
       err = dt_opencl_write_buffer_to_device(devid, tmpbuf, dev_tmpbuf, 0,
@@ -723,21 +907,28 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
 
     if(modflags & LF_MODIFY_VIGNETTING)
     {
+      dt_iop_lensfun_grid_t grid;
+      _grid_init(&grid, modifier, 1, roi_out, LENS_GRID_MAX_ERROR_VIGNETTING);
+      size_t padded_rowsize;
+      float *const row = dt_alloc_perthread_float((size_t)roi_out->width + grid.width, &padded_rowsize);
+
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-      dt_omp_firstprivate(ch, pixelformat, roi_out) \
-      shared(tmpbuf, modifier, d) \
+      dt_omp_firstprivate(ch, pixelformat, roi_out, padded_rowsize) \
+      dt_omp_sharedconst(row) \
+      shared(tmpbuf, modifier, d, grid) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         /* Colour correction: vignetting */
-        // actually this way row stride does not matter.
         float *buf = tmpbuf + (size_t)y * ch * roi_out->width;
         for(int k = 0; k < ch * roi_out->width; k++) buf[k] = 0.5f;
-        modifier->ApplyColorModification(buf, roi_out->x, roi_out->y + y, roi_out->width, 1,
-                                         pixelformat, ch * roi_out->width);
+        _vignetting_row(modifier, &grid, roi_out, y, buf, ch, pixelformat,
+                        (float *)dt_get_perthread(row, padded_rowsize));
       }
+      dt_free_align(row);
+      dt_free_align(grid.data);
 
       /* _blocking_ memory transfer: host tmpbuf buffer -> opencl dev_tmpbuf */
       err = dt_opencl_write_buffer_to_device(devid, tmpbuf, dev_tmpbuf, 0,
@@ -765,21 +956,28 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
 
     if(modflags & LF_MODIFY_VIGNETTING)
     {
+      dt_iop_lensfun_grid_t grid;
+      _grid_init(&grid, modifier, 1, roi_in, LENS_GRID_MAX_ERROR_VIGNETTING);
+      size_t padded_rowsize;
+      float *const row = dt_alloc_perthread_float((size_t)roi_in->width + grid.width, &padded_rowsize);
+
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-      dt_omp_firstprivate(ch, pixelformat, roi_in) \
-      shared(tmpbuf, modifier, d) \
+      dt_omp_firstprivate(ch, pixelformat, roi_in, padded_rowsize) \
+      dt_omp_sharedconst(row) \
+      shared(tmpbuf, modifier, d, grid) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_in->height; y++)
       {
         /* Colour correction: vignetting */
-        // actually this way row stride does not matter.
         float *buf = tmpbuf + (size_t)y * ch * roi_in->width;
         for(int k = 0; k < ch * roi_in->width; k++) buf[k] = 0.5f;
-        modifier->ApplyColorModification(buf, roi_in->x, roi_in->y + y, roi_in->width, 1,
-                                         pixelformat, ch * roi_in->width);
+        _vignetting_row(modifier, &grid, roi_in, y, buf, ch, pixelformat,
+                        (float *)dt_get_perthread(row, padded_rowsize));
       }
+      dt_free_align(row);
+      dt_free_align(grid.data);
 
       /* _blocking_ memory transfer: host tmpbuf buffer -> opencl dev_tmpbuf */
       err = dt_opencl_write_buffer_to_device(
@@ -802,18 +1000,25 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
 
     if(modflags & (LF_MODIFY_TCA | LF_MODIFY_DISTORTION | LF_MODIFY_GEOMETRY | LF_MODIFY_SCALE))
     {
+      dt_iop_lensfun_grid_t grid;
+      _grid_init(&grid, modifier, 6, roi_out, LENS_GRID_MAX_ERROR_DISTORTION);
+      size_t padded_nodessize;
+      float *const nodes = dt_alloc_perthread_float((size_t)grid.width * 6 + 1, &padded_nodessize);
+
 #ifdef _OPENMP
 #pragma omp parallel for default(none) \
-      dt_omp_firstprivate(tmpbufwidth, roi_out) \
-      dt_omp_sharedconst(raw_monochrome) \
-      shared(tmpbuf, d, modifier) \
+      dt_omp_firstprivate(tmpbufwidth, roi_out, padded_nodessize) \
+      dt_omp_sharedconst(raw_monochrome, nodes) \
+      shared(tmpbuf, d, modifier, grid) \
       schedule(static)
 #endif
       for(int y = 0; y < roi_out->height; y++)
       {
         float *pi = tmpbuf + (size_t)y * tmpbufwidth;
-        modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, pi);
+        _distort_row(modifier, &grid, roi_out, y, pi, (float *)dt_get_perthread(nodes, padded_nodessize));
       }
+      dt_free_align(nodes);
+      dt_free_align(grid.data);
 
       /* _blocking_ memory transfer: host tmpbuf buffer -> opencl dev_tmpbuf */
       err = dt_opencl_write_buffer_to_device(devid, tmpbuf, dev_tmpbuf, 0,
@@ -971,8 +1176,11 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
 
   const struct dt_interpolation *const interpolation = dt_interpolation_new(DT_INTERPOLATION_USERPREF_WARP);
 
-  // acquire temp memory for distorted pixel coords
-  const size_t bufsize = (size_t)roi_out->width * 2 * 3;
+  dt_iop_lensfun_grid_t grid;
+  _grid_init(&grid, modifier, 6, roi_out, LENS_GRID_MAX_ERROR_DISTORTION);
+
+  // acquire temp memory for distorted pixel coords, and the row of grid nodes
+  const size_t bufsize = (size_t)roi_out->width * 2 * 3 + (size_t)grid.width * 6;
   size_t padded_bufsize;
   float *const buf = dt_alloc_perthread_float(bufsize, &padded_bufsize);
 
@@ -980,13 +1188,13 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
 #pragma omp parallel for default(none) \
   dt_omp_firstprivate(padded_bufsize, d, in, interpolation, out, roi_in, roi_out) \
   dt_omp_sharedconst(buf) \
-  shared(modifier) \
+  shared(modifier, grid) \
   schedule(static)
 #endif
   for(int y = 0; y < roi_out->height; y++)
   {
     float *bufptr = (float*)dt_get_perthread(buf, padded_bufsize);
-    modifier->ApplySubpixelGeometryDistortion(roi_out->x, roi_out->y + y, roi_out->width, 1, bufptr);
+    _distort_row(modifier, &grid, roi_out, y, bufptr, bufptr + (size_t)roi_out->width * 6);
 
     // reverse transform the global coords from lf to our buffer
     float *_out = out + (size_t)y * roi_out->width;
@@ -1006,6 +1214,7 @@ void distort_mask(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *p
     }
   }
   dt_free_align(buf);
+  dt_free_align(grid.data);
   delete modifier;
 }
 
@@ -28,6 +28,7 @@
 #include "control/control.h"
 #include "develop/imageop.h"
 #include "develop/imageop_gui.h"
+#include "develop/tiling.h"
 #include "gui/accelerators.h"
 #include "gui/gtk.h"
 #include "iop/iop_api.h"
@@ -261,6 +262,19 @@ typedef struct
   int warp_kernel;
 } dt_iop_liquify_global_data_t;
 
+// The displacement map of all the warps is kept between runs of the pipe. It is in full resolution piece
+// coordinates, on a grid of map_step pixels, so that a new roi or zoom level only needs to upsample it. When
+// the warps change, only the discs of the ones added or removed are updated: the map is the sum of their stamps.
+typedef struct
+{
+  dt_iop_liquify_params_t params;
+  float complex *map;               // on the coarse grid, NULL if there are no warps
+  cairo_rectangle_int_t map_extent; // in grid coordinates
+  int map_step;
+  dt_liquify_warp_t *warps;         // the warps in the map, sorted, in grid coordinates
+  int num_warps;
+} dt_iop_liquify_data_t;
+
 typedef struct
 {
   dt_iop_liquify_params_t params;
@@ -855,7 +869,8 @@ static float *build_lookup_table(const int distance, const float control1, const
     const float dx2 = x - crealf(cptr[-1]);
     *ptr++ = cimagf(cptr[0]) +(dx2 / dx1) * (cimagf(cptr[0]) - cimagf(cptr[-1]));
   }
-  *ptr++ = 0.0f;
+  // the bezier may run out of points before x does
+  while(ptr < lookup + distance + 2) *ptr++ = 0.0f;
 
   dt_free_align(clookup);
   return lookup;
@@ -1133,8 +1148,12 @@ static float complex *create_global_distortion_map(const cairo_rectangle_int_t *
   }
 
   // allocate distortion map big enough to contain all paths
-  float complex *map = dt_alloc_align(64, sizeof(float complex) * mapsize);
-  memset(map, 0, sizeof(float complex) * mapsize);
+  float complex *map = dt_calloc_align(64, sizeof(float complex) * mapsize);
+  if(!map)
+  {
+    dt_control_log(_("liquify failed to allocate memory, check your RAM settings"));
+    return NULL;
+  }
 
   // build map
   for(const GSList *i = interpolated; i; i = g_slist_next(i))
@@ -1149,8 +1168,13 @@ static float complex *create_global_distortion_map(const cairo_rectangle_int_t *
 
   if(inverted)
   {
-    float complex * const imap = dt_alloc_align(64, sizeof(float complex) * mapsize);
-    memset(imap, 0, sizeof(float complex) * mapsize);
+    float complex * const imap = dt_calloc_align(64, sizeof(float complex) * mapsize);
+    if(!imap)
+    {
+      dt_free_align((void *) map);
+      dt_control_log(_("liquify failed to allocate memory, check your RAM settings"));
+      return NULL;
+    }
 
     // copy map into imap(inverted map).
     // imap [ n + dx(map[n]) , n + dy(map[n]) ] = -map[n]
@@ -1207,25 +1231,249 @@ static float complex *create_global_distortion_map(const cairo_rectangle_int_t *
   return map;
 }
 
+// largest grid step of the cached map, in pixels of the full resolution piece
+#define MAP_MAX_STEP 4
+// the grid has at least that many steps in the radius of the smallest warp
+#define MAP_STEPS_PER_RADIUS 16
+// margin of the cached map around the warps, in grid steps, so that moving a warp doesn't reallocate it
+#define MAP_MARGIN 64
+// largest cached map in bytes. larger maps, small warps all over a large image, are built for the roi only.
+#define MAP_MAX_SIZE ((size_t)64 << 20)
+
+static int _warp_cmp(const void *a, const void *b)
+{
+  return memcmp(a, b, sizeof(dt_liquify_warp_t));
+}
+
+// add the warp to the map, weighted. the stamp is evaluated at the exact position of the grid nodes: a stamp
+// centered on the nearest node like build_round_stamp() would move the warp by up to half a grid step.
+static void _stamp_map(float complex *map, const cairo_rectangle_int_t *const map_extent,
+                       const dt_liquify_warp_t *const warp, const float weight)
+{
+  const float radius = cabsf(warp->radius - warp->point);
+  const int table_size = radius * LOOKUP_OVERSAMPLE;
+  if(table_size < 1) return;
+
+  // same as build_round_stamp()
+  float complex strength = 0.5f * (warp->strength - warp->point);
+  strength = (warp->status & DT_LIQUIFY_STATUS_INTERPOLATED) ? (strength * STAMP_RELOCATION) : strength;
+  const float abs_strength = cabsf(strength);
+  const float radial = warp->type == DT_LIQUIFY_WARP_TYPE_RADIAL_GROW ? abs_strength / radius
+                     : warp->type == DT_LIQUIFY_WARP_TYPE_RADIAL_SHRINK ? -abs_strength / radius
+                     : 0.0f;
+  const float *const restrict lookup_table = build_lookup_table(table_size, warp->control1, warp->control2);
+
+  const float cx = crealf(warp->point);
+  const float cy = cimagf(warp->point);
+  const int x0 = MAX((int)ceilf(cx - radius), map_extent->x);
+  const int x1 = MIN((int)floorf(cx + radius), map_extent->x + map_extent->width - 1);
+  const int y0 = MAX((int)ceilf(cy - radius), map_extent->y);
+  const int y1 = MIN((int)floorf(cy + radius), map_extent->y + map_extent->height - 1);
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(map, map_extent, lookup_table, table_size, strength, radial, cx, cy, x0, x1, y0, y1, weight) \
+  dt_omp_sharedconst(LOOKUP_OVERSAMPLE) \
+  schedule(static)
+#endif
+  for(int y = y0; y <= y1; y++)
+  {
+    float complex *const row = map + (size_t)(y - map_extent->y) * map_extent->width - map_extent->x;
+    for(int x = x0; x <= x1; x++)
+    {
+      const float dx = x - cx;
+      const float dy = y - cy;
+      const int idist = round(sqrtf(dx * dx + dy * dy) * LOOKUP_OVERSAMPLE);
+      if(idist >= table_size) continue;
+      const float complex v = radial != 0.0f ? radial * lookup_table[idist] * (dx + dy * I)
+                                             : strength * lookup_table[idist];
+      row[x] -= weight * v;
+    }
+  }
+
+  dt_free_align((void *) lookup_table);
+}
+
+// the warps on the grid of step pixels, and their extent
+static void _grid_warps(const dt_liquify_warp_t *const warps, const int num_warps, const int step,
+                        dt_liquify_warp_t *const grid_warps, cairo_rectangle_int_t *const extent)
+{
+  cairo_region_t *region = cairo_region_create();
+  for(int k = 0; k < num_warps; k++)
+  {
+    grid_warps[k] = warps[k];
+    grid_warps[k].point /= step;
+    grid_warps[k].strength /= step;
+    grid_warps[k].radius /= step;
+    cairo_rectangle_int_t r;
+    compute_round_stamp_extent(&r, &grid_warps[k]);
+    cairo_region_union_rectangle(region, &r);
+  }
+  cairo_region_get_extents(region, extent);
+  cairo_region_destroy(region);
+  qsort(grid_warps, num_warps, sizeof(dt_liquify_warp_t), _warp_cmp);
+}
+
+// bring the cached map of the piece up to date with its params, for a roi at scale. returns FALSE if there is
+// no map to use: the map would be too large, or it could not be allocated.
+static gboolean _update_cached_map(struct dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece,
+                                   const float scale)
+{
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *)piece->data;
+
+  dt_iop_liquify_params_t copy_params;
+  memcpy(&copy_params, &d->params, sizeof(dt_iop_liquify_params_t));
+  distort_paths_raw_to_piece(module, piece->pipe, 1.0f, &copy_params, FALSE);
+  GList *interpolated = interpolate_paths(&copy_params);
+
+  const int num_warps = g_list_length(interpolated);
+  dt_liquify_warp_t *const full_warps = num_warps ? malloc(sizeof(dt_liquify_warp_t) * num_warps) : NULL;
+  dt_liquify_warp_t *warps = num_warps ? malloc(sizeof(dt_liquify_warp_t) * num_warps) : NULL;
+  float min_radius = FLT_MAX;
+  int k = 0;
+  for(const GList *i = interpolated; i; i = g_list_next(i), k++)
+  {
+    full_warps[k] = *(dt_liquify_warp_t *)i->data;
+    min_radius = MIN(min_radius, cabsf(full_warps[k].radius - full_warps[k].point));
+  }
+  g_list_free_full(interpolated, free);
+
+  // the step the smallest warp needs, but no finer than the pixels of the roi: zoomed out, a full
+  // resolution grid would be evaluated for nothing.
+  int step = MAP_MAX_STEP;
+  while(step > 1 && min_radius < MAP_STEPS_PER_RADIUS * step) step /= 2;
+  while(2 * step * scale <= 1.0f) step *= 2;
+
+  // a finer map in the cache is as good, keep it as long as it holds the warps
+  const int cached_step = d->map && d->map_step <= step ? d->map_step : step;
+  cairo_rectangle_int_t extent;
+  _grid_warps(full_warps, num_warps, cached_step, warps, &extent);
+
+  const cairo_rectangle_int_t *const m = &d->map_extent;
+  const gboolean inside = extent.x >= m->x && extent.y >= m->y && extent.x + extent.width <= m->x + m->width
+                          && extent.y + extent.height <= m->y + m->height;
+  const gboolean rebuild = !d->map || !num_warps || cached_step != d->map_step || !inside;
+  if(rebuild)
+  {
+    dt_free_align(d->map);
+    d->map = NULL;
+    if(cached_step != step) _grid_warps(full_warps, num_warps, step, warps, &extent);
+    const size_t width = (size_t)extent.width + 2 * MAP_MARGIN;
+    const size_t height = (size_t)extent.height + 2 * MAP_MARGIN;
+    if(num_warps && sizeof(float complex) * width * height <= MAP_MAX_SIZE)
+    {
+      d->map_step = step;
+      d->map_extent = (cairo_rectangle_int_t){ extent.x - MAP_MARGIN, extent.y - MAP_MARGIN, (int)width, (int)height };
+      d->map = dt_calloc_align(64, sizeof(float complex) * width * height);
+      if(d->map)
+        for(k = 0; k < num_warps; k++) _stamp_map(d->map, &d->map_extent, &warps[k], 1.0f);
+    }
+  }
+  else
+  {
+    // remove the warps which are gone, add the new ones
+    int i = 0, j = 0;
+    while(i < d->num_warps || j < num_warps)
+    {
+      const int cmp = i == d->num_warps ? 1 : j == num_warps ? -1 : _warp_cmp(&d->warps[i], &warps[j]);
+      if(cmp < 0)
+        _stamp_map(d->map, &d->map_extent, &d->warps[i++], -1.0f);
+      else if(cmp > 0)
+        _stamp_map(d->map, &d->map_extent, &warps[j++], 1.0f);
+      else
+      {
+        i++;
+        j++;
+      }
+    }
+  }
+
+  free(full_warps);
+  free(d->warps);
+  d->warps = d->map ? warps : NULL;
+  d->num_warps = d->map ? num_warps : 0;
+  if(!d->map) free(warps);
+  return d->map != NULL;
+}
+
 static float complex *build_global_distortion_map(struct dt_iop_module_t *module,
-                                                   const dt_dev_pixelpipe_iop_t *piece,
+                                                   dt_dev_pixelpipe_iop_t *piece,
                                                    const dt_iop_roi_t *roi_in,
                                                    const dt_iop_roi_t *roi_out,
                                                    cairo_rectangle_int_t *map_extent)
 {
-  // copy params
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *)piece->data;
+
+  // the part of the map we need, from the warps at the scale of the roi
   dt_iop_liquify_params_t copy_params;
-  memcpy(&copy_params, (dt_iop_liquify_params_t *)piece->data, sizeof(dt_iop_liquify_params_t));
+  memcpy(&copy_params, &d->params, sizeof(dt_iop_liquify_params_t));
 
   distort_paths_raw_to_piece(module, piece->pipe, roi_in->scale, &copy_params, FALSE);
 
   GList *interpolated = interpolate_paths(&copy_params);
   GSList *interpolated_in_roi = _get_map_extent(roi_out, interpolated, map_extent);
 
-  float complex *map = create_global_distortion_map(map_extent, interpolated_in_roi, FALSE);
-
+  const size_t mapsize = (size_t)map_extent->width * map_extent->height;
+  float complex *map = NULL;
+  if(mapsize == 0 || !_update_cached_map(module, piece, roi_in->scale)
+     || !(map = dt_alloc_align(64, sizeof(float complex) * mapsize)))
+  {
+    // no cached map: build the one of the roi from its warps
+    map = create_global_distortion_map(map_extent, interpolated_in_roi, FALSE);
+    g_slist_free(interpolated_in_roi);
+    g_list_free_full(interpolated, free);
+    return map;
+  }
   g_slist_free(interpolated_in_roi);
   g_list_free_full(interpolated, free);
+
+  // bilinear interpolation of the cached map, scaled to the roi. columns out of the map read the zeros of
+  // its margin.
+  const float to_grid = 1.0f / (roi_in->scale * d->map_step);
+  const float to_roi = roi_in->scale * d->map_step;
+  const float complex *const cached = d->map;
+  const cairo_rectangle_int_t cached_extent = d->map_extent;
+  const cairo_rectangle_int_t extent = *map_extent;
+  int *const col = dt_alloc_align(64, sizeof(int) * extent.width);
+  float *const wcol = dt_alloc_align_float(extent.width);
+  if(!col || !wcol)
+  {
+    dt_free_align(col);
+    dt_free_align(wcol);
+    dt_free_align(map);
+    dt_control_log(_("liquify failed to allocate memory, check your RAM settings"));
+    return NULL;
+  }
+  for(int x = 0; x < extent.width; x++)
+  {
+    const float fx = CLAMPF((x + extent.x) * to_grid - cached_extent.x, 0.0f, cached_extent.width - 1.0f);
+    col[x] = MIN((int)fx, cached_extent.width - 2);
+    wcol[x] = fx - col[x];
+  }
+
+#ifdef _OPENMP
+#pragma omp parallel for default(none) \
+  dt_omp_firstprivate(map, cached, cached_extent, extent, to_grid, to_roi, col, wcol) \
+  schedule(static)
+#endif
+  for(int y = 0; y < extent.height; y++)
+  {
+    float complex *const row = map + (size_t)y * extent.width;
+    const float fy = CLAMPF((y + extent.y) * to_grid - cached_extent.y, 0.0f, cached_extent.height - 1.0f);
+    const int y0 = MIN((int)fy, cached_extent.height - 2);
+    const float wy = fy - y0;
+    const float complex *const r0 = cached + (size_t)y0 * cached_extent.width;
+    const float complex *const r1 = r0 + cached_extent.width;
+    for(int x = 0; x < extent.width; x++)
+    {
+      const int x0 = col[x];
+      const float wx = wcol[x];
+      row[x] = to_roi * ((1.0f - wy) * ((1.0f - wx) * r0[x0] + wx * r0[x0 + 1])
+                         + wy * ((1.0f - wx) * r1[x0] + wx * r1[x0 + 1]));
+    }
+  }
+  dt_free_align(col);
+  dt_free_align(wcol);
   return map;
 }
 
@@ -1240,6 +1488,18 @@ void modify_roi_out(struct dt_iop_module_t *module,
   *roi_out = *roi_in;
 }
 
+void tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                     const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out,
+                     struct dt_develop_tiling_t *tiling)
+{
+  tiling->factor = 2.5f; // in + out + the map of the roi, two floats per pixel
+  tiling->maxbuf = 1.0f;
+  tiling->overhead = MAP_MAX_SIZE; // the cached map, kept between runs
+  tiling->overlap = 0;
+  tiling->xalign = 1;
+  tiling->yalign = 1;
+}
+
 // 2nd pass: which roi would this operation need as input to fill the given output region?
 void modify_roi_in(struct dt_iop_module_t *module,
                     struct dt_dev_pixelpipe_iop_t *piece,
@@ -1254,7 +1514,7 @@ void modify_roi_in(struct dt_iop_module_t *module,
 
   // copy params
   dt_iop_liquify_params_t copy_params;
-  memcpy(&copy_params, (dt_iop_liquify_params_t*)piece->data, sizeof(dt_iop_liquify_params_t));
+  memcpy(&copy_params, &((dt_iop_liquify_data_t *)piece->data)->params, sizeof(dt_iop_liquify_params_t));
 
   distort_paths_raw_to_piece(module, piece->pipe, roi_in->scale, &copy_params, FALSE);
 
@@ -1329,7 +1589,7 @@ static int _distort_xtransform(dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *pi
   {
     // copy params
     dt_iop_liquify_params_t copy_params;
-    memcpy(&copy_params, (dt_iop_liquify_params_t *)piece->data, sizeof(dt_iop_liquify_params_t));
+    memcpy(&copy_params, &((dt_iop_liquify_data_t *)piece->data)->params, sizeof(dt_iop_liquify_params_t));
 
     distort_paths_raw_to_piece(self, piece->pipe, scale, &copy_params, TRUE);
 
@@ -1639,7 +1899,8 @@ int process_cl(struct dt_iop_module_t *module,
   cairo_rectangle_int_t map_extent;
   const float complex *map = build_global_distortion_map(module, piece, roi_in, roi_out, &map_extent);
   if(map == NULL)
-    return TRUE;
+    // nothing to warp, or no memory for the map: let the CPU path try
+    return map_extent.width == 0 || map_extent.height == 0;
 
   // 3. apply the map
   if(map_extent.width != 0 && map_extent.height != 0)
@@ -1688,11 +1949,14 @@ void init(dt_iop_module_t *module)
 
 void init_pipe(struct dt_iop_module_t *module, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  piece->data = malloc(module->params_size);
+  piece->data = calloc(1, sizeof(dt_iop_liquify_data_t));
 }
 
 void cleanup_pipe(struct dt_iop_module_t *module, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *)piece->data;
+  dt_free_align(d->map);
+  free(d->warps);
   free(piece->data);
   piece->data = NULL;
 }
@@ -1704,7 +1968,8 @@ void commit_params(struct dt_iop_module_t *module,
                     dt_dev_pixelpipe_t *pipe,
                     dt_dev_pixelpipe_iop_t *piece)
 {
-  memcpy(piece->data, params, module->params_size);
+  dt_iop_liquify_data_t *d = (dt_iop_liquify_data_t *)piece->data;
+  memcpy(&d->params, params, module->params_size);
 }
 
 // calculate the dot product of 2 vectors.
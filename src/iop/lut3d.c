@@ -100,9 +100,22 @@ typedef enum dt_lut3d_cols_t
 
 const char invalid_filepath_prefix[] = "INVALID >> ";
 
+// parsed luts are shared by all the pipes using them, and kept for a while once unused so that a new pipe
+// (export, thumbnail, another image) doesn't read and parse the file again
+#define DT_IOP_LUT3D_CACHE_SIZE ((size_t)128 * 1024 * 1024)
+
+typedef struct dt_iop_lut3d_clut_t
+{
+  uint64_t key;   // hash of the file name, size and date, or of the compressed lut
+  float *clut;    // level^3 nodes of 4 floats
+  uint16_t level;
+  int users;      // pipes holding the lut
+} dt_iop_lut3d_clut_t;
+
 typedef struct dt_iop_lut3d_data_t
 {
   dt_iop_lut3d_params_t params;
+  dt_iop_lut3d_clut_t *entry; // the cached lut
   float *clut;  // cube lut pointer
   uint16_t level; // cube_size
 } dt_iop_lut3d_data_t;
@@ -113,6 +126,8 @@ typedef struct dt_iop_lut3d_global_data_t
   int kernel_lut3d_trilinear;
   int kernel_lut3d_pyramid;
   int kernel_lut3d_none;
+  GMutex lock;
+  GList *cluts;   // dt_iop_lut3d_clut_t, most recently used first
 } dt_iop_lut3d_global_data_t;
 
 #ifdef HAVE_GMIC
@@ -200,81 +215,55 @@ int legacy_params(dt_iop_module_t *self, const void *const old_params, const int
 
   return 1;
 }
+// the clut has level^3 nodes of 4 floats, red varying fastest: the nodes are loaded as whole pixels.
+// find the cube of nodes around the input, returns the position of its P000 corner and the deltas.
+static inline const float *_clut_cube(const float *const input, const float *const restrict clut,
+                                      const int level, dt_aligned_pixel_t rgbd)
+{
+  int rgbi[3];
+  for(int c = 0; c < 3; c++)
+  {
+    const float v = CLAMPF(input[c], 0.0f, 1.0f) * (float)(level - 1);
+    rgbi[c] = CLAMP((int)v, 0, level - 2);
+    rgbd[c] = v - rgbi[c];
+  }
+  return clut + (size_t)4 * (rgbi[0] + rgbi[1] * level + rgbi[2] * level * level);
+}
+
 // From `HaldCLUT_correct.c' by Eskil Steenberg (http://www.quelsolaar.com) (BSD licensed)
 void correct_pixel_trilinear(const float *const in, float *const out,
                              const size_t pixel_nb, const float *const restrict clut, const uint16_t level)
 {
-  const int level2 = level * level;
+  const size_t level2 = (size_t)level * level;
 #ifdef _OPENMP
-#pragma omp parallel for SIMD() default(none) \
+#pragma omp parallel for default(none) \
   dt_omp_firstprivate(clut, in, level, level2, out, pixel_nb) \
   schedule(static)
 #endif
   for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
   {
-    float *const input = ((float *const)in) + k;
-    float *const output = ((float *const)out) + k;
+    const float *const input = in + k;
+    float *const output = out + k;
+    const float alpha = input[3];
 
-    int rgbi[3], i, j;
-    float tmp[6];
     dt_aligned_pixel_t rgbd;
+    const float *const p000 = _clut_cube(input, clut, level, rgbd);
+    const float *const p010 = p000 + 4 * level;
+    const float *const p001 = p000 + 4 * level2;
+    const float *const p011 = p010 + 4 * level2;
 
-    for(int c = 0; c < 3; ++c) input[c] = fminf(fmaxf(input[c], 0.0f), 1.0f);
-
-    rgbd[0] = input[0] * (float)(level - 1);
-    rgbd[1] = input[1] * (float)(level - 1);
-    rgbd[2] = input[2] * (float)(level - 1);
-
-    rgbi[0] = CLAMP((int)rgbd[0], 0, level - 2);
-    rgbi[1] = CLAMP((int)rgbd[1], 0, level - 2);
-    rgbi[2] = CLAMP((int)rgbd[2], 0, level - 2);
-
-    rgbd[0] = rgbd[0] - rgbi[0]; // delta red
-    rgbd[1] = rgbd[1] - rgbi[1]; // delta green
-    rgbd[2] = rgbd[2] - rgbi[2]; // delta blue
-
-  // indexes of P000 to P111 in clut
-    const int color = rgbi[0] + rgbi[1] * level + rgbi[2] * level * level;
-    i = color * 3;  // P000
-    j = (color + 1) * 3;  // P100
-
-    tmp[0] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[1] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[2] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
-
-    i = (color + level) * 3;  // P010
-    j = (color + level + 1) * 3;  //P110
-
-    tmp[3] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[4] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[5] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
-
-    output[0] = tmp[0] * (1 - rgbd[1]) + tmp[3] * rgbd[1];
-    output[1] = tmp[1] * (1 - rgbd[1]) + tmp[4] * rgbd[1];
-    output[2] = tmp[2] * (1 - rgbd[1]) + tmp[5] * rgbd[1];
-
-    i = (color + level2) * 3;  // P001
-    j = (color + level2 + 1) * 3;  // P101
-
-    tmp[0] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[1] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[2] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
-
-    i = (color + level + level2) * 3;  // P011
-    j = (color + level + level2 + 1) * 3;  // P111
-
-    tmp[3] = clut[i] * (1 - rgbd[0]) + clut[j] * rgbd[0];
-    tmp[4] = clut[i+1] * (1 - rgbd[0]) + clut[j+1] * rgbd[0];
-    tmp[5] = clut[i+2] * (1 - rgbd[0]) + clut[j+2] * rgbd[0];
-
-    tmp[0] = tmp[0] * (1 - rgbd[1]) + tmp[3] * rgbd[1];
-    tmp[1] = tmp[1] * (1 - rgbd[1]) + tmp[4] * rgbd[1];
-    tmp[2] = tmp[2] * (1 - rgbd[1]) + tmp[5] * rgbd[1];
-
-    output[0] = output[0] * (1 - rgbd[2]) + tmp[0] * rgbd[2];
-    output[1] = output[1] * (1 - rgbd[2]) + tmp[1] * rgbd[2];
-    output[2] = output[2] * (1 - rgbd[2]) + tmp[2] * rgbd[2];
- }
+    for_each_channel(c, aligned(output))
+    {
+      const float p00 = p000[c] * (1 - rgbd[0]) + p000[c+4] * rgbd[0];
+      const float p10 = p010[c] * (1 - rgbd[0]) + p010[c+4] * rgbd[0];
+      const float p01 = p001[c] * (1 - rgbd[0]) + p001[c+4] * rgbd[0];
+      const float p11 = p011[c] * (1 - rgbd[0]) + p011[c+4] * rgbd[0];
+      const float p0 = p00 * (1 - rgbd[1]) + p10 * rgbd[1];
+      const float p1 = p01 * (1 - rgbd[1]) + p11 * rgbd[1];
+      output[c] = p0 * (1 - rgbd[2]) + p1 * rgbd[2];
+    }
+    output[3] = alpha;
+  }
 }
 
 // from OpenColorIO
@@ -282,86 +271,35 @@ void correct_pixel_trilinear(const float *const in, float *const out,
 void correct_pixel_tetrahedral(const float *const in, float *const out,
                                const size_t pixel_nb, const float *const restrict clut, const uint16_t level)
 {
-  const int level2 = level * level;
+  const size_t level2 = (size_t)level * level;
 #ifdef _OPENMP
-#pragma omp parallel for SIMD() default(none) \
+#pragma omp parallel for default(none) \
   dt_omp_firstprivate(clut, in, level, level2, out, pixel_nb) \
   schedule(static)
 #endif
   for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
   {
-    float *const input = ((float *const)in) + k;
-    float *const output = ((float *const)out) + k;
+    const float *const input = in + k;
+    float *const output = out + k;
+    const float alpha = input[3];
 
-    int rgbi[3];
     dt_aligned_pixel_t rgbd;
-    for(int c = 0; c < 3; ++c) input[c] = fminf(fmaxf(input[c], 0.0f), 1.0f);
-
-    rgbd[0] = input[0] * (float)(level - 1);
-    rgbd[1] = input[1] * (float)(level - 1);
-    rgbd[2] = input[2] * (float)(level - 1);
-
-    rgbi[0] = CLAMP((int)rgbd[0], 0, level - 2);
-    rgbi[1] = CLAMP((int)rgbd[1], 0, level - 2);
-    rgbi[2] = CLAMP((int)rgbd[2], 0, level - 2);
-
-    rgbd[0] = rgbd[0] - rgbi[0]; // delta red
-    rgbd[1] = rgbd[1] - rgbi[1]; // delta green
-    rgbd[2] = rgbd[2] - rgbi[2]; // delta blue
-
-  // indexes of P000 to P111 in clut
-    const int color = rgbi[0] + rgbi[1] * level + rgbi[2] * level * level;
-    const int i000 = color * 3;                     // P000
-    const int i100 = i000 + 3;                      // P100
-    const int i010 = (color + level) * 3;           // P010
-    const int i110 = i010 + 3;                      // P110
-    const int i001 = (color + level2) * 3;          // P001
-    const int i101 = i001 + 3;                      // P101
-    const int i011 = (color + level + level2) * 3;  // P011
-    const int i111 = i011 + 3;                      // P111
-
-    if (rgbd[0] > rgbd[1])
-    {
-      if (rgbd[1] > rgbd[2])
-      {
-        output[0] = (1-rgbd[0])*clut[i000] + (rgbd[0]-rgbd[1])*clut[i100] + (rgbd[1]-rgbd[2])*clut[i110] + rgbd[2]*clut[i111];
-        output[1] = (1-rgbd[0])*clut[i000+1] + (rgbd[0]-rgbd[1])*clut[i100+1] + (rgbd[1]-rgbd[2])*clut[i110+1] + rgbd[2]*clut[i111+1];
-        output[2] = (1-rgbd[0])*clut[i000+2] + (rgbd[0]-rgbd[1])*clut[i100+2] + (rgbd[1]-rgbd[2])*clut[i110+2] + rgbd[2]*clut[i111+2];
-      }
-      else if (rgbd[0] > rgbd[2])
-      {
-        output[0] = (1-rgbd[0])*clut[i000] + (rgbd[0]-rgbd[2])*clut[i100] + (rgbd[2]-rgbd[1])*clut[i101] + rgbd[1]*clut[i111];
-        output[1] = (1-rgbd[0])*clut[i000+1] + (rgbd[0]-rgbd[2])*clut[i100+1] + (rgbd[2]-rgbd[1])*clut[i101+1] + rgbd[1]*clut[i111+1];
-        output[2] = (1-rgbd[0])*clut[i000+2] + (rgbd[0]-rgbd[2])*clut[i100+2] + (rgbd[2]-rgbd[1])*clut[i101+2] + rgbd[1]*clut[i111+2];
-      }
-      else
-      {
-        output[0] = (1-rgbd[2])*clut[i000] + (rgbd[2]-rgbd[0])*clut[i001] + (rgbd[0]-rgbd[1])*clut[i101] + rgbd[1]*clut[i111];
-        output[1] = (1-rgbd[2])*clut[i000+1] + (rgbd[2]-rgbd[0])*clut[i001+1] + (rgbd[0]-rgbd[1])*clut[i101+1] + rgbd[1]*clut[i111+1];
-        output[2] = (1-rgbd[2])*clut[i000+2] + (rgbd[2]-rgbd[0])*clut[i001+2] + (rgbd[0]-rgbd[1])*clut[i101+2] + rgbd[1]*clut[i111+2];
-      }
-    }
-    else
-    {
-      if (rgbd[2] > rgbd[1])
-      {
-        output[0] = (1-rgbd[2])*clut[i000] + (rgbd[2]-rgbd[1])*clut[i001] + (rgbd[1]-rgbd[0])*clut[i011] + rgbd[0]*clut[i111];
-        output[1] = (1-rgbd[2])*clut[i000+1] + (rgbd[2]-rgbd[1])*clut[i001+1] + (rgbd[1]-rgbd[0])*clut[i011+1] + rgbd[0]*clut[i111+1];
-        output[2] = (1-rgbd[2])*clut[i000+2] + (rgbd[2]-rgbd[1])*clut[i001+2] + (rgbd[1]-rgbd[0])*clut[i011+2] + rgbd[0]*clut[i111+2];
-      }
-      else if (rgbd[2] > rgbd[0])
-      {
-        output[0] = (1-rgbd[1])*clut[i000] + (rgbd[1]-rgbd[2])*clut[i010] + (rgbd[2]-rgbd[0])*clut[i011] + rgbd[0]*clut[i111];
-        output[1] = (1-rgbd[1])*clut[i000+1] + (rgbd[1]-rgbd[2])*clut[i010+1] + (rgbd[2]-rgbd[0])*clut[i011+1] + rgbd[0]*clut[i111+1];
-        output[2] = (1-rgbd[1])*clut[i000+2] + (rgbd[1]-rgbd[2])*clut[i010+2] + (rgbd[2]-rgbd[0])*clut[i011+2] + rgbd[0]*clut[i111+2];
-      }
-      else
-      {
-        output[0] = (1-rgbd[1])*clut[i000] + (rgbd[1]-rgbd[0])*clut[i010] + (rgbd[0]-rgbd[2])*clut[i110] + rgbd[2]*clut[i111];
-        output[1] = (1-rgbd[1])*clut[i000+1] + (rgbd[1]-rgbd[0])*clut[i010+1] + (rgbd[0]-rgbd[2])*clut[i110+1] + rgbd[2]*clut[i111+1];
-        output[2] = (1-rgbd[1])*clut[i000+2] + (rgbd[1]-rgbd[0])*clut[i010+2] + (rgbd[0]-rgbd[2])*clut[i110+2] + rgbd[2]*clut[i111+2];
-      }
-    }
+    const float *const p000 = _clut_cube(input, clut, level, rgbd);
+
+    // the tetrahedron goes from P000 to P111 one axis at a time, by decreasing delta: sort the deltas along
+    // with the offsets of the axes instead of branching on the six cases
+    float d0 = rgbd[0], d1 = rgbd[1], d2 = rgbd[2];
+    size_t s0 = 4, s1 = 4 * level, s2 = 4 * level2;
+    if(d0 < d1) { const float d = d0; d0 = d1; d1 = d; const size_t t = s0; s0 = s1; s1 = t; }
+    if(d1 < d2) { const float d = d1; d1 = d2; d2 = d; const size_t t = s1; s1 = s2; s2 = t; }
+    if(d0 < d1) { const float d = d0; d0 = d1; d1 = d; const size_t t = s0; s0 = s1; s1 = t; }
+    const float *const pa = p000 + s0;
+    const float *const pb = pa + s1;
+    const float *const p111 = pb + s2;
+
+    for_each_channel(c, aligned(output))
+      output[c] = (1 - d0) * p000[c] + (d0 - d1) * pa[c] + (d1 - d2) * pb[c] + d2 * p111[c];
+    output[3] = alpha;
   }
 }
 
@@ -370,71 +308,47 @@ void correct_pixel_tetrahedral(const float *const in, float *const out,
 void correct_pixel_pyramid(const float *const in, float *const out,
                            const size_t pixel_nb, const float *const restrict clut, const uint16_t level)
 {
-  const int level2 = level * level;
+  const size_t level2 = (size_t)level * level;
 #ifdef _OPENMP
-#pragma omp parallel for SIMD() default(none) \
+#pragma omp parallel for default(none) \
   dt_omp_firstprivate(clut, in, level, level2, out, pixel_nb) \
   schedule(static)
 #endif
   for(size_t k = 0; k < (size_t)(pixel_nb * 4); k+=4)
   {
-    float *const input = ((float *const)in) + k;
-    float *const output = ((float *const)out) + k;
+    const float *const input = in + k;
+    float *const output = out + k;
+    const float alpha = input[3];
 
-    int rgbi[3];
     dt_aligned_pixel_t rgbd;
-    for(int c = 0; c < 3; ++c) input[c] = fminf(fmaxf(input[c], 0.0f), 1.0f);
-
-    rgbd[0] = input[0] * (float)(level - 1);
-    rgbd[1] = input[1] * (float)(level - 1);
-    rgbd[2] = input[2] * (float)(level - 1);
-
-    rgbi[0] = CLAMP((int)rgbd[0], 0, level - 2);
-    rgbi[1] = CLAMP((int)rgbd[1], 0, level - 2);
-    rgbi[2] = CLAMP((int)rgbd[2], 0, level - 2);
-
-    rgbd[0] = rgbd[0] - rgbi[0]; // delta red
-    rgbd[1] = rgbd[1] - rgbi[1]; // delta green
-    rgbd[2] = rgbd[2] - rgbi[2]; // delta blue
-
-  // indexes of P000 to P111 in clut
-    const int color = rgbi[0] + rgbi[1] * level + rgbi[2] * level * level;
-    const int i000 = color * 3;                     // P000
-    const int i100 = i000 + 3;                      // P100
-    const int i010 = (color + level) * 3;           // P010
-    const int i110 = i010 + 3;                      // P110
-    const int i001 = (color + level2) * 3;          // P001
-    const int i101 = i001 + 3;                      // P101
-    const int i011 = (color + level + level2) * 3;  // P011
-    const int i111 = i011 + 3;                      // P111
+    const float *const p000 = _clut_cube(input, clut, level, rgbd);
+    const float *const p100 = p000 + 4;
+    const float *const p010 = p000 + 4 * level;
+    const float *const p110 = p010 + 4;
+    const float *const p001 = p000 + 4 * level2;
+    const float *const p101 = p001 + 4;
+    const float *const p011 = p010 + 4 * level2;
+    const float *const p111 = p011 + 4;
 
     if (rgbd[1] > rgbd[0] && rgbd[2] > rgbd[0])
     {
-      output[0] = clut[i000] + (clut[i111]-clut[i011])*rgbd[0] + (clut[i010]-clut[i000])*rgbd[1] + (clut[i001]-clut[i000])*rgbd[2]
-        + (clut[i011]-clut[i001]-clut[i010]+clut[i000])*rgbd[1]*rgbd[2];
-      output[1] = clut[i000+1] + (clut[i111+1]-clut[i011+1])*rgbd[0] + (clut[i010+1]-clut[i000+1])*rgbd[1] + (clut[i001+1]-clut[i000+1])*rgbd[2]
-        + (clut[i011+1]-clut[i001+1]-clut[i010+1]+clut[i000+1])*rgbd[1]*rgbd[2];
-      output[2] = clut[i000+2] + (clut[i111+2]-clut[i011+2])*rgbd[0] + (clut[i010+2]-clut[i000+2])*rgbd[1] + (clut[i001+2]-clut[i000+2])*rgbd[2]
-        + (clut[i011+2]-clut[i001+2]-clut[i010+2]+clut[i000+2])*rgbd[1]*rgbd[2];
+      for_each_channel(c, aligned(output))
+        output[c] = p000[c] + (p111[c]-p011[c])*rgbd[0] + (p010[c]-p000[c])*rgbd[1] + (p001[c]-p000[c])*rgbd[2]
+          + (p011[c]-p001[c]-p010[c]+p000[c])*rgbd[1]*rgbd[2];
     }
     else if (rgbd[0] > rgbd[1] && rgbd[2] > rgbd[1])
     {
-      output[0] = clut[i000] + (clut[i100]-clut[i000])*rgbd[0] + (clut[i111]-clut[i101])*rgbd[1] + (clut[i001]-clut[i000])*rgbd[2]
-        + (clut[i101]-clut[i001]-clut[i100]+clut[i000])*rgbd[0]*rgbd[2];
-      output[1] = clut[i000+1] + (clut[i100+1]-clut[i000+1])*rgbd[0] + (clut[i111+1]-clut[i101+1])*rgbd[1] + (clut[i001+1]-clut[i000+1])*rgbd[2]
-        + (clut[i101+1]-clut[i001+1]-clut[i100+1]+clut[i000+1])*rgbd[0]*rgbd[2];
-      output[2] = clut[i000+2] + (clut[i100+2]-clut[i000+2])*rgbd[0] + (clut[i111]-clut[i101+2])*rgbd[1] + (clut[i001+2]-clut[i000+2])*rgbd[2]
-        + (clut[i101+2]-clut[i001+2]-clut[i100+2]+clut[i000+2])*rgbd[0]*rgbd[2];
+      for_each_channel(c, aligned(output))
+        output[c] = p000[c] + (p100[c]-p000[c])*rgbd[0] + (p111[c]-p101[c])*rgbd[1] + (p001[c]-p000[c])*rgbd[2]
+          + (p101[c]-p001[c]-p100[c]+p000[c])*rgbd[0]*rgbd[2];
     }
     else
     {
-      output[0] = clut[i000] + (clut[i100]-clut[i000])*rgbd[0] + (clut[i010]-clut[i000])*rgbd[1] + (clut[i111]-clut[i110])*rgbd[2]
-        + (clut[i110]-clut[i100]-clut[i010]+clut[i000])*rgbd[0]*rgbd[1];
-      output[1] = clut[i000+1] + (clut[i100+1]-clut[i000+1])*rgbd[0] + (clut[i010+1]-clut[i000+1])*rgbd[1] + (clut[i111+1]-clut[i110+1])*rgbd[2]
-        + (clut[i110+1]-clut[i100+1]-clut[i010+1]+clut[i000+1])*rgbd[0]*rgbd[1];
-      output[2] = clut[i000+2] + (clut[i100+2]-clut[i000+2])*rgbd[0] + (clut[i010+2]-clut[i000+2])*rgbd[1] + (clut[i111+2]-clut[i110+2])*rgbd[2]
-        + (clut[i110+2]-clut[i100+2]-clut[i010+2]+clut[i000+2])*rgbd[0]*rgbd[1];
+      for_each_channel(c, aligned(output))
+        output[c] = p000[c] + (p100[c]-p000[c])*rgbd[0] + (p010[c]-p000[c])*rgbd[1] + (p111[c]-p110[c])*rgbd[2]
+          + (p110[c]-p100[c]-p010[c]+p000[c])*rgbd[0]*rgbd[1];
     }
+    output[3] = alpha;
   }
 }
 
@@ -997,7 +911,7 @@ int process_cl(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, cl_m
 
   if (clut && level)
   {
-    clut_cl = dt_opencl_copy_host_to_device_constant(devid, sizeof(float) * 3 * level * level * level, (void *)clut);
+    clut_cl = dt_opencl_copy_host_to_device_constant(devid, sizeof(float) * 4 * level * level * level, (void *)clut);
     if(clut_cl == NULL)
     {
       fprintf(stderr, "[lut3d process_cl] error allocating memory\n");
@@ -1116,6 +1030,8 @@ void init_global(dt_iop_module_so_t *module)
   gd->kernel_lut3d_trilinear = dt_opencl_create_kernel(program, "lut3d_trilinear");
   gd->kernel_lut3d_pyramid = dt_opencl_create_kernel(program, "lut3d_pyramid");
   gd->kernel_lut3d_none = dt_opencl_create_kernel(program, "lut3d_none");
+  g_mutex_init(&gd->lock);
+  gd->cluts = NULL;
 
 #ifdef HAVE_GMIC
   // make sure the cache dir exists
@@ -1133,6 +1049,14 @@ void cleanup_global(dt_iop_module_so_t *module)
   dt_opencl_free_kernel(gd->kernel_lut3d_trilinear);
   dt_opencl_free_kernel(gd->kernel_lut3d_pyramid);
   dt_opencl_free_kernel(gd->kernel_lut3d_none);
+  for(GList *l = gd->cluts; l; l = g_list_next(l))
+  {
+    dt_iop_lut3d_clut_t *entry = (dt_iop_lut3d_clut_t *)l->data;
+    dt_free_align(entry->clut);
+    free(entry);
+  }
+  g_list_free(gd->cluts);
+  g_mutex_clear(&gd->lock);
   free(module->data);
   module->data = NULL;
 }
@@ -1175,6 +1099,145 @@ static int calculate_clut(dt_iop_lut3d_params_t *const p, float **clut)
   return level;
 }
 
+static inline uint64_t _hash_bytes(uint64_t hash, const void *data, const size_t size)
+{
+  // bernstein hash (djb2), like the pixelpipe cache
+  const char *str = (const char *)data;
+  for(size_t i = 0; i < size; i++) hash = ((hash << 5) + hash) ^ str[i];
+  return hash;
+}
+
+// identify the lut the params point to without reading it, 0 if there is none
+static uint64_t _clut_key(const dt_iop_lut3d_params_t *const p)
+{
+  uint64_t hash = 5381;
+  const char *filepath = p->filepath;
+  if(!filepath[0]) return 0;
+#ifdef HAVE_GMIC
+  if(p->nb_keypoints)
+  {
+    hash = _hash_bytes(hash, p->lutname, strlen(p->lutname));
+    hash = _hash_bytes(hash, &p->nb_keypoints, sizeof(p->nb_keypoints));
+    return _hash_bytes(hash, p->c_clut, MIN(p->nb_keypoints, DT_IOP_LUT3D_MAX_KEYPOINTS) * 2 * 3);
+  }
+#endif // HAVE_GMIC
+  gchar *lutfolder = dt_conf_get_string("plugins/darkroom/lut3d/def_path");
+  char *fullpath = g_build_filename(lutfolder, filepath, NULL);
+  GStatBuf st;
+  if(lutfolder[0] && g_stat(fullpath, &st) == 0)
+  {
+    hash = _hash_bytes(hash, fullpath, strlen(fullpath));
+    hash = _hash_bytes(hash, &st.st_size, sizeof(st.st_size));
+    hash = _hash_bytes(hash, &st.st_mtime, sizeof(st.st_mtime));
+  }
+  else
+    hash = 0;
+  g_free(fullpath);
+  g_free(lutfolder);
+  return hash;
+}
+
+// free the least recently used luts nobody holds while above the cache size, call with the lock held
+static void _clut_evict(dt_iop_lut3d_global_data_t *gd)
+{
+  size_t used = 0;
+  for(GList *l = gd->cluts; l; l = g_list_next(l))
+  {
+    const dt_iop_lut3d_clut_t *entry = (dt_iop_lut3d_clut_t *)l->data;
+    used += sizeof(float) * 4 * entry->level * entry->level * entry->level;
+  }
+  GList *l = g_list_last(gd->cluts);
+  while(l && used > DT_IOP_LUT3D_CACHE_SIZE)
+  {
+    GList *prev = g_list_previous(l);
+    dt_iop_lut3d_clut_t *entry = (dt_iop_lut3d_clut_t *)l->data;
+    if(!entry->users)
+    {
+      used -= sizeof(float) * 4 * entry->level * entry->level * entry->level;
+      dt_free_align(entry->clut);
+      free(entry);
+      gd->cluts = g_list_delete_link(gd->cluts, l);
+    }
+    l = prev;
+  }
+}
+
+// get the lut of the params from the cache, reading it on a miss. NULL if it could not be read.
+static dt_iop_lut3d_clut_t *_clut_get(dt_iop_lut3d_global_data_t *gd, dt_iop_lut3d_params_t *const p)
+{
+  const uint64_t key = _clut_key(p);
+  if(key)
+  {
+    g_mutex_lock(&gd->lock);
+    for(GList *l = gd->cluts; l; l = g_list_next(l))
+    {
+      dt_iop_lut3d_clut_t *entry = (dt_iop_lut3d_clut_t *)l->data;
+      if(entry->key != key) continue;
+      entry->users++;
+      gd->cluts = g_list_remove_link(gd->cluts, l);
+      gd->cluts = g_list_concat(l, gd->cluts);
+      g_mutex_unlock(&gd->lock);
+      return entry;
+    }
+    g_mutex_unlock(&gd->lock);
+  }
+
+  float *clut = NULL;
+  const uint16_t level = calculate_clut(p, &clut);
+  if(!level)
+  {
+    if(clut) dt_free_align(clut);
+    return NULL;
+  }
+
+  // pad the nodes to 4 floats
+  const size_t nodes = (size_t)level * level * level;
+  dt_iop_lut3d_clut_t *entry = malloc(sizeof(dt_iop_lut3d_clut_t));
+  float *padded = dt_alloc_align_float(4 * nodes);
+  if(!entry || !padded)
+  {
+    fprintf(stderr, "[lut3d] error allocating buffer for lut\n");
+    dt_control_log(_("error allocating buffer for lut"));
+    free(entry);
+    if(padded) dt_free_align(padded);
+    dt_free_align(clut);
+    return NULL;
+  }
+  for(size_t k = 0; k < nodes; k++)
+  {
+    for(int c = 0; c < 3; c++) padded[4*k + c] = clut[3*k + c];
+    padded[4*k + 3] = 0.0f;
+  }
+  dt_free_align(clut);
+
+  entry->key = key;
+  entry->clut = padded;
+  entry->level = level;
+  entry->users = 1;
+  g_mutex_lock(&gd->lock);
+  // a lut we can't identify is not shared, it is only in the list to be freed with the module
+  gd->cluts = g_list_prepend(gd->cluts, entry);
+  _clut_evict(gd);
+  g_mutex_unlock(&gd->lock);
+  return entry;
+}
+
+static void _clut_release(dt_iop_lut3d_global_data_t *gd, dt_iop_lut3d_clut_t *entry)
+{
+  if(!entry) return;
+  g_mutex_lock(&gd->lock);
+  entry->users--;
+  if(!entry->users && !entry->key)
+  {
+    gd->cluts = g_list_remove(gd->cluts, entry);
+    dt_free_align(entry->clut);
+    free(entry);
+  }
+  else
+    _clut_evict(gd);
+  g_mutex_unlock(&gd->lock);
+}
+
 #ifdef HAVE_GMIC
 static gboolean list_match_string(GtkTreeModel *model, GtkTreePath *path, GtkTreeIter *iter, dt_iop_lut3d_gui_data_t *g)
 {
@@ -1348,13 +1411,11 @@ void commit_params(struct dt_iop_module_t *self, dt_iop_params_t *p1, dt_dev_pix
 
   if (strcmp(p->filepath, d->params.filepath) != 0 || strcmp(p->lutname, d->params.lutname) != 0 )
   { // new clut file
-    if (d->clut)
-    { // reset current clut if any
-      dt_free_align(d->clut);
-      d->clut = NULL;
-      d->level = 0;
-    }
-    d->level = calculate_clut(p, &d->clut);
+    dt_iop_lut3d_global_data_t *gd = (dt_iop_lut3d_global_data_t *)self->global_data;
+    _clut_release(gd, d->entry);
+    d->entry = _clut_get(gd, p);
+    d->clut = d->entry ? d->entry->clut : NULL;
+    d->level = d->entry ? d->entry->level : 0;
   }
   memcpy(&d->params, p, sizeof(dt_iop_lut3d_params_t));
 }
@@ -1364,6 +1425,7 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
   piece->data = malloc(sizeof(dt_iop_lut3d_data_t));
   dt_iop_lut3d_data_t *d = (dt_iop_lut3d_data_t *)piece->data;
   memcpy(&d->params, self->default_params, sizeof(dt_iop_lut3d_params_t));
+  d->entry = NULL;
   d->clut = NULL;
   d->level = 0;
   d->params.filepath[0] = '\0';
@@ -1371,9 +1433,9 @@ void init_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pi
 
 void cleanup_pipe(struct dt_iop_module_t *self, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece)
 {
-  dt_iop_lut3d_data_t *d = (dt_iop_lut3d_data_t *)piece->data;;
-  if (d->clut)
-    dt_free_align(d->clut);
+  dt_iop_lut3d_data_t *d = (dt_iop_lut3d_data_t *)piece->data;
+  _clut_release((dt_iop_lut3d_global_data_t *)self->global_data, d->entry);
+  d->entry = NULL;
   d->clut = NULL;
   d->level = 0;
   free(piece->data);
@@ -28,6 +28,7 @@
 #include "common/heal.h"
 #include "common/imagebuf.h"
 #include "common/opencl.h"
+#include "common/wavelet_cache.h"
 #include "develop/blend.h"
 #include "develop/imageop_math.h"
 #include "develop/imageop_gui.h"
@@ -3458,6 +3459,13 @@ static void rt_process_forms(float *layer, dwt_params_t *const wt_p, const int s
   }
 }
 
+static gboolean rt_has_forms_on_scale(const dt_iop_retouch_params_t *const p, const int scale)
+{
+  for(int i = 0; i < RETOUCH_NO_FORMS; i++)
+    if(p->rt_forms[i].formid != 0 && p->rt_forms[i].scale == scale) return TRUE;
+  return FALSE;
+}
+
 static void process_internal(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const void *const ivoid,
                              void *const ovoid, const dt_iop_roi_t *const roi_in,
                              const dt_iop_roi_t *const roi_out, const int use_sse)
@@ -3530,6 +3538,11 @@ static void process_internal(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
     if(g) g->first_scale_visible = dt_dwt_first_scale_visible(dwt_p);
   }
 
+  // the scales of the input are kept between pipe runs, unless the image itself is changed before the
+  // decomposition: by shapes on scale 0 or by the mask display
+  if(!usr_data.mask_display && !rt_has_forms_on_scale(p, 0))
+    dwt_p->cache_key = dt_wavelet_cache_key(piece, roi_in, DT_WAVELET_DWT, p->num_scales);
+
   // decompose it
   dwt_decompose(dwt_p, rt_process_forms);
 
@@ -790,11 +790,13 @@ static inline float pixel_correction(const float exposure,
 }
 
 
+// returns 0 on success, 1 if the guided filter could not be applied
 __DT_CLONE_TARGETS__
-static inline void compute_luminance_mask(const float *const restrict in, float *const restrict luminance,
+static inline int compute_luminance_mask(const float *const restrict in, float *const restrict luminance,
                                           const size_t width, const size_t height, const size_t ch,
                                           const dt_iop_toneequalizer_data_t *const d)
 {
+  int err = 0;
   switch(d->details)
   {
     case(DT_TONEEQ_NONE):
@@ -808,7 +810,7 @@ static inline void compute_luminance_mask(const float *const restrict in, float
     {
       // Still no contrast boost
       luminance_mask(in, luminance, width, height, ch, d->method, d->exposure_boost, 0.0f, 1.0f);
-      fast_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
+      err = fast_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
                     DT_GF_BLENDING_GEOMEAN, d->scale, d->quantization, exp2f(-14.0f), 4.0f);
       break;
     }
@@ -824,7 +826,7 @@ static inline void compute_luminance_mask(const float *const restrict in, float
       // the exposure boost should be used to make this assumption true
       luminance_mask(in, luminance, width, height, ch, d->method, d->exposure_boost,
                       CONTRAST_FULCRUM, d->contrast_boost);
-      fast_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
+      err = fast_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
                     DT_GF_BLENDING_LINEAR, d->scale, d->quantization, exp2f(-14.0f), 4.0f);
       break;
     }
@@ -833,7 +835,7 @@ static inline void compute_luminance_mask(const float *const restrict in, float
     {
       // Still no contrast boost
       luminance_mask(in, luminance, width, height, ch, d->method, d->exposure_boost, 0.0f, 1.0f);
-      fast_eigf_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
+      err = fast_eigf_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
                     DT_GF_BLENDING_GEOMEAN, d->scale, d->quantization, exp2f(-14.0f), 4.0f);
       break;
     }
@@ -842,7 +844,7 @@ static inline void compute_luminance_mask(const float *const restrict in, float
     {
       luminance_mask(in, luminance, width, height, ch, d->method, d->exposure_boost,
                       CONTRAST_FULCRUM, d->contrast_boost);
-      fast_eigf_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
+      err = fast_eigf_surface_blur(luminance, width, height, d->radius, d->feathering, d->iterations,
                     DT_GF_BLENDING_LINEAR, d->scale, d->quantization, exp2f(-14.0f), 4.0f);
       break;
     }
@@ -853,6 +855,7 @@ static inline void compute_luminance_mask(const float *const restrict in, float
       break;
     }
   }
+  return err;
 }
 
 
@@ -1020,6 +1023,7 @@ void toneeq_process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
   }
 
   // Compute the luminance mask
+  int err = 0;
   if(cached)
   {
     // caching path : store the luminance mask for GUI access
@@ -1036,8 +1040,9 @@ void toneeq_process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
       if(hash != saved_hash || !luminance_valid)
       {
         /* compute only if upstream pipe state has changed */
-        compute_luminance_mask(in, luminance, width, height, ch, d);
-        hash_set_get(&hash, &g->ui_preview_hash, &self->gui_lock);
+        err = compute_luminance_mask(in, luminance, width, height, ch, d);
+        // a failed mask is not cached, it will be computed again
+        if(!err) hash_set_get(&hash, &g->ui_preview_hash, &self->gui_lock);
       }
     }
     else if((piece->pipe->type & DT_DEV_PIXELPIPE_PREVIEW) == DT_DEV_PIXELPIPE_PREVIEW)
@@ -1053,22 +1058,30 @@ void toneeq_process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece,
       {
         /* compute only if upstream pipe state has changed */
         dt_iop_gui_enter_critical_section(self);
-        g->thumb_preview_hash = hash;
         g->histogram_valid = FALSE;
-        compute_luminance_mask(in, luminance, width, height, ch, d);
-        g->luminance_valid = TRUE;
+        err = compute_luminance_mask(in, luminance, width, height, ch, d);
+        g->thumb_preview_hash = err ? 0 : hash;
+        g->luminance_valid = !err;
         dt_iop_gui_leave_critical_section(self);
       }
     }
     else // make it dummy-proof
     {
-      compute_luminance_mask(in, luminance, width, height, ch, d);
+      err = compute_luminance_mask(in, luminance, width, height, ch, d);
     }
   }
   else
   {
     // no caching path : compute no matter what
-    compute_luminance_mask(in, luminance, width, height, ch, d);
+    err = compute_luminance_mask(in, luminance, width, height, ch, d);
+  }
+
+  if(err)
+  {
+    // the unfiltered mask would make a different picture, rather pass the input through
+    dt_iop_copy_image_roi(out, in, ch, roi_in, roi_out, TRUE);
+    if(!cached) dt_free_align(luminance);
+    return;
   }
 
   // Display output
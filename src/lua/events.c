@@ -72,6 +72,28 @@ void dt_lua_event_trigger(lua_State *L, const char *event, int nargs)
   dt_lua_redraw_screen();
 }
 
+int dt_lua_event_in_use(lua_State *L, const char *event)
+{
+  lua_getfield(L, LUA_REGISTRYINDEX, "dt_lua_event_list");
+  if(lua_isnil(L, -1))
+  { // events have been disabled
+    lua_pop(L, 1);
+    return 0;
+  }
+
+  lua_getfield(L, -1, event);
+  if(lua_isnil(L, -1))
+  { // event doesn't exist
+    lua_pop(L, 2);
+    return 0;
+  }
+
+  lua_getfield(L, -1, "in_use");
+  const int in_use = lua_toboolean(L, -1);
+  lua_pop(L, 3);
+  return in_use;
+}
+
 int dt_lua_event_trigger_wrapper(lua_State *L)
 {
   // event name
@@ -63,6 +63,11 @@ void dt_lua_event_add(lua_State *L, const char *evt_name);
   */
 void dt_lua_event_trigger(lua_State *L, const char *event, int nargs);
 
+/**
+  check whether callbacks are registered for an event, with the lua lock held
+  */
+int dt_lua_event_in_use(lua_State *L, const char *event);
+
 /**
   wrapper for the previous function to use with dt_lua_async_call
   first parameter is the event name
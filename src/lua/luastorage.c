@@ -207,7 +207,7 @@ static int initialize_store_wrapper(struct dt_imageio_module_storage_t *self, dt
   dt_lua_unlock();
   return 0;
 }
-static void finalize_store_wrapper(struct dt_imageio_module_storage_t *self, dt_imageio_module_data_t *data)
+static int finalize_store_wrapper(struct dt_imageio_module_storage_t *self, dt_imageio_module_data_t *data)
 {
   dt_lua_lock();
   lua_State *L = darktable.lua_state.state;
@@ -220,7 +220,7 @@ static void finalize_store_wrapper(struct dt_imageio_module_storage_t *self, dt_
   {
     lua_pop(L, 3);
     dt_lua_unlock();
-    return;
+    return 0;
   }
 
   luaA_push_type(L, self->parameter_lua_type, data);
@@ -235,6 +235,7 @@ static void finalize_store_wrapper(struct dt_imageio_module_storage_t *self, dt_
   dt_lua_treated_pcall(L, 3, 0);
   lua_pop(L, 2);
   dt_lua_unlock();
+  return 0;
 }
 static size_t params_size_wrapper(struct dt_imageio_module_storage_t *self)
 {
@@ -0,0 +1,206 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2023 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the AVX2 and AVX-512 variants of the SSE2 Lab
+ * conversions in common/colorspaces_inline_conversions.h, used by the matrix
+ * paths of colorin and colorout: they have to give the same results as the
+ * SSE2 ones.
+ *
+ * Please see ../README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/colorspaces_inline_conversions.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// a multiple of 4 pixels, the leftovers are handled by the SSE2 code in the modules
+#define PIXELS 4096
+
+// with strict IEEE math the results are bit-identical, -ffast-math lets the
+// compiler reassociate each variant differently:
+#ifdef __FAST_MATH__
+#define E 1e-3f
+#else
+#define E 0.0f
+#endif
+
+#ifdef DT_HAVE_AVX_KERNELS
+
+typedef enum direction_t
+{
+  XYZ_TO_LAB,
+  LAB_TO_XYZ
+} direction_t;
+
+typedef struct buffers_t
+{
+  float *xyz;
+  float *lab;
+  float *out[3];
+} buffers_t;
+
+static void convert_sse2(const float *const in, float *const out, const direction_t dir)
+{
+  for(int k = 0; k < PIXELS; k++)
+  {
+    const __m128 v = _mm_load_ps(in + 4 * k);
+    _mm_store_ps(out + 4 * k, dir == XYZ_TO_LAB ? dt_XYZ_to_Lab_sse2(v) : dt_Lab_to_XYZ_sse2(v));
+  }
+}
+
+__DT_TARGET_AVX2__
+static void convert_avx2(const float *const in, float *const out, const direction_t dir)
+{
+  for(int k = 0; k < PIXELS / 2; k++)
+  {
+    const __m256 v = _mm256_load_ps(in + 8 * k);
+    _mm256_store_ps(out + 8 * k, dir == XYZ_TO_LAB ? dt_XYZ_to_Lab_avx2(v) : dt_Lab_to_XYZ_avx2(v));
+  }
+}
+
+__DT_TARGET_AVX512__
+static void convert_avx512(const float *const in, float *const out, const direction_t dir)
+{
+  for(int k = 0; k < PIXELS / 4; k++)
+  {
+    const __m512 v = _mm512_load_ps(in + 16 * k);
+    _mm512_store_ps(out + 16 * k, dir == XYZ_TO_LAB ? dt_XYZ_to_Lab_avx512(v) : dt_Lab_to_XYZ_avx512(v));
+  }
+}
+
+static void assert_pixels_close(const float *const a, const float *const b)
+{
+  for(size_t k = 0; k < (size_t)4 * PIXELS; k++)
+  {
+    if(E == 0.0f)
+      assert_memory_equal(a + k, b + k, sizeof(float));
+    else
+      assert_float_equal(a[k], b[k], E * (1.0f + fabsf(a[k])));
+  }
+}
+
+static int setup(void **state)
+{
+  buffers_t *b = calloc(1, sizeof(buffers_t));
+  b->xyz = dt_alloc_align_float((size_t)4 * PIXELS);
+  b->lab = dt_alloc_align_float((size_t)4 * PIXELS);
+  for(int k = 0; k < 3; k++) b->out[k] = dt_alloc_align_float((size_t)4 * PIXELS);
+
+  // both sides of the linear segments near black, and out of gamut values
+  unsigned int seed = 4242;
+  for(int k = 0; k < PIXELS; k++)
+  {
+    float r[3];
+    for(int c = 0; c < 3; c++)
+    {
+      seed = seed * 1103515245u + 12345u;
+      r[c] = (float)(seed >> 8 & 0xffff) / 65536.0f;
+    }
+    const float scale = (k % 8 == 0) ? 0.01f : 1.2f;
+    b->xyz[4 * k + 0] = scale * r[0];
+    b->xyz[4 * k + 1] = scale * r[1];
+    b->xyz[4 * k + 2] = scale * r[2];
+    b->xyz[4 * k + 3] = 1.0f;
+    b->lab[4 * k + 0] = 110.0f * r[0] - 5.0f;
+    b->lab[4 * k + 1] = 260.0f * r[1] - 130.0f;
+    b->lab[4 * k + 2] = 260.0f * r[2] - 130.0f;
+    b->lab[4 * k + 3] = 1.0f;
+  }
+  *state = b;
+  return 0;
+}
+
+static int teardown(void **state)
+{
+  buffers_t *b = *state;
+  dt_free_align(b->xyz);
+  dt_free_align(b->lab);
+  for(int k = 0; k < 3; k++) dt_free_align(b->out[k]);
+  free(b);
+  return 0;
+}
+
+static void check_direction(buffers_t *b, const float *const in, const direction_t dir)
+{
+  convert_sse2(in, b->out[0], dir);
+  convert_avx2(in, b->out[1], dir);
+  assert_pixels_close(b->out[0], b->out[1]);
+
+  if(!__builtin_cpu_supports("avx512f")) return;
+  convert_avx512(in, b->out[2], dir);
+  assert_pixels_close(b->out[0], b->out[2]);
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_xyz_to_lab(void **state)
+{
+  buffers_t *b = *state;
+  if(!__builtin_cpu_supports("avx2")) skip();
+  check_direction(b, b->xyz, XYZ_TO_LAB);
+}
+
+static void test_lab_to_xyz(void **state)
+{
+  buffers_t *b = *state;
+  if(!__builtin_cpu_supports("avx2")) skip();
+  check_direction(b, b->lab, LAB_TO_XYZ);
+}
+
+#endif // DT_HAVE_AVX_KERNELS
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+#ifdef DT_HAVE_AVX_KERNELS
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_xyz_to_lab),
+    cmocka_unit_test(test_lab_to_xyz)
+  };
+
+  return cmocka_run_group_tests(tests, setup, teardown);
+#else
+  return 0;
+#endif
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -0,0 +1,213 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2023 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for the AVX2 and AVX-512 variants of the SSE2 wavelet
+ * kernels in common/eaw.c: they have to give the same results as the SSE2
+ * ones.
+ *
+ * Please see ../README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "common/eaw.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+// odd sizes, so that the wide kernels have leftover pixels on each row:
+#define WIDTH 203
+#define HEIGHT 157
+
+// with strict IEEE math the results are bit-identical, -ffast-math lets the
+// compiler reassociate each variant differently:
+#ifdef __FAST_MATH__
+#define E 1e-3f
+#else
+#define E 0.0f
+#endif
+
+#ifdef DT_HAVE_AVX_KERNELS
+
+typedef struct buffers_t
+{
+  float *in;
+  float *coarse[3];
+  float *detail[3];
+} buffers_t;
+
+static float *alloc_image(void)
+{
+  return dt_alloc_align_float((size_t)4 * WIDTH * HEIGHT);
+}
+
+// deterministic texture with edges and noise-like detail:
+static void fill_image(float *const img)
+{
+  for(int y = 0; y < HEIGHT; y++)
+    for(int x = 0; x < WIDTH; x++)
+    {
+      float *p = img + 4 * ((size_t)y * WIDTH + x);
+      const float edge = (x > WIDTH / 3 && y < 2 * HEIGHT / 3) ? 40.0f : 0.0f;
+      p[0] = 50.0f + edge + 10.0f * sinf(0.9f * x) * cosf(1.3f * y);
+      p[1] = 20.0f * sinf(0.37f * x + 0.11f * y * y);
+      p[2] = -15.0f * cosf(0.05f * x * y);
+      p[3] = 1.0f;
+    }
+}
+
+static void assert_images_close(const float *const a, const float *const b)
+{
+  for(size_t k = 0; k < (size_t)4 * WIDTH * HEIGHT; k++)
+  {
+    if(E == 0.0f)
+      assert_memory_equal(a + k, b + k, sizeof(float));
+    else
+      assert_float_equal(a[k], b[k], E * (1.0f + fabsf(a[k])));
+  }
+}
+
+static int setup(void **state)
+{
+  buffers_t *b = calloc(1, sizeof(buffers_t));
+  b->in = alloc_image();
+  fill_image(b->in);
+  for(int k = 0; k < 3; k++)
+  {
+    b->coarse[k] = alloc_image();
+    b->detail[k] = alloc_image();
+  }
+  *state = b;
+  return 0;
+}
+
+static int teardown(void **state)
+{
+  buffers_t *b = *state;
+  dt_free_align(b->in);
+  for(int k = 0; k < 3; k++)
+  {
+    dt_free_align(b->coarse[k]);
+    dt_free_align(b->detail[k]);
+  }
+  free(b);
+  return 0;
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_decompose(void **state)
+{
+  buffers_t *b = *state;
+  const int has_avx512 = __builtin_cpu_supports("avx512f");
+  if(!__builtin_cpu_supports("avx2")) skip();
+
+  for(int scale = 0; scale < 4; scale++)
+  {
+    eaw_decompose_sse2(b->coarse[0], b->in, b->detail[0], scale, 0.01f, WIDTH, HEIGHT);
+    eaw_decompose_avx2(b->coarse[1], b->in, b->detail[1], scale, 0.01f, WIDTH, HEIGHT);
+    assert_images_close(b->coarse[0], b->coarse[1]);
+    assert_images_close(b->detail[0], b->detail[1]);
+
+    if(!has_avx512) continue;
+    eaw_decompose_avx512(b->coarse[2], b->in, b->detail[2], scale, 0.01f, WIDTH, HEIGHT);
+    assert_images_close(b->coarse[0], b->coarse[2]);
+    assert_images_close(b->detail[0], b->detail[2]);
+  }
+}
+
+static void test_dn_decompose(void **state)
+{
+  buffers_t *b = *state;
+  const int has_avx512 = __builtin_cpu_supports("avx512f");
+  if(!__builtin_cpu_supports("avx2")) skip();
+
+  for(int scale = 0; scale < 4; scale++)
+  {
+    dt_aligned_pixel_t sum_sq[3];
+    eaw_dn_decompose_sse(b->coarse[0], b->in, b->detail[0], sum_sq[0], scale, 0.3f, WIDTH, HEIGHT);
+    eaw_dn_decompose_avx2(b->coarse[1], b->in, b->detail[1], sum_sq[1], scale, 0.3f, WIDTH, HEIGHT);
+    assert_images_close(b->coarse[0], b->coarse[1]);
+    assert_images_close(b->detail[0], b->detail[1]);
+    // the per-thread partial sums are combined in an unspecified order:
+    for(int c = 0; c < 3; c++) assert_float_equal(sum_sq[0][c], sum_sq[1][c], 1e-4f * sum_sq[0][c]);
+
+    if(!has_avx512) continue;
+    eaw_dn_decompose_avx512(b->coarse[2], b->in, b->detail[2], sum_sq[2], scale, 0.3f, WIDTH, HEIGHT);
+    assert_images_close(b->coarse[0], b->coarse[2]);
+    assert_images_close(b->detail[0], b->detail[2]);
+    for(int c = 0; c < 3; c++) assert_float_equal(sum_sq[0][c], sum_sq[2][c], 1e-4f * sum_sq[0][c]);
+  }
+}
+
+static void test_synthesize(void **state)
+{
+  buffers_t *b = *state;
+  const dt_aligned_pixel_t threshold = { 1.0f, 2.0f, 3.0f, 0.0f };
+  const dt_aligned_pixel_t boost = { 1.5f, 0.5f, 2.0f, 1.0f };
+  if(!__builtin_cpu_supports("avx2")) skip();
+
+  // use the input as detail layer too, it has both signs
+  eaw_synthesize_sse2(b->coarse[0], b->in, b->in, threshold, boost, WIDTH, HEIGHT);
+  eaw_synthesize_avx2(b->coarse[1], b->in, b->in, threshold, boost, WIDTH, HEIGHT);
+  assert_images_close(b->coarse[0], b->coarse[1]);
+
+  if(!__builtin_cpu_supports("avx512f")) return;
+  eaw_synthesize_avx512(b->coarse[2], b->in, b->in, threshold, boost, WIDTH, HEIGHT);
+  assert_images_close(b->coarse[0], b->coarse[2]);
+}
+
+#endif // DT_HAVE_AVX_KERNELS
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+#ifdef DT_HAVE_AVX_KERNELS
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_decompose),
+    cmocka_unit_test(test_dn_decompose),
+    cmocka_unit_test(test_synthesize)
+  };
+
+  return cmocka_run_group_tests(tests, setup, teardown);
+#else
+  return 0;
+#endif
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
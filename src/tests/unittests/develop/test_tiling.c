@@ -0,0 +1,184 @@
+/*
+    This file is part of darktable,
+    Copyright (C) 2023 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+/*
+ * cmocka unit tests for dt_tiling_get_area() in develop/tiling.c: processing
+ * a module on the area it returns for some bounds has to give the same pixels
+ * in those bounds as processing it on the whole roi, also for modules working
+ * on a CFA pattern anchored at their buffer origin.
+ *
+ * Please see ../README.md for more detailed documentation.
+ */
+#include <limits.h>
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <cmocka.h>
+
+#include "develop/tiling.h"
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+/*
+ * DEFINITIONS
+ */
+
+#define RADIUS 4
+
+// an odd roi away from the image origin:
+static const dt_iop_roi_t roi = { .x = 7, .y = 5, .width = 97, .height = 83, .scale = 1.0f };
+
+/*
+ * HELPERS
+ */
+
+static float *make_input(void)
+{
+  float *img = malloc(sizeof(float) * roi.width * roi.height);
+  unsigned int seed = 12345;
+  for(int k = 0; k < roi.width * roi.height; k++)
+  {
+    seed = seed * 1103515245u + 12345u;
+    img[k] = (float)(seed >> 16 & 0x7fff) / 32768.0f;
+  }
+  return img;
+}
+
+// stands for a raw module: each pixel gets a gain that depends on its place in
+// a period x period pattern counted from the buffer origin, plus the mean of
+// the pixels of the same colour around it, clipped at the buffer edges.
+static void process(const float *const in, float *const out, const int width, const int height,
+                    const int period)
+{
+  for(int y = 0; y < height; y++)
+    for(int x = 0; x < width; x++)
+    {
+      const int c = (y % period) * period + x % period;
+      float sum = 0.0f;
+      int n = 0;
+      for(int dy = -RADIUS; dy <= RADIUS; dy += period)
+        for(int dx = -RADIUS; dx <= RADIUS; dx += period)
+        {
+          const int xx = x + dx, yy = y + dy;
+          if(xx < 0 || yy < 0 || xx >= width || yy >= height) continue;
+          sum += in[(size_t)yy * width + xx];
+          n++;
+        }
+      out[(size_t)y * width + x] = (1.0f + c) * in[(size_t)y * width + x] + sum / n;
+    }
+}
+
+static void check_area(const float *const input, const float *const full, const dt_iop_roi_t *const bounds,
+                       const int period)
+{
+  const dt_develop_tiling_t tiling = { .overlap = RADIUS, .xalign = period, .yalign = period };
+  dt_iop_roi_t area;
+  dt_tiling_get_area(&tiling, &roi, bounds, &area);
+
+  // inside the roi, on its alignment grid, and covering the bounds with their overlap
+  assert_true(area.x >= roi.x && area.y >= roi.y);
+  assert_true(area.x + area.width <= roi.x + roi.width && area.y + area.height <= roi.y + roi.height);
+  assert_int_equal((area.x - roi.x) % period, 0);
+  assert_int_equal((area.y - roi.y) % period, 0);
+  assert_true(area.x <= MAX(bounds->x - RADIUS, roi.x) && area.y <= MAX(bounds->y - RADIUS, roi.y));
+  assert_true(area.x + area.width >= MIN(bounds->x + bounds->width + RADIUS, roi.x + roi.width));
+  assert_true(area.y + area.height >= MIN(bounds->y + bounds->height + RADIUS, roi.y + roi.height));
+
+  float *area_in = malloc(sizeof(float) * area.width * area.height);
+  float *area_out = malloc(sizeof(float) * area.width * area.height);
+  for(int j = 0; j < area.height; j++)
+    memcpy(area_in + (size_t)j * area.width,
+           input + (size_t)(area.y - roi.y + j) * roi.width + (area.x - roi.x), sizeof(float) * area.width);
+
+  process(area_in, area_out, area.width, area.height, period);
+
+  for(int j = bounds->y; j < bounds->y + bounds->height; j++)
+    for(int i = bounds->x; i < bounds->x + bounds->width; i++)
+      assert_memory_equal(area_out + (size_t)(j - area.y) * area.width + (i - area.x),
+                          full + (size_t)(j - roi.y) * roi.width + (i - roi.x), sizeof(float));
+
+  free(area_in);
+  free(area_out);
+}
+
+static void check_period(const int period)
+{
+  float *input = make_input();
+  float *full = malloc(sizeof(float) * roi.width * roi.height);
+  process(input, full, roi.width, roi.height, period);
+
+  const dt_iop_roi_t bounds[] = {
+    { .x = 30, .y = 20, .width = 11, .height = 9 },   // inside, odd origin and size
+    { .x = 31, .y = 21, .width = 10, .height = 10 },  // inside, the other parity
+    { .x = 7, .y = 5, .width = 5, .height = 3 },      // top left corner of the roi
+    { .x = 9, .y = 6, .width = 3, .height = 3 },      // overlap crossing the roi origin
+    { .x = 98, .y = 80, .width = 6, .height = 8 },    // bottom right corner of the roi
+    { .x = 95, .y = 40, .width = 6, .height = 7 },    // overlap crossing the right edge
+    { .x = 50, .y = 50, .width = 1, .height = 1 },    // a single pixel
+  };
+  for(size_t k = 0; k < sizeof(bounds) / sizeof(bounds[0]); k++)
+    check_area(input, full, &bounds[k], period);
+
+  free(input);
+  free(full);
+}
+
+/*
+ * TEST FUNCTIONS
+ */
+
+static void test_area_unaligned(void **state)
+{
+  check_period(1);
+}
+
+static void test_area_bayer(void **state)
+{
+  check_period(2);
+}
+
+static void test_area_xtrans(void **state)
+{
+  check_period(3);
+}
+
+/*
+ * MAIN FUNCTION
+ */
+int main(int argc, char* argv[])
+{
+  const struct CMUnitTest tests[] = {
+    cmocka_unit_test(test_area_unaligned),
+    cmocka_unit_test(test_area_bayer),
+    cmocka_unit_test(test_area_xtrans)
+  };
+
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
+
+// clang-format off
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.py
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
+// clang-format on
@@ -108,7 +108,7 @@ static const char *mime(dt_imageio_module_data_t *data)
 static int write_image(dt_imageio_module_data_t *datai, const char *filename, const void *in,
                        dt_colorspaces_color_profile_type_t over_type, const char *over_filename,
                        void *exif, int exif_len, int imgid, int num, int total, dt_dev_pixelpipe_t *pipe,
-                       const gboolean export_masks)
+                       const gboolean export_masks, struct dt_export_metadata_t *metadata)
 {
   dt_slideshow_format_t *data = (dt_slideshow_format_t *)datai;
 